@@ -52,7 +52,10 @@ class ParsedExpression;
  * it many times as quickly as possible.  You should treat it as an opaque object; none of the internal representation
  * is visible.
  * 
- * A CompiledExpression is created by calling createCompiledExpression() on a ParsedExpression.
+ * A CompiledExpression is created by calling createCompiledExpression() on a ParsedExpression.  Alternatively,
+ * you can create one from a list of related ParsedExpressions, such as an energy and its derivatives.  All of them
+ * are then computed by a single call to evaluate(), and any subexpression that appears in more than one of them
+ * is only computed once.
  * 
  * WARNING: CompiledExpression is NOT thread safe.  You should never access a CompiledExpression from two threads at
  * the same time.
@@ -61,6 +64,11 @@ class ParsedExpression;
 class LEPTON_EXPORT CompiledExpression {
 public:
     CompiledExpression();
+    /**
+     * Create a CompiledExpression that computes several expressions at once.  Call evaluate() to compute
+     * all of them, then getOutput() to retrieve the value of each one.
+     */
+    CompiledExpression(const std::vector<ParsedExpression>& expressions);
     CompiledExpression(const CompiledExpression& expression);
     ~CompiledExpression();
     CompiledExpression& operator=(const CompiledExpression& expression);
@@ -74,16 +82,30 @@ public:
      */
     double& getVariableReference(const std::string& name);
     /**
-     * Evaluate the expression.  The values of all variables should have been set before calling this.
+     * Evaluate the expression.  The values of all variables should have been set before calling this.  If this
+     * object was created from multiple expressions, all of them are evaluated and the value of the first one is
+     * returned.
      */
     double evaluate() const;
+    /**
+     * Get the number of expressions computed by evaluate().
+     */
+    int getNumOutputs() const;
+    /**
+     * Get the value of one of the expressions, as computed by the most recent call to evaluate().
+     * 
+     * @param index    the index of the expression, in the order they were passed to the constructor
+     */
+    double getOutput(int index) const;
 private:
     friend class ParsedExpression;
     CompiledExpression(const ParsedExpression& expression);
+    void compileExpressions(const std::vector<ParsedExpression>& expressions);
     void compileExpression(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
     int findTempIndex(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
     std::vector<std::vector<int> > arguments;
     std::vector<int> target;
+    std::vector<int> outputIndex;
     std::vector<Operation*> operation;
     std::map<std::string, int> variableIndices;
     std::set<std::string> variableNames;
@@ -94,6 +116,7 @@ private:
 #ifdef LEPTON_USE_JIT
     void generateJitCode();
     void generateSingleArgCall(asmjit::X86Compiler& c, asmjit::X86XmmVar& dest, asmjit::X86XmmVar& arg, double (*function)(double));
+    void generateIntegerPower(asmjit::X86Compiler& c, asmjit::X86XmmVar& dest, asmjit::X86XmmVar& arg, int exponent, asmjit::X86XmmVar& one);
     std::vector<double> constants;
     asmjit::JitRuntime runtime;
 #endif
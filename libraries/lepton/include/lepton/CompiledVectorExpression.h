@@ -0,0 +1,149 @@
+#ifndef LEPTON_COMPILED_VECTOR_EXPRESSION_H_
+#define LEPTON_COMPILED_VECTOR_EXPRESSION_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   Lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the Lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "ExpressionTreeNode.h"
+#include "windowsIncludes.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#ifdef LEPTON_USE_JIT
+    #include "asmjit.h"
+#endif
+
+namespace Lepton {
+
+class Operation;
+class ParsedExpression;
+
+/**
+ * A CompiledVectorExpression is a highly optimized representation of an expression for cases when you want to evaluate
+ * it many times as quickly as possible.  It is similar to CompiledExpression, with the difference that it evaluates
+ * the expression for several sets of variable values at once, using single precision SIMD instructions.  Each variable
+ * is stored as an array of getWidth() floats, and evaluate() returns an array of the same size containing the result
+ * for each one.
+ * 
+ * When JIT compilation is enabled, exp(), log(), sin(), cos(), erfc(), and integer powers are evaluated inline with
+ * single precision approximations rather than by calling library functions.  sin() and cos() lose accuracy for
+ * arguments larger than about 8192 in magnitude.
+ * 
+ * A CompiledVectorExpression is created by calling createCompiledVectorExpression() on a ParsedExpression, or
+ * from a list of related ParsedExpressions.  In the latter case all of them are computed by a single call to
+ * evaluate(), and any subexpression that appears in more than one of them is only computed once.
+ * 
+ * WARNING: CompiledVectorExpression is NOT thread safe.  You should never access a CompiledVectorExpression from two
+ * threads at the same time.
+ */
+
+class LEPTON_EXPORT CompiledVectorExpression {
+public:
+    CompiledVectorExpression();
+    /**
+     * Create a CompiledVectorExpression that computes several expressions at once.  Call evaluate() to compute
+     * all of them, then getOutput() to retrieve the values of each one.
+     * 
+     * @param expressions    the expressions to compute
+     * @param width          the width of the vectors to evaluate them on.  This must be one of the values
+     *                       returned by getAllowedWidths().
+     */
+    CompiledVectorExpression(const std::vector<ParsedExpression>& expressions, int width);
+    CompiledVectorExpression(const CompiledVectorExpression& expression);
+    ~CompiledVectorExpression();
+    CompiledVectorExpression& operator=(const CompiledVectorExpression& expression);
+    /**
+     * Get the width of the vectors on which the expression is evaluated.
+     */
+    int getWidth() const;
+    /**
+     * Get the names of all variables used by this expression.
+     */
+    const std::set<std::string>& getVariables() const;
+    /**
+     * Get a pointer to the memory location where the value of a particular variable is stored.  This is an array
+     * of getWidth() elements, which should be filled in before calling evaluate().
+     */
+    float* getVariablePointer(const std::string& name);
+    /**
+     * Evaluate the expression.  The values of all variables should have been set before calling this.  The return
+     * value is an array of getWidth() elements containing the results.  If this object was created from multiple
+     * expressions, all of them are evaluated and the values of the first one are returned.
+     */
+    const float* evaluate() const;
+    /**
+     * Get the number of expressions computed by evaluate().
+     */
+    int getNumOutputs() const;
+    /**
+     * Get the values of one of the expressions, as computed by the most recent call to evaluate().  The return
+     * value is an array of getWidth() elements.
+     * 
+     * @param index    the index of the expression, in the order they were passed to the constructor
+     */
+    const float* getOutput(int index) const;
+    /**
+     * Get the list of vector widths that are supported.  The generated code uses packed SSE instructions,
+     * so a width of 8 is evaluated as two vectors of 4 elements each.  It reduces the number of calls
+     * to evaluate(), but does not perform any more arithmetic per instruction than a width of 4.
+     */
+    static const std::vector<int>& getAllowedWidths();
+private:
+    friend class ParsedExpression;
+    CompiledVectorExpression(const ParsedExpression& expression, int width);
+    void compileExpressions(const std::vector<ParsedExpression>& expressions);
+    void compileExpression(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
+    int findTempIndex(const ExpressionTreeNode& node, std::vector<std::pair<ExpressionTreeNode, int> >& temps);
+    int width;
+    std::vector<std::vector<int> > arguments;
+    std::vector<int> target;
+    std::vector<int> outputIndex;
+    std::vector<Operation*> operation;
+    std::map<std::string, int> variableIndices;
+    std::set<std::string> variableNames;
+    mutable std::vector<float> workspace;
+    mutable std::vector<double> argValues;
+    mutable std::vector<float> vectorArgs;
+    std::map<std::string, double> dummyVariables;
+    void* jitCode;
+#ifdef LEPTON_USE_JIT
+    void generateJitCode();
+    void generateGenericCall(asmjit::X86Compiler& c, Operation& op, std::vector<asmjit::X86XmmVar>& dest,
+            const std::vector<std::vector<asmjit::X86XmmVar>*>& args, asmjit::X86GpVar& argsPointer);
+    std::vector<float> constants;
+    asmjit::JitRuntime runtime;
+#endif
+};
+
+} // namespace Lepton
+
+#endif /*LEPTON_COMPILED_VECTOR_EXPRESSION_H_*/
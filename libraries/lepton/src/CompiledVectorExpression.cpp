@@ -0,0 +1,833 @@
+/* -------------------------------------------------------------------------- *
+ *                                   Lepton                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the Lepton expression parser originating from              *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2013-2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "lepton/CompiledVectorExpression.h"
+#include "lepton/Exception.h"
+#include "lepton/Operation.h"
+#include "lepton/ParsedExpression.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+using namespace Lepton;
+using namespace std;
+#ifdef LEPTON_USE_JIT
+    using namespace asmjit;
+#endif
+
+CompiledVectorExpression::CompiledVectorExpression() : width(4), jitCode(NULL) {
+}
+
+CompiledVectorExpression::CompiledVectorExpression(const ParsedExpression& expression, int width) : width(width), jitCode(NULL) {
+    compileExpressions(vector<ParsedExpression>(1, expression));
+}
+
+CompiledVectorExpression::CompiledVectorExpression(const vector<ParsedExpression>& expressions, int width) : width(width), jitCode(NULL) {
+    if (expressions.size() == 0)
+        throw Exception("CompiledVectorExpression: No expressions specified");
+    compileExpressions(expressions);
+}
+
+void CompiledVectorExpression::compileExpressions(const vector<ParsedExpression>& expressions) {
+    const vector<int> allowedWidths = getAllowedWidths();
+    if (find(allowedWidths.begin(), allowedWidths.end(), width) == allowedWidths.end())
+        throw Exception("Unsupported width for vector expression");
+    
+    // All expressions share the same list of temporaries, so a subexpression that appears in more than
+    // one of them is only computed once.
+    
+    vector<pair<ExpressionTreeNode, int> > temps;
+    for (int i = 0; i < (int) expressions.size(); i++) {
+        ParsedExpression expr = expressions[i].optimize(); // Just in case it wasn't already optimized.
+        compileExpression(expr.getRootNode(), temps);
+        outputIndex.push_back(temps[findTempIndex(expr.getRootNode(), temps)].second);
+    }
+    int maxArguments = 1;
+    for (int i = 0; i < (int) operation.size(); i++)
+        if (operation[i]->getNumArguments() > maxArguments)
+            maxArguments = operation[i]->getNumArguments();
+    argValues.resize(maxArguments);
+    vectorArgs.resize(maxArguments*width);
+#ifdef LEPTON_USE_JIT
+    generateJitCode();
+#endif
+}
+
+CompiledVectorExpression::~CompiledVectorExpression() {
+    for (int i = 0; i < (int) operation.size(); i++)
+        if (operation[i] != NULL)
+            delete operation[i];
+}
+
+CompiledVectorExpression::CompiledVectorExpression(const CompiledVectorExpression& expression) : jitCode(NULL) {
+    *this = expression;
+}
+
+CompiledVectorExpression& CompiledVectorExpression::operator=(const CompiledVectorExpression& expression) {
+    if (&expression == this)
+        return *this;
+    width = expression.width;
+    arguments = expression.arguments;
+    target = expression.target;
+    outputIndex = expression.outputIndex;
+    variableIndices = expression.variableIndices;
+    variableNames = expression.variableNames;
+    workspace.resize(expression.workspace.size());
+    argValues.resize(expression.argValues.size());
+    vectorArgs.resize(expression.vectorArgs.size());
+    for (int i = 0; i < (int) operation.size(); i++)
+        delete operation[i];
+    operation.resize(expression.operation.size());
+    for (int i = 0; i < (int) operation.size(); i++)
+        operation[i] = expression.operation[i]->clone();
+#ifdef LEPTON_USE_JIT
+    constants.clear();
+    jitCode = NULL;
+    if (workspace.size() > 0)
+        generateJitCode();
+#endif
+    return *this;
+}
+
+const vector<int>& CompiledVectorExpression::getAllowedWidths() {
+    static vector<int> widths;
+    if (widths.size() == 0) {
+        widths.push_back(4);
+        widths.push_back(8);
+    }
+    return widths;
+}
+
+void CompiledVectorExpression::compileExpression(const ExpressionTreeNode& node, vector<pair<ExpressionTreeNode, int> >& temps) {
+    if (findTempIndex(node, temps) != -1)
+        return; // We have already processed a node identical to this one.
+    
+    // Process the child nodes.
+    
+    vector<int> args;
+    for (int i = 0; i < node.getChildren().size(); i++) {
+        compileExpression(node.getChildren()[i], temps);
+        args.push_back(findTempIndex(node.getChildren()[i], temps));
+    }
+    
+    // Process this node.  Unlike CompiledExpression, every argument is recorded explicitly, since
+    // each temporary occupies width consecutive elements of the workspace.
+    
+    int index = (int) temps.size();
+    if (node.getOperation().getId() == Operation::VARIABLE) {
+        variableIndices[node.getOperation().getName()] = index;
+        variableNames.insert(node.getOperation().getName());
+    }
+    else {
+        arguments.push_back(args);
+        target.push_back(index);
+        operation.push_back(node.getOperation().clone());
+    }
+    temps.push_back(make_pair(node, index));
+    workspace.resize(workspace.size()+width, 0.0f);
+}
+
+int CompiledVectorExpression::findTempIndex(const ExpressionTreeNode& node, vector<pair<ExpressionTreeNode, int> >& temps) {
+    for (int i = 0; i < (int) temps.size(); i++)
+        if (temps[i].first == node)
+            return i;
+    return -1;
+}
+
+int CompiledVectorExpression::getWidth() const {
+    return width;
+}
+
+const set<string>& CompiledVectorExpression::getVariables() const {
+    return variableNames;
+}
+
+float* CompiledVectorExpression::getVariablePointer(const string& name) {
+    map<string, int>::iterator index = variableIndices.find(name);
+    if (index == variableIndices.end())
+        throw Exception("getVariablePointer: Unknown variable '"+name+"'");
+    return &workspace[width*index->second];
+}
+
+const float* CompiledVectorExpression::evaluate() const {
+    if (workspace.size() == 0)
+        throw Exception("evaluate: The expression has not been compiled");
+#ifdef LEPTON_USE_JIT
+    ((void (*)()) jitCode)();
+#else
+    // Loop over the operations and evaluate each one for every element of the vector.
+    
+    for (int step = 0; step < operation.size(); step++) {
+        const vector<int>& args = arguments[step];
+        for (int j = 0; j < width; j++) {
+            for (int i = 0; i < args.size(); i++)
+                argValues[i] = workspace[width*args[i]+j];
+            workspace[width*target[step]+j] = (float) operation[step]->evaluate(&argValues[0], dummyVariables);
+        }
+    }
+#endif
+    return &workspace[width*outputIndex[0]];
+}
+
+int CompiledVectorExpression::getNumOutputs() const {
+    return outputIndex.size();
+}
+
+const float* CompiledVectorExpression::getOutput(int index) const {
+    return &workspace[width*outputIndex[index]];
+}
+
+#ifdef LEPTON_USE_JIT
+/**
+ * Evaluate an operation that has no inline implementation.  args contains the arguments as consecutive
+ * vectors of the specified width.  The result is stored into the first vector.
+ */
+static void evaluateVectorOperation(Operation* op, float* args, int width) {
+    map<string, double>* dummyVariables = NULL;
+    int numArgs = op->getNumArguments();
+    double argValues[8];
+    vector<double> extraArgValues;
+    double* values = argValues;
+    if (numArgs > 8) {
+        extraArgValues.resize(numArgs);
+        values = &extraArgValues[0];
+    }
+    for (int j = 0; j < width; j++) {
+        for (int i = 0; i < numArgs; i++)
+            values[i] = args[i*width+j];
+        args[j] = (float) op->evaluate(values, *dummyVariables);
+    }
+}
+
+/**
+ * Decide whether a POWER_CONSTANT operation should be evaluated inline by repeated multiplication.
+ */
+static bool isInlinePower(const Operation& op) {
+    double exponent = dynamic_cast<const Operation::PowerConstant&>(op).getValue();
+    return (fabs(exponent) <= 64 && exponent == (int) exponent);
+}
+
+/**
+ * Constants used by the inline implementations of transcendental functions.  The polynomial
+ * approximations are the single precision ones from the Cephes library, except for erfc()
+ * which uses the Chebyshev fit from Numerical Recipes (fractional error below 1.2e-7).
+ */
+enum TableConstant {ONE, HALF, TWO, SIGN_MASK, ABS_MASK, INF, NEG_INF, INT_1, INT_NOT_1, INT_2, INT_4, INT_127,
+        EXP_HI, EXP_LO, LOG2E, LN2_HI, LN2_LO, EXP_P0, EXP_P1, EXP_P2, EXP_P3, EXP_P4, EXP_P5,
+        MIN_NORM, INV_MANT_MASK, SQRTHF, LOG_P0, LOG_P1, LOG_P2, LOG_P3, LOG_P4, LOG_P5, LOG_P6, LOG_P7, LOG_P8,
+        FOPI, DP1, DP2, DP3, SIN_P0, SIN_P1, SIN_P2, COS_P0, COS_P1, COS_P2,
+        ERFC_P0, ERFC_P1, ERFC_P2, ERFC_P3, ERFC_P4, ERFC_P5, ERFC_P6, ERFC_P7, ERFC_P8, ERFC_P9, NUM_TABLE_CONSTANTS};
+
+static float intBits(int value) {
+    float result;
+    memcpy(&result, &value, sizeof(float));
+    return result;
+}
+
+static vector<float> getTableConstants() {
+    vector<float> table(NUM_TABLE_CONSTANTS);
+    table[ONE] = 1.0f;
+    table[HALF] = 0.5f;
+    table[TWO] = 2.0f;
+    table[SIGN_MASK] = intBits(0x80000000);
+    table[ABS_MASK] = intBits(0x7FFFFFFF);
+    table[INF] = intBits(0x7F800000);
+    table[NEG_INF] = intBits(0xFF800000);
+    table[INT_1] = intBits(1);
+    table[INT_NOT_1] = intBits(~1);
+    table[INT_2] = intBits(2);
+    table[INT_4] = intBits(4);
+    table[INT_127] = intBits(127);
+    table[EXP_HI] = 88.3762626647949f;
+    table[EXP_LO] = -87.3365447504019f;
+    table[LOG2E] = 1.44269504088896341f;
+    table[LN2_HI] = 0.693359375f;
+    table[LN2_LO] = -2.12194440e-4f;
+    table[EXP_P0] = 1.9875691500e-4f;
+    table[EXP_P1] = 1.3981999507e-3f;
+    table[EXP_P2] = 8.3334519073e-3f;
+    table[EXP_P3] = 4.1665795894e-2f;
+    table[EXP_P4] = 1.6666665459e-1f;
+    table[EXP_P5] = 5.0000001201e-1f;
+    table[MIN_NORM] = intBits(0x00800000);
+    table[INV_MANT_MASK] = intBits(~0x7F800000);
+    table[SQRTHF] = 0.707106781186547524f;
+    table[LOG_P0] = 7.0376836292e-2f;
+    table[LOG_P1] = -1.1514610310e-1f;
+    table[LOG_P2] = 1.1676998740e-1f;
+    table[LOG_P3] = -1.2420140846e-1f;
+    table[LOG_P4] = 1.4249322787e-1f;
+    table[LOG_P5] = -1.6668057665e-1f;
+    table[LOG_P6] = 2.0000714765e-1f;
+    table[LOG_P7] = -2.4999993993e-1f;
+    table[LOG_P8] = 3.3333331174e-1f;
+    table[FOPI] = 1.27323954473516f;
+    table[DP1] = -0.78515625f;
+    table[DP2] = -2.4187564849853515625e-4f;
+    table[DP3] = -3.77489497744594108e-8f;
+    table[SIN_P0] = -1.9515295891e-4f;
+    table[SIN_P1] = 8.3321608736e-3f;
+    table[SIN_P2] = -1.6666654611e-1f;
+    table[COS_P0] = 2.443315711809948e-5f;
+    table[COS_P1] = -1.388731625493765e-3f;
+    table[COS_P2] = 4.166664568298827e-2f;
+    table[ERFC_P0] = 0.17087277f;
+    table[ERFC_P1] = -0.82215223f;
+    table[ERFC_P2] = 1.48851587f;
+    table[ERFC_P3] = -1.13520398f;
+    table[ERFC_P4] = 0.27886807f;
+    table[ERFC_P5] = -0.18628806f;
+    table[ERFC_P6] = 0.09678418f;
+    table[ERFC_P7] = 0.37409196f;
+    table[ERFC_P8] = 1.00002368f;
+    table[ERFC_P9] = -1.26551223f;
+    return table;
+}
+
+/**
+ * Load an element of the constant table into a new variable.  The table is not guaranteed to be
+ * aligned, so values are always loaded into registers rather than used as memory operands.
+ */
+static X86XmmVar loadConstant(X86Compiler& c, X86GpVar& table, int index) {
+    X86XmmVar value = c.newXmmVar(kX86VarTypeXmmPs);
+    c.movups(value, x86::ptr(table, 16*index, 0));
+    return value;
+}
+
+static X86XmmVar copyVar(X86Compiler& c, const X86XmmVar& var) {
+    X86XmmVar copy = c.newXmmVar(kX86VarTypeXmmPs);
+    c.movaps(copy, var);
+    return copy;
+}
+
+/**
+ * Evaluate a polynomial whose coefficients are consecutive table elements, starting from the highest order one.
+ */
+static X86XmmVar generatePolynomial(X86Compiler& c, const X86XmmVar& x, X86GpVar& table, int firstCoefficient, int numCoefficients) {
+    X86XmmVar y = loadConstant(c, table, firstCoefficient);
+    for (int i = 1; i < numCoefficients; i++) {
+        c.mulps(y, x);
+        c.addps(y, loadConstant(c, table, firstCoefficient+i));
+    }
+    return y;
+}
+
+/**
+ * Compute exp(x) as 2^n*exp(g), where n = round(x/ln(2)).
+ */
+static void generateExp(X86Compiler& c, const X86XmmVar& dest, const X86XmmVar& arg, X86GpVar& table) {
+    X86XmmVar x = copyVar(c, arg);
+    c.minps(x, loadConstant(c, table, EXP_HI));
+    c.maxps(x, loadConstant(c, table, EXP_LO));
+    
+    // Compute n = floor(x/ln(2)+0.5).  Truncation rounds negative values up, so correct for it.
+    
+    X86XmmVar fx = copyVar(c, x);
+    c.mulps(fx, loadConstant(c, table, LOG2E));
+    c.addps(fx, loadConstant(c, table, HALF));
+    X86XmmVar n = c.newXmmVar(kX86VarTypeXmmPs);
+    X86XmmVar floorFx = c.newXmmVar(kX86VarTypeXmmPs);
+    c.cvttps2dq(n, fx);
+    c.cvtdq2ps(floorFx, n);
+    X86XmmVar mask = copyVar(c, fx);
+    c.cmpps(mask, floorFx, imm(1)); // Comparison mode is _CMP_LT_OS = 1
+    c.andps(mask, loadConstant(c, table, ONE));
+    c.subps(floorFx, mask);
+    c.cvttps2dq(n, floorFx);
+    
+    // Reduce the argument, using two parts of ln(2) to preserve accuracy.
+    
+    X86XmmVar temp = copyVar(c, floorFx);
+    c.mulps(temp, loadConstant(c, table, LN2_HI));
+    c.subps(x, temp);
+    c.movaps(temp, floorFx);
+    c.mulps(temp, loadConstant(c, table, LN2_LO));
+    c.subps(x, temp);
+    
+    // Evaluate the polynomial and scale by 2^n, which is constructed directly in the exponent bits.
+    
+    X86XmmVar y = generatePolynomial(c, x, table, EXP_P0, 6);
+    X86XmmVar x2 = copyVar(c, x);
+    c.mulps(x2, x);
+    c.mulps(y, x2);
+    c.addps(y, x);
+    c.addps(y, loadConstant(c, table, ONE));
+    c.paddd(n, loadConstant(c, table, INT_127));
+    c.pslld(n, imm(23));
+    c.mulps(y, n);
+    
+    // Values outside the representable range underflow to 0 or overflow to infinity.
+    
+    c.movaps(mask, arg);
+    c.cmpps(mask, loadConstant(c, table, EXP_LO), imm(5)); // Comparison mode is _CMP_NLT_US = 5
+    c.andps(y, mask);
+    X86XmmVar overflow = loadConstant(c, table, EXP_HI);
+    c.cmpps(overflow, arg, imm(1)); // Comparison mode is _CMP_LT_OS = 1
+    c.movaps(mask, overflow);
+    c.andnps(mask, y);
+    c.andps(overflow, loadConstant(c, table, INF));
+    c.orps(mask, overflow);
+    c.movaps(dest, mask);
+}
+
+/**
+ * Compute log(x) by splitting x into its exponent and a mantissa in the range [sqrt(1/2), sqrt(2)).
+ */
+static void generateLog(X86Compiler& c, const X86XmmVar& dest, const X86XmmVar& arg, X86GpVar& table) {
+    X86XmmVar zero = c.newXmmVar(kX86VarTypeXmmPs);
+    c.xorps(zero, zero);
+    X86XmmVar invalid = copyVar(c, zero);
+    c.cmpps(invalid, arg, imm(6)); // Comparison mode is _CMP_NLE_US = 6, so this is true for negative values and NaN
+    X86XmmVar isZero = copyVar(c, arg);
+    c.cmpps(isZero, zero, imm(0)); // Comparison mode is _CMP_EQ_OQ = 0
+    X86XmmVar x = copyVar(c, arg);
+    c.maxps(x, loadConstant(c, table, MIN_NORM));
+    
+    // Extract the exponent and mantissa.
+    
+    X86XmmVar e = copyVar(c, x);
+    c.psrld(e, imm(23));
+    c.andps(x, loadConstant(c, table, INV_MANT_MASK));
+    c.orps(x, loadConstant(c, table, HALF));
+    c.psubd(e, loadConstant(c, table, INT_127));
+    c.cvtdq2ps(e, e);
+    X86XmmVar one = loadConstant(c, table, ONE);
+    c.addps(e, one);
+    X86XmmVar mask = copyVar(c, x);
+    c.cmpps(mask, loadConstant(c, table, SQRTHF), imm(1)); // Comparison mode is _CMP_LT_OS = 1
+    X86XmmVar temp = copyVar(c, x);
+    c.andps(temp, mask);
+    c.subps(x, one);
+    c.andps(mask, one);
+    c.subps(e, mask);
+    c.addps(x, temp);
+    
+    // Evaluate the polynomial and add in the exponent.
+    
+    X86XmmVar z = copyVar(c, x);
+    c.mulps(z, x);
+    X86XmmVar y = generatePolynomial(c, x, table, LOG_P0, 9);
+    c.mulps(y, x);
+    c.mulps(y, z);
+    c.movaps(temp, e);
+    c.mulps(temp, loadConstant(c, table, LN2_LO));
+    c.addps(y, temp);
+    c.mulps(z, loadConstant(c, table, HALF));
+    c.subps(y, z);
+    c.addps(x, y);
+    c.mulps(e, loadConstant(c, table, LN2_HI));
+    c.addps(x, e);
+    
+    // Negative arguments produce NaN (all bits set), and zero produces -infinity.
+    
+    c.orps(x, invalid);
+    c.movaps(temp, isZero);
+    c.andps(temp, loadConstant(c, table, NEG_INF));
+    c.andnps(isZero, x);
+    c.orps(isZero, temp);
+    c.movaps(dest, isZero);
+}
+
+/**
+ * Compute sin(x) or cos(x).  The argument is reduced to the range [-pi/4, pi/4] using a three part
+ * representation of pi/4, which gives full single precision accuracy for |x| up to about 8192.
+ */
+static void generateSinCos(X86Compiler& c, const X86XmmVar& dest, const X86XmmVar& arg, X86GpVar& table, bool cosine) {
+    X86XmmVar x = copyVar(c, arg);
+    c.andps(x, loadConstant(c, table, ABS_MASK));
+    
+    // Find the octant.
+    
+    X86XmmVar y = copyVar(c, x);
+    c.mulps(y, loadConstant(c, table, FOPI));
+    X86XmmVar j = c.newXmmVar(kX86VarTypeXmmPs);
+    c.cvttps2dq(j, y);
+    c.paddd(j, loadConstant(c, table, INT_1));
+    c.andps(j, loadConstant(c, table, INT_NOT_1));
+    c.cvtdq2ps(y, j);
+    if (cosine)
+        c.psubd(j, loadConstant(c, table, INT_2));
+    
+    // Determine the sign of the result and which polynomial to use.
+    
+    X86XmmVar sign = copyVar(c, j);
+    if (cosine)
+        c.andnps(sign, loadConstant(c, table, INT_4));
+    else
+        c.andps(sign, loadConstant(c, table, INT_4));
+    c.pslld(sign, imm(29));
+    if (!cosine) {
+        X86XmmVar argSign = copyVar(c, arg);
+        c.andps(argSign, loadConstant(c, table, SIGN_MASK));
+        c.xorps(sign, argSign);
+    }
+    X86XmmVar polyMask = copyVar(c, j);
+    c.andps(polyMask, loadConstant(c, table, INT_2));
+    X86XmmVar zero = c.newXmmVar(kX86VarTypeXmmPs);
+    c.xorps(zero, zero);
+    c.pcmpeqd(polyMask, zero);
+    
+    // Reduce the argument.
+    
+    X86XmmVar temp = copyVar(c, y);
+    c.mulps(temp, loadConstant(c, table, DP1));
+    c.addps(x, temp);
+    c.movaps(temp, y);
+    c.mulps(temp, loadConstant(c, table, DP2));
+    c.addps(x, temp);
+    c.movaps(temp, y);
+    c.mulps(temp, loadConstant(c, table, DP3));
+    c.addps(x, temp);
+    X86XmmVar z = copyVar(c, x);
+    c.mulps(z, x);
+    
+    // Evaluate both polynomials and select the correct one for each element.
+    
+    X86XmmVar cosPoly = generatePolynomial(c, z, table, COS_P0, 3);
+    c.mulps(cosPoly, z);
+    c.mulps(cosPoly, z);
+    c.movaps(temp, z);
+    c.mulps(temp, loadConstant(c, table, HALF));
+    c.subps(cosPoly, temp);
+    c.addps(cosPoly, loadConstant(c, table, ONE));
+    X86XmmVar sinPoly = generatePolynomial(c, z, table, SIN_P0, 3);
+    c.mulps(sinPoly, z);
+    c.mulps(sinPoly, x);
+    c.addps(sinPoly, x);
+    c.andps(sinPoly, polyMask);
+    c.andnps(polyMask, cosPoly);
+    c.orps(sinPoly, polyMask);
+    c.xorps(sinPoly, sign);
+    c.movaps(dest, sinPoly);
+}
+
+/**
+ * Compute erfc(x).  Negative arguments use the identity erfc(x) = 2-erfc(-x).
+ */
+static void generateErfc(X86Compiler& c, const X86XmmVar& dest, const X86XmmVar& arg, X86GpVar& table) {
+    X86XmmVar z = copyVar(c, arg);
+    c.andps(z, loadConstant(c, table, ABS_MASK));
+    X86XmmVar t = copyVar(c, z);
+    c.mulps(t, loadConstant(c, table, HALF));
+    c.addps(t, loadConstant(c, table, ONE));
+    X86XmmVar recip = loadConstant(c, table, ONE);
+    c.divps(recip, t);
+    c.movaps(t, recip);
+    X86XmmVar expArg = generatePolynomial(c, t, table, ERFC_P0, 10);
+    c.mulps(z, z);
+    c.subps(expArg, z);
+    X86XmmVar result = c.newXmmVar(kX86VarTypeXmmPs);
+    generateExp(c, result, expArg, table);
+    c.mulps(result, t);
+    X86XmmVar negative = c.newXmmVar(kX86VarTypeXmmPs);
+    c.xorps(negative, negative);
+    c.cmpps(negative, arg, imm(6)); // Comparison mode is _CMP_NLE_US = 6, so this is true for negative values
+    X86XmmVar reflected = loadConstant(c, table, TWO);
+    c.subps(reflected, result);
+    c.andps(reflected, negative);
+    c.andnps(negative, result);
+    c.orps(negative, reflected);
+    c.movaps(dest, negative);
+}
+
+/**
+ * Compute x^n for an integer n by repeated multiplication, in the same order as Operation::PowerConstant.
+ */
+static void generateIntegerPower(X86Compiler& c, const X86XmmVar& dest, const X86XmmVar& arg, int exponent, const X86XmmVar& one) {
+    X86XmmVar base = c.newXmmVar(kX86VarTypeXmmPs);
+    if (exponent < 0) {
+        exponent = -exponent;
+        c.movaps(base, one);
+        c.divps(base, arg);
+    }
+    else
+        c.movaps(base, arg);
+    X86XmmVar result = c.newXmmVar(kX86VarTypeXmmPs);
+    bool hasResult = false;
+    while (exponent != 0) {
+        if ((exponent&1) == 1) {
+            if (hasResult)
+                c.mulps(result, base);
+            else
+                c.movaps(result, base);
+            hasResult = true;
+        }
+        exponent = exponent>>1;
+        if (exponent != 0)
+            c.mulps(base, base);
+    }
+    if (!hasResult)
+        c.movaps(result, one);
+    c.movaps(dest, result);
+}
+
+void CompiledVectorExpression::generateJitCode() {
+    X86Compiler c(&runtime);
+    c.addFunc(kFuncConvHost, FuncBuilder0<void>());
+    
+    // Each value is stored in width/4 packed SSE registers.
+    
+    int numBlocks = width/4;
+    int numTemps = workspace.size()/width;
+    vector<vector<X86XmmVar> > workspaceVar(numTemps);
+    for (int i = 0; i < numTemps; i++)
+        for (int j = 0; j < numBlocks; j++)
+            workspaceVar[i].push_back(c.newXmmVar(kX86VarTypeXmmPs));
+    X86GpVar workspacePointer(c);
+    X86GpVar argsPointer(c);
+    c.mov(workspacePointer, imm_ptr(&workspace[0]));
+    c.mov(argsPointer, imm_ptr(&vectorArgs[0]));
+    
+    // Load the arguments into variables.
+    
+    for (set<string>::const_iterator iter = variableNames.begin(); iter != variableNames.end(); ++iter) {
+        map<string, int>::iterator index = variableIndices.find(*iter);
+        for (int j = 0; j < numBlocks; j++)
+            c.movups(workspaceVar[index->second][j], x86::ptr(workspacePointer, 4*(width*index->second+4*j), 0));
+    }
+
+    // Make a list of all constants that will be needed for evaluation.
+    
+    vector<int> operationConstantIndex(operation.size(), -1);
+    vector<float> constantValues;
+    bool needTable = false;
+    for (int step = 0; step < (int) operation.size(); step++) {
+        // Find the constant value (if any) used by this operation.
+        
+        Operation& op = *operation[step];
+        Operation::Id id = op.getId();
+        if (id == Operation::EXP || id == Operation::LOG || id == Operation::SIN || id == Operation::COS || id == Operation::ERFC)
+            needTable = true;
+        double value;
+        if (op.getId() == Operation::CONSTANT)
+            value = dynamic_cast<Operation::Constant&>(op).getValue();
+        else if (op.getId() == Operation::ADD_CONSTANT)
+            value = dynamic_cast<Operation::AddConstant&>(op).getValue();
+        else if (op.getId() == Operation::MULTIPLY_CONSTANT)
+            value = dynamic_cast<Operation::MultiplyConstant&>(op).getValue();
+        else if (op.getId() == Operation::RECIPROCAL)
+            value = 1.0;
+        else if (op.getId() == Operation::STEP)
+            value = 1.0;
+        else if (op.getId() == Operation::DELTA)
+            value = 1.0;
+        else if (op.getId() == Operation::POWER_CONSTANT && isInlinePower(op))
+            value = 1.0;
+        else
+            continue;
+        
+        // See if we already have a variable for this constant.
+        
+        for (int i = 0; i < (int) constantValues.size(); i++)
+            if ((float) value == constantValues[i]) {
+                operationConstantIndex[step] = i;
+                break;
+            }
+        if (operationConstantIndex[step] == -1) {
+            operationConstantIndex[step] = constantValues.size();
+            constantValues.push_back((float) value);
+        }
+    }
+    
+    // Load constants into variables.  Each one is stored four times so it can be loaded directly into a packed register.
+    // If any transcendental functions are evaluated inline, the table of constants they use is appended at the end.
+    // Those are loaded only where they are used.
+    
+    int numConstants = constantValues.size();
+    if (needTable) {
+        vector<float> table = getTableConstants();
+        constantValues.insert(constantValues.end(), table.begin(), table.end());
+    }
+    constants.resize(4*constantValues.size());
+    for (int i = 0; i < (int) constantValues.size(); i++)
+        for (int j = 0; j < 4; j++)
+            constants[4*i+j] = constantValues[i];
+    vector<X86XmmVar> constantVar(numConstants);
+    X86GpVar tablePointer(c);
+    if (constantValues.size() > 0) {
+        X86GpVar constantsPointer(c);
+        c.mov(constantsPointer, imm_ptr(&constants[0]));
+        for (int i = 0; i < numConstants; i++) {
+            constantVar[i] = c.newXmmVar(kX86VarTypeXmmPs);
+            c.movups(constantVar[i], x86::ptr(constantsPointer, 16*i, 0));
+        }
+        if (needTable)
+            c.mov(tablePointer, imm_ptr(&constants[4*numConstants]));
+    }
+    
+    // Evaluate the operations.
+    
+    for (int step = 0; step < (int) operation.size(); step++) {
+        Operation& op = *operation[step];
+        const vector<int>& args = arguments[step];
+        vector<X86XmmVar>& dest = workspaceVar[target[step]];
+        
+        // Generate instructions to execute this operation.
+        
+        bool inlined = true;
+        for (int j = 0; j < numBlocks; j++) {
+            X86XmmVar& d = dest[j];
+            switch (op.getId()) {
+                case Operation::CONSTANT:
+                    c.movaps(d, constantVar[operationConstantIndex[step]]);
+                    break;
+                case Operation::ADD:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.addps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::SUBTRACT:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.subps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::MULTIPLY:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.mulps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::DIVIDE:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.divps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::NEGATE:
+                    c.xorps(d, d);
+                    c.subps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::SQRT:
+                    c.sqrtps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::STEP:
+                    c.xorps(d, d);
+                    c.cmpps(d, workspaceVar[args[0]][j], imm(2)); // Comparison mode is _CMP_LE_OS = 2
+                    c.andps(d, constantVar[operationConstantIndex[step]]);
+                    break;
+                case Operation::DELTA:
+                    c.xorps(d, d);
+                    c.cmpps(d, workspaceVar[args[0]][j], imm(0)); // Comparison mode is _CMP_EQ_OQ = 0
+                    c.andps(d, constantVar[operationConstantIndex[step]]);
+                    break;
+                case Operation::SQUARE:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.mulps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::CUBE:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.mulps(d, workspaceVar[args[0]][j]);
+                    c.mulps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::RECIPROCAL:
+                    c.movaps(d, constantVar[operationConstantIndex[step]]);
+                    c.divps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::ADD_CONSTANT:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.addps(d, constantVar[operationConstantIndex[step]]);
+                    break;
+                case Operation::MULTIPLY_CONSTANT:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.mulps(d, constantVar[operationConstantIndex[step]]);
+                    break;
+                case Operation::MIN:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.minps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::MAX:
+                    c.movaps(d, workspaceVar[args[0]][j]);
+                    c.maxps(d, workspaceVar[args[1]][j]);
+                    break;
+                case Operation::ABS:
+                    c.xorps(d, d);
+                    c.subps(d, workspaceVar[args[0]][j]);
+                    c.maxps(d, workspaceVar[args[0]][j]);
+                    break;
+                case Operation::EXP:
+                    generateExp(c, d, workspaceVar[args[0]][j], tablePointer);
+                    break;
+                case Operation::LOG:
+                    generateLog(c, d, workspaceVar[args[0]][j], tablePointer);
+                    break;
+                case Operation::SIN:
+                    generateSinCos(c, d, workspaceVar[args[0]][j], tablePointer, false);
+                    break;
+                case Operation::COS:
+                    generateSinCos(c, d, workspaceVar[args[0]][j], tablePointer, true);
+                    break;
+                case Operation::ERFC:
+                    generateErfc(c, d, workspaceVar[args[0]][j], tablePointer);
+                    break;
+                case Operation::POWER_CONSTANT:
+                    if (isInlinePower(op))
+                        generateIntegerPower(c, d, workspaceVar[args[0]][j], (int) dynamic_cast<Operation::PowerConstant&>(op).getValue(),
+                                constantVar[operationConstantIndex[step]]);
+                    else
+                        inlined = false;
+                    break;
+                default:
+                    inlined = false;
+            }
+            if (!inlined)
+                break;
+        }
+        if (!inlined) {
+            // Just invoke evaluateVectorOperation().
+            
+            vector<vector<X86XmmVar>*> argVars;
+            for (int i = 0; i < (int) args.size(); i++)
+                argVars.push_back(&workspaceVar[args[i]]);
+            generateGenericCall(c, op, dest, argVars, argsPointer);
+        }
+    }
+    
+    // Store the values of all outputs into the workspace.
+    
+    for (int i = 0; i < (int) outputIndex.size(); i++)
+        for (int j = 0; j < numBlocks; j++)
+            c.movups(x86::ptr(workspacePointer, 4*(width*outputIndex[i]+4*j), 0), workspaceVar[outputIndex[i]][j]);
+    c.ret();
+    c.endFunc();
+    jitCode = c.make();
+}
+
+void CompiledVectorExpression::generateGenericCall(X86Compiler& c, Operation& op, vector<X86XmmVar>& dest,
+            const vector<vector<X86XmmVar>*>& args, X86GpVar& argsPointer) {
+    int numBlocks = width/4;
+    for (int i = 0; i < (int) args.size(); i++)
+        for (int j = 0; j < numBlocks; j++)
+            c.movups(x86::ptr(argsPointer, 4*(width*i+4*j), 0), (*args[i])[j]);
+    X86GpVar fn(c, kVarTypeIntPtr);
+    c.mov(fn, imm_ptr((void*) evaluateVectorOperation));
+    X86CallNode* call = c.call(fn, kFuncConvHost, FuncBuilder3<void, Operation*, float*, int>());
+    call->setArg(0, imm_ptr(&op));
+    call->setArg(1, imm_ptr(&vectorArgs[0]));
+    call->setArg(2, imm(width));
+    for (int j = 0; j < numBlocks; j++)
+        c.movups(dest[j], x86::ptr(argsPointer, 16*j, 0));
+}
+#endif
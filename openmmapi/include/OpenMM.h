@@ -72,6 +72,7 @@
 #include "openmm/VerletIntegrator.h"
 #include "openmm/VirtualSite.h"
 #include "openmm/Platform.h"
+#include "openmm/serialization/BinarySerializer.h"
 #include "openmm/serialization/XmlSerializer.h"
 
 #endif /*OPENMM_H_*/
@@ -245,9 +245,34 @@ public:
      * with different versions of OpenMM are also often incompatible.  If a checkpoint cannot be loaded,
      * that is signaled by throwing an exception.
      * 
+     * Every checkpoint also contains a platform independent section with the time, periodic box vectors,
+     * positions, velocities, and parameters.  If the checkpoint was created by a Context that used a
+     * different Platform, only that section is loaded.  This allows a simulation to be moved between
+     * Platforms, but internal data such as the states of random number generators is not restored, so
+     * the trajectory will not continue exactly as it would have on the original Platform.
+     * 
      * @param stream    an input stream the checkpoint data should be read from
      */
     void loadCheckpoint(std::istream& stream);
+    /**
+     * Create a checkpoint recording the current state of the Context, and write it to a stream on a
+     * background thread.  The state is copied into memory before this method returns, so the simulation
+     * can continue immediately, while the (often much slower) writing happens in parallel with it.  The
+     * data written is identical to what createCheckpoint() would produce.
+     * 
+     * Only one checkpoint is written at a time.  If this is called again before the previous checkpoint
+     * has finished writing, it blocks until that one is complete.
+     * 
+     * @param stream    an output stream the checkpoint data should be written to.  It must remain valid
+     *                  until waitForCheckpoint() has been called, another asynchronous checkpoint has been
+     *                  started, or the Context has been deleted.
+     */
+    void createCheckpointAsync(std::ostream& stream);
+    /**
+     * Block until any checkpoint started by createCheckpointAsync() has been completely written.  If an
+     * error occurred while writing it, this throws an exception.
+     */
+    void waitForCheckpoint();
     /**
      * Get a description of how the particles in the system are grouped into molecules.  Two particles are in the
      * same molecule if they are connected by constraints or bonds, where every Force object can define bonds
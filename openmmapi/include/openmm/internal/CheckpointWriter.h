@@ -0,0 +1,88 @@
+#ifndef OPENMM_CHECKPOINT_WRITER_H_
+#define OPENMM_CHECKPOINT_WRITER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "windowsExport.h"
+#include <pthread.h>
+#include <iosfwd>
+#include <string>
+
+namespace OpenMM {
+
+/**
+ * A CheckpointWriter writes blocks of checkpoint data to output streams on a background thread,
+ * so the simulation can continue while slow I/O is in progress.
+ *
+ * It is double buffered.  The caller prepares a checkpoint in its own buffer and passes it to write(),
+ * which swaps it with the internal buffer and returns immediately.  The caller can then prepare the next
+ * checkpoint while the first one is still being written.  Only one write is ever in progress: if write()
+ * is called again before the previous write has finished, it blocks until the previous write completes.
+ *
+ * This is an internal class used by ContextImpl.
+ */
+class OPENMM_EXPORT CheckpointWriter {
+public:
+    CheckpointWriter();
+    /**
+     * Deleting a CheckpointWriter waits for any write that is in progress to finish.
+     */
+    ~CheckpointWriter();
+    /**
+     * Begin writing data to a stream on the background thread.  If a previous write is still in
+     * progress, this first waits for it to finish.  If the previous write failed, this throws an
+     * exception instead.
+     *
+     * @param stream   the stream to write to.  It must remain valid until the write has finished.
+     * @param data     the data to write.  Its contents are swapped with an internal buffer, so on exit
+     *                 it contains the data from an earlier write (or is empty), and its memory can be
+     *                 reused for preparing the next checkpoint.
+     */
+    void write(std::ostream& stream, std::string& data);
+    /**
+     * Block until all writes have finished.  If a write failed, this throws an exception.
+     */
+    void waitForCompletion();
+private:
+    static void* threadBody(void* args);
+    void waitUntilIdle();
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t condition;
+    std::ostream* stream;
+    std::string buffer;
+    bool hasPendingWrite, isDeleted, writeFailed;
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_CHECKPOINT_WRITER_H_*/
@@ -37,10 +37,12 @@
 #include "openmm/Vec3.h"
 #include <iosfwd>
 #include <map>
+#include <string>
 #include <vector>
 
 namespace OpenMM {
 
+class CheckpointWriter;
 class ForceImpl;
 class Integrator;
 class Context;
@@ -241,6 +243,17 @@ public:
      * @param stream    an input stream the checkpoint data should be read from
      */
     void loadCheckpoint(std::istream& stream);
+    /**
+     * Create a checkpoint recording the current state of the Context, and write it to a stream on a
+     * background thread.
+     *
+     * @param stream    an output stream the checkpoint data should be written to
+     */
+    void createCheckpointAsync(std::ostream& stream);
+    /**
+     * Wait until all checkpoints started by createCheckpointAsync() have been written.
+     */
+    void waitForCheckpoint();
     /**
      * This is invoked by the Integrator when it is deleted.  This is needed to ensure the cleanup process
      * is done correctly, since we don't know whether the Integrator or Context will be deleted first.
@@ -266,6 +279,8 @@ private:
     Platform* platform;
     Kernel initializeForcesKernel, updateStateDataKernel, applyConstraintsKernel, virtualSitesKernel;
     void* platformData;
+    CheckpointWriter* checkpointWriter;
+    std::string checkpointBuffer;
 };
 
 } // namespace OpenMM
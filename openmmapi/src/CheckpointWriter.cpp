@@ -0,0 +1,107 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/internal/CheckpointWriter.h"
+#include "openmm/OpenMMException.h"
+#include <ostream>
+
+using namespace OpenMM;
+using namespace std;
+
+CheckpointWriter::CheckpointWriter() : stream(NULL), hasPendingWrite(false), isDeleted(false), writeFailed(false) {
+    pthread_mutex_init(&lock, NULL);
+    pthread_cond_init(&condition, NULL);
+    pthread_create(&thread, NULL, threadBody, this);
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    pthread_mutex_lock(&lock);
+    while (hasPendingWrite)
+        pthread_cond_wait(&condition, &lock);
+    isDeleted = true;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&lock);
+    pthread_join(thread, NULL);
+    pthread_mutex_destroy(&lock);
+    pthread_cond_destroy(&condition);
+}
+
+void* CheckpointWriter::threadBody(void* args) {
+    CheckpointWriter& owner = *reinterpret_cast<CheckpointWriter*>(args);
+    pthread_mutex_lock(&owner.lock);
+    while (true) {
+        while (!owner.hasPendingWrite && !owner.isDeleted)
+            pthread_cond_wait(&owner.condition, &owner.lock);
+        if (owner.isDeleted)
+            break;
+
+        // Release the lock while writing, so the main thread is never blocked by I/O unless it
+        // explicitly waits for it.
+
+        pthread_mutex_unlock(&owner.lock);
+        owner.stream->write(owner.buffer.c_str(), owner.buffer.size());
+        owner.stream->flush();
+        bool failed = owner.stream->fail();
+        pthread_mutex_lock(&owner.lock);
+        owner.writeFailed |= failed;
+        owner.hasPendingWrite = false;
+        owner.stream = NULL;
+        pthread_cond_broadcast(&owner.condition);
+    }
+    pthread_mutex_unlock(&owner.lock);
+    return 0;
+}
+
+void CheckpointWriter::waitUntilIdle() {
+    while (hasPendingWrite)
+        pthread_cond_wait(&condition, &lock);
+    if (writeFailed) {
+        writeFailed = false;
+        pthread_mutex_unlock(&lock);
+        throw OpenMMException("Error writing checkpoint");
+    }
+}
+
+void CheckpointWriter::write(ostream& stream, string& data) {
+    pthread_mutex_lock(&lock);
+    waitUntilIdle();
+    buffer.swap(data);
+    this->stream = &stream;
+    hasPendingWrite = true;
+    pthread_cond_broadcast(&condition);
+    pthread_mutex_unlock(&lock);
+}
+
+void CheckpointWriter::waitForCompletion() {
+    pthread_mutex_lock(&lock);
+    waitUntilIdle();
+    pthread_mutex_unlock(&lock);
+}
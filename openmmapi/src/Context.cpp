@@ -248,6 +248,14 @@ void Context::loadCheckpoint(istream& stream) {
     impl->loadCheckpoint(stream);
 }
 
+void Context::createCheckpointAsync(ostream& stream) {
+    impl->createCheckpointAsync(stream);
+}
+
+void Context::waitForCheckpoint() {
+    impl->waitForCheckpoint();
+}
+
 ContextImpl& Context::getImpl() {
     return *impl;
 }
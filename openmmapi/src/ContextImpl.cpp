@@ -36,6 +36,7 @@
 #include "openmm/kernels.h"
 #include "openmm/internal/ForceImpl.h"
 #include "openmm/internal/ContextImpl.h"
+#include "openmm/internal/CheckpointWriter.h"
 #include "openmm/State.h"
 #include "openmm/VirtualSite.h"
 #include "openmm/Context.h"
@@ -49,12 +50,12 @@
 
 using namespace OpenMM;
 using namespace std;
-const static char CHECKPOINT_MAGIC_BYTES[] = "OpenMM Binary Checkpoint\n";
+const static char CHECKPOINT_MAGIC_BYTES[] = "OpenMM Binary Checkpoint 2\n";
 
 
 ContextImpl::ContextImpl(Context& owner, const System& system, Integrator& integrator, Platform* platform, const map<string, string>& properties) :
         owner(owner), system(system), integrator(integrator), hasInitializedForces(false), hasSetPositions(false), integratorIsDeleted(false),
-        lastForceGroups(-1), platform(platform), platformData(NULL) {
+        lastForceGroups(-1), platform(platform), platformData(NULL), checkpointWriter(NULL) {
     if (system.getNumParticles() == 0)
         throw OpenMMException("Cannot create a Context for a System with no particles");
     
@@ -82,16 +83,18 @@ ContextImpl::ContextImpl(Context& owner, const System& system, Integrator& integ
     
     // Validate the list of properties.
 
-    const vector<string>& platformProperties = platform->getPropertyNames();
-    for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter) {
-        bool valid = false;
-        for (int i = 0; i < (int) platformProperties.size(); i++)
-            if (platformProperties[i] == iter->first) {
-                valid = true;
-                break;
-            }
-        if (!valid)
-            throw OpenMMException("Illegal property name: "+iter->first);
+    if (platform != NULL) {
+        const vector<string>& platformProperties = platform->getPropertyNames();
+        for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter) {
+            bool valid = false;
+            for (int i = 0; i < (int) platformProperties.size(); i++)
+                if (platformProperties[i] == iter->first) {
+                    valid = true;
+                    break;
+                }
+            if (!valid)
+                throw OpenMMException("Illegal property name: "+iter->first);
+        }
     }
     
     // Find the list of kernels required.
@@ -163,6 +166,7 @@ ContextImpl::ContextImpl(Context& owner, const System& system, Integrator& integ
 }
 
 ContextImpl::~ContextImpl() {
+    delete checkpointWriter;
     for (int i = 0; i < (int) forceImpls.size(); ++i)
         delete forceImpls[i];
     
@@ -405,6 +409,38 @@ static string readString(istream& stream) {
     return str;
 }
 
+/**
+ * This stream buffer appends everything written to it to a string.  Unlike a stringstream, it lets
+ * the string's memory be reused from one checkpoint to the next.
+ */
+class StringOutputBuffer : public streambuf {
+public:
+    StringOutputBuffer(string& output) : output(output) {
+    }
+protected:
+    int overflow(int c) {
+        if (c != EOF)
+            output += (char) c;
+        return c;
+    }
+    streamsize xsputn(const char* s, streamsize n) {
+        output.append(s, n);
+        return n;
+    }
+private:
+    string& output;
+};
+
+static void writeVectors(ostream& stream, const vector<Vec3>& values) {
+    for (int i = 0; i < (int) values.size(); i++)
+        stream.write((char*) &values[i], sizeof(Vec3));
+}
+
+static void readVectors(istream& stream, vector<Vec3>& values) {
+    for (int i = 0; i < (int) values.size(); i++)
+        stream.read((char*) &values[i], sizeof(Vec3));
+}
+
 void ContextImpl::createCheckpoint(ostream& stream) {
     stream.write(CHECKPOINT_MAGIC_BYTES, sizeof(CHECKPOINT_MAGIC_BYTES)/sizeof(CHECKPOINT_MAGIC_BYTES[0]));
     writeString(stream, getPlatform().getName());
@@ -416,7 +452,30 @@ void ContextImpl::createCheckpoint(ostream& stream) {
         writeString(stream, iter->first);
         stream.write((char*) &iter->second, sizeof(double));
     }
-    updateStateDataKernel.getAs<UpdateStateDataKernel>().createCheckpoint(*this, stream);
+
+    // Write the platform independent section.
+
+    double time = getTime();
+    stream.write((char*) &time, sizeof(double));
+    Vec3 box[3];
+    getPeriodicBoxVectors(box[0], box[1], box[2]);
+    stream.write((char*) box, sizeof(box));
+    vector<Vec3> values;
+    getPositions(values);
+    writeVectors(stream, values);
+    getVelocities(values);
+    writeVectors(stream, values);
+
+    // Write the platform specific section, preceded by its length so it can be skipped when loading
+    // on a different platform.
+
+    string platformSection;
+    StringOutputBuffer buffer(platformSection);
+    ostream platformStream(&buffer);
+    updateStateDataKernel.getAs<UpdateStateDataKernel>().createCheckpoint(*this, platformStream);
+    long long length = platformSection.size();
+    stream.write((char*) &length, sizeof(long long));
+    stream.write(platformSection.c_str(), length);
     stream.flush();
 }
 
@@ -428,19 +487,60 @@ void ContextImpl::loadCheckpoint(istream& stream) {
         throw OpenMMException("loadCheckpoint: Checkpoint header was not correct");
 
     string platformName = readString(stream);
-    if (platformName != getPlatform().getName())
-        throw OpenMMException("loadCheckpoint: Checkpoint was created with a different Platform: "+platformName);
     int numParticles;
     stream.read((char*) &numParticles, sizeof(int));
     if (numParticles != getSystem().getNumParticles())
         throw OpenMMException("loadCheckpoint: Checkpoint contains the wrong number of particles");
     int numParameters;
     stream.read((char*) &numParameters, sizeof(int));
+    map<string, double> checkpointParameters;
     for (int i = 0; i < numParameters; i++) {
         string name = readString(stream);
         double value;
         stream.read((char*) &value, sizeof(double));
-        parameters[name] = value;
+        checkpointParameters[name] = value;
+    }
+    double time;
+    stream.read((char*) &time, sizeof(double));
+    Vec3 box[3];
+    stream.read((char*) box, sizeof(box));
+    vector<Vec3> positions(numParticles), velocities(numParticles);
+    readVectors(stream, positions);
+    readVectors(stream, velocities);
+    long long length;
+    stream.read((char*) &length, sizeof(long long));
+    if (!stream)
+        throw OpenMMException("loadCheckpoint: Checkpoint is incomplete");
+    if (platformName == getPlatform().getName()) {
+        for (map<string, double>::const_iterator iter = checkpointParameters.begin(); iter != checkpointParameters.end(); ++iter)
+            parameters[iter->first] = iter->second;
+        updateStateDataKernel.getAs<UpdateStateDataKernel>().loadCheckpoint(*this, stream);
+        return;
     }
-    updateStateDataKernel.getAs<UpdateStateDataKernel>().loadCheckpoint(*this, stream);
+
+    // The checkpoint came from a different platform, so restore only the platform independent state.
+
+    stream.ignore(length);
+    for (map<string, double>::const_iterator iter = checkpointParameters.begin(); iter != checkpointParameters.end(); ++iter)
+        if (parameters.find(iter->first) != parameters.end())
+            setParameter(iter->first, iter->second);
+    setTime(time);
+    setPeriodicBoxVectors(box[0], box[1], box[2]);
+    setPositions(positions);
+    setVelocities(velocities);
+}
+
+void ContextImpl::createCheckpointAsync(ostream& stream) {
+    if (checkpointWriter == NULL)
+        checkpointWriter = new CheckpointWriter();
+    checkpointBuffer.clear();
+    StringOutputBuffer buffer(checkpointBuffer);
+    ostream checkpointStream(&buffer);
+    createCheckpoint(checkpointStream);
+    checkpointWriter->write(stream, checkpointBuffer);
+}
+
+void ContextImpl::waitForCheckpoint() {
+    if (checkpointWriter != NULL)
+        checkpointWriter->waitForCompletion();
 }
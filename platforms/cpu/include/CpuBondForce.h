@@ -57,6 +57,14 @@ public:
      */
     void calculateForce(std::vector<OpenMM::RealVec>& atomCoordinates, RealOpenMM** parameters, std::vector<OpenMM::RealVec>& forces, 
             RealOpenMM* totalEnergy, ReferenceBondIxn& referenceBondIxn);
+    /**
+     * Compute the forces from all bonds, giving each thread its own ReferenceBondIxn.  This is needed
+     * when calculateBondIxn() modifies internal state, as is the case for custom forces that evaluate
+     * compiled expressions.  Bonds that cannot be assigned to any single thread are computed with
+     * the first element of threadBondIxn.
+     */
+    void calculateForce(std::vector<OpenMM::RealVec>& atomCoordinates, RealOpenMM** parameters, std::vector<OpenMM::RealVec>& forces, 
+            RealOpenMM* totalEnergy, std::vector<ReferenceBondIxn*>& threadBondIxn);
     /**
      * This routine contains the code executed by each thread.
      */
@@ -0,0 +1,150 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENMM_CPU_CUSTOM_COMPOUND_BOND_FORCE_H__
+#define OPENMM_CPU_CUSTOM_COMPOUND_BOND_FORCE_H__
+
+#include "CompiledExpressionSet.h"
+#include "CpuBondForce.h"
+#include "ReferenceBondIxn.h"
+#include "ReferenceForce.h"
+#include "openmm/CustomCompoundBondForce.h"
+#include "openmm/internal/ThreadPool.h"
+#include "lepton/CompiledExpression.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the interactions of a CustomCompoundBondForce.  The energy and all its derivatives are
+ * compiled into a single CompiledExpression.  Each thread has its own copy of it, and bonds are divided
+ * between threads by a CpuBondForce so no two threads ever write to the same atom.
+ */
+class CpuCustomCompoundBondForce {
+private:
+
+    class ParticleTermInfo;
+    class DistanceTermInfo;
+    class AngleTermInfo;
+    class DihedralTermInfo;
+    class ThreadData;
+    int numBonds;
+    std::vector<std::vector<int> > bondAtoms;
+    int** bondAtomArray;
+    CpuBondForce bondForce;
+    std::vector<ThreadData*> threadData;
+    std::vector<ReferenceBondIxn*> threadBondIxn;
+
+public:
+    /**
+     * Create a new CpuCustomCompoundBondForce.
+     *
+     * @param force      the CustomCompoundBondForce to create it for
+     * @param numAtoms   the number of atoms in the System
+     * @param threads    the thread pool to use
+     */
+    CpuCustomCompoundBondForce(const CustomCompoundBondForce& force, int numAtoms, ThreadPool& threads);
+
+    ~CpuCustomCompoundBondForce();
+
+    /**
+     * Get the list of atoms in each bond.
+     */
+    const std::vector<std::vector<int> >& getBondAtoms() const {
+        return bondAtoms;
+    }
+
+    /**
+     * Calculate the interaction.
+     *
+     * @param atomCoordinates    atom coordinates
+     * @param bondParameters     bond parameters values (bondParameters[bondIndex][parameterIndex])
+     * @param globalParameters   the values of global parameters
+     * @param forces             force array (forces added)
+     * @param totalEnergy        if not null, the energy will be added to this
+     */
+    void calculateIxn(std::vector<RealVec>& atomCoordinates, RealOpenMM** bondParameters, const std::map<std::string, double>& globalParameters,
+                      std::vector<RealVec>& forces, RealOpenMM* totalEnergy);
+};
+
+class CpuCustomCompoundBondForce::ParticleTermInfo {
+public:
+    int atom, component, variableIndex, derivIndex;
+    ParticleTermInfo(const std::string& name, int atom, int component, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomCompoundBondForce::DistanceTermInfo {
+public:
+    int p1, p2, variableIndex, derivIndex;
+    RealOpenMM delta[ReferenceForce::LastDeltaRIndex];
+    DistanceTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomCompoundBondForce::AngleTermInfo {
+public:
+    int p1, p2, p3, variableIndex, derivIndex;
+    RealOpenMM delta1[ReferenceForce::LastDeltaRIndex];
+    RealOpenMM delta2[ReferenceForce::LastDeltaRIndex];
+    AngleTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomCompoundBondForce::DihedralTermInfo {
+public:
+    int p1, p2, p3, p4, variableIndex, derivIndex;
+    RealOpenMM delta1[ReferenceForce::LastDeltaRIndex];
+    RealOpenMM delta2[ReferenceForce::LastDeltaRIndex];
+    RealOpenMM delta3[ReferenceForce::LastDeltaRIndex];
+    RealOpenMM cross1[3];
+    RealOpenMM cross2[3];
+    DihedralTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+/**
+ * This holds the expression and workspace used by one thread.  It is a ReferenceBondIxn so CpuBondForce
+ * can invoke it directly.  Since calculateBondIxn() is const, everything it modifies is mutable.
+ */
+class CpuCustomCompoundBondForce::ThreadData : public ReferenceBondIxn {
+public:
+    ThreadData(const CustomCompoundBondForce& force, const Lepton::CompiledExpression& expression, const std::vector<std::string>& particleVariables,
+            const std::map<std::string, std::vector<int> >& distances, const std::map<std::string, std::vector<int> >& angles,
+            const std::map<std::string, std::vector<int> >& dihedrals);
+    void calculateBondIxn(int* atomIndices, std::vector<OpenMM::RealVec>& atomCoordinates, RealOpenMM* parameters,
+            std::vector<OpenMM::RealVec>& forces, RealOpenMM* totalEnergy) const;
+    /**
+     * Output 0 of the expression is the energy, and each term's derivIndex selects the output holding its derivative.
+     */
+    mutable Lepton::CompiledExpression expression;
+    mutable CompiledExpressionSet expressionSet;
+    std::vector<int> bondParamIndex;
+    mutable std::vector<ParticleTermInfo> particleTerms;
+    mutable std::vector<DistanceTermInfo> distanceTerms;
+    mutable std::vector<AngleTermInfo> angleTerms;
+    mutable std::vector<DihedralTermInfo> dihedralTerms;
+};
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_CUSTOM_COMPOUND_BOND_FORCE_H__
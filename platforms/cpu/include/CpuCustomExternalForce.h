@@ -0,0 +1,147 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENMM_CPU_CUSTOM_EXTERNAL_FORCE_H__
+#define OPENMM_CPU_CUSTOM_EXTERNAL_FORCE_H__
+
+#include "AlignedArray.h"
+#include "CompiledExpressionSet.h"
+#include "CpuBondForce.h"
+#include "ReferenceBondIxn.h"
+#include "openmm/CustomExternalForce.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/internal/vectorize.h"
+#include "lepton/CompiledExpression.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the interactions of a CustomExternalForce.  The energy and its gradient are compiled into
+ * a single CompiledExpression, of which each thread has its own copy.
+ *
+ * Most uses of this force are harmonic position restraints.  When the energy is a quadratic function of x, y,
+ * and z with a diagonal Hessian (for example, k*((x-x0)^2+(y-y0)^2+(z-z0)^2)), it is instead rewritten for each
+ * particle as E = E0 + g.s + 0.5*c.s^2, where s is the displacement from the energy minimum.  The coefficients
+ * only need to be recomputed when parameters change, and the force on every particle is then evaluated with a
+ * few vector operations and no expression evaluation at all.
+ */
+class CpuCustomExternalForce {
+private:
+
+    class ThreadData;
+    class ComputeForceTask;
+    int numParticles;
+    std::vector<int> particles;
+    int** particleArray;
+    CpuBondForce bondForce;
+    std::vector<ThreadData*> threadData;
+    std::vector<ReferenceBondIxn*> threadBondIxn;
+    ThreadPool& threads;
+    bool useFastPath, coefficientsValid;
+    std::map<std::string, double> lastGlobalParameters;
+    std::vector<RealVec> restraintCenter;
+    AlignedArray<fvec4> restraintScale, restraintGradient;
+    std::vector<double> restraintEnergy;
+    // The following variables are used to make information accessible to the individual threads.
+    std::vector<RealVec>* atomCoordinates;
+    RealOpenMM** particleParameters;
+    std::vector<RealVec>* forces;
+    std::vector<double> threadEnergy;
+    bool includeEnergy;
+
+    /**
+     * This routine contains the code executed by each thread when using the fast path.
+     */
+    void threadComputeForce(ThreadPool& threads, int threadIndex);
+
+public:
+    /**
+     * Create a new CpuCustomExternalForce.
+     *
+     * @param force      the CustomExternalForce to create it for
+     * @param numAtoms   the number of atoms in the System
+     * @param threads    the thread pool to use
+     */
+    CpuCustomExternalForce(const CustomExternalForce& force, int numAtoms, ThreadPool& threads);
+
+    ~CpuCustomExternalForce();
+
+    /**
+     * Get the index of the atom each term is applied to.
+     */
+    const std::vector<int>& getParticles() const {
+        return particles;
+    }
+
+    /**
+     * Get whether the energy was recognized as a harmonic restraint, so the fast path is used.
+     */
+    bool getUseFastPath() const {
+        return useFastPath;
+    }
+
+    /**
+     * This must be called whenever the per-particle parameters are modified.
+     */
+    void parametersChanged() {
+        coefficientsValid = false;
+    }
+
+    /**
+     * Calculate the interaction.
+     *
+     * @param atomCoordinates    atom coordinates
+     * @param particleParameters particle parameter values (particleParameters[termIndex][parameterIndex])
+     * @param globalParameters   the values of global parameters
+     * @param forces             force array (forces added)
+     * @param totalEnergy        if not null, the energy will be added to this
+     */
+    void calculateIxn(std::vector<RealVec>& atomCoordinates, RealOpenMM** particleParameters, const std::map<std::string, double>& globalParameters,
+                      std::vector<RealVec>& forces, RealOpenMM* totalEnergy);
+};
+
+/**
+ * This holds the expression used by one thread.  It is a ReferenceBondIxn so CpuBondForce can invoke it directly.
+ */
+class CpuCustomExternalForce::ThreadData : public ReferenceBondIxn {
+public:
+    ThreadData(const CustomExternalForce& force, const Lepton::CompiledExpression& expression);
+    void calculateBondIxn(int* atomIndices, std::vector<OpenMM::RealVec>& atomCoordinates, RealOpenMM* parameters,
+            std::vector<OpenMM::RealVec>& forces, RealOpenMM* totalEnergy) const;
+    /**
+     * Outputs 0-3 of the expression are the energy and its derivatives with respect to x, y, and z.  When the fast
+     * path is used, outputs 4-6 are the second derivatives with respect to x, y, and z.
+     */
+    mutable Lepton::CompiledExpression expression;
+    mutable CompiledExpressionSet expressionSet;
+    std::vector<int> paramIndex;
+    int xIndex, yIndex, zIndex;
+};
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_CUSTOM_EXTERNAL_FORCE_H__
@@ -183,6 +183,11 @@ public:
 
     /**
      * Construct a new CpuCustomGBForce.
+     * 
+     * Each element of energyExpressions computes an energy term together with all of its derivatives.  Output 0
+     * is the energy.  For a SingleParticle term, it is followed by the derivative with respect to each computed value,
+     * then the derivatives with respect to x, y, and z.  For other terms, it is followed by the derivative with respect
+     * to r, then the derivatives with respect to each computed value of the first and second particle in turn.
      */
 
      CpuCustomGBForce(int numAtoms, const std::vector<std::set<int> >& exclusions,
@@ -192,8 +197,6 @@ public:
                         const std::vector<std::string>& valueNames,
                         const std::vector<CustomGBForce::ComputationType>& valueTypes,
                         const std::vector<Lepton::CompiledExpression>& energyExpressions,
-                        const std::vector<std::vector<Lepton::CompiledExpression> >& energyDerivExpressions,
-                        const std::vector<std::vector<Lepton::CompiledExpression> >& energyGradientExpressions,
                         const std::vector<CustomGBForce::ComputationType>& energyTypes,
                         const std::vector<std::string>& parameterNames, ThreadPool& threads);
 
@@ -233,6 +236,13 @@ public:
                      std::map<std::string, double>& globalParameters, std::vector<AlignedArray<float> >& threadForce, bool includeForce, bool includeEnergy, double& totalEnergy);
 };
 
+/**
+ * Unlike CpuCustomNonbondedForce, this class still evaluates its pair expressions one interaction at a time
+ * with CompiledExpressionSet.  The value and energy expressions share variables (including previously computed
+ * per-particle values) through the set, and each pair requires evaluating many expressions and their derivatives,
+ * so batching them would require a vectorized equivalent of CompiledExpressionSet.  Each energy term is compiled
+ * together with its derivatives, so they are all computed by a single evaluation.
+ */
 class CpuCustomGBForce::ThreadData {
 public:
     ThreadData(int numAtoms, int numThreads, int threadIndex,
@@ -241,8 +251,6 @@ public:
                const std::vector<std::vector<Lepton::CompiledExpression> >& valueGradientExpressions,
                const std::vector<std::string>& valueNames,
                const std::vector<Lepton::CompiledExpression>& energyExpressions,
-               const std::vector<std::vector<Lepton::CompiledExpression> >& energyDerivExpressions,
-               const std::vector<std::vector<Lepton::CompiledExpression> >& energyGradientExpressions,
                const std::vector<std::string>& parameterNames);
     CompiledExpressionSet expressionSet;
     std::vector<Lepton::CompiledExpression> valueExpressions;
@@ -250,8 +258,6 @@ public:
     std::vector<std::vector<Lepton::CompiledExpression> > valueGradientExpressions;
     std::vector<int> valueIndex;
     std::vector<Lepton::CompiledExpression> energyExpressions;
-    std::vector<std::vector<Lepton::CompiledExpression> > energyDerivExpressions;
-    std::vector<std::vector<Lepton::CompiledExpression> > energyGradientExpressions;
     std::vector<int> paramIndex;
     std::vector<int> particleParamIndex;
     std::vector<int> particleValueIndex;
@@ -0,0 +1,210 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENMM_CPU_CUSTOM_HBOND_FORCE_H__
+#define OPENMM_CPU_CUSTOM_HBOND_FORCE_H__
+
+#include "AlignedArray.h"
+#include "CompiledExpressionSet.h"
+#include "RealVec.h"
+#include "openmm/CustomHbondForce.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/internal/vectorize.h"
+#include "lepton/CompiledExpression.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the interactions of a CustomHbondForce.  When a cutoff is used, the acceptors are
+ * sorted into a grid of cells based on the position of their first particle, so each donor only needs to
+ * be compared to the acceptors in the cells adjacent to its own.  Donors are divided between threads, each
+ * of which adds forces to its own buffer.
+ */
+class CpuCustomHbondForce {
+private:
+
+    class DistanceTermInfo;
+    class AngleTermInfo;
+    class DihedralTermInfo;
+    class ComputeForceTask;
+    class ThreadData;
+    int numDonors, numAcceptors;
+    bool useCutoff, usePeriodic;
+    RealOpenMM cutoffDistance;
+    RealVec periodicBoxVectors[3];
+    std::vector<std::vector<int> > donorAtoms, acceptorAtoms;
+    std::vector<std::set<int> > exclusions;
+    std::vector<ThreadData*> threadData;
+    ThreadPool& threads;
+    int numCells[3];
+    float cellOrigin[3], cellScale[3];
+    std::vector<int> cellStart, cellAcceptors;
+    // The following variables are used to make information accessible to the individual threads.
+    float* posq;
+    RealOpenMM** donorParameters;
+    RealOpenMM** acceptorParameters;
+    const std::map<std::string, double>* globalParameters;
+    std::vector<AlignedArray<float> >* threadForce;
+    bool includeForces, includeEnergy;
+    void* atomicCounter;
+
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputeForce(ThreadPool& threads, int threadIndex);
+
+    /**
+     * Sort the acceptors into cells.
+     */
+    void buildCells();
+
+    /**
+     * Find the (possibly out of range) cell containing a position.  For periodic systems, this is computed
+     * from the fractional coordinates along the box vectors.
+     */
+    void getCellIndex(const float* pos, int* cell) const;
+
+    /**
+     * Calculate the interaction between a donor and an acceptor.
+     *
+     * @param donor       the index of the donor
+     * @param acceptor    the index of the acceptor
+     * @param forces      force array (forces added)
+     * @param data        information and workspace for the current thread
+     * @param boxSize     the size of the periodic box
+     * @param invBoxSize  the inverse size of the periodic box
+     */
+    void calculateOneIxn(int donor, int acceptor, float* forces, ThreadData& data, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Compute the displacement and squared distance between two points, optionally using
+     * periodic boundary conditions.
+     */
+    void computeDelta(const fvec4& posI, const fvec4& posJ, fvec4& deltaR, float& r2, const fvec4& boxSize, const fvec4& invBoxSize) const;
+
+    static float computeAngle(const fvec4& vi, const fvec4& vj, float v2i, float v2j);
+
+    static float getDihedralAngleBetweenThreeVectors(const fvec4& v1, const fvec4& v2, const fvec4& v3, fvec4& cross1, fvec4& cross2, const fvec4& signVector);
+
+public:
+    /**
+     * Create a new CpuCustomHbondForce.
+     *
+     * @param force      the CustomHbondForce to create it for
+     * @param threads    the thread pool to use
+     */
+    CpuCustomHbondForce(const CustomHbondForce& force, ThreadPool& threads);
+
+    ~CpuCustomHbondForce();
+
+    /**
+     * Get the list of atoms for each donor group.
+     */
+    const std::vector<std::vector<int> >& getDonorAtoms() const {
+        return donorAtoms;
+    }
+
+    /**
+     * Get the list of atoms for each acceptor group.
+     */
+    const std::vector<std::vector<int> >& getAcceptorAtoms() const {
+        return acceptorAtoms;
+    }
+
+    /**
+     * Set the force to use periodic boundary conditions.  This requires that a cutoff has
+     * already been set, and the smallest side of the periodic box is at least twice the cutoff
+     * distance.
+     *
+     * @param periodicBoxVectors    the vectors defining the periodic box
+     */
+    void setPeriodic(RealVec* periodicBoxVectors);
+
+    /**
+     * Calculate the interaction.
+     *
+     * @param posq               atom coordinates in float format
+     * @param donorParameters    donor parameter values (donorParameters[donorIndex][parameterIndex])
+     * @param acceptorParameters acceptor parameter values (acceptorParameters[acceptorIndex][parameterIndex])
+     * @param globalParameters   the values of global parameters
+     * @param threadForce        the collection of arrays for each thread to add forces to
+     * @param includeForces      whether to compute forces
+     * @param includeEnergy      whether to compute energy
+     * @param energy             the total energy is added to this
+     */
+    void calculateIxn(AlignedArray<float>& posq, RealOpenMM** donorParameters, RealOpenMM** acceptorParameters,
+                      const std::map<std::string, double>& globalParameters, std::vector<AlignedArray<float> >& threadForce,
+                      bool includeForces, bool includeEnergy, double& energy);
+};
+
+class CpuCustomHbondForce::DistanceTermInfo {
+public:
+    int p1, p2, variableIndex, derivIndex, delta;
+    DistanceTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomHbondForce::AngleTermInfo {
+public:
+    int p1, p2, p3, variableIndex, derivIndex, delta1, delta2;
+    AngleTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomHbondForce::DihedralTermInfo {
+public:
+    int p1, p2, p3, p4, variableIndex, derivIndex, delta1, delta2, delta3;
+    DihedralTermInfo(const std::string& name, const std::vector<int>& atoms, int derivIndex, ThreadData& data);
+};
+
+class CpuCustomHbondForce::ThreadData {
+public:
+    ThreadData(const CustomHbondForce& force, const Lepton::CompiledExpression& expression, const std::map<std::string, std::vector<int> >& distances,
+            const std::map<std::string, std::vector<int> >& angles, const std::map<std::string, std::vector<int> >& dihedrals);
+    /**
+     * Request the displacement from particle p1 to particle p2 (both numbered a1=0, a2=1, a3=2, d1=3, d2=4, d3=5),
+     * and return the index at which it will be stored in delta.
+     */
+    int requestDelta(int p1, int p2);
+    /**
+     * The energy and its derivatives with respect to every distance, angle, and dihedral are computed by a single
+     * expression.  Output 0 is the energy, and each term's derivIndex selects the output holding its derivative.
+     */
+    Lepton::CompiledExpression expression;
+    CompiledExpressionSet expressionSet;
+    std::vector<int> donorParamIndex, acceptorParamIndex;
+    std::vector<DistanceTermInfo> distanceTerms;
+    std::vector<AngleTermInfo> angleTerms;
+    std::vector<DihedralTermInfo> dihedralTerms;
+    std::vector<std::pair<int, int> > deltaPairs;
+    AlignedArray<fvec4> delta, cross1, cross2;
+    std::vector<float> normDelta, norm2Delta;
+    double energy;
+};
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_CUSTOM_HBOND_FORCE_H__
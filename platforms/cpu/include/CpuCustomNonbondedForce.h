@@ -29,7 +29,7 @@
 #include "CpuNeighborList.h"
 #include "openmm/internal/ThreadPool.h"
 #include "openmm/internal/vectorize.h"
-#include "lepton/CompiledExpression.h"
+#include "lepton/CompiledVectorExpression.h"
 #include <map>
 #include <set>
 #include <utility>
@@ -44,10 +44,12 @@ class CpuCustomNonbondedForce {
 
          Constructor
 
+         @param expression          computes the energy (output 0) and its derivative with respect to r (output 1)
+
          --------------------------------------------------------------------------------------- */
 
-       CpuCustomNonbondedForce(const Lepton::CompiledExpression& energyExpression, const Lepton::CompiledExpression& forceExpression,
-                                   const std::vector<std::string>& parameterNames, const std::vector<std::set<int> >& exclusions, ThreadPool& threads);
+       CpuCustomNonbondedForce(const Lepton::CompiledVectorExpression& expression, const std::vector<std::string>& parameterNames,
+                                   const std::vector<std::set<int> >& exclusions, ThreadPool& threads);
 
       /**---------------------------------------------------------------------------------------
 
@@ -101,6 +103,27 @@ class CpuCustomNonbondedForce {
 
       void setPeriodic(RealVec* periodicBoxVectors);
 
+      /**---------------------------------------------------------------------------------------
+
+         Compute interactions by interpolating in tables, rather than by evaluating the expression.
+         Every particle is assigned to a class, and there is one table for each ordered pair of
+         classes.  Interval i of a table covers the distances minDistance+i*spacing to
+         minDistance+(i+1)*spacing, and is described by 8 coefficients: a cubic polynomial in the
+         fractional position within the interval for the energy, followed by one for dE/dr.
+         Interactions closer than minDistance are still computed from the expression.  Pass
+         empty vectors to stop using tables.
+
+         @param particleClass       the class of each particle
+         @param numClasses          the number of classes
+         @param tables              the table for each pair of classes, indexed by class1*numClasses+class2
+         @param spacing             the spacing between table points, for each pair of classes
+         @param minDistance         the distance at which the tables begin
+
+         --------------------------------------------------------------------------------------- */
+
+      void setTables(const std::vector<int>& particleClass, int numClasses, const std::vector<std::vector<float> >& tables,
+                     const std::vector<float>& spacing, float minDistance);
+
       /**---------------------------------------------------------------------------------------
 
          Calculate custom pair ixn
@@ -139,6 +162,12 @@ private:
     std::vector<std::string> paramNames;
     std::vector<std::pair<int, int> > groupInteractions;
     std::vector<double> threadEnergy;
+    bool useTables;
+    int numClasses;
+    float tableMinDistance;
+    std::vector<int> particleClass;
+    std::vector<std::vector<float> > tables;
+    std::vector<float> tableInvSpacing;
     // The following variables are used to make information accessible to the individual threads.
     int numberOfAtoms;
     float* posq;
@@ -155,7 +184,8 @@ private:
     void threadComputeForce(ThreadPool& threads, int threadIndex);
 
     /**
-     * Calculate the interaction between two atoms.
+     * Add the interaction between two atoms to the current batch.  If this fills up the batch,
+     * computeBatch() is called to evaluate it.
      * 
      * @param atom1            the index of the first atom
      * @param atom2            the index of the second atom
@@ -165,7 +195,33 @@ private:
      * @param boxSize          the size of the periodic box
      * @param boxSize          the inverse size of the periodic box
      */
-    void calculateOneIxn(int atom1, int atom2, ThreadData& data, float* forces, double& totalEnergy, const fvec4& boxSize, const fvec4& invBoxSize);
+    void addOneIxn(int atom1, int atom2, ThreadData& data, float* forces, double& totalEnergy, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Evaluate all interactions in the current batch with a single call to each vectorized expression,
+     * and accumulate the resulting forces and energy.
+     * 
+     * @param data             workspace for the current thread
+     * @param forces           force array (forces added)
+     * @param totalEnergy      total energy
+     */
+    void computeBatch(ThreadData& data, float* forces, double& totalEnergy);
+
+    /**
+     * Evaluate all interactions in the current batch of tabulated interactions, and accumulate the
+     * resulting forces and energy.
+     * 
+     * @param data             workspace for the current thread
+     * @param forces           force array (forces added)
+     * @param totalEnergy      total energy
+     */
+    void computeTableBatch(ThreadData& data, float* forces, double& totalEnergy);
+
+    /**
+     * Apply the switching function to a set of interactions, then add their forces and energy.
+     */
+    void accumulateInteractions(int numInteractions, const int* atom1, const int* atom2, const float* deltaR, const float* r,
+                                const float* energy, const float* dEdR, float* forces, double& totalEnergy);
 
     /**
      * Compute the displacement and squared distance between two points, optionally using
@@ -176,13 +232,22 @@ private:
 
 class CpuCustomNonbondedForce::ThreadData {
 public:
-    ThreadData(const Lepton::CompiledExpression& energyExpression, const Lepton::CompiledExpression& forceExpression, const std::vector<std::string>& parameterNames);
-    Lepton::CompiledExpression energyExpression;
-    Lepton::CompiledExpression forceExpression;
-    std::vector<double*> energyParticleParams;
-    std::vector<double*> forceParticleParams;
-    double* energyR;
-    double* forceR;
+    ThreadData(const Lepton::CompiledVectorExpression& expression, const std::vector<std::string>& parameterNames);
+    float* getVariablePointer(const std::string& name);
+    void setVariable(float* pointer, float value);
+    Lepton::CompiledVectorExpression expression;
+    std::vector<float*> particleParams;
+    float* r;
+    // The interactions that have been collected for the next batch.
+    int width, numInBatch;
+    std::vector<int> batchAtom1, batchAtom2;
+    std::vector<float> batchDeltaR, batchR;
+    std::vector<float> unusedVariable;
+    // The interactions that have been collected for the next batch of table lookups.
+    int numInTableBatch;
+    int tableAtom1[4], tableAtom2[4];
+    float tableDeltaR[16], tableR[4], tableX[4];
+    const float* tableCoeff[4];
 };
 
 } // namespace OpenMM
@@ -26,6 +26,7 @@
 #define OPENMM_CPU_GBSAOBC_FORCE_H__
 
 #include "AlignedArray.h"
+#include "CpuNeighborList.h"
 #include "openmm/internal/ThreadPool.h"
 #include "openmm/internal/vectorize.h"
 #include <set>
@@ -43,8 +44,11 @@ public:
      * Set the force to use a cutoff.
      * 
      * @param distance    the cutoff distance
+     * @param neighbors   the neighbor list to use.  It may have any block size that is a multiple of 4, and
+     *                    may include pairs beyond the cutoff.  Its exclusions are ignored, since every pair
+     *                    within the cutoff contributes to the Born radii and energy.
      */
-    void setUseCutoff(float distance);
+    void setUseCutoff(float distance, const CpuNeighborList& neighbors);
 
     /**
      * 
@@ -105,10 +109,13 @@ private:
     std::vector<std::pair<float, float> > particleParams;        
     AlignedArray<float> bornRadii;
     std::vector<AlignedArray<float> > threadBornForces;
+    std::vector<AlignedArray<float> > threadBornSums;
+    AlignedArray<float> totalBornForces;
     AlignedArray<float> obcChain;
     std::vector<double> threadEnergy;
     std::vector<float> logTable;
     float logDX, logDXInv;
+    const CpuNeighborList* neighborList;
     // The following variables are used to make information accessible to the individual threads.
     float const* posq;
     std::vector<AlignedArray<float> >* threadForce;
@@ -125,6 +132,51 @@ private:
      */
     void getDeltaR(const fvec4& posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const;
     
+    /**
+     * Compute the Born radius and OBC chain term for one atom from the sum of the contributions of all other atoms.
+     */
+    void setBornRadius(int atom, float sum);
+
+    /**
+     * Compute the contribution of atom J to the integral used in computing the Born radius of atom I, where
+     * offsetRadius is the offset radius of I and scaledRadius is the scaled radius of J.  Lanes not set in include
+     * are 0.
+     */
+    fvec4 computeBornSumTerm(const fvec4& r, const fvec4& rInverse, const fvec4& offsetRadius, const fvec4& scaledRadius, const ivec4& include);
+
+    /**
+     * Compute the factor that, multiplied by the Born force of atom I and divided by r, gives the force along the
+     * displacement between I and J due to the dependence of I's Born radius on their separation.  Lanes not set in
+     * include are 0.
+     */
+    fvec4 computeChainTerm(const fvec4& r, const fvec4& rInverse, const fvec4& offsetRadius, const fvec4& scaledRadius, const ivec4& include);
+
+    /**
+     * Loop over the neighbor list, accumulating the contributions of every pair within the cutoff to the
+     * integral used in computing the Born radii.  Each thread adds them to its own element of threadBornSums.
+     */
+    void threadComputeNeighborBornSums(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Loop over the neighbor list, computing the first loop of the Born energy and forces for every pair within
+     * the cutoff.  The contribution of each particle interacting with itself is not included.
+     */
+    double threadComputeNeighborBornEnergy(int threadIndex, float preFactor, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Loop over the neighbor list, computing the forces from the chain rule terms involving the Born radii.
+     * This requires that totalBornForces has already been computed.
+     */
+    void threadComputeNeighborChainForces(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Determine which lanes of a group of four atoms within a neighbor list block should interact with a
+     * neighbor.  The atoms are positions firstPosition to firstPosition+3 in the block.  This excludes padding
+     * atoms and, if the neighbor is itself in the block, every atom that does not precede it, so each pair is
+     * processed exactly once.
+     */
+    ivec4 getNeighborMask(const int* blockAtom, int atomsInBlock, int blockSize, int firstPosition, int neighbor) const;
+
     /**
      * Evaluate log(x) using a lookup table for speed.
      */
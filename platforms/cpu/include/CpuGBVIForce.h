@@ -0,0 +1,190 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef OPENMM_CPU_GBVI_FORCE_H__
+#define OPENMM_CPU_GBVI_FORCE_H__
+
+#include "AlignedArray.h"
+#include "CpuNeighborList.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/internal/vectorize.h"
+#include <utility>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the GB/VI implicit solvent energy and forces.  It is organized the same way as
+ * CpuGBSAOBCForce: the Born radii, the pairwise energy, and the chain rule terms are each computed
+ * by a separate pass in which threads process blocks of four atoms at a time with vectorized pair loops.
+ */
+class CpuGBVIForce {
+public:
+    class ComputeTask;
+    CpuGBVIForce();
+
+    /**
+     * Set the force to use a cutoff.
+     * 
+     * @param distance    the cutoff distance
+     * @param neighbors   the neighbor list to use.  It may have any block size that is a multiple of 4, and
+     *                    may include pairs beyond the cutoff.  Its exclusions are ignored, since every pair
+     *                    within the cutoff contributes to the Born radii and energy.
+     */
+    void setUseCutoff(float distance, const CpuNeighborList& neighbors);
+
+    /**
+     * Set the force to use periodic boundary conditions.  This requires that a cutoff has
+     * already been set, and the smallest side of the periodic box is at least twice the cutoff
+     * distance.
+     *
+     * @param boxSize             the X, Y, and Z widths of the periodic box
+     */
+    void setPeriodic(float* periodicBoxSize);
+
+    /**
+     * Set the solute dielectric constant.
+     */
+    void setSoluteDielectric(float dielectric);
+
+    /**
+     * Set the solvent dielectric constant.
+     */
+    void setSolventDielectric(float dielectric);
+
+    /**
+     * Set how Born radii are computed from the volume integrals.
+     *
+     * @param useQuinticSpline   if true, the integral is smoothly switched off with a quintic spline as
+     *                           it approaches the atomic volume.  Otherwise, it is used unmodified.
+     * @param lowerLimitFactor   the fraction of the atomic volume at which the spline begins
+     * @param upperLimit         the value the spline approaches at the upper end
+     */
+    void setBornRadiusScaling(bool useQuinticSpline, float lowerLimitFactor, float upperLimit);
+
+    /**
+     * Get the per-particle parameters (atomic radius, scaled radius).
+     */
+    const std::vector<std::pair<float, float> >& getParticleParameters() const;
+
+    /**
+     * Set the per-particle parameters.
+     *
+     * @param params   the atomic radius and scaled radius of each particle
+     * @param gammas   the gamma parameter of each particle
+     */
+    void setParticleParameters(const std::vector<std::pair<float, float> >& params, const std::vector<float>& gammas);
+
+    /**
+     * Calculate the GB/VI forces and energy.
+     *
+     * @param posq             atom coordinates and charges
+     * @param threadForce      the force array for each thread (forces added)
+     * @param totalEnergy      if not null, the energy will be added to this
+     * @param threads          the thread pool to use
+     */
+    void computeForce(const AlignedArray<float>& posq, std::vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads);
+
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputeForce(ThreadPool& threads, int threadIndex);
+
+private:
+    bool cutoff;
+    bool periodic;
+    bool useQuinticSpline;
+    float periodicBoxSize[3];
+    float cutoffDistance, soluteDielectric, solventDielectric, quinticLowerLimitFactor, quinticUpperLimit;
+    std::vector<std::pair<float, float> > particleParams;
+    std::vector<float> gammas;
+    AlignedArray<float> bornRadii;
+    AlignedArray<float> switchDerivative;
+    std::vector<AlignedArray<float> > threadBornForces;
+    std::vector<AlignedArray<float> > threadBornSums;
+    AlignedArray<float> totalBornForces;
+    std::vector<double> threadEnergy;
+    const CpuNeighborList* neighborList;
+    // The following variables are used to make information accessible to the individual threads.
+    float const* posq;
+    std::vector<AlignedArray<float> >* threadForce;
+    bool includeEnergy;
+    void* atomicCounter;
+
+    /**
+     * Compute the displacement and squared distance between a collection of points, optionally using
+     * periodic boundary conditions.
+     */
+    void getDeltaR(const fvec4& posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const;
+
+    /**
+     * Compute the Born radius and switching function derivative for one atom from the sum of the
+     * volume integrals of all other atoms.
+     */
+    void setBornRadius(int atom, float sum);
+
+    /**
+     * Compute the volume integral of atom J over the region outside atom I (Eq. 4 of Labute, JCC 29 p. 1693),
+     * where radius is the atomic radius of I and scaledRadius is the scaled radius of J.  Lanes not set in
+     * include are 0.
+     */
+    fvec4 computeVolume(const fvec4& r, const fvec4& radius, const fvec4& scaledRadius, const ivec4& include) const;
+
+    /**
+     * Compute the derivative with respect to r of the value returned by computeVolume().  Lanes not set in
+     * include are 0.
+     */
+    fvec4 computeVolumeDerivative(const fvec4& r, const fvec4& radius, const fvec4& scaledRadius, const ivec4& include) const;
+
+    /**
+     * Loop over the neighbor list, accumulating the volume integrals of every pair within the cutoff.
+     * Each thread adds them to its own element of threadBornSums.
+     */
+    void threadComputeNeighborBornSums(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Loop over the neighbor list, computing the first loop of the Born energy and forces for every pair within
+     * the cutoff.  The contribution of each particle interacting with itself is included.
+     */
+    double threadComputeNeighborBornEnergy(int threadIndex, float preFactor, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Loop over the neighbor list, computing the forces from the chain rule terms involving the Born radii.
+     * This requires that totalBornForces has already been computed.
+     */
+    void threadComputeNeighborChainForces(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize);
+
+    /**
+     * Determine which lanes of a group of four atoms within a neighbor list block should interact with a
+     * neighbor.  This excludes padding atoms and, if the neighbor is itself in the block, every atom that does
+     * not precede it, so each pair is processed exactly once.
+     */
+    ivec4 getNeighborMask(const int* blockAtom, int atomsInBlock, int blockSize, int firstPosition, int neighbor) const;
+};
+
+} // namespace OpenMM
+
+// ---------------------------------------------------------------------------------------
+
+#endif // OPENMM_CPU_GBVI_FORCE_H__
@@ -33,19 +33,54 @@
  * -------------------------------------------------------------------------- */
 
 #include "CpuBondForce.h"
+#include "CpuBrownianDynamics.h"
+#include "CpuCustomCompoundBondForce.h"
+#include "CpuCustomExternalForce.h"
 #include "CpuCustomGBForce.h"
+#include "CpuCustomHbondForce.h"
 #include "CpuCustomManyParticleForce.h"
 #include "CpuCustomNonbondedForce.h"
 #include "CpuGBSAOBCForce.h"
+#include "CpuGBVIForce.h"
 #include "CpuLangevinDynamics.h"
 #include "CpuNeighborList.h"
 #include "CpuNonbondedForce.h"
 #include "CpuPlatform.h"
+#include "CpuRandom.h"
+#include "CpuVariableLangevinDynamics.h"
+#include "CpuVariableVerletDynamics.h"
+#include "ReferenceKernels.h"
+#include "lepton/CompiledExpression.h"
 #include "openmm/kernels.h"
 #include "openmm/System.h"
 
 namespace OpenMM {
 
+/**
+ * This kernel provides methods for setting and retrieving various state data.  It extends the reference
+ * kernel so that checkpoints also record the state of the CPU platform's random number generators.
+ */
+class CpuUpdateStateDataKernel : public ReferenceUpdateStateDataKernel {
+public:
+    CpuUpdateStateDataKernel(std::string name, const Platform& platform, ReferencePlatform::PlatformData& refData, CpuPlatform::PlatformData& data) :
+            ReferenceUpdateStateDataKernel(name, platform, refData), data(data) {
+    }
+    /**
+     * Create a checkpoint recording the current state of the Context.
+     * 
+     * @param stream    an output stream the checkpoint data should be written to
+     */
+    void createCheckpoint(ContextImpl& context, std::ostream& stream);
+    /**
+     * Load a checkpoint that was written by createCheckpoint().
+     * 
+     * @param stream    an input stream the checkpoint data should be read from
+     */
+    void loadCheckpoint(ContextImpl& context, std::istream& stream);
+private:
+    CpuPlatform::PlatformData& data;
+};
+
 /**
  * This kernel is invoked at the beginning and end of force and energy computations.  It gives the
  * Platform a chance to clear buffers and do other initialization at the beginning, and to do any
@@ -253,11 +288,21 @@ public:
      */
     void copyParametersToContext(ContextImpl& context, const CustomNonbondedForce& force);
 private:
+    /**
+     * Group the particles into classes with identical parameters, and build the tables of interactions between them.
+     */
+    void createTables();
+    /**
+     * Build the table for the interaction between two classes of particles.  This returns false if the requested
+     * accuracy could not be reached.
+     */
+    bool createTable(const std::vector<double>& params1, const std::vector<double>& params2, std::vector<float>& table, float& spacing);
     CpuPlatform::PlatformData& data;
     int numParticles;
     double **particleParamArray;
-    double nonbondedCutoff, switchingDistance, periodicBoxSize[3], longRangeCoefficient;
-    bool useSwitchingFunction, hasInitializedLongRangeCorrection;
+    double nonbondedCutoff, switchingDistance, periodicBoxSize[3], longRangeCoefficient, tableTolerance;
+    bool useSwitchingFunction, hasInitializedLongRangeCorrection, tablesNeedUpdate;
+    Lepton::CompiledExpression tableExpression;
     CustomNonbondedForce* forceCopy;
     std::map<std::string, double> globalParamValues;
     std::vector<std::set<int> > exclusions;
@@ -274,7 +319,7 @@ private:
 class CpuCalcGBSAOBCForceKernel : public CalcGBSAOBCForceKernel {
 public:
     CpuCalcGBSAOBCForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcGBSAOBCForceKernel(name, platform),
-            data(data) {
+            data(data), neighborList(NULL) {
     }
     ~CpuCalcGBSAOBCForceKernel();
     /**
@@ -304,6 +349,41 @@ private:
     CpuPlatform::PlatformData& data;
     std::vector<std::pair<float, float> > particleParams;
     CpuGBSAOBCForce obc;
+    CpuNeighborList* neighborList;
+    double cutoffDistance;
+};
+
+/**
+ * This kernel is invoked by GBVIForce to calculate the forces acting on the system.
+ */
+class CpuCalcGBVIForceKernel : public CalcGBVIForceKernel {
+public:
+    CpuCalcGBVIForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcGBVIForceKernel(name, platform),
+            data(data), neighborList(NULL) {
+    }
+    ~CpuCalcGBVIForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system       the System this kernel will be applied to
+     * @param force        the GBVIForce this kernel will be used for
+     * @param scaledRadii  the scaled radius of each particle
+     */
+    void initialize(const System& system, const GBVIForce& force, const std::vector<double>& scaledRadii);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+private:
+    CpuPlatform::PlatformData& data;
+    CpuGBVIForce gbvi;
+    CpuNeighborList* neighborList;
+    double cutoffDistance;
 };
 
 /**
@@ -353,6 +433,129 @@ private:
     CpuNeighborList* neighborList;
 };
 
+/**
+ * This kernel is invoked by CustomExternalForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcCustomExternalForceKernel : public CalcCustomExternalForceKernel {
+public:
+    CpuCalcCustomExternalForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcCustomExternalForceKernel(name, platform),
+            data(data), particleParamArray(NULL), ixn(NULL) {
+    }
+    ~CpuCalcCustomExternalForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the CustomExternalForce this kernel will be used for
+     */
+    void initialize(const System& system, const CustomExternalForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the CustomExternalForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const CustomExternalForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numParticles;
+    RealOpenMM **particleParamArray;
+    CpuCustomExternalForce* ixn;
+    std::vector<std::string> globalParameterNames;
+};
+
+/**
+ * This kernel is invoked by CustomHbondForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcCustomHbondForceKernel : public CalcCustomHbondForceKernel {
+public:
+    CpuCalcCustomHbondForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcCustomHbondForceKernel(name, platform),
+            data(data), donorParamArray(NULL), acceptorParamArray(NULL), ixn(NULL) {
+    }
+    ~CpuCalcCustomHbondForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the CustomHbondForce this kernel will be used for
+     */
+    void initialize(const System& system, const CustomHbondForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the CustomHbondForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const CustomHbondForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numDonors, numAcceptors;
+    RealOpenMM cutoffDistance;
+    RealOpenMM **donorParamArray;
+    RealOpenMM **acceptorParamArray;
+    CpuCustomHbondForce* ixn;
+    std::vector<std::string> globalParameterNames;
+    NonbondedMethod nonbondedMethod;
+};
+
+/**
+ * This kernel is invoked by CustomCompoundBondForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcCustomCompoundBondForceKernel : public CalcCustomCompoundBondForceKernel {
+public:
+    CpuCalcCustomCompoundBondForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : CalcCustomCompoundBondForceKernel(name, platform),
+            data(data), bondParamArray(NULL), ixn(NULL) {
+    }
+    ~CpuCalcCustomCompoundBondForceKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param force      the CustomCompoundBondForce this kernel will be used for
+     */
+    void initialize(const System& system, const CustomCompoundBondForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the CustomCompoundBondForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const CustomCompoundBondForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numBonds;
+    RealOpenMM **bondParamArray;
+    CpuCustomCompoundBondForce* ixn;
+    std::vector<std::string> globalParameterNames;
+};
+
 /**
  * This kernel is invoked by CustomManyParticleForce to calculate the forces acting on the system and the energy of the system.
  */
@@ -432,6 +635,179 @@ private:
     double prevTemp, prevFriction, prevStepSize;
 };
 
+/**
+ * This kernel is invoked by BrownianIntegrator to take one time step.
+ */
+class CpuIntegrateBrownianStepKernel : public IntegrateBrownianStepKernel {
+public:
+    CpuIntegrateBrownianStepKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : IntegrateBrownianStepKernel(name, platform),
+            data(data), dynamics(NULL) {
+    }
+    ~CpuIntegrateBrownianStepKernel();
+    /**
+     * Initialize the kernel, setting up the particle masses.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param integrator the BrownianIntegrator this kernel will be used for
+     */
+    void initialize(const System& system, const BrownianIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the BrownianIntegrator this kernel is being used for
+     */
+    void execute(ContextImpl& context, const BrownianIntegrator& integrator);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the BrownianIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(ContextImpl& context, const BrownianIntegrator& integrator);
+private:
+    CpuPlatform::PlatformData& data;
+    CpuBrownianDynamics* dynamics;
+    std::vector<RealOpenMM> masses;
+    double prevTemp, prevFriction, prevStepSize;
+};
+
+/**
+ * This kernel is invoked by VariableLangevinIntegrator to take one time step.
+ */
+class CpuIntegrateVariableLangevinStepKernel : public IntegrateVariableLangevinStepKernel {
+public:
+    CpuIntegrateVariableLangevinStepKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : IntegrateVariableLangevinStepKernel(name, platform),
+            data(data), dynamics(NULL) {
+    }
+    ~CpuIntegrateVariableLangevinStepKernel();
+    /**
+     * Initialize the kernel, setting up the particle masses.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param integrator the VariableLangevinIntegrator this kernel will be used for
+     */
+    void initialize(const System& system, const VariableLangevinIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     *
+     * @param context    the context in which to execute this kernel
+     * @param integrator the VariableLangevinIntegrator this kernel is being used for
+     * @param maxTime    the maximum time beyond which the simulation should not be advanced
+     * @return the size of the step that was taken
+     */
+    double execute(ContextImpl& context, const VariableLangevinIntegrator& integrator, double maxTime);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the VariableLangevinIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(ContextImpl& context, const VariableLangevinIntegrator& integrator);
+private:
+    CpuPlatform::PlatformData& data;
+    CpuVariableLangevinDynamics* dynamics;
+    std::vector<RealOpenMM> masses;
+    double prevTemp, prevFriction, prevErrorTol;
+};
+
+/**
+ * This kernel is invoked by VariableVerletIntegrator to take one time step.
+ */
+class CpuIntegrateVariableVerletStepKernel : public IntegrateVariableVerletStepKernel {
+public:
+    CpuIntegrateVariableVerletStepKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : IntegrateVariableVerletStepKernel(name, platform),
+            data(data), dynamics(NULL) {
+    }
+    ~CpuIntegrateVariableVerletStepKernel();
+    /**
+     * Initialize the kernel, setting up the particle masses.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param integrator the VariableVerletIntegrator this kernel will be used for
+     */
+    void initialize(const System& system, const VariableVerletIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     *
+     * @param context    the context in which to execute this kernel
+     * @param integrator the VariableVerletIntegrator this kernel is being used for
+     * @param maxTime    the maximum time beyond which the simulation should not be advanced
+     * @return the size of the step that was taken
+     */
+    double execute(ContextImpl& context, const VariableVerletIntegrator& integrator, double maxTime);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator the VariableVerletIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(ContextImpl& context, const VariableVerletIntegrator& integrator);
+private:
+    CpuPlatform::PlatformData& data;
+    CpuVariableVerletDynamics* dynamics;
+    std::vector<RealOpenMM> masses;
+    double prevErrorTol;
+};
+
+/**
+ * This kernel is invoked by AndersenThermostat at the start of each time step to adjust the particle velocities.
+ */
+class CpuApplyAndersenThermostatKernel : public ApplyAndersenThermostatKernel {
+public:
+    class ApplyThermostatTask;
+    CpuApplyAndersenThermostatKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : ApplyAndersenThermostatKernel(name, platform),
+            data(data) {
+    }
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param thermostat the AndersenThermostat this kernel will be used for
+     */
+    void initialize(const System& system, const AndersenThermostat& thermostat);
+    /**
+     * Execute the kernel.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void execute(ContextImpl& context);
+private:
+    CpuPlatform::PlatformData& data;
+    std::vector<std::vector<int> > particleGroups;
+    std::vector<RealOpenMM> masses;
+};
+
+/**
+ * This kernel is invoked to remove center of mass motion from the system.
+ */
+class CpuRemoveCMMotionKernel : public RemoveCMMotionKernel {
+public:
+    class RemoveMomentumTask;
+    CpuRemoveCMMotionKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) : RemoveCMMotionKernel(name, platform), data(data) {
+    }
+    /**
+     * Initialize the kernel, setting up the particle masses.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the CMMotionRemover this kernel will be used for
+     */
+    void initialize(const System& system, const CMMotionRemover& force);
+    /**
+     * Execute the kernel.
+     * 
+     * @param context    the context in which to execute this kernel
+     */
+    void execute(ContextImpl& context);
+private:
+    CpuPlatform::PlatformData& data;
+    std::vector<double> masses;
+    std::vector<RealVec> threadMomentum;
+    RealVec cmVelocity;
+    double inverseTotalMass;
+    int frequency;
+};
+
 } // namespace OpenMM
 
 #endif /*OPENMM_CPUKERNELS_H_*/
@@ -47,8 +47,24 @@ public:
     class ThreadTask;
     class Voxels;
     CpuNeighborList(int blockSize);
+    /**
+     * Record the exclusions to use when building the neighbor list.  They are converted to a compact table
+     * (sorted excluded atoms for each atom, stored contiguously), so this only needs to be called once when
+     * the exclusions are first known, not every time the list is rebuilt.
+     */
+    void setExclusions(const std::vector<std::set<int> >& exclusions);
+    /**
+     * Build the neighbor list, using the exclusions most recently passed to setExclusions().
+     */
+    void computeNeighborList(int numAtoms, const AlignedArray<float>& atomLocations, const RealVec* periodicBoxVectors,
+            bool usePeriodic, float maxDistance, ThreadPool& threads);
+    /**
+     * Set the exclusions and build the neighbor list.  This is equivalent to calling setExclusions() followed by
+     * computeNeighborList().
+     */
     void computeNeighborList(int numAtoms, const AlignedArray<float>& atomLocations, const std::vector<std::set<int> >& exclusions,
             const RealVec* periodicBoxVectors, bool usePeriodic, float maxDistance, ThreadPool& threads);
+    int getBlockSize() const;
     int getNumBlocks() const;
     const std::vector<int>& getSortedAtoms() const;
     const std::vector<int>& getBlockNeighbors(int blockIndex) const;
@@ -63,11 +79,12 @@ private:
     std::vector<int> sortedAtoms;
     std::vector<std::vector<int> > blockNeighbors;
     std::vector<std::vector<char> > blockExclusions;
+    std::vector<int> exclusionStart;
+    std::vector<int> exclusionAtoms;
     // The following variables are used to make information accessible to the individual threads.
     float minx, maxx, miny, maxy, minz, maxz;
     std::vector<std::pair<int, int> > atomBins;
     Voxels* voxels;
-    const std::vector<std::set<int> >* exclusions;
     const float* atomLocations;
     RealVec periodicBoxVectors[3];
     int numAtoms;
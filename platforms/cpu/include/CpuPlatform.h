@@ -34,6 +34,7 @@
 
 #include "AlignedArray.h"
 #include "CpuRandom.h"
+#include "RealVec.h"
 #include "ReferencePlatform.h"
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/internal/ThreadPool.h"
@@ -41,6 +42,8 @@
 #include <map>
 
 namespace OpenMM {
+
+class CpuNeighborList;
     
 /**
  * This Platform subclass uses CPU implementations of the OpenMM kernels.
@@ -67,6 +70,19 @@ public:
         static const std::string key = "CpuThreads";
         return key;
     }
+    /**
+     * This is the name of the parameter for selecting the error tolerance used when tabulating the interactions of a
+     * CustomNonbondedForce.  When it is greater than 0 and the force uses a cutoff, the energy and its derivative are
+     * sampled onto cubic spline tables for every pair of particle types (particles with identical per-particle parameters),
+     * with enough points that the interpolated values differ from the expression by no more than this fraction of their
+     * magnitude (or of 1, whichever is larger).  Interactions closer than 1/10 of the cutoff are always computed from the
+     * expression.  If there are more than 32 types, or the tolerance cannot be reached, the tables are not used.  The
+     * default value of 0 disables tabulation.
+     */
+    static const std::string& CpuCustomNonbondedTableTolerance() {
+        static const std::string key = "CpuCustomNonbondedTableTolerance";
+        return key;
+    }
     /**
      * We cannot use the standard mechanism for platform data, because that is already used by the superclass.
      * Instead, we maintain a table of ContextImpls to PlatformDatas.
@@ -85,7 +101,25 @@ public:
     ThreadPool threads;
     bool isPeriodic;
     CpuRandom random;
+    CpuRandom thermostatRandom;
     std::map<std::string, std::string> propertyValues;
+    /**
+     * Record a neighbor list that other kernels may use instead of building their own.  This is called by the
+     * NonbondedForce kernel.  The list must contain every pair of particles within paddedCutoff of each other
+     * at the positions stored in listPositions, and both the list and the vector must remain valid for the
+     * life of the context.  Only the first list to be recorded is used.
+     */
+    void setSharedNeighborList(const CpuNeighborList& list, double cutoff, double paddedCutoff, const std::vector<RealVec>& listPositions);
+    /**
+     * Get the shared neighbor list, if one has been recorded with the specified cutoff and no particle has
+     * moved far enough since it was built for any pair within the cutoff to be missing from it.  Otherwise
+     * this returns NULL.
+     */
+    const CpuNeighborList* getSharedNeighborList(double cutoff, const std::vector<RealVec>& positions) const;
+private:
+    const CpuNeighborList* sharedNeighborList;
+    double sharedNeighborListCutoff, sharedNeighborListPadding;
+    const std::vector<RealVec>* sharedNeighborListPositions;
 };
 
 } // namespace OpenMM
@@ -0,0 +1,108 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __CPU_VARIABLE_VERLET_DYNAMICS_H__
+#define __CPU_VARIABLE_VERLET_DYNAMICS_H__
+
+#include "ReferenceVariableVerletDynamics.h"
+#include "openmm/internal/ThreadPool.h"
+
+namespace OpenMM {
+
+class CpuVariableVerletDynamics : public ReferenceVariableVerletDynamics {
+public:
+    class ErrorTask;
+    class Update1Task;
+    class Update2Task;
+    /**
+     * Constructor.
+     *
+     * @param numberOfAtoms  number of atoms
+     * @param accuracy       required accuracy
+     * @param threads        thread pool for parallelizing computation
+     */
+    CpuVariableVerletDynamics(int numberOfAtoms, RealOpenMM accuracy, OpenMM::ThreadPool& threads);
+
+    /**
+     * Destructor.
+     */
+    ~CpuVariableVerletDynamics();
+
+    /**
+     * Compute the RMS acceleration, which is used to estimate the integration error.  Each thread sums
+     * over a block of atoms, and the partial sums are then added in a fixed order so the result does
+     * not depend on thread timing.
+     *
+     * @param numberOfAtoms       number of atoms
+     * @param forces              forces
+     * @param inverseMasses       inverse atom masses
+     */
+    RealOpenMM computeErrorNorm(int numberOfAtoms, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses);
+
+    /**
+     * First update step.
+     *
+     * @param numberOfAtoms       number of atoms
+     * @param atomCoordinates     atom coordinates
+     * @param velocities          velocities
+     * @param forces              forces
+     * @param inverseMasses       inverse atom masses
+     * @param xPrime              xPrime
+     * @param vstep               the time interval by which to advance the velocities
+     */
+    void updatePart1(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                     std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime,
+                     RealOpenMM vstep);
+
+    /**
+     * Second update step.
+     *
+     * @param numberOfAtoms       number of atoms
+     * @param atomCoordinates     atom coordinates
+     * @param velocities          velocities
+     * @param inverseMasses       inverse atom masses
+     * @param xPrime              xPrime
+     */
+    void updatePart2(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                     std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime);
+
+private:
+    void threadComputeError(int threadIndex);
+    void threadUpdate1(int threadIndex);
+    void threadUpdate2(int threadIndex);
+    OpenMM::ThreadPool& threads;
+    std::vector<double> threadError;
+    // The following variables are used to make information accessible to the individual threads.
+    int numberOfAtoms;
+    OpenMM::RealVec* atomCoordinates;
+    OpenMM::RealVec* velocities;
+    OpenMM::RealVec* forces;
+    RealOpenMM* inverseMasses;
+    OpenMM::RealVec* xPrime;
+    RealOpenMM vstep;
+};
+
+} // namespace OpenMM
+
+#endif // __CPU_VARIABLE_VERLET_DYNAMICS_H__
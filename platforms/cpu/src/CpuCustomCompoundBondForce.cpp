@@ -0,0 +1,285 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <sstream>
+
+#include "CpuCustomCompoundBondForce.h"
+#include "ReferenceTabulatedFunction.h"
+#include "SimTKOpenMMUtilities.h"
+#include "openmm/internal/CustomCompoundBondForceImpl.h"
+#include "lepton/CustomFunction.h"
+#include "lepton/Operation.h"
+#include "lepton/ParsedExpression.h"
+
+using namespace OpenMM;
+using namespace std;
+
+static bool isZero(const Lepton::ParsedExpression& expression) {
+    const Lepton::Operation& op = expression.getRootNode().getOperation();
+    return (op.getId() == Lepton::Operation::CONSTANT && dynamic_cast<const Lepton::Operation::Constant&>(op).getValue() == 0.0);
+}
+
+CpuCustomCompoundBondForce::CpuCustomCompoundBondForce(const CustomCompoundBondForce& force, int numAtoms, ThreadPool& threads) {
+    numBonds = force.getNumBonds();
+    int numParticlesPerBond = force.getNumParticlesPerBond();
+    bondAtoms.resize(numBonds);
+    bondAtomArray = new int*[numBonds];
+    for (int i = 0; i < numBonds; i++) {
+        vector<double> parameters;
+        force.getBondParameters(i, bondAtoms[i], parameters);
+        bondAtomArray[i] = new int[numParticlesPerBond];
+        for (int j = 0; j < numParticlesPerBond; j++)
+            bondAtomArray[i][j] = bondAtoms[i][j];
+    }
+    bondForce.initialize(numAtoms, numBonds, numParticlesPerBond, bondAtomArray, threads);
+
+    // Create custom functions for the tabulated functions.
+
+    map<string, Lepton::CustomFunction*> functions;
+    for (int i = 0; i < force.getNumFunctions(); i++)
+        functions[force.getTabulatedFunctionName(i)] = createReferenceTabulatedFunction(force.getTabulatedFunction(i));
+
+    // Parse the expression, and compile it together with all the derivatives that are not identically zero.
+
+    map<string, vector<int> > distances;
+    map<string, vector<int> > angles;
+    map<string, vector<int> > dihedrals;
+    Lepton::ParsedExpression energyExpr = CustomCompoundBondForceImpl::prepareExpression(force, functions, distances, angles, dihedrals);
+    vector<Lepton::ParsedExpression> outputs;
+    outputs.push_back(energyExpr);
+    vector<string> particleVariables;
+    for (int i = 0; i < numParticlesPerBond; i++) {
+        for (int j = 0; j < 3; j++) {
+            stringstream name;
+            name << "xyz"[j] << (i+1);
+            Lepton::ParsedExpression deriv = energyExpr.differentiate(name.str()).optimize();
+            if (!isZero(deriv)) {
+                particleVariables.push_back(name.str());
+                outputs.push_back(deriv);
+            }
+        }
+    }
+    for (map<string, vector<int> >::const_iterator iter = distances.begin(); iter != distances.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    for (map<string, vector<int> >::const_iterator iter = angles.begin(); iter != angles.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    for (map<string, vector<int> >::const_iterator iter = dihedrals.begin(); iter != dihedrals.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    Lepton::CompiledExpression expression(outputs);
+    for (int i = 0; i < threads.getNumThreads(); i++) {
+        threadData.push_back(new ThreadData(force, expression, particleVariables, distances, angles, dihedrals));
+        threadBondIxn.push_back(threadData[i]);
+    }
+
+    // Delete the custom functions.
+
+    for (map<string, Lepton::CustomFunction*>::iterator iter = functions.begin(); iter != functions.end(); iter++)
+        delete iter->second;
+}
+
+CpuCustomCompoundBondForce::~CpuCustomCompoundBondForce() {
+    for (int i = 0; i < numBonds; i++)
+        delete[] bondAtomArray[i];
+    delete[] bondAtomArray;
+    for (int i = 0; i < (int) threadData.size(); i++)
+        delete threadData[i];
+}
+
+void CpuCustomCompoundBondForce::calculateIxn(vector<RealVec>& atomCoordinates, RealOpenMM** bondParameters, const map<string, double>& globalParameters,
+                                              vector<RealVec>& forces, RealOpenMM* totalEnergy) {
+    for (int i = 0; i < (int) threadData.size(); i++) {
+        CompiledExpressionSet& expressionSet = threadData[i]->expressionSet;
+        for (map<string, double>::const_iterator iter = globalParameters.begin(); iter != globalParameters.end(); ++iter)
+            expressionSet.setVariable(expressionSet.getVariableIndex(iter->first), iter->second);
+    }
+    bondForce.calculateForce(atomCoordinates, bondParameters, forces, totalEnergy, threadBondIxn);
+}
+
+CpuCustomCompoundBondForce::ParticleTermInfo::ParticleTermInfo(const string& name, int atom, int component, int derivIndex, ThreadData& data) :
+        atom(atom), component(component), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+}
+
+CpuCustomCompoundBondForce::DistanceTermInfo::DistanceTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+}
+
+CpuCustomCompoundBondForce::AngleTermInfo::AngleTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), p3(atoms[2]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+}
+
+CpuCustomCompoundBondForce::DihedralTermInfo::DihedralTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), p3(atoms[2]), p4(atoms[3]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+}
+
+CpuCustomCompoundBondForce::ThreadData::ThreadData(const CustomCompoundBondForce& force, const Lepton::CompiledExpression& expression,
+            const vector<string>& particleVariables, const map<string, vector<int> >& distances, const map<string, vector<int> >& angles,
+            const map<string, vector<int> >& dihedrals) : expression(expression) {
+    expressionSet.registerExpression(this->expression);
+    for (int i = 0; i < force.getNumPerBondParameters(); i++)
+        bondParamIndex.push_back(expressionSet.getVariableIndex(force.getPerBondParameterName(i)));
+    int derivIndex = 1;
+    for (int i = 0; i < (int) particleVariables.size(); i++) {
+        const string& name = particleVariables[i];
+        int component = (name[0] == 'x' ? 0 : (name[0] == 'y' ? 1 : 2));
+        int atom = atoi(name.substr(1).c_str())-1;
+        particleTerms.push_back(CpuCustomCompoundBondForce::ParticleTermInfo(name, atom, component, derivIndex++, *this));
+    }
+    for (map<string, vector<int> >::const_iterator iter = distances.begin(); iter != distances.end(); ++iter)
+        distanceTerms.push_back(CpuCustomCompoundBondForce::DistanceTermInfo(iter->first, iter->second, derivIndex++, *this));
+    for (map<string, vector<int> >::const_iterator iter = angles.begin(); iter != angles.end(); ++iter)
+        angleTerms.push_back(CpuCustomCompoundBondForce::AngleTermInfo(iter->first, iter->second, derivIndex++, *this));
+    for (map<string, vector<int> >::const_iterator iter = dihedrals.begin(); iter != dihedrals.end(); ++iter)
+        dihedralTerms.push_back(CpuCustomCompoundBondForce::DihedralTermInfo(iter->first, iter->second, derivIndex++, *this));
+}
+
+void CpuCustomCompoundBondForce::ThreadData::calculateBondIxn(int* atoms, vector<RealVec>& atomCoordinates, RealOpenMM* parameters,
+            vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+    // Compute all of the variables the energy can depend on.
+
+    for (int i = 0; i < (int) bondParamIndex.size(); i++)
+        expressionSet.setVariable(bondParamIndex[i], parameters[i]);
+    for (int i = 0; i < (int) particleTerms.size(); i++) {
+        const ParticleTermInfo& term = particleTerms[i];
+        expressionSet.setVariable(term.variableIndex, atomCoordinates[atoms[term.atom]][term.component]);
+    }
+    for (int i = 0; i < (int) distanceTerms.size(); i++) {
+        DistanceTermInfo& term = distanceTerms[i];
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p1]], atomCoordinates[atoms[term.p2]], term.delta);
+        expressionSet.setVariable(term.variableIndex, term.delta[ReferenceForce::RIndex]);
+    }
+    for (int i = 0; i < (int) angleTerms.size(); i++) {
+        AngleTermInfo& term = angleTerms[i];
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p1]], atomCoordinates[atoms[term.p2]], term.delta1);
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p3]], atomCoordinates[atoms[term.p2]], term.delta2);
+        RealOpenMM cosine = DOT3(term.delta1, term.delta2)/SQRT(term.delta1[ReferenceForce::R2Index]*term.delta2[ReferenceForce::R2Index]);
+        RealOpenMM angle;
+        if (cosine >= 1)
+            angle = 0;
+        else if (cosine <= -1)
+            angle = PI_M;
+        else
+            angle = ACOS(cosine);
+        expressionSet.setVariable(term.variableIndex, angle);
+    }
+    for (int i = 0; i < (int) dihedralTerms.size(); i++) {
+        DihedralTermInfo& term = dihedralTerms[i];
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p2]], atomCoordinates[atoms[term.p1]], term.delta1);
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p2]], atomCoordinates[atoms[term.p3]], term.delta2);
+        ReferenceForce::getDeltaR(atomCoordinates[atoms[term.p4]], atomCoordinates[atoms[term.p3]], term.delta3);
+        RealOpenMM dotDihedral, signOfDihedral;
+        RealOpenMM* crossProduct[] = {term.cross1, term.cross2};
+        expressionSet.setVariable(term.variableIndex, getDihedralAngleBetweenThreeVectors(term.delta1, term.delta2, term.delta3, crossProduct, &dotDihedral, term.delta1, &signOfDihedral, 1));
+    }
+
+    // Evaluate the energy and all its derivatives.
+
+    expression.evaluate();
+
+    // Apply forces based on individual particle coordinates.
+
+    for (int i = 0; i < (int) particleTerms.size(); i++) {
+        const ParticleTermInfo& term = particleTerms[i];
+        forces[atoms[term.atom]][term.component] -= expression.getOutput(term.derivIndex);
+    }
+
+    // Apply forces based on distances.
+
+    for (int i = 0; i < (int) distanceTerms.size(); i++) {
+        const DistanceTermInfo& term = distanceTerms[i];
+        RealOpenMM dEdR = (RealOpenMM) (expression.getOutput(term.derivIndex)/(term.delta[ReferenceForce::RIndex]));
+        for (int j = 0; j < 3; j++) {
+           RealOpenMM force = -dEdR*term.delta[j];
+           forces[atoms[term.p1]][j] -= force;
+           forces[atoms[term.p2]][j] += force;
+        }
+    }
+
+    // Apply forces based on angles.
+
+    for (int i = 0; i < (int) angleTerms.size(); i++) {
+        AngleTermInfo& term = angleTerms[i];
+        RealOpenMM dEdTheta = (RealOpenMM) expression.getOutput(term.derivIndex);
+        RealOpenMM thetaCross[ReferenceForce::LastDeltaRIndex];
+        SimTKOpenMMUtilities::crossProductVector3(term.delta1, term.delta2, thetaCross);
+        RealOpenMM lengthThetaCross = SQRT(DOT3(thetaCross, thetaCross));
+        if (lengthThetaCross < 1.0e-06)
+            lengthThetaCross = (RealOpenMM) 1.0e-06;
+        RealOpenMM termA = dEdTheta/(term.delta1[ReferenceForce::R2Index]*lengthThetaCross);
+        RealOpenMM termC = -dEdTheta/(term.delta2[ReferenceForce::R2Index]*lengthThetaCross);
+        RealOpenMM deltaCrossP[3][3];
+        SimTKOpenMMUtilities::crossProductVector3(term.delta1, thetaCross, deltaCrossP[0]);
+        SimTKOpenMMUtilities::crossProductVector3(term.delta2, thetaCross, deltaCrossP[2]);
+        for (int j = 0; j < 3; j++) {
+            deltaCrossP[0][j] *= termA;
+            deltaCrossP[2][j] *= termC;
+            deltaCrossP[1][j] = -(deltaCrossP[0][j]+deltaCrossP[2][j]);
+        }
+        for (int j = 0; j < 3; j++) {
+            forces[atoms[term.p1]][j] += deltaCrossP[0][j];
+            forces[atoms[term.p2]][j] += deltaCrossP[1][j];
+            forces[atoms[term.p3]][j] += deltaCrossP[2][j];
+        }
+    }
+
+    // Apply forces based on dihedrals.
+
+    for (int i = 0; i < (int) dihedralTerms.size(); i++) {
+        const DihedralTermInfo& term = dihedralTerms[i];
+        RealOpenMM dEdTheta = (RealOpenMM) expression.getOutput(term.derivIndex);
+        RealOpenMM internalF[4][3];
+        RealOpenMM forceFactors[4];
+        RealOpenMM normCross1 = DOT3(term.cross1, term.cross1);
+        RealOpenMM normBC = term.delta2[ReferenceForce::RIndex];
+        forceFactors[0] = (-dEdTheta*normBC)/normCross1;
+        RealOpenMM normCross2 = DOT3(term.cross2, term.cross2);
+        forceFactors[3] = (dEdTheta*normBC)/normCross2;
+        forceFactors[1] = DOT3(term.delta1, term.delta2);
+        forceFactors[1] /= term.delta2[ReferenceForce::R2Index];
+        forceFactors[2] = DOT3(term.delta3, term.delta2);
+        forceFactors[2] /= term.delta2[ReferenceForce::R2Index];
+        for (int j = 0; j < 3; j++) {
+            internalF[0][j] = forceFactors[0]*term.cross1[j];
+            internalF[3][j] = forceFactors[3]*term.cross2[j];
+            RealOpenMM s = forceFactors[1]*internalF[0][j] - forceFactors[2]*internalF[3][j];
+            internalF[1][j] = internalF[0][j] - s;
+            internalF[2][j] = internalF[3][j] + s;
+        }
+        for (int j = 0; j < 3; j++) {
+            forces[atoms[term.p1]][j] += internalF[0][j];
+            forces[atoms[term.p2]][j] -= internalF[1][j];
+            forces[atoms[term.p3]][j] -= internalF[2][j];
+            forces[atoms[term.p4]][j] += internalF[3][j];
+        }
+    }
+
+    // Add the energy
+
+    if (totalEnergy != NULL)
+        *totalEnergy += (RealOpenMM) expression.getOutput(0);
+}
@@ -0,0 +1,243 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <set>
+
+#include "CpuCustomExternalForce.h"
+#include "lepton/Operation.h"
+#include "lepton/ParsedExpression.h"
+#include "lepton/Parser.h"
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuCustomExternalForce::ComputeForceTask : public ThreadPool::Task {
+public:
+    ComputeForceTask(CpuCustomExternalForce& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeForce(threads, threadIndex);
+    }
+    CpuCustomExternalForce& owner;
+};
+
+static bool isZero(const Lepton::ParsedExpression& expression) {
+    const Lepton::Operation& op = expression.getRootNode().getOperation();
+    return (op.getId() == Lepton::Operation::CONSTANT && dynamic_cast<const Lepton::Operation::Constant&>(op).getValue() == 0.0);
+}
+
+/**
+ * Determine whether an expression is a quadratic function of x, y, and z with a diagonal Hessian.  If so,
+ * the second derivatives with respect to x, y, and z are appended to secondDerivs.
+ */
+static bool isDiagonalQuadratic(const Lepton::ParsedExpression& energy, vector<Lepton::ParsedExpression>& secondDerivs) {
+    const string names[] = {"x", "y", "z"};
+    vector<Lepton::ParsedExpression> diagonal;
+    for (int i = 0; i < 3; i++) {
+        Lepton::ParsedExpression deriv = energy.differentiate(names[i]).optimize();
+        for (int j = 0; j < 3; j++) {
+            Lepton::ParsedExpression deriv2 = deriv.differentiate(names[j]).optimize();
+            if (i != j) {
+                if (!isZero(deriv2))
+                    return false;
+                continue;
+            }
+            for (int k = 0; k < 3; k++)
+                if (!isZero(deriv2.differentiate(names[k]).optimize()))
+                    return false;
+            diagonal.push_back(deriv2);
+        }
+    }
+    secondDerivs.insert(secondDerivs.end(), diagonal.begin(), diagonal.end());
+    return true;
+}
+
+CpuCustomExternalForce::CpuCustomExternalForce(const CustomExternalForce& force, int numAtoms, ThreadPool& threads) :
+            threads(threads), coefficientsValid(false) {
+    numParticles = force.getNumParticles();
+    particles.resize(numParticles);
+    particleArray = new int*[numParticles];
+    set<int> uniqueParticles;
+    for (int i = 0; i < numParticles; i++) {
+        vector<double> parameters;
+        force.getParticleParameters(i, particles[i], parameters);
+        particleArray[i] = new int[1];
+        particleArray[i][0] = particles[i];
+        uniqueParticles.insert(particles[i]);
+    }
+    bondForce.initialize(numAtoms, numParticles, 1, particleArray, threads);
+
+    // Parse the expression and compile it together with its derivatives.  If it is a harmonic restraint,
+    // and no particle appears more than once (so threads can safely work on contiguous blocks of particles),
+    // include the second derivatives so the fast path can be used.
+
+    Lepton::ParsedExpression energyExpr = Lepton::Parser::parse(force.getEnergyFunction()).optimize();
+    vector<Lepton::ParsedExpression> outputs;
+    outputs.push_back(energyExpr);
+    outputs.push_back(energyExpr.differentiate("x").optimize());
+    outputs.push_back(energyExpr.differentiate("y").optimize());
+    outputs.push_back(energyExpr.differentiate("z").optimize());
+    useFastPath = ((int) uniqueParticles.size() == numParticles && isDiagonalQuadratic(energyExpr, outputs));
+    Lepton::CompiledExpression expression(outputs);
+    for (int i = 0; i < threads.getNumThreads(); i++) {
+        threadData.push_back(new ThreadData(force, expression));
+        threadBondIxn.push_back(threadData[i]);
+    }
+    if (useFastPath) {
+        restraintCenter.resize(numParticles);
+        restraintScale.resize(numParticles);
+        restraintGradient.resize(numParticles);
+        restraintEnergy.resize(numParticles);
+    }
+}
+
+CpuCustomExternalForce::~CpuCustomExternalForce() {
+    for (int i = 0; i < numParticles; i++)
+        delete[] particleArray[i];
+    delete[] particleArray;
+    for (int i = 0; i < (int) threadData.size(); i++)
+        delete threadData[i];
+}
+
+void CpuCustomExternalForce::calculateIxn(vector<RealVec>& atomCoordinates, RealOpenMM** particleParameters, const map<string, double>& globalParameters,
+                                          vector<RealVec>& forces, RealOpenMM* totalEnergy) {
+    if (globalParameters != lastGlobalParameters) {
+        for (int i = 0; i < (int) threadData.size(); i++) {
+            CompiledExpressionSet& expressionSet = threadData[i]->expressionSet;
+            for (map<string, double>::const_iterator iter = globalParameters.begin(); iter != globalParameters.end(); ++iter)
+                expressionSet.setVariable(expressionSet.getVariableIndex(iter->first), iter->second);
+        }
+        lastGlobalParameters = globalParameters;
+        coefficientsValid = false;
+    }
+    if (!useFastPath) {
+        bondForce.calculateForce(atomCoordinates, particleParameters, forces, totalEnergy, threadBondIxn);
+        return;
+    }
+
+    // Record the parameters for the threads.
+
+    this->atomCoordinates = &atomCoordinates;
+    this->particleParameters = particleParameters;
+    this->forces = &forces;
+    includeEnergy = (totalEnergy != NULL);
+    threadEnergy.resize(threads.getNumThreads());
+
+    // Signal the threads to start running and wait for them to finish.
+
+    ComputeForceTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+    coefficientsValid = true;
+
+    // Combine the energies from all the threads.
+
+    if (includeEnergy)
+        for (int i = 0; i < (int) threadEnergy.size(); i++)
+            *totalEnergy += threadEnergy[i];
+}
+
+void CpuCustomExternalForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
+    int numThreads = threads.getNumThreads();
+    int start = (threadIndex*numParticles)/numThreads;
+    int end = ((threadIndex+1)*numParticles)/numThreads;
+    vector<RealVec>& pos = *atomCoordinates;
+    vector<RealVec>& f = *forces;
+    if (!coefficientsValid) {
+        // Expand the energy around the origin to find the minimum and curvature along each axis.
+
+        ThreadData& data = *threadData[threadIndex];
+        data.expressionSet.setVariable(data.xIndex, 0.0);
+        data.expressionSet.setVariable(data.yIndex, 0.0);
+        data.expressionSet.setVariable(data.zIndex, 0.0);
+        for (int i = start; i < end; i++) {
+            for (int j = 0; j < (int) data.paramIndex.size(); j++)
+                data.expressionSet.setVariable(data.paramIndex[j], particleParameters[i][j]);
+            data.expression.evaluate();
+            double energy = data.expression.getOutput(0);
+            double scale[3], gradient[3];
+            for (int j = 0; j < 3; j++) {
+                double g = data.expression.getOutput(1+j);
+                double c = data.expression.getOutput(4+j);
+                if (c == 0.0) {
+                    restraintCenter[i][j] = 0.0;
+                    gradient[j] = g;
+                }
+                else {
+                    double center = -g/c;
+                    restraintCenter[i][j] = center;
+                    energy += center*(g+0.5*c*center);
+                    gradient[j] = 0.0;
+                }
+                scale[j] = c;
+            }
+            restraintScale[i] = fvec4((float) scale[0], (float) scale[1], (float) scale[2], 0.0f);
+            restraintGradient[i] = fvec4((float) gradient[0], (float) gradient[1], (float) gradient[2], 0.0f);
+            restraintEnergy[i] = energy;
+        }
+    }
+
+    // Compute the forces.
+
+    double energy = 0;
+    for (int i = start; i < end; i++) {
+        RealVec& r = pos[particles[i]];
+        const RealVec& center = restraintCenter[i];
+        fvec4 s((float) (r[0]-center[0]), (float) (r[1]-center[1]), (float) (r[2]-center[2]), 0.0f);
+        fvec4 scaled = restraintScale[i]*s;
+        fvec4 force = restraintGradient[i]+scaled;
+        RealVec& atomForce = f[particles[i]];
+        atomForce[0] -= force[0];
+        atomForce[1] -= force[1];
+        atomForce[2] -= force[2];
+        if (includeEnergy)
+            energy += restraintEnergy[i]+dot3(restraintGradient[i]+0.5f*scaled, s);
+    }
+    threadEnergy[threadIndex] = energy;
+}
+
+CpuCustomExternalForce::ThreadData::ThreadData(const CustomExternalForce& force, const Lepton::CompiledExpression& expression) : expression(expression) {
+    expressionSet.registerExpression(this->expression);
+    for (int i = 0; i < force.getNumPerParticleParameters(); i++)
+        paramIndex.push_back(expressionSet.getVariableIndex(force.getPerParticleParameterName(i)));
+    xIndex = expressionSet.getVariableIndex("x");
+    yIndex = expressionSet.getVariableIndex("y");
+    zIndex = expressionSet.getVariableIndex("z");
+}
+
+void CpuCustomExternalForce::ThreadData::calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters,
+            vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+    int atom = atomIndices[0];
+    for (int i = 0; i < (int) paramIndex.size(); i++)
+        expressionSet.setVariable(paramIndex[i], parameters[i]);
+    expressionSet.setVariable(xIndex, atomCoordinates[atom][0]);
+    expressionSet.setVariable(yIndex, atomCoordinates[atom][1]);
+    expressionSet.setVariable(zIndex, atomCoordinates[atom][2]);
+    expression.evaluate();
+    forces[atom][0] -= expression.getOutput(1);
+    forces[atom][1] -= expression.getOutput(2);
+    forces[atom][2] -= expression.getOutput(3);
+    if (totalEnergy != NULL)
+        *totalEnergy += (RealOpenMM) expression.getOutput(0);
+}
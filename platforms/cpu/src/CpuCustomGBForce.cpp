@@ -49,11 +49,9 @@ CpuCustomGBForce::ThreadData::ThreadData(int numAtoms, int numThreads, int threa
                       const vector<vector<Lepton::CompiledExpression> >& valueGradientExpressions,
                       const vector<string>& valueNames,
                       const vector<Lepton::CompiledExpression>& energyExpressions,
-                      const vector<vector<Lepton::CompiledExpression> >& energyDerivExpressions,
-                      const vector<vector<Lepton::CompiledExpression> >& energyGradientExpressions,
                       const vector<string>& parameterNames) :
             valueExpressions(valueExpressions), valueDerivExpressions(valueDerivExpressions), valueGradientExpressions(valueGradientExpressions),
-            energyExpressions(energyExpressions), energyDerivExpressions(energyDerivExpressions), energyGradientExpressions(energyGradientExpressions) {
+            energyExpressions(energyExpressions) {
     firstAtom = (threadIndex*(long long) numAtoms)/numThreads;
     lastAtom = ((threadIndex+1)*(long long) numAtoms)/numThreads;
     for (int i = 0; i < (int) valueExpressions.size(); i++)
@@ -66,12 +64,6 @@ CpuCustomGBForce::ThreadData::ThreadData(int numAtoms, int numThreads, int threa
             expressionSet.registerExpression(this->valueGradientExpressions[i][j]);
     for (int i = 0; i < (int) energyExpressions.size(); i++)
         expressionSet.registerExpression(this->energyExpressions[i]);
-    for (int i = 0; i < (int) energyDerivExpressions.size(); i++)
-        for (int j = 0; j < (int) energyDerivExpressions[i].size(); j++)
-            expressionSet.registerExpression(this->energyDerivExpressions[i][j]);
-    for (int i = 0; i < (int) energyGradientExpressions.size(); i++)
-        for (int j = 0; j < (int) energyGradientExpressions[i].size(); j++)
-            expressionSet.registerExpression(this->energyGradientExpressions[i][j]);
     xindex = expressionSet.getVariableIndex("x");
     yindex = expressionSet.getVariableIndex("y");
     zindex = expressionSet.getVariableIndex("z");
@@ -110,15 +102,13 @@ CpuCustomGBForce::CpuCustomGBForce(int numAtoms, const std::vector<std::set<int>
                      const vector<string>& valueNames,
                      const vector<CustomGBForce::ComputationType>& valueTypes,
                      const vector<Lepton::CompiledExpression>& energyExpressions,
-                     const vector<vector<Lepton::CompiledExpression> >& energyDerivExpressions,
-                     const vector<vector<Lepton::CompiledExpression> >& energyGradientExpressions,
                      const vector<CustomGBForce::ComputationType>& energyTypes,
                      const vector<string>& parameterNames, ThreadPool& threads) :
             exclusions(exclusions), cutoff(false), periodic(false), valueNames(valueNames), valueTypes(valueTypes),
             energyTypes(energyTypes), paramNames(parameterNames), threads(threads) {
     for (int i = 0; i < threads.getNumThreads(); i++)
         threadData.push_back(new ThreadData(numAtoms, threads.getNumThreads(), i, valueExpressions, valueDerivExpressions, valueGradientExpressions, valueNames,
-                      energyExpressions, energyDerivExpressions, energyGradientExpressions, parameterNames));
+                      energyExpressions, parameterNames));
     values.resize(valueNames.size());
     dEdV.resize(valueNames.size());
     for (int i = 0; i < (int) values.size(); i++) {
@@ -360,13 +350,16 @@ void CpuCustomGBForce::calculateSingleParticleEnergyTerm(int index, ThreadData&
             data.expressionSet.setVariable(data.paramIndex[j], atomParameters[i][j]);
         for (int j = 0; j < (int) valueNames.size(); j++)
             data.expressionSet.setVariable(data.valueIndex[j], values[j][i]);
+        const Lepton::CompiledExpression& expression = data.energyExpressions[index];
+        double energy = expression.evaluate();
         if (includeEnergy)
-            totalEnergy += (float) data.energyExpressions[index].evaluate();
-        for (int j = 0; j < (int) valueNames.size(); j++)
-            data.dEdV[j][i] += (float) data.energyDerivExpressions[index][j].evaluate();
-        forces[4*i+0] -= (float) data.energyGradientExpressions[index][0].evaluate();
-        forces[4*i+1] -= (float) data.energyGradientExpressions[index][1].evaluate();
-        forces[4*i+2] -= (float) data.energyGradientExpressions[index][2].evaluate();
+            totalEnergy += (float) energy;
+        int numValues = valueNames.size();
+        for (int j = 0; j < numValues; j++)
+            data.dEdV[j][i] += (float) expression.getOutput(j+1);
+        forces[4*i+0] -= (float) expression.getOutput(numValues+1);
+        forces[4*i+1] -= (float) expression.getOutput(numValues+2);
+        forces[4*i+2] -= (float) expression.getOutput(numValues+3);
     }
 }
 
@@ -438,16 +431,18 @@ void CpuCustomGBForce::calculateOnePairEnergyTerm(int index, int atom1, int atom
 
     // Evaluate the energy and its derivatives.
 
+    const Lepton::CompiledExpression& expression = data.energyExpressions[index];
+    double energy = expression.evaluate();
     if (includeEnergy)
-        totalEnergy += (float) data.energyExpressions[index].evaluate();
-    float dEdR = (float) data.energyDerivExpressions[index][0].evaluate();
+        totalEnergy += (float) energy;
+    float dEdR = (float) expression.getOutput(1);
     dEdR *= 1/r;
     fvec4 result = deltaR*dEdR;
     (fvec4(forces+4*atom1)-result).store(forces+4*atom1);
     (fvec4(forces+4*atom2)+result).store(forces+4*atom2);
     for (int i = 0; i < (int) valueNames.size(); i++) {
-        data.dEdV[i][atom1] += (float) data.energyDerivExpressions[index][2*i+1].evaluate();
-        data.dEdV[i][atom2] += (float) data.energyDerivExpressions[index][2*i+2].evaluate();
+        data.dEdV[i][atom1] += (float) expression.getOutput(2*i+2);
+        data.dEdV[i][atom2] += (float) expression.getOutput(2*i+3);
     }
 }
 
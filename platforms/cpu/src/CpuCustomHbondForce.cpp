@@ -0,0 +1,516 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <cmath>
+#include <utility>
+
+#include "CpuCustomHbondForce.h"
+#include "ReferenceTabulatedFunction.h"
+#include "openmm/internal/CustomHbondForceImpl.h"
+#include "lepton/CustomFunction.h"
+#include "lepton/ParsedExpression.h"
+#include "gmx_atomic.h"
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuCustomHbondForce::ComputeForceTask : public ThreadPool::Task {
+public:
+    ComputeForceTask(CpuCustomHbondForce& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeForce(threads, threadIndex);
+    }
+    CpuCustomHbondForce& owner;
+};
+
+CpuCustomHbondForce::CpuCustomHbondForce(const CustomHbondForce& force, ThreadPool& threads) :
+            threads(threads), useCutoff(false), usePeriodic(false) {
+    numDonors = force.getNumDonors();
+    numAcceptors = force.getNumAcceptors();
+    for (int i = 0; i < numDonors; i++) {
+        int d1, d2, d3;
+        vector<double> parameters;
+        force.getDonorParameters(i, d1, d2, d3, parameters);
+        vector<int> atoms;
+        atoms.push_back(d1);
+        atoms.push_back(d2);
+        atoms.push_back(d3);
+        donorAtoms.push_back(atoms);
+    }
+    for (int i = 0; i < numAcceptors; i++) {
+        int a1, a2, a3;
+        vector<double> parameters;
+        force.getAcceptorParameters(i, a1, a2, a3, parameters);
+        vector<int> atoms;
+        atoms.push_back(a1);
+        atoms.push_back(a2);
+        atoms.push_back(a3);
+        acceptorAtoms.push_back(atoms);
+    }
+    exclusions.resize(numDonors);
+    for (int i = 0; i < force.getNumExclusions(); i++) {
+        int donor, acceptor;
+        force.getExclusionParticles(i, donor, acceptor);
+        exclusions[donor].insert(acceptor);
+    }
+    if (force.getNonbondedMethod() != CustomHbondForce::NoCutoff) {
+        useCutoff = true;
+        cutoffDistance = force.getCutoffDistance();
+    }
+
+    // Create custom functions for the tabulated functions.
+
+    map<string, Lepton::CustomFunction*> functions;
+    for (int i = 0; i < force.getNumFunctions(); i++)
+        functions[force.getTabulatedFunctionName(i)] = createReferenceTabulatedFunction(force.getTabulatedFunction(i));
+
+    // Parse the expression, and compile it together with its derivatives.
+
+    map<string, vector<int> > distances;
+    map<string, vector<int> > angles;
+    map<string, vector<int> > dihedrals;
+    Lepton::ParsedExpression energyExpr = CustomHbondForceImpl::prepareExpression(force, functions, distances, angles, dihedrals);
+    vector<Lepton::ParsedExpression> outputs;
+    outputs.push_back(energyExpr);
+    for (map<string, vector<int> >::const_iterator iter = distances.begin(); iter != distances.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    for (map<string, vector<int> >::const_iterator iter = angles.begin(); iter != angles.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    for (map<string, vector<int> >::const_iterator iter = dihedrals.begin(); iter != dihedrals.end(); ++iter)
+        outputs.push_back(energyExpr.differentiate(iter->first).optimize());
+    Lepton::CompiledExpression expression(outputs);
+    for (int i = 0; i < threads.getNumThreads(); i++)
+        threadData.push_back(new ThreadData(force, expression, distances, angles, dihedrals));
+
+    // Delete the custom functions.
+
+    for (map<string, Lepton::CustomFunction*>::iterator iter = functions.begin(); iter != functions.end(); iter++)
+        delete iter->second;
+}
+
+CpuCustomHbondForce::~CpuCustomHbondForce() {
+    for (int i = 0; i < (int) threadData.size(); i++)
+        delete threadData[i];
+}
+
+void CpuCustomHbondForce::setPeriodic(RealVec* periodicBoxVectors) {
+    assert(useCutoff);
+    assert(periodicBoxVectors[0][0] >= 2.0*cutoffDistance);
+    assert(periodicBoxVectors[1][1] >= 2.0*cutoffDistance);
+    assert(periodicBoxVectors[2][2] >= 2.0*cutoffDistance);
+    usePeriodic = true;
+    this->periodicBoxVectors[0] = periodicBoxVectors[0];
+    this->periodicBoxVectors[1] = periodicBoxVectors[1];
+    this->periodicBoxVectors[2] = periodicBoxVectors[2];
+}
+
+void CpuCustomHbondForce::calculateIxn(AlignedArray<float>& posq, RealOpenMM** donorParameters, RealOpenMM** acceptorParameters,
+                                       const map<string, double>& globalParameters, vector<AlignedArray<float> >& threadForce,
+                                       bool includeForces, bool includeEnergy, double& energy) {
+    // Record the parameters for the threads.
+
+    this->posq = &posq[0];
+    this->donorParameters = donorParameters;
+    this->acceptorParameters = acceptorParameters;
+    this->globalParameters = &globalParameters;
+    this->threadForce = &threadForce;
+    this->includeForces = includeForces;
+    this->includeEnergy = includeEnergy;
+    gmx_atomic_t counter;
+    gmx_atomic_set(&counter, 0);
+    this->atomicCounter = &counter;
+    if (useCutoff)
+        buildCells();
+
+    // Signal the threads to start running and wait for them to finish.
+
+    ComputeForceTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+
+    // Combine the energies from all the threads.
+
+    if (includeEnergy) {
+        int numThreads = threads.getNumThreads();
+        for (int i = 0; i < numThreads; i++)
+            energy += threadData[i]->energy;
+    }
+}
+
+void CpuCustomHbondForce::buildCells() {
+    if (usePeriodic) {
+        // Choose the number of cells along each box vector so that the distance between opposite faces of a cell
+        // is at least the cutoff.  Any acceptor within the cutoff of a donor is then in the same cell or an
+        // adjacent one, even for a triclinic box.
+
+        RealVec* box = periodicBoxVectors;
+        RealOpenMM volume = box[0][0]*box[1][1]*box[2][2];
+        RealVec faceNormal[3] = {box[1].cross(box[2]), box[2].cross(box[0]), box[0].cross(box[1])};
+        for (int i = 0; i < 3; i++) {
+            RealOpenMM width = volume/SQRT(faceNormal[i].dot(faceNormal[i]));
+            numCells[i] = max(1, (int) floor(width/cutoffDistance));
+        }
+    }
+    else {
+        // Find the bounding box of the acceptors and divide it into cubes whose width is the cutoff.
+
+        float minPos[3], maxPos[3];
+        for (int i = 0; i < 3; i++) {
+            minPos[i] = (numAcceptors > 0 ? posq[4*acceptorAtoms[0][0]+i] : 0.0f);
+            maxPos[i] = minPos[i];
+        }
+        for (int acceptor = 1; acceptor < numAcceptors; acceptor++) {
+            const float* pos = posq+4*acceptorAtoms[acceptor][0];
+            for (int i = 0; i < 3; i++) {
+                minPos[i] = min(minPos[i], pos[i]);
+                maxPos[i] = max(maxPos[i], pos[i]);
+            }
+        }
+        for (int i = 0; i < 3; i++) {
+            cellOrigin[i] = minPos[i];
+            cellScale[i] = (float) (1/cutoffDistance);
+            numCells[i] = (int) ((maxPos[i]-minPos[i])*cellScale[i])+1;
+        }
+    }
+
+    // Sort the acceptors by cell.
+
+    int totalCells = numCells[0]*numCells[1]*numCells[2];
+    vector<int> acceptorCell(numAcceptors);
+    cellStart.resize(totalCells+1);
+    for (int i = 0; i <= totalCells; i++)
+        cellStart[i] = 0;
+    for (int acceptor = 0; acceptor < numAcceptors; acceptor++) {
+        int cell[3];
+        getCellIndex(posq+4*acceptorAtoms[acceptor][0], cell);
+        for (int i = 0; i < 3; i++)
+            cell[i] = min(max(cell[i], 0), numCells[i]-1);
+        acceptorCell[acceptor] = cell[0]+numCells[0]*(cell[1]+numCells[1]*cell[2]);
+        cellStart[acceptorCell[acceptor]+1]++;
+    }
+    for (int i = 0; i < totalCells; i++)
+        cellStart[i+1] += cellStart[i];
+    vector<int> cellEnd(cellStart.begin(), cellStart.end()-1);
+    cellAcceptors.resize(numAcceptors);
+    for (int acceptor = 0; acceptor < numAcceptors; acceptor++)
+        cellAcceptors[cellEnd[acceptorCell[acceptor]]++] = acceptor;
+}
+
+void CpuCustomHbondForce::getCellIndex(const float* pos, int* cell) const {
+    if (usePeriodic) {
+        // Compute the fractional coordinates along each box vector.  The box vectors are in reduced form,
+        // so this only requires back substitution.
+
+        const RealVec* box = periodicBoxVectors;
+        RealOpenMM frac[3];
+        frac[2] = pos[2]/box[2][2];
+        frac[1] = (pos[1]-frac[2]*box[2][1])/box[1][1];
+        frac[0] = (pos[0]-frac[2]*box[2][0]-frac[1]*box[1][0])/box[0][0];
+        for (int i = 0; i < 3; i++) {
+            int index = (int) floor((frac[i]-floor(frac[i]))*numCells[i]);
+            cell[i] = (index < numCells[i] ? index : 0);
+        }
+    }
+    else {
+        for (int i = 0; i < 3; i++)
+            cell[i] = (int) floorf((pos[i]-cellOrigin[i])*cellScale[i]);
+    }
+}
+
+void CpuCustomHbondForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
+    fvec4 boxSize(periodicBoxVectors[0][0], periodicBoxVectors[1][1], periodicBoxVectors[2][2], 0);
+    fvec4 invBoxSize((1/periodicBoxVectors[0][0]), (1/periodicBoxVectors[1][1]), (1/periodicBoxVectors[2][2]), 0);
+    float* forces = &(*threadForce)[threadIndex][0];
+    ThreadData& data = *threadData[threadIndex];
+    data.energy = 0;
+    for (map<string, double>::const_iterator iter = globalParameters->begin(); iter != globalParameters->end(); ++iter)
+        data.expressionSet.setVariable(data.expressionSet.getVariableIndex(iter->first), iter->second);
+    vector<int> searchCells[3];
+    while (true) {
+        int donor = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (donor >= numDonors)
+            break;
+        for (int i = 0; i < (int) data.donorParamIndex.size(); i++)
+            data.expressionSet.setVariable(data.donorParamIndex[i], donorParameters[donor][i]);
+        const set<int>& excluded = exclusions[donor];
+        if (!useCutoff) {
+            // Loop over all acceptors.
+
+            for (int acceptor = 0; acceptor < numAcceptors; acceptor++)
+                if (excluded.find(acceptor) == excluded.end())
+                    calculateOneIxn(donor, acceptor, forces, data, boxSize, invBoxSize);
+            continue;
+        }
+
+        // Find the cells that could contain acceptors within the cutoff.  With periodic boundary conditions,
+        // an axis with fewer than three cells is searched in its entirety so no cell is visited twice.
+
+        int cell[3];
+        getCellIndex(posq+4*donorAtoms[donor][0], cell);
+        for (int i = 0; i < 3; i++) {
+            searchCells[i].clear();
+            if (usePeriodic && numCells[i] < 3) {
+                for (int j = 0; j < numCells[i]; j++)
+                    searchCells[i].push_back(j);
+            }
+            else {
+                for (int j = cell[i]-1; j <= cell[i]+1; j++) {
+                    if (usePeriodic)
+                        searchCells[i].push_back((j+numCells[i])%numCells[i]);
+                    else if (j >= 0 && j < numCells[i])
+                        searchCells[i].push_back(j);
+                }
+            }
+        }
+
+        // Loop over acceptors in those cells.
+
+        for (int z = 0; z < (int) searchCells[2].size(); z++)
+            for (int y = 0; y < (int) searchCells[1].size(); y++)
+                for (int x = 0; x < (int) searchCells[0].size(); x++) {
+                    int cellIndex = searchCells[0][x]+numCells[0]*(searchCells[1][y]+numCells[1]*searchCells[2][z]);
+                    for (int i = cellStart[cellIndex]; i < cellStart[cellIndex+1]; i++) {
+                        int acceptor = cellAcceptors[i];
+                        if (excluded.find(acceptor) == excluded.end())
+                            calculateOneIxn(donor, acceptor, forces, data, boxSize, invBoxSize);
+                    }
+                }
+    }
+}
+
+void CpuCustomHbondForce::calculateOneIxn(int donor, int acceptor, float* forces, ThreadData& data, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int atoms[6];
+    atoms[0] = acceptorAtoms[acceptor][0];
+    atoms[1] = acceptorAtoms[acceptor][1];
+    atoms[2] = acceptorAtoms[acceptor][2];
+    atoms[3] = donorAtoms[donor][0];
+    atoms[4] = donorAtoms[donor][1];
+    atoms[5] = donorAtoms[donor][2];
+
+    // Compute the distance between the primary donor and acceptor atoms, and compare to the cutoff.
+
+    if (useCutoff) {
+        fvec4 deltaR;
+        float r2;
+        computeDelta(fvec4(posq+4*atoms[0]), fvec4(posq+4*atoms[3]), deltaR, r2, boxSize, invBoxSize);
+        if (r2 >= cutoffDistance*cutoffDistance)
+            return;
+    }
+
+    // Record per-acceptor parameters.
+
+    CompiledExpressionSet& expressionSet = data.expressionSet;
+    for (int i = 0; i < (int) data.acceptorParamIndex.size(); i++)
+        expressionSet.setVariable(data.acceptorParamIndex[i], acceptorParameters[acceptor][i]);
+
+    // Compute the displacements between particles.
+
+    AlignedArray<fvec4>& delta = data.delta;
+    AlignedArray<fvec4>& cross1 = data.cross1;
+    AlignedArray<fvec4>& cross2 = data.cross2;
+    vector<float>& normDelta = data.normDelta;
+    vector<float>& norm2Delta = data.norm2Delta;
+    for (int i = 0; i < (int) data.deltaPairs.size(); i++) {
+        int p1 = atoms[data.deltaPairs[i].first];
+        int p2 = atoms[data.deltaPairs[i].second];
+        computeDelta(fvec4(posq+4*p1), fvec4(posq+4*p2), delta[i], norm2Delta[i], boxSize, invBoxSize);
+        normDelta[i] = sqrtf(norm2Delta[i]);
+    }
+
+    // Compute all of the variables the energy can depend on, then evaluate the energy and its derivatives.
+
+    for (int i = 0; i < (int) data.distanceTerms.size(); i++) {
+        const DistanceTermInfo& term = data.distanceTerms[i];
+        expressionSet.setVariable(term.variableIndex, normDelta[term.delta]);
+    }
+    for (int i = 0; i < (int) data.angleTerms.size(); i++) {
+        const AngleTermInfo& term = data.angleTerms[i];
+        expressionSet.setVariable(term.variableIndex, computeAngle(delta[term.delta1], delta[term.delta2], norm2Delta[term.delta1], norm2Delta[term.delta2]));
+    }
+    for (int i = 0; i < (int) data.dihedralTerms.size(); i++) {
+        const DihedralTermInfo& term = data.dihedralTerms[i];
+        expressionSet.setVariable(term.variableIndex, getDihedralAngleBetweenThreeVectors(delta[term.delta1], delta[term.delta2], delta[term.delta3], cross1[i], cross2[i], delta[term.delta1]));
+    }
+    data.expression.evaluate();
+    if (includeForces) {
+        // Apply forces based on distances.
+
+        for (int i = 0; i < (int) data.distanceTerms.size(); i++) {
+            const DistanceTermInfo& term = data.distanceTerms[i];
+            float dEdR = (float) (data.expression.getOutput(term.derivIndex)/normDelta[term.delta]);
+            fvec4 force = -dEdR*delta[term.delta];
+            float* f1 = forces+4*atoms[term.p1];
+            float* f2 = forces+4*atoms[term.p2];
+            (fvec4(f1)-force).store(f1);
+            (fvec4(f2)+force).store(f2);
+        }
+
+        // Apply forces based on angles.
+
+        for (int i = 0; i < (int) data.angleTerms.size(); i++) {
+            const AngleTermInfo& term = data.angleTerms[i];
+            float dEdTheta = (float) data.expression.getOutput(term.derivIndex);
+            fvec4 thetaCross = cross(delta[term.delta1], delta[term.delta2]);
+            float lengthThetaCross = sqrtf(dot3(thetaCross, thetaCross));
+            if (lengthThetaCross < 1.0e-6f)
+                lengthThetaCross = 1.0e-6f;
+            float termA = dEdTheta/(norm2Delta[term.delta1]*lengthThetaCross);
+            float termC = -dEdTheta/(norm2Delta[term.delta2]*lengthThetaCross);
+            fvec4 force1 = termA*cross(delta[term.delta1], thetaCross);
+            fvec4 force3 = termC*cross(delta[term.delta2], thetaCross);
+            fvec4 force2 = -(force1+force3);
+            float* f1 = forces+4*atoms[term.p1];
+            float* f2 = forces+4*atoms[term.p2];
+            float* f3 = forces+4*atoms[term.p3];
+            (fvec4(f1)+force1).store(f1);
+            (fvec4(f2)+force2).store(f2);
+            (fvec4(f3)+force3).store(f3);
+        }
+
+        // Apply forces based on dihedrals.
+
+        for (int i = 0; i < (int) data.dihedralTerms.size(); i++) {
+            const DihedralTermInfo& term = data.dihedralTerms[i];
+            float dEdTheta = (float) data.expression.getOutput(term.derivIndex);
+            float normCross1 = dot3(cross1[i], cross1[i]);
+            float normBC = normDelta[term.delta2];
+            float forceFactors[4];
+            forceFactors[0] = (-dEdTheta*normBC)/normCross1;
+            float normCross2 = dot3(cross2[i], cross2[i]);
+            forceFactors[3] = (dEdTheta*normBC)/normCross2;
+            forceFactors[1] = dot3(delta[term.delta1], delta[term.delta2]);
+            forceFactors[1] /= norm2Delta[term.delta2];
+            forceFactors[2] = dot3(delta[term.delta3], delta[term.delta2]);
+            forceFactors[2] /= norm2Delta[term.delta2];
+            fvec4 force1 = forceFactors[0]*cross1[i];
+            fvec4 force4 = forceFactors[3]*cross2[i];
+            fvec4 s = forceFactors[1]*force1 - forceFactors[2]*force4;
+            float* f1 = forces+4*atoms[term.p1];
+            float* f2 = forces+4*atoms[term.p2];
+            float* f3 = forces+4*atoms[term.p3];
+            float* f4 = forces+4*atoms[term.p4];
+            (fvec4(f1)+force1).store(f1);
+            (fvec4(f2)-(force1-s)).store(f2);
+            (fvec4(f3)-(force4+s)).store(f3);
+            (fvec4(f4)+force4).store(f4);
+        }
+    }
+
+    // Add the energy
+
+    if (includeEnergy)
+        data.energy += data.expression.getOutput(0);
+}
+
+void CpuCustomHbondForce::computeDelta(const fvec4& posI, const fvec4& posJ, fvec4& deltaR, float& r2, const fvec4& boxSize, const fvec4& invBoxSize) const {
+    deltaR = posJ-posI;
+    if (usePeriodic) {
+        const RealVec* box = periodicBoxVectors;
+        float dz = floorf(deltaR[2]*invBoxSize[2]+0.5f);
+        deltaR -= fvec4((float) box[2][0], (float) box[2][1], (float) box[2][2], 0)*dz;
+        float dy = floorf(deltaR[1]*invBoxSize[1]+0.5f);
+        deltaR -= fvec4((float) box[1][0], (float) box[1][1], 0, 0)*dy;
+        float dx = floorf(deltaR[0]*invBoxSize[0]+0.5f);
+        deltaR -= fvec4((float) box[0][0], 0, 0, 0)*dx;
+    }
+    r2 = dot3(deltaR, deltaR);
+}
+
+float CpuCustomHbondForce::computeAngle(const fvec4& vi, const fvec4& vj, float v2i, float v2j) {
+    float dot = dot3(vi, vj);
+    float cosine = dot/sqrtf(v2i*v2j);
+    if (cosine > 0.99f || cosine < -0.99f) {
+        // We're close to the singularity in acos(), so take the cross product and use asin() instead.
+
+        fvec4 cross12 = cross(vi, vj);
+        float scale = v2i*v2j;
+        float angle = asinf(sqrtf(dot3(cross12, cross12)/scale));
+        if (cosine < 0.0f)
+            angle = (float) (M_PI-angle);
+        return angle;
+    }
+    return acosf(cosine);
+}
+
+float CpuCustomHbondForce::getDihedralAngleBetweenThreeVectors(const fvec4& v1, const fvec4& v2, const fvec4& v3, fvec4& cross1, fvec4& cross2, const fvec4& signVector) {
+    cross1 = cross(v1, v2);
+    cross2 = cross(v2, v3);
+    float angle = computeAngle(cross1, cross2, dot3(cross1, cross1), dot3(cross2, cross2));
+    float dotProduct = dot3(signVector, cross2);
+    if (dotProduct < 0)
+        angle = -angle;
+    return angle;
+}
+
+CpuCustomHbondForce::DistanceTermInfo::DistanceTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+    delta = data.requestDelta(p1, p2);
+}
+
+CpuCustomHbondForce::AngleTermInfo::AngleTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), p3(atoms[2]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+    delta1 = data.requestDelta(p1, p2);
+    delta2 = data.requestDelta(p3, p2);
+}
+
+CpuCustomHbondForce::DihedralTermInfo::DihedralTermInfo(const string& name, const vector<int>& atoms, int derivIndex, ThreadData& data) :
+        p1(atoms[0]), p2(atoms[1]), p3(atoms[2]), p4(atoms[3]), derivIndex(derivIndex) {
+    variableIndex = data.expressionSet.getVariableIndex(name);
+    delta1 = data.requestDelta(p2, p1);
+    delta2 = data.requestDelta(p2, p3);
+    delta3 = data.requestDelta(p4, p3);
+}
+
+CpuCustomHbondForce::ThreadData::ThreadData(const CustomHbondForce& force, const Lepton::CompiledExpression& expression, const map<string, vector<int> >& distances,
+            const map<string, vector<int> >& angles, const map<string, vector<int> >& dihedrals) : expression(expression) {
+    expressionSet.registerExpression(this->expression);
+    for (int i = 0; i < force.getNumPerDonorParameters(); i++)
+        donorParamIndex.push_back(expressionSet.getVariableIndex(force.getPerDonorParameterName(i)));
+    for (int i = 0; i < force.getNumPerAcceptorParameters(); i++)
+        acceptorParamIndex.push_back(expressionSet.getVariableIndex(force.getPerAcceptorParameterName(i)));
+    int derivIndex = 1;
+    for (map<string, vector<int> >::const_iterator iter = distances.begin(); iter != distances.end(); ++iter)
+        distanceTerms.push_back(CpuCustomHbondForce::DistanceTermInfo(iter->first, iter->second, derivIndex++, *this));
+    for (map<string, vector<int> >::const_iterator iter = angles.begin(); iter != angles.end(); ++iter)
+        angleTerms.push_back(CpuCustomHbondForce::AngleTermInfo(iter->first, iter->second, derivIndex++, *this));
+    for (map<string, vector<int> >::const_iterator iter = dihedrals.begin(); iter != dihedrals.end(); ++iter)
+        dihedralTerms.push_back(CpuCustomHbondForce::DihedralTermInfo(iter->first, iter->second, derivIndex++, *this));
+    int numDeltas = deltaPairs.size();
+    delta.resize(numDeltas);
+    normDelta.resize(numDeltas);
+    norm2Delta.resize(numDeltas);
+    cross1.resize(dihedralTerms.size());
+    cross2.resize(dihedralTerms.size());
+}
+
+int CpuCustomHbondForce::ThreadData::requestDelta(int p1, int p2) {
+    for (int i = 0; i < (int) deltaPairs.size(); i++)
+        if (deltaPairs[i].first == p1 && deltaPairs[i].second == p2)
+            return i;
+    deltaPairs.push_back(make_pair(p1, p2));
+    return deltaPairs.size()-1;
+}
@@ -85,6 +85,8 @@ CpuCustomManyParticleForce::CpuCustomManyParticleForce(const CustomManyParticleF
         exclusions[p1].insert(p2);
         exclusions[p2].insert(p1);
     }
+    if (neighborList != NULL)
+        neighborList->setExclusions(exclusions);
     
     // Record information about type filters.
     
@@ -120,7 +122,7 @@ void CpuCustomManyParticleForce::calculateIxn(AlignedArray<float>& posq, RealOpe
         particleNeighbors.resize(numParticles);
         for (int i = 0; i < numParticles; i++)
             particleNeighbors[i].clear();
-        neighborList->computeNeighborList(numParticles, posq, exclusions, periodicBoxVectors, usePeriodic, cutoffDistance, threads);
+        neighborList->computeNeighborList(numParticles, posq, periodicBoxVectors, usePeriodic, cutoffDistance, threads);
         for (int blockIndex = 0; blockIndex < neighborList->getNumBlocks(); blockIndex++) {
             const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
             const vector<char>& exclusions = neighborList->getBlockExclusions(blockIndex);
@@ -23,6 +23,7 @@
  */
 
 #include <string.h>
+#include <algorithm>
 #include <sstream>
 
 #include "SimTKOpenMMUtilities.h"
@@ -43,25 +44,42 @@ public:
     CpuCustomNonbondedForce& owner;
 };
 
-CpuCustomNonbondedForce::ThreadData::ThreadData(const Lepton::CompiledExpression& energyExpression, const Lepton::CompiledExpression& forceExpression, const vector<string>& parameterNames) :
-            energyExpression(energyExpression), forceExpression(forceExpression) {
-    energyR = ReferenceForce::getVariablePointer(this->energyExpression, "r");
-    forceR = ReferenceForce::getVariablePointer(this->forceExpression, "r");
+CpuCustomNonbondedForce::ThreadData::ThreadData(const Lepton::CompiledVectorExpression& expression, const vector<string>& parameterNames) :
+            expression(expression), numInBatch(0), numInTableBatch(0) {
+    width = expression.getWidth();
+    batchAtom1.resize(width);
+    batchAtom2.resize(width);
+    batchDeltaR.resize(4*width);
+    batchR.resize(width);
+    unusedVariable.resize(width);
+    r = getVariablePointer("r");
     for (int i = 0; i < (int) parameterNames.size(); i++) {
         for (int j = 1; j < 3; j++) {
             stringstream name;
             name << parameterNames[i] << j;
-            energyParticleParams.push_back(ReferenceForce::getVariablePointer(this->energyExpression, name.str()));
-            forceParticleParams.push_back(ReferenceForce::getVariablePointer(this->forceExpression, name.str()));
+            particleParams.push_back(getVariablePointer(name.str()));
         }
     }
 }
 
-CpuCustomNonbondedForce::CpuCustomNonbondedForce(const Lepton::CompiledExpression& energyExpression,
-            const Lepton::CompiledExpression& forceExpression, const vector<string>& parameterNames, const vector<set<int> >& exclusions,ThreadPool& threads) :
-            cutoff(false), useSwitch(false), periodic(false), paramNames(parameterNames), exclusions(exclusions), threads(threads) {
+float* CpuCustomNonbondedForce::ThreadData::getVariablePointer(const string& name) {
+    // Variables that are not used by the expression get written to a scratch array, so the caller never needs to check.
+
+    if (expression.getVariables().find(name) == expression.getVariables().end())
+        return &unusedVariable[0];
+    return expression.getVariablePointer(name);
+}
+
+void CpuCustomNonbondedForce::ThreadData::setVariable(float* pointer, float value) {
+    for (int i = 0; i < width; i++)
+        pointer[i] = value;
+}
+
+CpuCustomNonbondedForce::CpuCustomNonbondedForce(const Lepton::CompiledVectorExpression& expression, const vector<string>& parameterNames,
+            const vector<set<int> >& exclusions, ThreadPool& threads) :
+            cutoff(false), useSwitch(false), periodic(false), paramNames(parameterNames), exclusions(exclusions), threads(threads), useTables(false) {
     for (int i = 0; i < threads.getNumThreads(); i++)
-        threadData.push_back(new ThreadData(energyExpression, forceExpression, parameterNames));
+        threadData.push_back(new ThreadData(expression, parameterNames));
 }
 
 CpuCustomNonbondedForce::~CpuCustomNonbondedForce() {
@@ -96,6 +114,18 @@ void CpuCustomNonbondedForce::setUseSwitchingFunction(RealOpenMM distance) {
     switchingDistance = distance;
 }
 
+void CpuCustomNonbondedForce::setTables(const vector<int>& particleClass, int numClasses, const vector<vector<float> >& tables,
+            const vector<float>& spacing, float minDistance) {
+    useTables = (tables.size() > 0);
+    this->particleClass = particleClass;
+    this->numClasses = numClasses;
+    this->tables = tables;
+    tableMinDistance = minDistance;
+    tableInvSpacing.resize(spacing.size());
+    for (int i = 0; i < (int) spacing.size(); i++)
+        tableInvSpacing[i] = 1.0f/spacing[i];
+}
+
 void CpuCustomNonbondedForce::setPeriodic(RealVec* periodicBoxVectors) {
     assert(cutoff);
     assert(periodicBoxVectors[0][0] >= 2.0*cutoffDistance);
@@ -159,10 +189,8 @@ void CpuCustomNonbondedForce::threadComputeForce(ThreadPool& threads, int thread
     double& energy = threadEnergy[threadIndex];
     float* forces = &(*threadForce)[threadIndex][0];
     ThreadData& data = *threadData[threadIndex];
-    for (map<string, double>::const_iterator iter = globalParameters->begin(); iter != globalParameters->end(); ++iter) {
-        ReferenceForce::setVariable(ReferenceForce::getVariablePointer(data.energyExpression, iter->first), iter->second);
-        ReferenceForce::setVariable(ReferenceForce::getVariablePointer(data.forceExpression, iter->first), iter->second);
-    }
+    for (map<string, double>::const_iterator iter = globalParameters->begin(); iter != globalParameters->end(); ++iter)
+        data.setVariable(data.getVariablePointer(iter->first), (float) iter->second);
     fvec4 boxSize(periodicBoxVectors[0][0], periodicBoxVectors[1][1], periodicBoxVectors[2][2], 0);
     fvec4 invBoxSize(recipBoxSize[0], recipBoxSize[1], recipBoxSize[2], 0);
     if (groupInteractions.size() > 0) {
@@ -172,15 +200,7 @@ void CpuCustomNonbondedForce::threadComputeForce(ThreadPool& threads, int thread
             int i = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
             if (i >= groupInteractions.size())
                 break;
-            int atom1 = groupInteractions[i].first;
-            int atom2 = groupInteractions[i].second;
-            for (int j = 0; j < (int) paramNames.size(); j++) {
-                ReferenceForce::setVariable(data.energyParticleParams[j*2], atomParameters[atom1][j]);
-                ReferenceForce::setVariable(data.energyParticleParams[j*2+1], atomParameters[atom2][j]);
-                ReferenceForce::setVariable(data.forceParticleParams[j*2], atomParameters[atom1][j]);
-                ReferenceForce::setVariable(data.forceParticleParams[j*2+1], atomParameters[atom2][j]);
-            }
-            calculateOneIxn(atom1, atom2, data, forces, energy, boxSize, invBoxSize);
+            addOneIxn(groupInteractions[i].first, groupInteractions[i].second, data, forces, energy, boxSize, invBoxSize);
         }
     }
     else if (cutoff) {
@@ -195,20 +215,9 @@ void CpuCustomNonbondedForce::threadComputeForce(ThreadPool& threads, int thread
             const vector<char>& exclusions = neighborList->getBlockExclusions(blockIndex);
             for (int i = 0; i < (int) neighbors.size(); i++) {
                 int first = neighbors[i];
-                for (int j = 0; j < (int) paramNames.size(); j++) {
-                    ReferenceForce::setVariable(data.energyParticleParams[j*2], atomParameters[first][j]);
-                    ReferenceForce::setVariable(data.forceParticleParams[j*2], atomParameters[first][j]);
-                }
-                for (int k = 0; k < 4; k++) {
-                    if ((exclusions[i] & (1<<k)) == 0) {
-                        int second = blockAtom[k];
-                        for (int j = 0; j < (int) paramNames.size(); j++) {
-                            ReferenceForce::setVariable(data.energyParticleParams[j*2+1], atomParameters[second][j]);
-                            ReferenceForce::setVariable(data.forceParticleParams[j*2+1], atomParameters[second][j]);
-                        }
-                        calculateOneIxn(first, second, data, forces, energy, boxSize, invBoxSize);
-                    }
-                }
+                for (int k = 0; k < 4; k++)
+                    if ((exclusions[i] & (1<<k)) == 0)
+                        addOneIxn(first, blockAtom[k], data, forces, energy, boxSize, invBoxSize);
             }
         }
     }
@@ -219,22 +228,21 @@ void CpuCustomNonbondedForce::threadComputeForce(ThreadPool& threads, int thread
             int ii = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
             if (ii >= numberOfAtoms)
                 break;
-            for (int jj = ii+1; jj < numberOfAtoms; jj++) {
-                if (exclusions[jj].find(ii) == exclusions[jj].end()) {
-                    for (int j = 0; j < (int) paramNames.size(); j++) {
-                        ReferenceForce::setVariable(data.energyParticleParams[j*2], atomParameters[ii][j]);
-                        ReferenceForce::setVariable(data.energyParticleParams[j*2+1], atomParameters[jj][j]);
-                        ReferenceForce::setVariable(data.forceParticleParams[j*2], atomParameters[ii][j]);
-                        ReferenceForce::setVariable(data.forceParticleParams[j*2+1], atomParameters[jj][j]);
-                    }
-                    calculateOneIxn(ii, jj, data, forces, energy, boxSize, invBoxSize);
-                }
-            }
+            for (int jj = ii+1; jj < numberOfAtoms; jj++)
+                if (exclusions[jj].find(ii) == exclusions[jj].end())
+                    addOneIxn(ii, jj, data, forces, energy, boxSize, invBoxSize);
         }
     }
+    
+    // Evaluate any interactions left over in the final, partially filled batches.
+    
+    if (data.numInBatch > 0)
+        computeBatch(data, forces, energy);
+    if (data.numInTableBatch > 0)
+        computeTableBatch(data, forces, energy);
 }
 
-void CpuCustomNonbondedForce::calculateOneIxn(int ii, int jj, ThreadData& data, 
+void CpuCustomNonbondedForce::addOneIxn(int ii, int jj, ThreadData& data, 
         float* forces, double& totalEnergy, const fvec4& boxSize, const fvec4& invBoxSize) {
     // Get deltaR, R2, and R between 2 atoms
 
@@ -245,30 +253,106 @@ void CpuCustomNonbondedForce::calculateOneIxn(int ii, int jj, ThreadData& data,
     getDeltaR(posI, posJ, deltaR, r2, boxSize, invBoxSize);
     if (cutoff && r2 >= cutoffDistance*cutoffDistance)
         return;
+    
     float r = sqrtf(r2);
+    if (useTables && r >= tableMinDistance) {
+        // Record the interaction and its position in the table in the next free slot of the table batch.
+        
+        int table = particleClass[ii]*numClasses+particleClass[jj];
+        const vector<float>& coeff = tables[table];
+        float x = (r-tableMinDistance)*tableInvSpacing[table];
+        int index = min((int) x, (int) coeff.size()/8-1);
+        int slot = data.numInTableBatch++;
+        data.tableAtom1[slot] = ii;
+        data.tableAtom2[slot] = jj;
+        deltaR.store(&data.tableDeltaR[4*slot]);
+        data.tableR[slot] = r;
+        data.tableX[slot] = x-index;
+        data.tableCoeff[slot] = &coeff[8*index];
+        if (data.numInTableBatch == 4)
+            computeTableBatch(data, forces, totalEnergy);
+        return;
+    }
+    
+    // Record the interaction and its variables in the next free slot of the batch.
+    
+    int slot = data.numInBatch++;
+    data.batchAtom1[slot] = ii;
+    data.batchAtom2[slot] = jj;
+    deltaR.store(&data.batchDeltaR[4*slot]);
+    data.batchR[slot] = r;
+    data.r[slot] = r;
+    for (int j = 0; j < (int) paramNames.size(); j++) {
+        data.particleParams[j*2][slot] = (float) atomParameters[ii][j];
+        data.particleParams[j*2+1][slot] = (float) atomParameters[jj][j];
+    }
+    if (data.numInBatch == data.width)
+        computeBatch(data, forces, totalEnergy);
+}
 
-    // accumulate forces
-
-    ReferenceForce::setVariable(data.energyR, r);
-    ReferenceForce::setVariable(data.forceR, r);
-    double dEdR = (includeForce ? data.forceExpression.evaluate()/r : 0.0);
-    double energy = (includeEnergy ? data.energyExpression.evaluate() : 0.0);
-    if (useSwitch) {
-        if (r > switchingDistance) {
-            RealOpenMM t = (r-switchingDistance)/(cutoffDistance-switchingDistance);
-            RealOpenMM switchValue = 1+t*t*t*(-10+t*(15-t*6));
-            RealOpenMM switchDeriv = t*t*(-30+t*(60-t*30))/(cutoffDistance-switchingDistance);
-            dEdR = switchValue*dEdR + energy*switchDeriv/r;
-            energy *= switchValue;
-        }
+void CpuCustomNonbondedForce::computeBatch(ThreadData& data, float* forces, double& totalEnergy) {
+    // Fill any unused slots with copies of the first interaction, so every element holds valid input.
+    
+    int numInBatch = data.numInBatch;
+    for (int slot = numInBatch; slot < data.width; slot++) {
+        data.r[slot] = data.r[0];
+        for (int j = 0; j < (int) data.particleParams.size(); j++)
+            data.particleParams[j][slot] = data.particleParams[j][0];
     }
-    fvec4 result = deltaR*dEdR;
-    (fvec4(forces+4*ii)+result).store(forces+4*ii);
-    (fvec4(forces+4*jj)-result).store(forces+4*jj);
+    data.numInBatch = 0;
+    
+    // Evaluate the energy and force for all interactions at once.
+    
+    data.expression.evaluate();
+    accumulateInteractions(numInBatch, &data.batchAtom1[0], &data.batchAtom2[0], &data.batchDeltaR[0], &data.batchR[0],
+            data.expression.getOutput(0), data.expression.getOutput(1), forces, totalEnergy);
+}
 
-    // accumulate energies
+void CpuCustomNonbondedForce::computeTableBatch(ThreadData& data, float* forces, double& totalEnergy) {
+    // Fill any unused slots with copies of the first interaction.
+    
+    int numInBatch = data.numInTableBatch;
+    for (int slot = numInBatch; slot < 4; slot++) {
+        data.tableX[slot] = data.tableX[0];
+        data.tableCoeff[slot] = data.tableCoeff[0];
+    }
+    data.numInTableBatch = 0;
+    
+    // Load the coefficients for all four interactions and evaluate the polynomials.
+    
+    fvec4 x(data.tableX);
+    fvec4 e0(data.tableCoeff[0]), e1(data.tableCoeff[1]), e2(data.tableCoeff[2]), e3(data.tableCoeff[3]);
+    fvec4 f0(data.tableCoeff[0]+4), f1(data.tableCoeff[1]+4), f2(data.tableCoeff[2]+4), f3(data.tableCoeff[3]+4);
+    transpose(e0, e1, e2, e3);
+    transpose(f0, f1, f2, f3);
+    float energy[4], dEdR[4];
+    (e0+x*(e1+x*(e2+x*e3))).store(energy);
+    (f0+x*(f1+x*(f2+x*f3))).store(dEdR);
+    accumulateInteractions(numInBatch, data.tableAtom1, data.tableAtom2, data.tableDeltaR, data.tableR, energy, dEdR, forces, totalEnergy);
+}
 
-    totalEnergy += energy;
+void CpuCustomNonbondedForce::accumulateInteractions(int numInteractions, const int* atom1, const int* atom2, const float* deltaR,
+            const float* r, const float* energy, const float* dEdR, float* forces, double& totalEnergy) {
+    for (int i = 0; i < numInteractions; i++) {
+        double interactionDEdR = (includeForce ? dEdR[i]/r[i] : 0.0);
+        double interactionEnergy = energy[i];
+        if (useSwitch) {
+            if (r[i] > switchingDistance) {
+                RealOpenMM t = (r[i]-switchingDistance)/(cutoffDistance-switchingDistance);
+                RealOpenMM switchValue = 1+t*t*t*(-10+t*(15-t*6));
+                RealOpenMM switchDeriv = t*t*(-30+t*(60-t*30))/(cutoffDistance-switchingDistance);
+                interactionDEdR = switchValue*interactionDEdR + interactionEnergy*switchDeriv/r[i];
+                interactionEnergy *= switchValue;
+            }
+        }
+        int ii = atom1[i];
+        int jj = atom2[i];
+        fvec4 result = fvec4(deltaR+4*i)*interactionDEdR;
+        (fvec4(forces+4*ii)+result).store(forces+4*ii);
+        (fvec4(forces+4*jj)-result).store(forces+4*jj);
+        if (includeEnergy)
+            totalEnergy += interactionEnergy;
+    }
 }
 
 void CpuCustomNonbondedForce::getDeltaR(const fvec4& posI, const fvec4& posJ, fvec4& deltaR, float& r2, const fvec4& boxSize, const fvec4& invBoxSize) const {
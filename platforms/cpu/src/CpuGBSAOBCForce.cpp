@@ -47,7 +47,7 @@ public:
     CpuGBSAOBCForce& owner;
 };
 
-CpuGBSAOBCForce::CpuGBSAOBCForce() : cutoff(false), periodic(false) {
+CpuGBSAOBCForce::CpuGBSAOBCForce() : cutoff(false), periodic(false), neighborList(NULL) {
     logDX = (TABLE_MAX-TABLE_MIN)/NUM_TABLE_POINTS;
     logDXInv = 1.0f/logDX;
     logTable.resize(NUM_TABLE_POINTS+4);
@@ -57,9 +57,10 @@ CpuGBSAOBCForce::CpuGBSAOBCForce() : cutoff(false), periodic(false) {
     }
 }
 
-void CpuGBSAOBCForce::setUseCutoff(float distance) {
+void CpuGBSAOBCForce::setUseCutoff(float distance, const CpuNeighborList& neighbors) {
     cutoff = true;
     cutoffDistance = distance;
+    neighborList = &neighbors;
 }
 
 void CpuGBSAOBCForce::setPeriodic(float* periodicBoxSize) {
@@ -89,6 +90,7 @@ void CpuGBSAOBCForce::setParticleParameters(const std::vector<std::pair<float, f
     particleParams = params;
     bornRadii.resize(params.size()+3);
     obcChain.resize(params.size()+3);
+    totalBornForces.resize(params.size()+3);
 }
 
 void CpuGBSAOBCForce::computeForce(const AlignedArray<float>& posq, vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads) {
@@ -102,21 +104,38 @@ void CpuGBSAOBCForce::computeForce(const AlignedArray<float>& posq, vector<Align
     threadBornForces.resize(numThreads);
     for (int i = 0; i < numThreads; i++)
         threadBornForces[i].resize(particleParams.size()+3);
+    if (cutoff) {
+        threadBornSums.resize(numThreads);
+        for (int i = 0; i < numThreads; i++)
+            threadBornSums[i].resize(particleParams.size()+3);
+    }
     gmx_atomic_t counter;
     this->atomicCounter = &counter;
     
-    // Signal the threads to start running and wait for them to finish.
+    // Signal the threads to start running and wait for them to finish.  With a cutoff, the pair loops
+    // only visit each pair once, so the Born radii and Born forces need extra passes to sum the values
+    // each thread has accumulated.
     
     ComputeTask task(*this);
     gmx_atomic_set(&counter, 0);
     threads.execute(task);
-    threads.waitForThreads(); // Compute Born radii
+    threads.waitForThreads(); // Compute Born radii (or the sums used to compute them)
+    if (cutoff) {
+        gmx_atomic_set(&counter, 0);
+        threads.resumeThreads();
+        threads.waitForThreads(); // Compute Born radii from the sums
+    }
     gmx_atomic_set(&counter, 0);
     threads.resumeThreads();
     threads.waitForThreads(); // Compute surface area term
     gmx_atomic_set(&counter, 0);
     threads.resumeThreads();
     threads.waitForThreads(); // First loop
+    if (cutoff) {
+        gmx_atomic_set(&counter, 0);
+        threads.resumeThreads();
+        threads.waitForThreads(); // Sum the Born forces
+    }
     gmx_atomic_set(&counter, 0);
     threads.resumeThreads();
     threads.waitForThreads(); // Second loop
@@ -135,9 +154,6 @@ void CpuGBSAOBCForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
     int numParticles = particleParams.size();
     int numThreads = threads.getNumThreads();
     const float dielectricOffset = 0.009;
-    const float alphaObc = 1.0f;
-    const float betaObc = 0.8f;
-    const float gammaObc = 4.85f;
     fvec4 boxSize(periodicBoxSize[0], periodicBoxSize[1], periodicBoxSize[2], 0);
     fvec4 invBoxSize((1/periodicBoxSize[0]), (1/periodicBoxSize[1]), (1/periodicBoxSize[2]), 0);
     int start = (threadIndex*numParticles)/numThreads;
@@ -145,69 +161,75 @@ void CpuGBSAOBCForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
 
     // Calculate Born radii
 
-    while (true) {
-        int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
-        if (blockStart >= numParticles)
-            break;
-        int numInBlock = min(4, numParticles-blockStart);
-        ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
-        float atomRadius[4], atomx[4], atomy[4], atomz[4];
-        int blockMask[4] = {0, 0, 0, 0};
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            atomRadius[i] = particleParams[atomIndex].first;
-            atomx[i] = posq[4*atomIndex];
-            atomy[i] = posq[4*atomIndex+1];
-            atomz[i] = posq[4*atomIndex+2];
-            blockMask[i] = 0xFFFFFFFF;
+    if (cutoff) {
+        threadComputeNeighborBornSums(threadIndex, boxSize, invBoxSize);
+        threads.syncThreads();
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            fvec4 sum(0.0f);
+            for (int i = 0; i < numThreads; i++)
+                sum += fvec4(&threadBornSums[i][blockStart]);
+            int numInBlock = min(4, numParticles-blockStart);
+            for (int i = 0; i < numInBlock; i++)
+                setBornRadius(blockStart+i, sum[i]);
         }
-        fvec4 offsetRadiusI(atomRadius);
-        fvec4 radiusIInverse = 1.0f/offsetRadiusI;
-        fvec4 x(atomx);
-        fvec4 y(atomy);
-        fvec4 z(atomz);
-        ivec4 mask(blockMask);
-        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        for (int atomJ = 0; atomJ < numParticles; atomJ++) {
-            fvec4 posJ(posq+4*atomJ);
-            fvec4 dx, dy, dz, r2;
-            getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
-            ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
-            if (cutoff)
-                include = include & (r2 < cutoffDistance*cutoffDistance);
-            if (!any(include))
-                continue;
-            fvec4 r = sqrt(r2);
-            float scaledRadiusJ = particleParams[atomJ].second;
-            float scaledRadiusJ2 = scaledRadiusJ*scaledRadiusJ;
-            fvec4 rScaledRadiusJ = r + scaledRadiusJ;
-            include = include & (offsetRadiusI < rScaledRadiusJ);
-            fvec4 l_ij = 1.0f/max(offsetRadiusI, abs(r-scaledRadiusJ));
-            fvec4 u_ij = 1.0f/rScaledRadiusJ;
-            fvec4 l_ij2 = l_ij*l_ij;
-            fvec4 u_ij2 = u_ij*u_ij;
-            fvec4 rInverse = 1.0f/r;
-            fvec4 r2Inverse = rInverse*rInverse;
-            fvec4 logRatio = fastLog(u_ij/l_ij);
-            fvec4 term = l_ij - u_ij + 0.25f*r*(u_ij2 - l_ij2) + (0.5f*rInverse*logRatio) + (0.25f*scaledRadiusJ*scaledRadiusJ*rInverse)*(l_ij2 - u_ij2);
-            for (int j = 0; j < 4; j++) {
-                if (include[j]) {
-                    sum[j] += term[j];
-                    if (offsetRadiusI[j] < scaledRadiusJ-r[j])
-                        sum[j] += 2.0f*(radiusIInverse[j]-l_ij[j]);
+    }
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomRadius[4], atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            fvec4 offsetRadiusI(atomRadius);
+            fvec4 radiusIInverse = 1.0f/offsetRadiusI;
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            ivec4 mask(blockMask);
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            for (int atomJ = 0; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(r2);
+                float scaledRadiusJ = particleParams[atomJ].second;
+                float scaledRadiusJ2 = scaledRadiusJ*scaledRadiusJ;
+                fvec4 rScaledRadiusJ = r + scaledRadiusJ;
+                include = include & (offsetRadiusI < rScaledRadiusJ);
+                fvec4 l_ij = 1.0f/max(offsetRadiusI, abs(r-scaledRadiusJ));
+                fvec4 u_ij = 1.0f/rScaledRadiusJ;
+                fvec4 l_ij2 = l_ij*l_ij;
+                fvec4 u_ij2 = u_ij*u_ij;
+                fvec4 rInverse = 1.0f/r;
+                fvec4 r2Inverse = rInverse*rInverse;
+                fvec4 logRatio = fastLog(u_ij/l_ij);
+                fvec4 term = l_ij - u_ij + 0.25f*r*(u_ij2 - l_ij2) + (0.5f*rInverse*logRatio) + (0.25f*scaledRadiusJ*scaledRadiusJ*rInverse)*(l_ij2 - u_ij2);
+                for (int j = 0; j < 4; j++) {
+                    if (include[j]) {
+                        sum[j] += term[j];
+                        if (offsetRadiusI[j] < scaledRadiusJ-r[j])
+                            sum[j] += 2.0f*(radiusIInverse[j]-l_ij[j]);
+                    }
                 }
             }
-        }
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            sum[i] *= 0.5f*atomRadius[i];
-            float sum2 = sum[i]*sum[i];
-            float sum3 = sum[i]*sum2;
-            float tanhSum = tanh(alphaObc*sum[i] - betaObc*sum2 + gammaObc*sum3);
-            float radiusI = atomRadius[i] + dielectricOffset;
-            bornRadii[atomIndex] = 1.0f/(1.0f/atomRadius[i] - tanhSum/radiusI);
-            obcChain[atomIndex] = atomRadius[i]*(alphaObc - 2.0f*betaObc*sum[i] + 3.0f*gammaObc*sum2);
-            obcChain[atomIndex] = (1.0f - tanhSum*tanhSum)*obcChain[atomIndex]/radiusI;
+            for (int i = 0; i < numInBlock; i++)
+                setBornRadius(blockStart+i, sum[i]);
         }
     }
     threads.syncThreads();
@@ -244,157 +266,428 @@ void CpuGBSAOBCForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
         preFactor = ONE_4PI_EPS0*((1.0f/solventDielectric) - (1.0f/soluteDielectric));
     else
         preFactor = 0.0f;
-    while (true) {
-        int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
-        if (blockStart >= numParticles)
-            break;
-        int numInBlock = min(4, numParticles-blockStart);
-        ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
-        float atomCharge[4], atomx[4], atomy[4], atomz[4];
-        int blockMask[4] = {0, 0, 0, 0};
-        fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f), blockAtomBornForce(0.0f);
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            atomx[i] = posq[4*atomIndex];
-            atomy[i] = posq[4*atomIndex+1];
-            atomz[i] = posq[4*atomIndex+2];
-            atomCharge[i] = preFactor*posq[4*atomIndex+3];
-            blockMask[i] = 0xFFFFFFFF;
-        }
-        fvec4 radii(&bornRadii[blockStart]);
-        fvec4 x(atomx);
-        fvec4 y(atomy);
-        fvec4 z(atomz);
-        fvec4 partialChargeI(atomCharge);
-        ivec4 mask(blockMask);
-        for (int atomJ = blockStart; atomJ < numParticles; atomJ++) {
-            fvec4 posJ(posq+4*atomJ);
-            fvec4 dx, dy, dz, r2;
-            getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
-            ivec4 include = mask & (blockAtomIndex <= ivec4(atomJ));
-            if (cutoff)
-                include = include & (r2 < cutoffDistance*cutoffDistance);
-            if (!any(include))
-                continue;
-            fvec4 r = sqrt(r2);
-            fvec4 alpha2_ij = radii*bornRadii[atomJ];
-            fvec4 D_ij = r2/(4.0f*alpha2_ij);
-            fvec4 expTerm(expf(-D_ij[0]), expf(-D_ij[1]), expf(-D_ij[2]), expf(-D_ij[3]));
-            fvec4 denominator2 = r2 + alpha2_ij*expTerm;
-            fvec4 denominator = sqrt(denominator2);
-            fvec4 Gpol = (partialChargeI*posJ[3])/denominator; 
-            fvec4 dGpol_dr = -Gpol*(1.0f - 0.25f*expTerm)/denominator2;  
-            fvec4 dGpol_dalpha2_ij = -0.5f*Gpol*expTerm*(1.0f + D_ij)/denominator2;
-            dGpol_dr = blend(0.0f, dGpol_dr, include);
-            dGpol_dalpha2_ij = blend(0.0f, dGpol_dalpha2_ij, include);
-            fvec4 fx = dx*dGpol_dr;
-            fvec4 fy = dy*dGpol_dr;
-            fvec4 fz = dz*dGpol_dr;
-            blockAtomForceX -= fx;
-            blockAtomForceY -= fy;
-            blockAtomForceZ -= fz;
-            blockAtomBornForce += dGpol_dalpha2_ij*bornRadii[atomJ];
-            float* atomForce = forces+4*atomJ;
-            fvec4 one(1.0f);
-            atomForce[0] += dot4(fx, one);
-            atomForce[1] += dot4(fy, one);
-            atomForce[2] += dot4(fz, one);
-            ivec4 atomJMask = include & (blockAtomIndex != ivec4(atomJ));
-            fvec4 termEnergy = blend(0.0f, Gpol, include);
-            if (cutoff)
-                termEnergy -= blend(0.0f, partialChargeI*posJ[3]/cutoffDistance, atomJMask);
-            termEnergy *= blend(0.5f, 1.0f, atomJMask);
-            energy += dot4(termEnergy, one);
-            bornForces[atomJ] += dot4(blend(0.0f, dGpol_dalpha2_ij, atomJMask), radii);
-        }
-        fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
-        transpose(f[0], f[1], f[2], f[3]);
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
-            bornForces[atomIndex] += blockAtomBornForce[i];
+    if (cutoff)
+        energy += threadComputeNeighborBornEnergy(threadIndex, preFactor, boxSize, invBoxSize);
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomCharge[4], atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f), blockAtomBornForce(0.0f);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                atomCharge[i] = preFactor*posq[4*atomIndex+3];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            fvec4 radii(&bornRadii[blockStart]);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 partialChargeI(atomCharge);
+            ivec4 mask(blockMask);
+            for (int atomJ = blockStart; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex <= ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 alpha2_ij = radii*bornRadii[atomJ];
+                fvec4 D_ij = r2/(4.0f*alpha2_ij);
+                fvec4 expTerm(expf(-D_ij[0]), expf(-D_ij[1]), expf(-D_ij[2]), expf(-D_ij[3]));
+                fvec4 denominator2 = r2 + alpha2_ij*expTerm;
+                fvec4 denominator = sqrt(denominator2);
+                fvec4 Gpol = (partialChargeI*posJ[3])/denominator; 
+                fvec4 dGpol_dr = -Gpol*(1.0f - 0.25f*expTerm)/denominator2;  
+                fvec4 dGpol_dalpha2_ij = -0.5f*Gpol*expTerm*(1.0f + D_ij)/denominator2;
+                dGpol_dr = blend(0.0f, dGpol_dr, include);
+                dGpol_dalpha2_ij = blend(0.0f, dGpol_dalpha2_ij, include);
+                fvec4 fx = dx*dGpol_dr;
+                fvec4 fy = dy*dGpol_dr;
+                fvec4 fz = dz*dGpol_dr;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                blockAtomBornForce += dGpol_dalpha2_ij*bornRadii[atomJ];
+                float* atomForce = forces+4*atomJ;
+                fvec4 one(1.0f);
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+                ivec4 atomJMask = include & (blockAtomIndex != ivec4(atomJ));
+                fvec4 termEnergy = blend(0.0f, Gpol, include);
+                termEnergy *= blend(0.5f, 1.0f, atomJMask);
+                energy += dot4(termEnergy, one);
+                bornForces[atomJ] += dot4(blend(0.0f, dGpol_dalpha2_ij, atomJMask), radii);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+                bornForces[atomIndex] += blockAtomBornForce[i];
+            }
         }
     }
     threads.syncThreads();
 
     // Second loop of Born energy computation.
 
-    while (true) {
-        int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
-        if (blockStart >= numParticles)
+    if (cutoff) {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            fvec4 bornForce(0.0f);
+            for (int i = 0; i < numThreads; i++)
+                bornForce += fvec4(&threadBornForces[i][blockStart]);
+            fvec4 radii(&bornRadii[blockStart]);
+            bornForce *= radii*radii*fvec4(&obcChain[blockStart]);
+            bornForce.store(&totalBornForces[blockStart]);
+        }
+        threads.syncThreads();
+        threadComputeNeighborChainForces(threadIndex, boxSize, invBoxSize);
+    }
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            fvec4 bornForce(0.0f);
+            for (int i = 0; i < numThreads; i++)
+                bornForce += fvec4(&threadBornForces[i][blockStart]);
+            fvec4 radii(&bornRadii[blockStart]);
+            bornForce *= radii*radii*fvec4(&obcChain[blockStart]);
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomRadius[4], atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            for (int i = numInBlock; i < 4; i++) {
+                atomx[i] = 0.0f;
+                atomy[i] = 0.0f;
+                atomz[i] = 0.0f;
+            }
+            fvec4 offsetRadiusI(atomRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            ivec4 mask(blockMask);
+            for (int atomJ = 0; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(r2);
+                float scaledRadiusJ = particleParams[atomJ].second;
+                float scaledRadiusJ2 = scaledRadiusJ*scaledRadiusJ;
+                fvec4 rScaledRadiusJ = r + scaledRadiusJ;
+                include = include & (offsetRadiusI < rScaledRadiusJ);
+                fvec4 l_ij = 1.0f/max(offsetRadiusI, abs(r-scaledRadiusJ));
+                fvec4 u_ij = 1.0f/rScaledRadiusJ;
+                fvec4 l_ij2 = l_ij*l_ij;
+                fvec4 u_ij2 = u_ij*u_ij;
+                fvec4 rInverse = 1.0f/r;
+                fvec4 r2Inverse = rInverse*rInverse;
+                fvec4 logRatio = fastLog(u_ij/l_ij);
+                fvec4 t3 = 0.125f*(1.0f + scaledRadiusJ2*r2Inverse)*(l_ij2 - u_ij2) + 0.25f*logRatio*r2Inverse;
+                fvec4 de = bornForce*t3*rInverse;
+                de = blend(0.0f, de, include);
+                fvec4 fx = dx*de;
+                fvec4 fy = dy*de;
+                fvec4 fz = dz*de;
+                blockAtomForceX += fx;
+                blockAtomForceY += fy;
+                blockAtomForceZ += fz;
+                float* atomForce = forces+4*atomJ;
+                fvec4 one(1.0f);
+                atomForce[0] -= dot4(fx, one);
+                atomForce[1] -= dot4(fy, one);
+                atomForce[2] -= dot4(fz, one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+            }
+        }
+    }
+    threadEnergy[threadIndex] = energy;
+}
+
+void CpuGBSAOBCForce::setBornRadius(int atom, float sum) {
+    const float dielectricOffset = 0.009;
+    const float alphaObc = 1.0f;
+    const float betaObc = 0.8f;
+    const float gammaObc = 4.85f;
+    float atomRadius = particleParams[atom].first;
+    sum *= 0.5f*atomRadius;
+    float sum2 = sum*sum;
+    float sum3 = sum*sum2;
+    float tanhSum = tanh(alphaObc*sum - betaObc*sum2 + gammaObc*sum3);
+    float radiusI = atomRadius + dielectricOffset;
+    bornRadii[atom] = 1.0f/(1.0f/atomRadius - tanhSum/radiusI);
+    obcChain[atom] = atomRadius*(alphaObc - 2.0f*betaObc*sum + 3.0f*gammaObc*sum2);
+    obcChain[atom] = (1.0f - tanhSum*tanhSum)*obcChain[atom]/radiusI;
+}
+
+fvec4 CpuGBSAOBCForce::computeBornSumTerm(const fvec4& r, const fvec4& rInverse, const fvec4& offsetRadius, const fvec4& scaledRadius, const ivec4& include) {
+    fvec4 rScaledRadius = r + scaledRadius;
+    ivec4 mask = include & (offsetRadius < rScaledRadius);
+    fvec4 l_ij = 1.0f/max(offsetRadius, abs(r-scaledRadius));
+    fvec4 u_ij = 1.0f/rScaledRadius;
+    fvec4 l_ij2 = l_ij*l_ij;
+    fvec4 u_ij2 = u_ij*u_ij;
+    fvec4 logRatio = fastLog(u_ij/l_ij);
+    fvec4 term = l_ij - u_ij + 0.25f*r*(u_ij2 - l_ij2) + (0.5f*rInverse*logRatio) + (0.25f*scaledRadius*scaledRadius*rInverse)*(l_ij2 - u_ij2);
+    term += blend(0.0f, 2.0f*(1.0f/offsetRadius-l_ij), offsetRadius < scaledRadius-r);
+    return blend(0.0f, term, mask);
+}
+
+fvec4 CpuGBSAOBCForce::computeChainTerm(const fvec4& r, const fvec4& rInverse, const fvec4& offsetRadius, const fvec4& scaledRadius, const ivec4& include) {
+    fvec4 rScaledRadius = r + scaledRadius;
+    ivec4 mask = include & (offsetRadius < rScaledRadius);
+    fvec4 l_ij = 1.0f/max(offsetRadius, abs(r-scaledRadius));
+    fvec4 u_ij = 1.0f/rScaledRadius;
+    fvec4 l_ij2 = l_ij*l_ij;
+    fvec4 u_ij2 = u_ij*u_ij;
+    fvec4 r2Inverse = rInverse*rInverse;
+    fvec4 logRatio = fastLog(u_ij/l_ij);
+    fvec4 t3 = 0.125f*(1.0f + scaledRadius*scaledRadius*r2Inverse)*(l_ij2 - u_ij2) + 0.25f*logRatio*r2Inverse;
+    return blend(0.0f, t3, mask);
+}
+
+ivec4 CpuGBSAOBCForce::getNeighborMask(const int* blockAtom, int atomsInBlock, int blockSize, int firstPosition, int neighbor) const {
+    int neighborPosition = blockSize;
+    for (int i = 0; i < atomsInBlock; i++)
+        if (blockAtom[i] == neighbor) {
+            neighborPosition = i;
             break;
-        fvec4 bornForce(0.0f);
-        for (int i = 0; i < numThreads; i++)
-            bornForce += fvec4(&threadBornForces[i][blockStart]);
-        fvec4 radii(&bornRadii[blockStart]);
-        bornForce *= radii*radii*fvec4(&obcChain[blockStart]);
-        int numInBlock = min(4, numParticles-blockStart);
-        ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
-        float atomRadius[4], atomx[4], atomy[4], atomz[4];
-        int blockMask[4] = {0, 0, 0, 0};
-        fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            atomRadius[i] = particleParams[atomIndex].first;
-            atomx[i] = posq[4*atomIndex];
-            atomy[i] = posq[4*atomIndex+1];
-            atomz[i] = posq[4*atomIndex+2];
-            blockMask[i] = 0xFFFFFFFF;
         }
-        for (int i = numInBlock; i < 4; i++) {
-            atomx[i] = 0.0f;
-            atomy[i] = 0.0f;
-            atomz[i] = 0.0f;
+    int lastPosition = min(atomsInBlock, neighborPosition);
+    return ivec4(firstPosition, firstPosition+1, firstPosition+2, firstPosition+3) < ivec4(lastPosition);
+}
+
+void CpuGBSAOBCForce::threadComputeNeighborBornSums(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    AlignedArray<float>& sums = threadBornSums[threadIndex];
+    for (int i = 0; i < numParticles; i++)
+        sums[i] = 0.0f;
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomOffsetRadius[4], atomScaledRadius[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomOffsetRadius[i] = particleParams[atomIndex].first;
+                atomScaledRadius[i] = particleParams[atomIndex].second;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 offsetRadiusI(atomOffsetRadius);
+            fvec4 scaledRadiusI(atomScaledRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 sum(0.0f);
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+                fvec4 rInverse = 1.0f/r;
+                sum += computeBornSumTerm(r, rInverse, offsetRadiusI, particleParams[atomJ].second, include);
+                sums[atomJ] += dot4(computeBornSumTerm(r, rInverse, particleParams[atomJ].first, scaledRadiusI, include), one);
+            }
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++)
+                sums[blockAtom[group+i]] += sum[i];
         }
-        fvec4 offsetRadiusI(atomRadius);
-        fvec4 x(atomx);
-        fvec4 y(atomy);
-        fvec4 z(atomz);
-        ivec4 mask(blockMask);
-        for (int atomJ = 0; atomJ < numParticles; atomJ++) {
-            fvec4 posJ(posq+4*atomJ);
-            fvec4 dx, dy, dz, r2;
-            getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
-            ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
-            if (cutoff)
-                include = include & (r2 < cutoffDistance*cutoffDistance);
-            if (!any(include))
-                continue;
-            fvec4 r = sqrt(r2);
-            float scaledRadiusJ = particleParams[atomJ].second;
-            float scaledRadiusJ2 = scaledRadiusJ*scaledRadiusJ;
-            fvec4 rScaledRadiusJ = r + scaledRadiusJ;
-            include = include & (offsetRadiusI < rScaledRadiusJ);
-            fvec4 l_ij = 1.0f/max(offsetRadiusI, abs(r-scaledRadiusJ));
-            fvec4 u_ij = 1.0f/rScaledRadiusJ;
-            fvec4 l_ij2 = l_ij*l_ij;
-            fvec4 u_ij2 = u_ij*u_ij;
-            fvec4 rInverse = 1.0f/r;
-            fvec4 r2Inverse = rInverse*rInverse;
-            fvec4 logRatio = fastLog(u_ij/l_ij);
-            fvec4 t3 = 0.125f*(1.0f + scaledRadiusJ2*r2Inverse)*(l_ij2 - u_ij2) + 0.25f*logRatio*r2Inverse;
-            fvec4 de = bornForce*t3*rInverse;
-            de = blend(0.0f, de, include);
-            fvec4 fx = dx*de;
-            fvec4 fy = dy*de;
-            fvec4 fz = dz*de;
-            blockAtomForceX += fx;
-            blockAtomForceY += fy;
-            blockAtomForceZ += fz;
-            float* atomForce = forces+4*atomJ;
-            fvec4 one(1.0f);
-            atomForce[0] -= dot4(fx, one);
-            atomForce[1] -= dot4(fy, one);
-            atomForce[2] -= dot4(fz, one);
+    }
+}
+
+double CpuGBSAOBCForce::threadComputeNeighborBornEnergy(int threadIndex, float preFactor, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    float* forces = &(*threadForce)[threadIndex][0];
+    AlignedArray<float>& bornForces = threadBornForces[threadIndex];
+    double energy = 0.0;
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomCharge[4], atomRadius[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomCharge[i] = posq[4*atomIndex+3];
+                atomRadius[i] = bornRadii[atomIndex];
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 chargeI(atomCharge);
+            fvec4 partialChargeI = preFactor*chargeI;
+            fvec4 radii(atomRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+
+            // Each atom's interaction with itself.
+
+            fvec4 selfEnergy = blend(0.0f, partialChargeI*chargeI/radii, getNeighborMask(blockAtom, atomsInBlock, blockSize, group, -1));
+            energy += 0.5f*dot4(selfEnergy, one);
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            fvec4 blockAtomBornForce = -0.5f*selfEnergy/radii;
+
+            // Interactions with neighbors.
+
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 alpha2_ij = radii*bornRadii[atomJ];
+                fvec4 D_ij = r2/(4.0f*alpha2_ij);
+                fvec4 expTerm(expf(-D_ij[0]), expf(-D_ij[1]), expf(-D_ij[2]), expf(-D_ij[3]));
+                fvec4 denominator2 = r2 + alpha2_ij*expTerm;
+                fvec4 denominator = sqrt(denominator2);
+                fvec4 chargeProduct = partialChargeI*posJ[3];
+                fvec4 Gpol = chargeProduct/denominator;
+                fvec4 dGpol_dr = -Gpol*(1.0f - 0.25f*expTerm)/denominator2;
+                fvec4 dGpol_dalpha2_ij = -0.5f*Gpol*expTerm*(1.0f + D_ij)/denominator2;
+                dGpol_dr = blend(0.0f, dGpol_dr, include);
+                dGpol_dalpha2_ij = blend(0.0f, dGpol_dalpha2_ij, include);
+                fvec4 fx = dx*dGpol_dr;
+                fvec4 fy = dy*dGpol_dr;
+                fvec4 fz = dz*dGpol_dr;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                blockAtomBornForce += dGpol_dalpha2_ij*bornRadii[atomJ];
+                float* atomForce = forces+4*atomJ;
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+                bornForces[atomJ] += dot4(dGpol_dalpha2_ij, radii);
+                energy += dot4(blend(0.0f, Gpol-chargeProduct/cutoffDistance, include), one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++) {
+                int atomIndex = blockAtom[group+i];
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+                bornForces[atomIndex] += blockAtomBornForce[i];
+            }
         }
-        fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
-        transpose(f[0], f[1], f[2], f[3]);
-        for (int i = 0; i < numInBlock; i++) {
-            int atomIndex = blockStart+i;
-            (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+    }
+    return energy;
+}
+
+void CpuGBSAOBCForce::threadComputeNeighborChainForces(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    float* forces = &(*threadForce)[threadIndex][0];
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomOffsetRadius[4], atomScaledRadius[4], atomBornForce[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomOffsetRadius[i] = particleParams[atomIndex].first;
+                atomScaledRadius[i] = particleParams[atomIndex].second;
+                atomBornForce[i] = totalBornForces[atomIndex];
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 offsetRadiusI(atomOffsetRadius);
+            fvec4 scaledRadiusI(atomScaledRadius);
+            fvec4 bornForceI(atomBornForce);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+                fvec4 rInverse = 1.0f/r;
+
+                // Both atoms' Born radii depend on their separation.
+
+                fvec4 de = bornForceI*computeChainTerm(r, rInverse, offsetRadiusI, particleParams[atomJ].second, include);
+                de += totalBornForces[atomJ]*computeChainTerm(r, rInverse, particleParams[atomJ].first, scaledRadiusI, include);
+                de *= rInverse;
+                fvec4 fx = dx*de;
+                fvec4 fy = dy*de;
+                fvec4 fz = dz*de;
+                blockAtomForceX += fx;
+                blockAtomForceY += fy;
+                blockAtomForceZ += fz;
+                float* atomForce = forces+4*atomJ;
+                atomForce[0] -= dot4(fx, one);
+                atomForce[1] -= dot4(fy, one);
+                atomForce[2] -= dot4(fz, one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++) {
+                int atomIndex = blockAtom[group+i];
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+            }
         }
     }
-    threadEnergy[threadIndex] = energy;
 }
 
 void CpuGBSAOBCForce::getDeltaR(const fvec4& posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const {
@@ -0,0 +1,713 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "CpuGBVIForce.h"
+#include "SimTKOpenMMRealType.h"
+#include "openmm/internal/vectorize.h"
+#include "gmx_atomic.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+using namespace OpenMM;
+
+class CpuGBVIForce::ComputeTask : public ThreadPool::Task {
+public:
+    ComputeTask(CpuGBVIForce& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeForce(threads, threadIndex);
+    }
+    CpuGBVIForce& owner;
+};
+
+/**
+ * Compute L (Eq. 4 of Labute, JCC 29 p. 1693), from which the volume integrals are built.
+ */
+static fvec4 getL(const fvec4& r, const fvec4& x, const fvec4& S) {
+    fvec4 rInv = 1.0f/r;
+    fvec4 xInv = 1.0f/x;
+    fvec4 xInv2 = xInv*xInv;
+    fvec4 diff2 = (r+S)*(r-S);
+    return (1.5f*xInv)*(0.25f*xInv*rInv - (1.0f/3.0f)*xInv2 + 0.125f*diff2*xInv2*xInv*rInv);
+}
+
+/**
+ * Compute the partial derivative of L with respect to r.
+ */
+static fvec4 getDLdr(const fvec4& r, const fvec4& x, const fvec4& S) {
+    fvec4 rInv = 1.0f/r;
+    fvec4 xInv = 1.0f/x;
+    fvec4 xInv2 = xInv*xInv;
+    fvec4 diff2 = (r+S)*(r-S);
+    return (-1.5f*xInv2*rInv*rInv)*(0.25f + 0.125f*diff2*xInv2) + 0.375f*xInv2*xInv2;
+}
+
+/**
+ * Compute the partial derivative of L with respect to x.
+ */
+static fvec4 getDLdx(const fvec4& r, const fvec4& x, const fvec4& S) {
+    fvec4 rInv = 1.0f/r;
+    fvec4 xInv = 1.0f/x;
+    fvec4 xInv2 = xInv*xInv;
+    fvec4 diff2 = (r+S)*(r-S);
+    return (-1.5f*xInv2*xInv)*(0.5f*rInv - xInv + 0.5f*diff2*xInv2*rInv);
+}
+
+CpuGBVIForce::CpuGBVIForce() : cutoff(false), periodic(false), useQuinticSpline(false), neighborList(NULL) {
+}
+
+void CpuGBVIForce::setUseCutoff(float distance, const CpuNeighborList& neighbors) {
+    cutoff = true;
+    cutoffDistance = distance;
+    neighborList = &neighbors;
+}
+
+void CpuGBVIForce::setPeriodic(float* periodicBoxSize) {
+    periodic = true;
+    this->periodicBoxSize[0] = periodicBoxSize[0];
+    this->periodicBoxSize[1] = periodicBoxSize[1];
+    this->periodicBoxSize[2] = periodicBoxSize[2];
+}
+
+void CpuGBVIForce::setSoluteDielectric(float dielectric) {
+    soluteDielectric = dielectric;
+}
+
+void CpuGBVIForce::setSolventDielectric(float dielectric) {
+    solventDielectric = dielectric;
+}
+
+void CpuGBVIForce::setBornRadiusScaling(bool useQuinticSpline, float lowerLimitFactor, float upperLimit) {
+    this->useQuinticSpline = useQuinticSpline;
+    quinticLowerLimitFactor = lowerLimitFactor;
+    quinticUpperLimit = upperLimit;
+}
+
+const vector<pair<float, float> >& CpuGBVIForce::getParticleParameters() const {
+    return particleParams;
+}
+
+void CpuGBVIForce::setParticleParameters(const vector<pair<float, float> >& params, const vector<float>& gammas) {
+    particleParams = params;
+    this->gammas = gammas;
+    bornRadii.resize(params.size()+3);
+    switchDerivative.resize(params.size()+3);
+    totalBornForces.resize(params.size()+3);
+    for (int i = 0; i < 3; i++) {
+        bornRadii[params.size()+i] = 1.0f;
+        switchDerivative[params.size()+i] = 0.0f;
+        totalBornForces[params.size()+i] = 0.0f;
+    }
+}
+
+void CpuGBVIForce::computeForce(const AlignedArray<float>& posq, vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads) {
+    // Record the parameters for the threads.
+    
+    this->posq = &posq[0];
+    this->threadForce = &threadForce;
+    includeEnergy = (totalEnergy != NULL);
+    int numThreads = threads.getNumThreads();
+    threadEnergy.resize(numThreads);
+    threadBornForces.resize(numThreads);
+    for (int i = 0; i < numThreads; i++)
+        threadBornForces[i].resize(particleParams.size()+3);
+    if (cutoff) {
+        threadBornSums.resize(numThreads);
+        for (int i = 0; i < numThreads; i++)
+            threadBornSums[i].resize(particleParams.size()+3);
+    }
+    gmx_atomic_t counter;
+    this->atomicCounter = &counter;
+    
+    // Signal the threads to start running and wait for them to finish.  With a cutoff, the pair loops
+    // only visit each pair once, so the Born radii need an extra pass to sum the values each thread
+    // has accumulated.
+    
+    ComputeTask task(*this);
+    gmx_atomic_set(&counter, 0);
+    threads.execute(task);
+    threads.waitForThreads(); // Compute Born radii (or the sums used to compute them)
+    if (cutoff) {
+        gmx_atomic_set(&counter, 0);
+        threads.resumeThreads();
+        threads.waitForThreads(); // Compute Born radii from the sums
+    }
+    gmx_atomic_set(&counter, 0);
+    threads.resumeThreads();
+    threads.waitForThreads(); // Compute cavity term
+    gmx_atomic_set(&counter, 0);
+    threads.resumeThreads();
+    threads.waitForThreads(); // First loop
+    gmx_atomic_set(&counter, 0);
+    threads.resumeThreads();
+    threads.waitForThreads(); // Sum the Born forces
+    gmx_atomic_set(&counter, 0);
+    threads.resumeThreads();
+    threads.waitForThreads(); // Second loop
+    
+    // Combine the energies from all the threads.
+    
+    if (totalEnergy != NULL) {
+        double energy = 0;
+        for (int i = 0; i < numThreads; i++)
+            energy += threadEnergy[i];
+        *totalEnergy += energy;
+    }
+}
+
+void CpuGBVIForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
+    int numParticles = particleParams.size();
+    int numThreads = threads.getNumThreads();
+    fvec4 boxSize(periodicBoxSize[0], periodicBoxSize[1], periodicBoxSize[2], 0);
+    fvec4 invBoxSize((1/periodicBoxSize[0]), (1/periodicBoxSize[1]), (1/periodicBoxSize[2]), 0);
+    float tau;
+    if (soluteDielectric != 0.0f && solventDielectric != 0.0f)
+        tau = (1.0f/soluteDielectric) - (1.0f/solventDielectric);
+    else
+        tau = 0.0f;
+
+    // Calculate Born radii
+
+    if (cutoff) {
+        threadComputeNeighborBornSums(threadIndex, boxSize, invBoxSize);
+        threads.syncThreads();
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            fvec4 sum(0.0f);
+            for (int i = 0; i < numThreads; i++)
+                sum += fvec4(&threadBornSums[i][blockStart]);
+            int numInBlock = min(4, numParticles-blockStart);
+            for (int i = 0; i < numInBlock; i++)
+                setBornRadius(blockStart+i, sum[i]);
+        }
+    }
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomRadius[4] = {1.0f, 1.0f, 1.0f, 1.0f}, atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            for (int i = numInBlock; i < 4; i++) {
+                atomx[i] = 0.0f;
+                atomy[i] = 0.0f;
+                atomz[i] = 0.0f;
+            }
+            fvec4 radiusI(atomRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            ivec4 mask(blockMask);
+            fvec4 sum(0.0f);
+            for (int atomJ = 0; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+                sum += computeVolume(r, radiusI, particleParams[atomJ].second, include);
+            }
+            for (int i = 0; i < numInBlock; i++)
+                setBornRadius(blockStart+i, sum[i]);
+        }
+    }
+    threads.syncThreads();
+
+    // Calculate the cavity term.
+
+    double energy = 0.0;
+    AlignedArray<float>& bornForces = threadBornForces[threadIndex];
+    for (int i = 0; i < numParticles; i++)
+        bornForces[i] = 0.0f;
+    while (true) {
+        int atomI = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (atomI >= numParticles)
+            break;
+        float ratio = particleParams[atomI].first/bornRadii[atomI];
+        float cavityTerm = tau*gammas[atomI]*ratio*ratio*ratio;
+        energy -= cavityTerm;
+        bornForces[atomI] = 3.0f*cavityTerm/bornRadii[atomI];
+    }
+    threads.syncThreads();
+ 
+    // First loop of Born energy computation.
+
+    float* forces = &(*threadForce)[threadIndex][0];
+    float preFactor = -tau*ONE_4PI_EPS0;
+    if (cutoff)
+        energy += threadComputeNeighborBornEnergy(threadIndex, preFactor, boxSize, invBoxSize);
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomCharge[4], atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f), blockAtomBornForce(0.0f);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                atomCharge[i] = preFactor*posq[4*atomIndex+3];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            for (int i = numInBlock; i < 4; i++) {
+                atomx[i] = 0.0f;
+                atomy[i] = 0.0f;
+                atomz[i] = 0.0f;
+                atomCharge[i] = 0.0f;
+            }
+            fvec4 radii(&bornRadii[blockStart]);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 partialChargeI(atomCharge);
+            ivec4 mask(blockMask);
+            for (int atomJ = blockStart; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex <= ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 alpha2_ij = radii*bornRadii[atomJ];
+                fvec4 D_ij = r2/(4.0f*alpha2_ij);
+                fvec4 expTerm(expf(-D_ij[0]), expf(-D_ij[1]), expf(-D_ij[2]), expf(-D_ij[3]));
+                fvec4 denominator2 = r2 + alpha2_ij*expTerm;
+                fvec4 denominator = sqrt(denominator2);
+                fvec4 Gpol = (partialChargeI*posJ[3])/denominator; 
+                fvec4 dGpol_dr = -Gpol*(1.0f - 0.25f*expTerm)/denominator2;  
+                fvec4 dGpol_dalpha2_ij = -0.5f*Gpol*expTerm*(1.0f + D_ij)/denominator2;
+                dGpol_dr = blend(0.0f, dGpol_dr, include);
+                dGpol_dalpha2_ij = blend(0.0f, dGpol_dalpha2_ij, include);
+                fvec4 fx = dx*dGpol_dr;
+                fvec4 fy = dy*dGpol_dr;
+                fvec4 fz = dz*dGpol_dr;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                blockAtomBornForce += dGpol_dalpha2_ij*bornRadii[atomJ];
+                float* atomForce = forces+4*atomJ;
+                fvec4 one(1.0f);
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+                ivec4 atomJMask = include & (blockAtomIndex != ivec4(atomJ));
+                fvec4 termEnergy = blend(0.0f, Gpol, include);
+                termEnergy *= blend(0.5f, 1.0f, atomJMask);
+                energy += dot4(termEnergy, one);
+                bornForces[atomJ] += dot4(blend(0.0f, dGpol_dalpha2_ij, atomJMask), radii);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+                bornForces[atomIndex] += blockAtomBornForce[i];
+            }
+        }
+    }
+    threads.syncThreads();
+
+    // Sum the Born forces from all threads and convert them to derivatives with respect to the volume integrals.
+
+    while (true) {
+        int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+        if (blockStart >= numParticles)
+            break;
+        fvec4 bornForce(0.0f);
+        for (int i = 0; i < numThreads; i++)
+            bornForce += fvec4(&threadBornForces[i][blockStart]);
+        fvec4 radii(&bornRadii[blockStart]);
+        fvec4 radii2 = radii*radii;
+        bornForce *= (1.0f/3.0f)*radii2*radii2*fvec4(&switchDerivative[blockStart]);
+        bornForce.store(&totalBornForces[blockStart]);
+    }
+    threads.syncThreads();
+
+    // Second loop of Born energy computation.
+
+    if (cutoff)
+        threadComputeNeighborChainForces(threadIndex, boxSize, invBoxSize);
+    else {
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            fvec4 bornForce(&totalBornForces[blockStart]);
+            int numInBlock = min(4, numParticles-blockStart);
+            ivec4 blockAtomIndex(blockStart, blockStart+1, blockStart+2, blockStart+3);
+            float atomRadius[4] = {1.0f, 1.0f, 1.0f, 1.0f}, atomx[4], atomy[4], atomz[4];
+            int blockMask[4] = {0, 0, 0, 0};
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+                blockMask[i] = 0xFFFFFFFF;
+            }
+            for (int i = numInBlock; i < 4; i++) {
+                atomx[i] = 0.0f;
+                atomy[i] = 0.0f;
+                atomz[i] = 0.0f;
+            }
+            fvec4 radiusI(atomRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            ivec4 mask(blockMask);
+            for (int atomJ = 0; atomJ < numParticles; atomJ++) {
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = mask & (blockAtomIndex != ivec4(atomJ));
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+                fvec4 de = bornForce*computeVolumeDerivative(r, radiusI, particleParams[atomJ].second, include)/r;
+                fvec4 fx = dx*de;
+                fvec4 fy = dy*de;
+                fvec4 fz = dz*de;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                float* atomForce = forces+4*atomJ;
+                fvec4 one(1.0f);
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < numInBlock; i++) {
+                int atomIndex = blockStart+i;
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+            }
+        }
+    }
+    threadEnergy[threadIndex] = energy;
+}
+
+void CpuGBVIForce::setBornRadius(int atom, float sum) {
+    float atomicRadius = particleParams[atom].first;
+    float atomicRadius3 = 1.0f/(atomicRadius*atomicRadius*atomicRadius);
+    float volume;
+    if (!useQuinticSpline) {
+        volume = atomicRadius3-sum;
+        switchDerivative[atom] = 1.0f;
+    }
+    else {
+        // Smoothly switch off the integral as it approaches the atomic volume, so the Born radius stays finite.
+
+        float splineL = quinticLowerLimitFactor*atomicRadius3;
+        if (sum <= splineL) {
+            volume = atomicRadius3-sum;
+            switchDerivative[atom] = 1.0f;
+        }
+        else if (sum < atomicRadius3) {
+            float width = atomicRadius3-splineL;
+            float ratio = (sum-splineL)/width;
+            float ratio2 = ratio*ratio;
+            float splineValue = 1.0f + ratio2*ratio*(-10.0f + 15.0f*ratio - 6.0f*ratio2);
+            float splineDerivative = ratio2*(-30.0f + 60.0f*ratio - 30.0f*ratio2)/width;
+            volume = (atomicRadius3-sum)*splineValue + quinticUpperLimit;
+            switchDerivative[atom] = splineValue - (atomicRadius3-sum)*splineDerivative;
+        }
+        else {
+            volume = quinticUpperLimit;
+            switchDerivative[atom] = 0.0f;
+        }
+    }
+    bornRadii[atom] = powf(volume, -1.0f/3.0f);
+}
+
+fvec4 CpuGBVIForce::computeVolume(const fvec4& r, const fvec4& radius, const fvec4& scaledRadius, const ivec4& include) const {
+    fvec4 diff = scaledRadius-radius;
+    ivec4 overlap = abs(diff) < r;
+    ivec4 inside = r <= diff;
+    fvec4 lowerBound = blend(r-scaledRadius, max(radius, r-scaledRadius), overlap);
+    fvec4 volume = getL(r, r+scaledRadius, scaledRadius) - getL(r, lowerBound, scaledRadius);
+    volume += blend(0.0f, 1.0f/(radius*radius*radius), inside);
+    return blend(0.0f, volume, include & (overlap | inside));
+}
+
+fvec4 CpuGBVIForce::computeVolumeDerivative(const fvec4& r, const fvec4& radius, const fvec4& scaledRadius, const ivec4& include) const {
+    fvec4 diff = scaledRadius-radius;
+    ivec4 overlap = abs(diff) < r;
+    ivec4 inside = r < diff;
+    fvec4 upperBound = r+scaledRadius;
+    fvec4 lowerBound = blend(r-scaledRadius, max(radius, r-scaledRadius), overlap);
+
+    // When the lower bound is the atomic radius it does not depend on r, so only the partial derivative
+    // with respect to r contributes.
+
+    ivec4 fixedLowerBound = overlap & (radius > r-scaledRadius);
+    fvec4 deriv = getDLdr(r, upperBound, scaledRadius) + getDLdx(r, upperBound, scaledRadius) - getDLdr(r, lowerBound, scaledRadius);
+    deriv -= blend(getDLdx(r, lowerBound, scaledRadius), 0.0f, fixedLowerBound);
+    return blend(0.0f, deriv, include & (overlap | inside));
+}
+
+ivec4 CpuGBVIForce::getNeighborMask(const int* blockAtom, int atomsInBlock, int blockSize, int firstPosition, int neighbor) const {
+    int neighborPosition = blockSize;
+    for (int i = 0; i < atomsInBlock; i++)
+        if (blockAtom[i] == neighbor) {
+            neighborPosition = i;
+            break;
+        }
+    int lastPosition = min(atomsInBlock, neighborPosition);
+    return ivec4(firstPosition, firstPosition+1, firstPosition+2, firstPosition+3) < ivec4(lastPosition);
+}
+
+void CpuGBVIForce::threadComputeNeighborBornSums(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    AlignedArray<float>& sums = threadBornSums[threadIndex];
+    for (int i = 0; i < numParticles; i++)
+        sums[i] = 0.0f;
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomRadius[4], atomScaledRadius[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomScaledRadius[i] = particleParams[atomIndex].second;
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 radiusI(atomRadius);
+            fvec4 scaledRadiusI(atomScaledRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 sum(0.0f);
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+                sum += computeVolume(r, radiusI, particleParams[atomJ].second, include);
+                sums[atomJ] += dot4(computeVolume(r, particleParams[atomJ].first, scaledRadiusI, include), one);
+            }
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++)
+                sums[blockAtom[group+i]] += sum[i];
+        }
+    }
+}
+
+double CpuGBVIForce::threadComputeNeighborBornEnergy(int threadIndex, float preFactor, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    float* forces = &(*threadForce)[threadIndex][0];
+    AlignedArray<float>& bornForces = threadBornForces[threadIndex];
+    double energy = 0.0;
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomCharge[4], atomRadius[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomCharge[i] = posq[4*atomIndex+3];
+                atomRadius[i] = bornRadii[atomIndex];
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 chargeI(atomCharge);
+            fvec4 partialChargeI = preFactor*chargeI;
+            fvec4 radii(atomRadius);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+
+            // Each atom's interaction with itself.
+
+            fvec4 selfEnergy = blend(0.0f, partialChargeI*chargeI/radii, getNeighborMask(blockAtom, atomsInBlock, blockSize, group, -1));
+            energy += 0.5f*dot4(selfEnergy, one);
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            fvec4 blockAtomBornForce = -0.5f*selfEnergy/radii;
+
+            // Interactions with neighbors.
+
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 alpha2_ij = radii*bornRadii[atomJ];
+                fvec4 D_ij = r2/(4.0f*alpha2_ij);
+                fvec4 expTerm(expf(-D_ij[0]), expf(-D_ij[1]), expf(-D_ij[2]), expf(-D_ij[3]));
+                fvec4 denominator2 = r2 + alpha2_ij*expTerm;
+                fvec4 denominator = sqrt(denominator2);
+                fvec4 Gpol = (partialChargeI*posJ[3])/denominator;
+                fvec4 dGpol_dr = -Gpol*(1.0f - 0.25f*expTerm)/denominator2;
+                fvec4 dGpol_dalpha2_ij = -0.5f*Gpol*expTerm*(1.0f + D_ij)/denominator2;
+                dGpol_dr = blend(0.0f, dGpol_dr, include);
+                dGpol_dalpha2_ij = blend(0.0f, dGpol_dalpha2_ij, include);
+                fvec4 fx = dx*dGpol_dr;
+                fvec4 fy = dy*dGpol_dr;
+                fvec4 fz = dz*dGpol_dr;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                blockAtomBornForce += dGpol_dalpha2_ij*bornRadii[atomJ];
+                float* atomForce = forces+4*atomJ;
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+                bornForces[atomJ] += dot4(dGpol_dalpha2_ij, radii);
+                energy += dot4(blend(0.0f, Gpol, include), one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++) {
+                int atomIndex = blockAtom[group+i];
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+                bornForces[atomIndex] += blockAtomBornForce[i];
+            }
+        }
+    }
+    return energy;
+}
+
+void CpuGBVIForce::threadComputeNeighborChainForces(int threadIndex, const fvec4& boxSize, const fvec4& invBoxSize) {
+    int numParticles = particleParams.size();
+    int blockSize = neighborList->getBlockSize();
+    float cutoff2 = cutoffDistance*cutoffDistance;
+    fvec4 one(1.0f);
+    float* forces = &(*threadForce)[threadIndex][0];
+    while (true) {
+        int blockIndex = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+        if (blockIndex >= neighborList->getNumBlocks())
+            break;
+        const int* blockAtom = &neighborList->getSortedAtoms()[blockSize*blockIndex];
+        int atomsInBlock = min(blockSize, numParticles-blockSize*blockIndex);
+        const vector<int>& neighbors = neighborList->getBlockNeighbors(blockIndex);
+        for (int group = 0; group < atomsInBlock; group += 4) {
+            float atomRadius[4], atomScaledRadius[4], atomBornForce[4], atomx[4], atomy[4], atomz[4];
+            for (int i = 0; i < 4; i++) {
+                int atomIndex = blockAtom[group+i];
+                atomRadius[i] = particleParams[atomIndex].first;
+                atomScaledRadius[i] = particleParams[atomIndex].second;
+                atomBornForce[i] = totalBornForces[atomIndex];
+                atomx[i] = posq[4*atomIndex];
+                atomy[i] = posq[4*atomIndex+1];
+                atomz[i] = posq[4*atomIndex+2];
+            }
+            fvec4 radiusI(atomRadius);
+            fvec4 scaledRadiusI(atomScaledRadius);
+            fvec4 bornForceI(atomBornForce);
+            fvec4 x(atomx);
+            fvec4 y(atomy);
+            fvec4 z(atomz);
+            fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int atomJ = neighbors[k];
+                fvec4 posJ(posq+4*atomJ);
+                fvec4 dx, dy, dz, r2;
+                getDeltaR(posJ, x, y, z, dx, dy, dz, r2, periodic, boxSize, invBoxSize);
+                ivec4 include = getNeighborMask(blockAtom, atomsInBlock, blockSize, group, atomJ) & (r2 < cutoff2);
+                if (!any(include))
+                    continue;
+                fvec4 r = sqrt(blend(1.0f, r2, include));
+
+                // Both atoms' Born radii depend on their separation.
+
+                fvec4 de = bornForceI*computeVolumeDerivative(r, radiusI, particleParams[atomJ].second, include);
+                de += totalBornForces[atomJ]*computeVolumeDerivative(r, particleParams[atomJ].first, scaledRadiusI, include);
+                de /= r;
+                fvec4 fx = dx*de;
+                fvec4 fy = dy*de;
+                fvec4 fz = dz*de;
+                blockAtomForceX -= fx;
+                blockAtomForceY -= fy;
+                blockAtomForceZ -= fz;
+                float* atomForce = forces+4*atomJ;
+                atomForce[0] += dot4(fx, one);
+                atomForce[1] += dot4(fy, one);
+                atomForce[2] += dot4(fz, one);
+            }
+            fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+            transpose(f[0], f[1], f[2], f[3]);
+            for (int i = 0; i < 4 && group+i < atomsInBlock; i++) {
+                int atomIndex = blockAtom[group+i];
+                (fvec4(forces+4*atomIndex)+f[i]).store(forces+4*atomIndex);
+            }
+        }
+    }
+}
+
+void CpuGBVIForce::getDeltaR(const fvec4& posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const {
+    dx = x-posI[0];
+    dy = y-posI[1];
+    dz = z-posI[2];
+    if (periodic) {
+        dx -= round(dx*invBoxSize[0])*boxSize[0];
+        dy -= round(dy*invBoxSize[1])*boxSize[1];
+        dz -= round(dz*invBoxSize[2])*boxSize[2];
+    }
+    r2 = dx*dx + dy*dy + dz*dz;
+}
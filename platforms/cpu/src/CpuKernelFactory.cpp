@@ -41,6 +41,8 @@ KernelImpl* CpuKernelFactory::createKernelImpl(std::string name, const Platform&
     CpuPlatform::PlatformData& data = CpuPlatform::getPlatformData(context);
     if (name == CalcForcesAndEnergyKernel::Name())
         return new CpuCalcForcesAndEnergyKernel(name, platform, data, context);
+    if (name == UpdateStateDataKernel::Name())
+        return new CpuUpdateStateDataKernel(name, platform, *reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData()), data);
     if (name == CalcPeriodicTorsionForceKernel::Name())
         return new CpuCalcPeriodicTorsionForceKernel(name, platform, data);
     if (name == CalcRBTorsionForceKernel::Name())
@@ -49,13 +51,31 @@ KernelImpl* CpuKernelFactory::createKernelImpl(std::string name, const Platform&
         return new CpuCalcNonbondedForceKernel(name, platform, data);
     if (name == CalcCustomNonbondedForceKernel::Name())
         return new CpuCalcCustomNonbondedForceKernel(name, platform, data);
+    if (name == CalcCustomExternalForceKernel::Name())
+        return new CpuCalcCustomExternalForceKernel(name, platform, data);
+    if (name == CalcCustomHbondForceKernel::Name())
+        return new CpuCalcCustomHbondForceKernel(name, platform, data);
+    if (name == CalcCustomCompoundBondForceKernel::Name())
+        return new CpuCalcCustomCompoundBondForceKernel(name, platform, data);
     if (name == CalcCustomManyParticleForceKernel::Name())
         return new CpuCalcCustomManyParticleForceKernel(name, platform, data);
     if (name == CalcGBSAOBCForceKernel::Name())
         return new CpuCalcGBSAOBCForceKernel(name, platform, data);
+    if (name == CalcGBVIForceKernel::Name())
+        return new CpuCalcGBVIForceKernel(name, platform, data);
     if (name == CalcCustomGBForceKernel::Name())
         return new CpuCalcCustomGBForceKernel(name, platform, data);
     if (name == IntegrateLangevinStepKernel::Name())
         return new CpuIntegrateLangevinStepKernel(name, platform, data);
+    if (name == IntegrateBrownianStepKernel::Name())
+        return new CpuIntegrateBrownianStepKernel(name, platform, data);
+    if (name == IntegrateVariableLangevinStepKernel::Name())
+        return new CpuIntegrateVariableLangevinStepKernel(name, platform, data);
+    if (name == IntegrateVariableVerletStepKernel::Name())
+        return new CpuIntegrateVariableVerletStepKernel(name, platform, data);
+    if (name == ApplyAndersenThermostatKernel::Name())
+        return new CpuApplyAndersenThermostatKernel(name, platform, data);
+    if (name == RemoveCMMotionKernel::Name())
+        return new CpuRemoveCMMotionKernel(name, platform, data);
     throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '") + name + "'").c_str());
 }
@@ -40,15 +40,19 @@
 #include "ReferenceTabulatedFunction.h"
 #include "openmm/Context.h"
 #include "openmm/OpenMMException.h"
+#include "openmm/internal/AndersenThermostatImpl.h"
 #include "openmm/internal/ContextImpl.h"
 #include "openmm/internal/CustomNonbondedForceImpl.h"
 #include "openmm/internal/NonbondedForceImpl.h"
+#include "openmm/internal/SplineFitter.h"
 #include "openmm/internal/vectorize.h"
 #include "RealVec.h"
 #include "lepton/CompiledExpression.h"
+#include "lepton/CompiledVectorExpression.h"
 #include "lepton/CustomFunction.h"
 #include "lepton/Parser.h"
 #include "lepton/ParsedExpression.h"
+#include <sstream>
 
 using namespace OpenMM;
 using namespace std;
@@ -143,6 +147,18 @@ public:
     CpuPlatform::PlatformData& data;
 };
 
+void CpuUpdateStateDataKernel::createCheckpoint(ContextImpl& context, ostream& stream) {
+    ReferenceUpdateStateDataKernel::createCheckpoint(context, stream);
+    data.random.createCheckpoint(stream);
+    data.thermostatRandom.createCheckpoint(stream);
+}
+
+void CpuUpdateStateDataKernel::loadCheckpoint(ContextImpl& context, istream& stream) {
+    ReferenceUpdateStateDataKernel::loadCheckpoint(context, stream);
+    data.random.loadCheckpoint(stream);
+    data.thermostatRandom.loadCheckpoint(stream);
+}
+
 class CpuCalcForcesAndEnergyKernel::InitForceTask : public ThreadPool::Task {
 public:
     InitForceTask(int numParticles, ContextImpl& context, CpuPlatform::PlatformData& data) : numParticles(numParticles), positionsValid(true), context(context), data(data) {
@@ -499,6 +515,10 @@ void CpuCalcNonbondedForceKernel::initialize(const System& system, const Nonbond
         dispersionCoefficient = 0.0;
     lastPositions.resize(numParticles, Vec3(1e10, 1e10, 1e10));
     data.isPeriodic = (nonbondedMethod == CutoffPeriodic || nonbondedMethod == Ewald || nonbondedMethod == PME);
+    if (nonbondedMethod != NoCutoff) {
+        neighborList->setExclusions(exclusions);
+        data.setSharedNeighborList(*neighborList, nonbondedCutoff, 1.15*nonbondedCutoff, lastPositions);
+    }
 }
 
 double CpuCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy, bool includeDirect, bool includeReciprocal) {
@@ -566,7 +586,7 @@ double CpuCalcNonbondedForceKernel::execute(ContextImpl& context, bool includeFo
                 }
         }
         if (needRecompute) {
-            neighborList->computeNeighborList(numParticles, posq, exclusions, boxVectors, data.isPeriodic, nonbondedCutoff+padding, data.threads);
+            neighborList->computeNeighborList(numParticles, posq, boxVectors, data.isPeriodic, nonbondedCutoff+padding, data.threads);
             lastPositions = posData;
         }
         nonbonded->setUseCutoff(nonbondedCutoff, *neighborList, rfDielectric);
@@ -655,7 +675,8 @@ void CpuCalcNonbondedForceKernel::copyParametersToContext(ContextImpl& context,
 }
 
 CpuCalcCustomNonbondedForceKernel::CpuCalcCustomNonbondedForceKernel(string name, const Platform& platform, CpuPlatform::PlatformData& data) :
-            CalcCustomNonbondedForceKernel(name, platform), data(data), forceCopy(NULL), neighborList(NULL), nonbonded(NULL) {
+            CalcCustomNonbondedForceKernel(name, platform), data(data), tableTolerance(0), tablesNeedUpdate(false), forceCopy(NULL),
+            neighborList(NULL), nonbonded(NULL) {
 }
 
 CpuCalcCustomNonbondedForceKernel::~CpuCalcCustomNonbondedForceKernel() {
@@ -716,8 +737,17 @@ void CpuCalcCustomNonbondedForceKernel::initialize(const System& system, const C
     // Parse the various expressions used to calculate the force.
 
     Lepton::ParsedExpression expression = Lepton::Parser::parse(force.getEnergyFunction(), functions).optimize();
-    Lepton::CompiledExpression energyExpression = expression.createCompiledExpression();
-    Lepton::CompiledExpression forceExpression = expression.differentiate("r").createCompiledExpression();
+    vector<Lepton::ParsedExpression> energyAndForce;
+    energyAndForce.push_back(expression);
+    energyAndForce.push_back(expression.differentiate("r").optimize());
+    Lepton::CompiledVectorExpression energyForceExpression(energyAndForce, 4);
+    stringstream(data.propertyValues[CpuPlatform::CpuCustomNonbondedTableTolerance()]) >> tableTolerance;
+    if (tableTolerance > 0 && nonbondedMethod != NoCutoff) {
+        tableExpression = Lepton::CompiledExpression(energyAndForce);
+        tablesNeedUpdate = true;
+    }
+    else
+        tableTolerance = 0;
     for (int i = 0; i < numParameters; i++)
         parameterNames.push_back(force.getPerParticleParameterName(i));
     for (int i = 0; i < force.getNumGlobalParameters(); i++) {
@@ -749,9 +779,11 @@ void CpuCalcCustomNonbondedForceKernel::initialize(const System& system, const C
         interactionGroups.push_back(make_pair(set1, set2));
     }
     data.isPeriodic = (nonbondedMethod == CutoffPeriodic);
-    nonbonded = new CpuCustomNonbondedForce(energyExpression, forceExpression, parameterNames, exclusions, data.threads);
+    nonbonded = new CpuCustomNonbondedForce(energyForceExpression, parameterNames, exclusions, data.threads);
     if (interactionGroups.size() > 0)
         nonbonded->setInteractionGroups(interactionGroups);
+    if (neighborList != NULL)
+        neighborList->setExclusions(exclusions);
 }
 
 double CpuCalcCustomNonbondedForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
@@ -761,7 +793,7 @@ double CpuCalcCustomNonbondedForceKernel::execute(ContextImpl& context, bool inc
     double energy = 0;
     bool periodic = (nonbondedMethod == CutoffPeriodic);
     if (nonbondedMethod != NoCutoff) {
-        neighborList->computeNeighborList(numParticles, data.posq, exclusions, boxVectors, data.isPeriodic, nonbondedCutoff, data.threads);
+        neighborList->computeNeighborList(numParticles, data.posq, boxVectors, data.isPeriodic, nonbondedCutoff, data.threads);
         nonbonded->setUseCutoff(nonbondedCutoff, *neighborList);
     }
     if (periodic) {
@@ -777,6 +809,8 @@ double CpuCalcCustomNonbondedForceKernel::execute(ContextImpl& context, bool inc
             globalParamsChanged = true;
         globalParamValues[globalParameterNames[i]] = value;
     }
+    if (tableTolerance > 0 && (tablesNeedUpdate || globalParamsChanged))
+        createTables();
     if (useSwitchingFunction)
         nonbonded->setUseSwitchingFunction(switchingDistance);
     nonbonded->calculatePairIxn(numParticles, &data.posq[0], posData, particleParamArray, 0, globalParamValues, data.threadForce, includeForces, includeEnergy, energy);
@@ -806,6 +840,8 @@ void CpuCalcCustomNonbondedForceKernel::copyParametersToContext(ContextImpl& con
             particleParamArray[i][j] = parameters[j];
     }
     
+    tablesNeedUpdate = (tableTolerance > 0);
+    
     // If necessary, recompute the long range correction.
     
     if (forceCopy != NULL) {
@@ -815,7 +851,121 @@ void CpuCalcCustomNonbondedForceKernel::copyParametersToContext(ContextImpl& con
     }
 }
 
+// Tables start at this fraction of the cutoff distance.  Closer interactions are computed from the expression.
+static const double TableStartFraction = 0.1;
+static const int MaxTableClasses = 32;
+static const int MaxTableIntervals = 16384;
+
+void CpuCalcCustomNonbondedForceKernel::createTables() {
+    tablesNeedUpdate = false;
+    
+    // Identify the classes of particles.
+    
+    int numParameters = parameterNames.size();
+    vector<int> particleClass(numParticles);
+    vector<vector<double> > classParams;
+    map<vector<double>, int> classIndex;
+    for (int i = 0; i < numParticles; i++) {
+        vector<double> params(particleParamArray[i], particleParamArray[i]+numParameters);
+        map<vector<double>, int>::const_iterator index = classIndex.find(params);
+        if (index == classIndex.end()) {
+            particleClass[i] = classParams.size();
+            classIndex[params] = classParams.size();
+            classParams.push_back(params);
+        }
+        else
+            particleClass[i] = index->second;
+    }
+    
+    // Build the tables.  If there are too many classes or any table fails to reach the requested
+    // accuracy, all interactions are computed from the expression instead.
+    
+    int numClasses = classParams.size();
+    vector<vector<float> > tables;
+    vector<float> spacing;
+    if (numClasses <= MaxTableClasses) {
+        tables.resize(numClasses*numClasses);
+        spacing.resize(numClasses*numClasses);
+        for (int i = 0; i < numClasses*numClasses; i++) {
+            if (!createTable(classParams[i/numClasses], classParams[i%numClasses], tables[i], spacing[i])) {
+                tables.clear();
+                spacing.clear();
+                break;
+            }
+        }
+    }
+    nonbonded->setTables(particleClass, numClasses, tables, spacing, (float) (TableStartFraction*nonbondedCutoff));
+}
+
+bool CpuCalcCustomNonbondedForceKernel::createTable(const vector<double>& params1, const vector<double>& params2, vector<float>& table, float& spacing) {
+    // Set the values of the variables.
+    
+    const set<string>& variables = tableExpression.getVariables();
+    for (int i = 0; i < (int) parameterNames.size(); i++) {
+        if (variables.find(parameterNames[i]+"1") != variables.end())
+            tableExpression.getVariableReference(parameterNames[i]+"1") = params1[i];
+        if (variables.find(parameterNames[i]+"2") != variables.end())
+            tableExpression.getVariableReference(parameterNames[i]+"2") = params2[i];
+    }
+    for (map<string, double>::const_iterator iter = globalParamValues.begin(); iter != globalParamValues.end(); ++iter)
+        if (variables.find(iter->first) != variables.end())
+            tableExpression.getVariableReference(iter->first) = iter->second;
+    double unusedR;
+    double& r = (variables.find("r") == variables.end() ? unusedR : tableExpression.getVariableReference("r"));
+    
+    // Keep doubling the number of points until the error at the middle of every interval is small enough.
+    
+    double minR = TableStartFraction*nonbondedCutoff;
+    for (int numIntervals = 64; numIntervals <= MaxTableIntervals; numIntervals *= 2) {
+        double h = (nonbondedCutoff-minR)/numIntervals;
+        vector<double> x(numIntervals+1), energy(numIntervals+1), dEdR(numIntervals+1);
+        for (int i = 0; i <= numIntervals; i++) {
+            x[i] = minR+i*h;
+            r = x[i];
+            tableExpression.evaluate();
+            energy[i] = tableExpression.getOutput(0);
+            dEdR[i] = tableExpression.getOutput(1);
+        }
+        vector<double> energyDeriv, dEdRDeriv;
+        SplineFitter::createNaturalSpline(x, energy, energyDeriv);
+        SplineFitter::createNaturalSpline(x, dEdR, dEdRDeriv);
+        
+        // Convert each interval of the splines to a cubic polynomial in the fractional position t within it.
+        
+        table.resize(8*numIntervals);
+        for (int i = 0; i < numIntervals; i++) {
+            for (int j = 0; j < 2; j++) {
+                const vector<double>& y = (j == 0 ? energy : dEdR);
+                const vector<double>& deriv = (j == 0 ? energyDeriv : dEdRDeriv);
+                table[8*i+4*j] = (float) y[i];
+                table[8*i+4*j+1] = (float) (y[i+1]-y[i]-h*h*(2*deriv[i]+deriv[i+1])/6);
+                table[8*i+4*j+2] = (float) (h*h*deriv[i]/2);
+                table[8*i+4*j+3] = (float) (h*h*(deriv[i+1]-deriv[i])/6);
+            }
+        }
+        bool accurate = true;
+        for (int i = 0; i < numIntervals && accurate; i++) {
+            r = x[i]+0.5*h;
+            tableExpression.evaluate();
+            for (int j = 0; j < 2; j++) {
+                const float* c = &table[8*i+4*j];
+                double interpolated = c[0]+0.5*(c[1]+0.5*(c[2]+0.5*c[3]));
+                double exact = tableExpression.getOutput(j);
+                if (!(fabs(interpolated-exact) <= tableTolerance*max(1.0, fabs(exact))))
+                    accurate = false;
+            }
+        }
+        if (accurate) {
+            spacing = (float) h;
+            return true;
+        }
+    }
+    return false;
+}
+
 CpuCalcGBSAOBCForceKernel::~CpuCalcGBSAOBCForceKernel() {
+    if (neighborList != NULL)
+        delete neighborList;
 }
 
 void CpuCalcGBSAOBCForceKernel::initialize(const System& system, const GBSAOBCForce& force) {
@@ -832,8 +982,11 @@ void CpuCalcGBSAOBCForceKernel::initialize(const System& system, const GBSAOBCFo
     obc.setSolventDielectric((float) force.getSolventDielectric());
     obc.setSoluteDielectric((float) force.getSoluteDielectric());
     obc.setSurfaceAreaEnergy((float) force.getSurfaceAreaEnergy());
-    if (force.getNonbondedMethod() != GBSAOBCForce::NoCutoff)
-        obc.setUseCutoff((float) force.getCutoffDistance());
+    cutoffDistance = force.getCutoffDistance();
+    if (force.getNonbondedMethod() != GBSAOBCForce::NoCutoff) {
+        neighborList = new CpuNeighborList(4);
+        neighborList->setExclusions(vector<set<int> >(numParticles));
+    }
     data.isPeriodic = (force.getNonbondedMethod() == GBSAOBCForce::CutoffPeriodic);
 }
 
@@ -843,6 +996,17 @@ double CpuCalcGBSAOBCForceKernel::execute(ContextImpl& context, bool includeForc
         float floatBoxSize[3] = {(float) boxSize[0], (float) boxSize[1], (float) boxSize[2]};
         obc.setPeriodic(floatBoxSize);
     }
+    if (neighborList != NULL) {
+        // Use the NonbondedForce's neighbor list if it has the same cutoff and is still valid.  Otherwise
+        // build our own.
+
+        const CpuNeighborList* neighbors = data.getSharedNeighborList(cutoffDistance, extractPositions(context));
+        if (neighbors == NULL) {
+            neighborList->computeNeighborList(particleParams.size(), data.posq, extractBoxVectors(context), data.isPeriodic, cutoffDistance, data.threads);
+            neighbors = neighborList;
+        }
+        obc.setUseCutoff((float) cutoffDistance, *neighbors);
+    }
     double energy = 0.0;
     obc.computeForce(data.posq, data.threadForce, includeEnergy ? &energy : NULL, data.threads);
     return energy;
@@ -865,6 +1029,57 @@ void CpuCalcGBSAOBCForceKernel::copyParametersToContext(ContextImpl& context, co
     obc.setParticleParameters(particleParams);
 }
 
+CpuCalcGBVIForceKernel::~CpuCalcGBVIForceKernel() {
+    if (neighborList != NULL)
+        delete neighborList;
+}
+
+void CpuCalcGBVIForceKernel::initialize(const System& system, const GBVIForce& force, const vector<double>& scaledRadii) {
+    int numParticles = system.getNumParticles();
+    vector<pair<float, float> > particleParams(numParticles);
+    vector<float> gammas(numParticles);
+    for (int i = 0; i < numParticles; ++i) {
+        double charge, radius, gamma;
+        force.getParticleParameters(i, charge, radius, gamma);
+        data.posq[4*i+3] = (float) charge;
+        particleParams[i] = make_pair((float) radius, (float) scaledRadii[i]);
+        gammas[i] = (float) gamma;
+    }
+    gbvi.setParticleParameters(particleParams, gammas);
+    gbvi.setSolventDielectric((float) force.getSolventDielectric());
+    gbvi.setSoluteDielectric((float) force.getSoluteDielectric());
+    gbvi.setBornRadiusScaling(force.getBornRadiusScalingMethod() == GBVIForce::QuinticSpline,
+            (float) force.getQuinticLowerLimitFactor(), (float) force.getQuinticUpperBornRadiusLimit());
+    cutoffDistance = force.getCutoffDistance();
+    if (force.getNonbondedMethod() != GBVIForce::NoCutoff) {
+        neighborList = new CpuNeighborList(4);
+        neighborList->setExclusions(vector<set<int> >(numParticles));
+    }
+    data.isPeriodic = (force.getNonbondedMethod() == GBVIForce::CutoffPeriodic);
+}
+
+double CpuCalcGBVIForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    if (data.isPeriodic) {
+        RealVec& boxSize = extractBoxSize(context);
+        float floatBoxSize[3] = {(float) boxSize[0], (float) boxSize[1], (float) boxSize[2]};
+        gbvi.setPeriodic(floatBoxSize);
+    }
+    if (neighborList != NULL) {
+        // Use the NonbondedForce's neighbor list if it has the same cutoff and is still valid.  Otherwise
+        // build our own.
+
+        const CpuNeighborList* neighbors = data.getSharedNeighborList(cutoffDistance, extractPositions(context));
+        if (neighbors == NULL) {
+            neighborList->computeNeighborList(gbvi.getParticleParameters().size(), data.posq, extractBoxVectors(context), data.isPeriodic, cutoffDistance, data.threads);
+            neighbors = neighborList;
+        }
+        gbvi.setUseCutoff((float) cutoffDistance, *neighbors);
+    }
+    double energy = 0.0;
+    gbvi.computeForce(data.posq, data.threadForce, includeEnergy ? &energy : NULL, data.threads);
+    return energy;
+}
+
 CpuCalcCustomGBForceKernel::~CpuCalcCustomGBForceKernel() {
     if (particleParamArray != NULL) {
         for (int i = 0; i < numParticles; i++)
@@ -956,31 +1171,32 @@ void CpuCalcCustomGBForceKernel::initialize(const System& system, const CustomGB
         }
     }
 
-    // Parse the expressions for energy terms.
+    // Parse the expressions for energy terms.  Each one is compiled together with its derivatives, so that
+    // subexpressions they have in common are only computed once.
 
-    vector<vector<Lepton::CompiledExpression> > energyDerivExpressions(force.getNumEnergyTerms());
-    vector<vector<Lepton::CompiledExpression> > energyGradientExpressions(force.getNumEnergyTerms());
     for (int i = 0; i < force.getNumEnergyTerms(); i++) {
         string expression;
         CustomGBForce::ComputationType type;
         force.getEnergyTermParameters(i, expression, type);
         Lepton::ParsedExpression ex = Lepton::Parser::parse(expression, functions).optimize();
-        energyExpressions.push_back(ex.createCompiledExpression());
+        vector<Lepton::ParsedExpression> outputs;
+        outputs.push_back(ex);
         energyTypes.push_back(type);
-        if (type != CustomGBForce::SingleParticle)
-            energyDerivExpressions[i].push_back(ex.differentiate("r").createCompiledExpression());
-        for (int j = 0; j < force.getNumComputedValues(); j++) {
-            if (type == CustomGBForce::SingleParticle) {
-                energyDerivExpressions[i].push_back(ex.differentiate(valueNames[j]).createCompiledExpression());
-                energyGradientExpressions[i].push_back(ex.differentiate("x").createCompiledExpression());
-                energyGradientExpressions[i].push_back(ex.differentiate("y").createCompiledExpression());
-                energyGradientExpressions[i].push_back(ex.differentiate("z").createCompiledExpression());
-            }
-            else {
-                energyDerivExpressions[i].push_back(ex.differentiate(valueNames[j]+"1").createCompiledExpression());
-                energyDerivExpressions[i].push_back(ex.differentiate(valueNames[j]+"2").createCompiledExpression());
+        if (type == CustomGBForce::SingleParticle) {
+            for (int j = 0; j < force.getNumComputedValues(); j++)
+                outputs.push_back(ex.differentiate(valueNames[j]).optimize());
+            outputs.push_back(ex.differentiate("x").optimize());
+            outputs.push_back(ex.differentiate("y").optimize());
+            outputs.push_back(ex.differentiate("z").optimize());
+        }
+        else {
+            outputs.push_back(ex.differentiate("r").optimize());
+            for (int j = 0; j < force.getNumComputedValues(); j++) {
+                outputs.push_back(ex.differentiate(valueNames[j]+"1").optimize());
+                outputs.push_back(ex.differentiate(valueNames[j]+"2").optimize());
             }
         }
+        energyExpressions.push_back(Lepton::CompiledExpression(outputs));
     }
 
     // Delete the custom functions.
@@ -988,8 +1204,10 @@ void CpuCalcCustomGBForceKernel::initialize(const System& system, const CustomGB
     for (map<string, Lepton::CustomFunction*>::iterator iter = functions.begin(); iter != functions.end(); iter++)
         delete iter->second;
     ixn = new CpuCustomGBForce(numParticles, exclusions, valueExpressions, valueDerivExpressions, valueGradientExpressions, valueNames, valueTypes, energyExpressions,
-        energyDerivExpressions, energyGradientExpressions, energyTypes, particleParameterNames, data.threads);
+        energyTypes, particleParameterNames, data.threads);
     data.isPeriodic = (force.getNonbondedMethod() == CustomGBForce::CutoffPeriodic);
+    if (neighborList != NULL)
+        neighborList->setExclusions(exclusions);
 }
 
 double CpuCalcCustomGBForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
@@ -999,8 +1217,7 @@ double CpuCalcCustomGBForceKernel::execute(ContextImpl& context, bool includeFor
     if (data.isPeriodic)
         ixn->setPeriodic(extractBoxSize(context));
     if (nonbondedMethod != NoCutoff) {
-        vector<set<int> > noExclusions(numParticles);
-        neighborList->computeNeighborList(numParticles, data.posq, exclusions, boxVectors, data.isPeriodic, nonbondedCutoff, data.threads);
+        neighborList->computeNeighborList(numParticles, data.posq, boxVectors, data.isPeriodic, nonbondedCutoff, data.threads);
         ixn->setUseCutoff(nonbondedCutoff, *neighborList);
     }
     map<string, double> globalParameters;
@@ -1026,6 +1243,224 @@ void CpuCalcCustomGBForceKernel::copyParametersToContext(ContextImpl& context, c
     }
 }
 
+CpuCalcCustomExternalForceKernel::~CpuCalcCustomExternalForceKernel() {
+    if (particleParamArray != NULL) {
+        for (int i = 0; i < numParticles; i++)
+            delete[] particleParamArray[i];
+        delete[] particleParamArray;
+    }
+    if (ixn != NULL)
+        delete ixn;
+}
+
+void CpuCalcCustomExternalForceKernel::initialize(const System& system, const CustomExternalForce& force) {
+    numParticles = force.getNumParticles();
+    int numParameters = force.getNumPerParticleParameters();
+
+    // Build the arrays.
+
+    particleParamArray = new RealOpenMM*[numParticles];
+    for (int i = 0; i < numParticles; i++) {
+        int particle;
+        vector<double> parameters;
+        force.getParticleParameters(i, particle, parameters);
+        particleParamArray[i] = new RealOpenMM[numParameters];
+        for (int j = 0; j < numParameters; j++)
+            particleParamArray[i][j] = (RealOpenMM) parameters[j];
+    }
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        globalParameterNames.push_back(force.getGlobalParameterName(i));
+    ixn = new CpuCustomExternalForce(force, system.getNumParticles(), data.threads);
+}
+
+double CpuCalcCustomExternalForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    map<string, double> globalParameters;
+    for (int i = 0; i < (int) globalParameterNames.size(); i++)
+        globalParameters[globalParameterNames[i]] = context.getParameter(globalParameterNames[i]);
+    ixn->calculateIxn(posData, particleParamArray, globalParameters, forceData, includeEnergy ? &energy : NULL);
+    return energy;
+}
+
+void CpuCalcCustomExternalForceKernel::copyParametersToContext(ContextImpl& context, const CustomExternalForce& force) {
+    if (numParticles != force.getNumParticles())
+        throw OpenMMException("updateParametersInContext: The number of particles has changed");
+
+    // Record the values.
+
+    int numParameters = force.getNumPerParticleParameters();
+    const vector<int>& particles = ixn->getParticles();
+    for (int i = 0; i < numParticles; ++i) {
+        int particle;
+        vector<double> parameters;
+        force.getParticleParameters(i, particle, parameters);
+        if (particle != particles[i])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+        for (int j = 0; j < numParameters; j++)
+            particleParamArray[i][j] = static_cast<RealOpenMM>(parameters[j]);
+    }
+    ixn->parametersChanged();
+}
+
+CpuCalcCustomHbondForceKernel::~CpuCalcCustomHbondForceKernel() {
+    if (donorParamArray != NULL) {
+        for (int i = 0; i < numDonors; i++)
+            delete[] donorParamArray[i];
+        delete[] donorParamArray;
+    }
+    if (acceptorParamArray != NULL) {
+        for (int i = 0; i < numAcceptors; i++)
+            delete[] acceptorParamArray[i];
+        delete[] acceptorParamArray;
+    }
+    if (ixn != NULL)
+        delete ixn;
+}
+
+void CpuCalcCustomHbondForceKernel::initialize(const System& system, const CustomHbondForce& force) {
+
+    // Build the arrays.
+
+    numDonors = force.getNumDonors();
+    numAcceptors = force.getNumAcceptors();
+    int numDonorParameters = force.getNumPerDonorParameters();
+    donorParamArray = new double*[numDonors];
+    for (int i = 0; i < numDonors; i++) {
+        vector<double> parameters;
+        int d1, d2, d3;
+        force.getDonorParameters(i, d1, d2, d3, parameters);
+        donorParamArray[i] = new double[numDonorParameters];
+        for (int j = 0; j < numDonorParameters; j++)
+            donorParamArray[i][j] = parameters[j];
+    }
+    int numAcceptorParameters = force.getNumPerAcceptorParameters();
+    acceptorParamArray = new double*[numAcceptors];
+    for (int i = 0; i < numAcceptors; i++) {
+        vector<double> parameters;
+        int a1, a2, a3;
+        force.getAcceptorParameters(i, a1, a2, a3, parameters);
+        acceptorParamArray[i] = new double[numAcceptorParameters];
+        for (int j = 0; j < numAcceptorParameters; j++)
+            acceptorParamArray[i][j] = parameters[j];
+    }
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        globalParameterNames.push_back(force.getGlobalParameterName(i));
+    ixn = new CpuCustomHbondForce(force, data.threads);
+    nonbondedMethod = CalcCustomHbondForceKernel::NonbondedMethod(force.getNonbondedMethod());
+    cutoffDistance = force.getCutoffDistance();
+    data.isPeriodic = (nonbondedMethod == CutoffPeriodic);
+}
+
+double CpuCalcCustomHbondForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    map<string, double> globalParameters;
+    for (int i = 0; i < (int) globalParameterNames.size(); i++)
+        globalParameters[globalParameterNames[i]] = context.getParameter(globalParameterNames[i]);
+    if (nonbondedMethod == CutoffPeriodic) {
+        RealVec* boxVectors = extractBoxVectors(context);
+        double minAllowedSize = 2*cutoffDistance;
+        if (boxVectors[0][0] < minAllowedSize || boxVectors[1][1] < minAllowedSize || boxVectors[2][2] < minAllowedSize)
+            throw OpenMMException("The periodic box size has decreased to less than twice the nonbonded cutoff.");
+        ixn->setPeriodic(boxVectors);
+    }
+    double energy = 0;
+    ixn->calculateIxn(data.posq, donorParamArray, acceptorParamArray, globalParameters, data.threadForce, includeForces, includeEnergy, energy);
+    return energy;
+}
+
+void CpuCalcCustomHbondForceKernel::copyParametersToContext(ContextImpl& context, const CustomHbondForce& force) {
+    if (numDonors != force.getNumDonors())
+        throw OpenMMException("updateParametersInContext: The number of donors has changed");
+    if (numAcceptors != force.getNumAcceptors())
+        throw OpenMMException("updateParametersInContext: The number of acceptors has changed");
+
+    // Record the values.
+
+    vector<double> parameters;
+    int numDonorParameters = force.getNumPerDonorParameters();
+    const vector<vector<int> >& donorAtoms = ixn->getDonorAtoms();
+    for (int i = 0; i < numDonors; ++i) {
+        int d1, d2, d3;
+        force.getDonorParameters(i, d1, d2, d3, parameters);
+        if (d1 != donorAtoms[i][0] || d2 != donorAtoms[i][1] || d3 != donorAtoms[i][2])
+            throw OpenMMException("updateParametersInContext: The set of particles in a donor group has changed");
+        for (int j = 0; j < numDonorParameters; j++)
+            donorParamArray[i][j] = static_cast<RealOpenMM>(parameters[j]);
+    }
+    int numAcceptorParameters = force.getNumPerAcceptorParameters();
+    const vector<vector<int> >& acceptorAtoms = ixn->getAcceptorAtoms();
+    for (int i = 0; i < numAcceptors; ++i) {
+        int a1, a2, a3;
+        force.getAcceptorParameters(i, a1, a2, a3, parameters);
+        if (a1 != acceptorAtoms[i][0] || a2 != acceptorAtoms[i][1] || a3 != acceptorAtoms[i][2])
+            throw OpenMMException("updateParametersInContext: The set of particles in an acceptor group has changed");
+        for (int j = 0; j < numAcceptorParameters; j++)
+            acceptorParamArray[i][j] = static_cast<RealOpenMM>(parameters[j]);
+    }
+}
+
+CpuCalcCustomCompoundBondForceKernel::~CpuCalcCustomCompoundBondForceKernel() {
+    if (bondParamArray != NULL) {
+        for (int i = 0; i < numBonds; i++)
+            delete[] bondParamArray[i];
+        delete[] bondParamArray;
+    }
+    if (ixn != NULL)
+        delete ixn;
+}
+
+void CpuCalcCustomCompoundBondForceKernel::initialize(const System& system, const CustomCompoundBondForce& force) {
+
+    // Build the arrays.
+
+    numBonds = force.getNumBonds();
+    int numBondParameters = force.getNumPerBondParameters();
+    bondParamArray = new RealOpenMM*[numBonds];
+    for (int i = 0; i < numBonds; i++) {
+        vector<int> particles;
+        vector<double> parameters;
+        force.getBondParameters(i, particles, parameters);
+        bondParamArray[i] = new RealOpenMM[numBondParameters];
+        for (int j = 0; j < numBondParameters; j++)
+            bondParamArray[i][j] = static_cast<RealOpenMM>(parameters[j]);
+    }
+    for (int i = 0; i < force.getNumGlobalParameters(); i++)
+        globalParameterNames.push_back(force.getGlobalParameterName(i));
+    ixn = new CpuCustomCompoundBondForce(force, system.getNumParticles(), data.threads);
+}
+
+double CpuCalcCustomCompoundBondForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    map<string, double> globalParameters;
+    for (int i = 0; i < (int) globalParameterNames.size(); i++)
+        globalParameters[globalParameterNames[i]] = context.getParameter(globalParameterNames[i]);
+    ixn->calculateIxn(posData, bondParamArray, globalParameters, forceData, includeEnergy ? &energy : NULL);
+    return energy;
+}
+
+void CpuCalcCustomCompoundBondForceKernel::copyParametersToContext(ContextImpl& context, const CustomCompoundBondForce& force) {
+    if (numBonds != force.getNumBonds())
+        throw OpenMMException("updateParametersInContext: The number of bonds has changed");
+
+    // Record the values.
+
+    int numParameters = force.getNumPerBondParameters();
+    const vector<vector<int> >& bondAtoms = ixn->getBondAtoms();
+    vector<int> particles;
+    vector<double> params;
+    for (int i = 0; i < numBonds; ++i) {
+        force.getBondParameters(i, particles, params);
+        for (int j = 0; j < (int) particles.size(); j++)
+            if (particles[j] != bondAtoms[i][j])
+                throw OpenMMException("updateParametersInContext: The set of particles in a bond has changed");
+        for (int j = 0; j < numParameters; j++)
+            bondParamArray[i][j] = (RealOpenMM) params[j];
+    }
+}
+
 CpuCalcCustomManyParticleForceKernel::~CpuCalcCustomManyParticleForceKernel() {
     if (particleParamArray != NULL) {
         for (int i = 0; i < numParticles; i++)
@@ -1134,3 +1569,239 @@ void CpuIntegrateLangevinStepKernel::execute(ContextImpl& context, const Langevi
 double CpuIntegrateLangevinStepKernel::computeKineticEnergy(ContextImpl& context, const LangevinIntegrator& integrator) {
     return computeShiftedKineticEnergy(context, masses, 0.5*integrator.getStepSize());
 }
+
+CpuIntegrateBrownianStepKernel::~CpuIntegrateBrownianStepKernel() {
+    if (dynamics)
+        delete dynamics;
+}
+
+void CpuIntegrateBrownianStepKernel::initialize(const System& system, const BrownianIntegrator& integrator) {
+    int numParticles = system.getNumParticles();
+    masses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i)
+        masses[i] = static_cast<RealOpenMM>(system.getParticleMass(i));
+    data.random.initialize(integrator.getRandomNumberSeed(), data.threads.getNumThreads());
+}
+
+void CpuIntegrateBrownianStepKernel::execute(ContextImpl& context, const BrownianIntegrator& integrator) {
+    double temperature = integrator.getTemperature();
+    double friction = integrator.getFriction();
+    double stepSize = integrator.getStepSize();
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& velData = extractVelocities(context);
+    vector<RealVec>& forceData = extractForces(context);
+    if (dynamics == 0 || temperature != prevTemp || friction != prevFriction || stepSize != prevStepSize) {
+        // Recreate the computation objects with the new parameters.
+        
+        if (dynamics)
+            delete dynamics;
+        dynamics = new CpuBrownianDynamics(context.getSystem().getNumParticles(), stepSize, friction, temperature, data.threads, data.random);
+        dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
+        prevTemp = temperature;
+        prevFriction = friction;
+        prevStepSize = stepSize;
+    }
+    dynamics->update(context.getSystem(), posData, velData, forceData, masses, integrator.getConstraintTolerance());
+    ReferencePlatform::PlatformData* refData = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    refData->time += stepSize;
+    refData->stepCount++;
+}
+
+double CpuIntegrateBrownianStepKernel::computeKineticEnergy(ContextImpl& context, const BrownianIntegrator& integrator) {
+    return computeShiftedKineticEnergy(context, masses, 0);
+}
+
+CpuIntegrateVariableLangevinStepKernel::~CpuIntegrateVariableLangevinStepKernel() {
+    if (dynamics)
+        delete dynamics;
+}
+
+void CpuIntegrateVariableLangevinStepKernel::initialize(const System& system, const VariableLangevinIntegrator& integrator) {
+    int numParticles = system.getNumParticles();
+    masses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i)
+        masses[i] = static_cast<RealOpenMM>(system.getParticleMass(i));
+    data.random.initialize(integrator.getRandomNumberSeed(), data.threads.getNumThreads());
+}
+
+double CpuIntegrateVariableLangevinStepKernel::execute(ContextImpl& context, const VariableLangevinIntegrator& integrator, double maxTime) {
+    double temperature = integrator.getTemperature();
+    double friction = integrator.getFriction();
+    double errorTol = integrator.getErrorTolerance();
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& velData = extractVelocities(context);
+    vector<RealVec>& forceData = extractForces(context);
+    if (dynamics == 0 || temperature != prevTemp || friction != prevFriction || errorTol != prevErrorTol) {
+        // Recreate the computation objects with the new parameters.
+
+        if (dynamics)
+            delete dynamics;
+        RealOpenMM tau = (friction == 0.0 ? 0.0 : 1.0/friction);
+        dynamics = new CpuVariableLangevinDynamics(context.getSystem().getNumParticles(), tau, temperature, errorTol, data.threads, data.random);
+        dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
+        prevTemp = temperature;
+        prevFriction = friction;
+        prevErrorTol = errorTol;
+    }
+    ReferencePlatform::PlatformData* refData = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    RealOpenMM maxStepSize = (RealOpenMM) (maxTime-refData->time);
+    dynamics->update(context.getSystem(), posData, velData, forceData, masses, maxStepSize, integrator.getConstraintTolerance());
+    refData->time += dynamics->getDeltaT();
+    if (dynamics->getDeltaT() == maxStepSize)
+        refData->time = maxTime; // Avoid round-off error
+    refData->stepCount++;
+    return dynamics->getDeltaT();
+}
+
+double CpuIntegrateVariableLangevinStepKernel::computeKineticEnergy(ContextImpl& context, const VariableLangevinIntegrator& integrator) {
+    return computeShiftedKineticEnergy(context, masses, 0.5*integrator.getStepSize());
+}
+
+CpuIntegrateVariableVerletStepKernel::~CpuIntegrateVariableVerletStepKernel() {
+    if (dynamics)
+        delete dynamics;
+}
+
+void CpuIntegrateVariableVerletStepKernel::initialize(const System& system, const VariableVerletIntegrator& integrator) {
+    int numParticles = system.getNumParticles();
+    masses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i)
+        masses[i] = static_cast<RealOpenMM>(system.getParticleMass(i));
+}
+
+double CpuIntegrateVariableVerletStepKernel::execute(ContextImpl& context, const VariableVerletIntegrator& integrator, double maxTime) {
+    double errorTol = integrator.getErrorTolerance();
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& velData = extractVelocities(context);
+    vector<RealVec>& forceData = extractForces(context);
+    if (dynamics == 0 || errorTol != prevErrorTol) {
+        // Recreate the computation objects with the new parameters.
+
+        if (dynamics)
+            delete dynamics;
+        dynamics = new CpuVariableVerletDynamics(context.getSystem().getNumParticles(), errorTol, data.threads);
+        dynamics->setReferenceConstraintAlgorithm(&extractConstraints(context));
+        prevErrorTol = errorTol;
+    }
+    ReferencePlatform::PlatformData* refData = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    RealOpenMM maxStepSize = (RealOpenMM) (maxTime-refData->time);
+    dynamics->update(context.getSystem(), posData, velData, forceData, masses, maxStepSize, integrator.getConstraintTolerance());
+    refData->time += dynamics->getDeltaT();
+    if (dynamics->getDeltaT() == maxStepSize)
+        refData->time = maxTime; // Avoid round-off error
+    refData->stepCount++;
+    return dynamics->getDeltaT();
+}
+
+double CpuIntegrateVariableVerletStepKernel::computeKineticEnergy(ContextImpl& context, const VariableVerletIntegrator& integrator) {
+    return computeShiftedKineticEnergy(context, masses, 0.5*integrator.getStepSize());
+}
+
+class CpuApplyAndersenThermostatKernel::ApplyThermostatTask : public ThreadPool::Task {
+public:
+    ApplyThermostatTask(vector<RealVec>& velData, CpuApplyAndersenThermostatKernel& owner, RealOpenMM temperature, RealOpenMM collisionProbability) :
+            velData(velData), owner(owner), temperature(temperature), collisionProbability(collisionProbability) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        // Each thread processes a contiguous block of particle groups, drawing from its own random stream.
+
+        vector<vector<int> >& groups = owner.particleGroups;
+        int numGroups = groups.size();
+        int start = threadIndex*numGroups/threads.getNumThreads();
+        int end = (threadIndex+1)*numGroups/threads.getNumThreads();
+        for (int i = start; i < end; i++) {
+            if (owner.data.thermostatRandom.getUniformRandom(threadIndex) < collisionProbability) {
+                // A collision occurred, so set the velocities to new values chosen from a Boltzmann distribution.
+
+                for (int j = 0; j < (int) groups[i].size(); j++) {
+                    int atom = groups[i][j];
+                    if (owner.masses[atom] != 0) {
+                        const RealOpenMM velocityScale = SQRT(BOLTZ*temperature/owner.masses[atom]);
+                        velData[atom][0] = velocityScale*owner.data.thermostatRandom.getGaussianRandom(threadIndex);
+                        velData[atom][1] = velocityScale*owner.data.thermostatRandom.getGaussianRandom(threadIndex);
+                        velData[atom][2] = velocityScale*owner.data.thermostatRandom.getGaussianRandom(threadIndex);
+                    }
+                }
+            }
+        }
+    }
+    vector<RealVec>& velData;
+    CpuApplyAndersenThermostatKernel& owner;
+    RealOpenMM temperature, collisionProbability;
+};
+
+void CpuApplyAndersenThermostatKernel::initialize(const System& system, const AndersenThermostat& thermostat) {
+    int numParticles = system.getNumParticles();
+    masses.resize(numParticles);
+    for (int i = 0; i < numParticles; ++i)
+        masses[i] = static_cast<RealOpenMM>(system.getParticleMass(i));
+    data.thermostatRandom.initialize(thermostat.getRandomNumberSeed(), data.threads.getNumThreads());
+    particleGroups = AndersenThermostatImpl::calcParticleGroups(system);
+}
+
+void CpuApplyAndersenThermostatKernel::execute(ContextImpl& context) {
+    RealOpenMM temperature = context.getParameter(AndersenThermostat::Temperature());
+    RealOpenMM collisionFrequency = context.getParameter(AndersenThermostat::CollisionFrequency());
+    RealOpenMM collisionProbability = 1.0 - EXP(-collisionFrequency*context.getIntegrator().getStepSize());
+    ApplyThermostatTask task(extractVelocities(context), *this, temperature, collisionProbability);
+    data.threads.execute(task);
+    data.threads.waitForThreads();
+}
+
+class CpuRemoveCMMotionKernel::RemoveMomentumTask : public ThreadPool::Task {
+public:
+    RemoveMomentumTask(vector<RealVec>& velData, CpuRemoveCMMotionKernel& owner) : velData(velData), owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numParticles = owner.masses.size();
+        int numThreads = threads.getNumThreads();
+        int start = threadIndex*numParticles/numThreads;
+        int end = (threadIndex+1)*numParticles/numThreads;
+
+        // Calculate this thread's contribution to the center of mass momentum.
+
+        RealVec momentum;
+        for (int i = start; i < end; i++)
+            momentum += velData[i]*owner.masses[i];
+        owner.threadMomentum[threadIndex] = momentum;
+        threads.syncThreads();
+
+        // Adjust the particle velocities.
+
+        for (int i = start; i < end; i++)
+            if (owner.masses[i] != 0.0)
+                velData[i] -= owner.cmVelocity;
+    }
+    vector<RealVec>& velData;
+    CpuRemoveCMMotionKernel& owner;
+};
+
+void CpuRemoveCMMotionKernel::initialize(const System& system, const CMMotionRemover& force) {
+    frequency = force.getFrequency();
+    masses.resize(system.getNumParticles());
+    double totalMass = 0.0;
+    for (size_t i = 0; i < masses.size(); ++i) {
+        masses[i] = system.getParticleMass(i);
+        totalMass += masses[i];
+    }
+    inverseTotalMass = (totalMass == 0.0 ? 0.0 : 1.0/totalMass);
+    threadMomentum.resize(data.threads.getNumThreads());
+}
+
+void CpuRemoveCMMotionKernel::execute(ContextImpl& context) {
+    ReferencePlatform::PlatformData* refData = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    if (refData->stepCount%frequency != 0)
+        return;
+    RemoveMomentumTask task(extractVelocities(context), *this);
+    data.threads.execute(task);
+    data.threads.waitForThreads(); // Compute the momentum
+
+    // Sum the contributions from the threads in a fixed order, so the result does not depend on thread timing.
+
+    cmVelocity = RealVec();
+    for (int i = 0; i < (int) threadMomentum.size(); i++)
+        cmVelocity += threadMomentum[i];
+    cmVelocity *= inverseTotalMass;
+    data.threads.resumeThreads();
+    data.threads.waitForThreads(); // Adjust the velocities
+}
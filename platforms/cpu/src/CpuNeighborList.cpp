@@ -30,6 +30,7 @@
  * -------------------------------------------------------------------------- */
 
 #include "CpuNeighborList.h"
+#include "openmm/OpenMMException.h"
 #include "openmm/internal/hardware.h"
 #include "openmm/internal/vectorize.h"
 #include "hilbert.h"
@@ -157,7 +158,7 @@ public:
             yperiodic = location[1]-periodicBoxVectors[2][1]*scale2;
             zperiodic = location[2]-periodicBoxVectors[2][2]*scale2;
             float scale1 = floorf(yperiodic*recipBoxSize[1]);
-            yperiodic -= periodicBoxVectors[1][0]*scale1;
+            yperiodic -= periodicBoxVectors[1][1]*scale1;
         }
         int y = min(ny-1, int(floorf(yperiodic / voxelSizeY)));
         int z = min(nz-1, int(floorf(zperiodic / voxelSizeZ)));
@@ -181,7 +182,7 @@ public:
 
         int dIndexY = int((maxDistance+blockWidth[1])/voxelSizeY)+1; // How may voxels away do we have to look?
         int dIndexZ = int((maxDistance+blockWidth[2])/voxelSizeZ)+1;
-        if (usePeriodic) {
+        if (usePeriodic && !triclinic) {
             dIndexY = min(ny/2, dIndexY);
             dIndexZ = min(nz/2, dIndexZ);
         }
@@ -193,8 +194,10 @@ public:
 
         int startz = centerVoxelIndex.z-dIndexZ;
         int endz = centerVoxelIndex.z+dIndexZ;
-        if (usePeriodic)
-            endz = min(endz, startz+nz-1);
+        if (usePeriodic) {
+            if (!triclinic)
+                endz = min(endz, startz+nz-1);
+        }
         else {
             startz = max(startz, 0);
             endz = min(endz, nz-1);
@@ -204,7 +207,7 @@ public:
         for (int z = startz; z <= endz; ++z) {
             voxelIndex.z = z;
             if (usePeriodic)
-                voxelIndex.z = (z < 0 ? z+nz : (z >= nz ? z-nz : z));
+                voxelIndex.z = z-nz*(int) floor((float) z/nz);
 
             // Loop over voxels along the y axis.
 
@@ -213,9 +216,15 @@ public:
             int endy = centerVoxelIndex.y+dIndexY;
             float yoffset = (float) (usePeriodic ? boxz*periodicBoxVectors[2][1] : 0);
             if (usePeriodic) {
-                starty -= (int) ceil(yoffset/voxelSizeY);
-                endy -= (int) floor(yoffset/voxelSizeY);
-                endy = min(endy, starty+ny-1);
+                // The atoms in this image of the box are shifted along y by yoffset, so center the range
+                // of voxels on the shifted block.  In a triclinic box, each image of a voxel is shifted by
+                // a different amount along x, so the range may not be limited to one period.  Any atom
+                // found in more than one image is removed below.
+
+                starty = (int) floorf((centerPos[1]-blockWidth[1]-maxDistance-yoffset)/voxelSizeY);
+                endy = (int) floorf((centerPos[1]+blockWidth[1]+maxDistance-yoffset)/voxelSizeY);
+                if (!triclinic)
+                    endy = min(endy, starty+ny-1);
             }
             else {
                 starty = max(starty, 0);
@@ -224,7 +233,7 @@ public:
             for (int y = starty; y <= endy; ++y) {
                 voxelIndex.y = y;
                 if (usePeriodic)
-                    voxelIndex.y = (y < 0 ? y+ny : (y >= ny ? y-ny : y));
+                    voxelIndex.y = y-ny*(int) floor((float) y/ny);
                 int boxy = (int) floor((float) y/ny);
                 float xoffset = (float) (usePeriodic ? boxy*periodicBoxVectors[1][0]+boxz*periodicBoxVectors[2][0] : 0);
                 
@@ -233,7 +242,7 @@ public:
                 
                 float minx = centerPos[0];
                 float maxx = centerPos[0];
-                fvec4 offset(-xoffset, -yoffset+voxelSizeY*y+(usePeriodic ? 0.0f : miny), voxelSizeZ*z+(usePeriodic ? 0.0f : minz), 0);
+                fvec4 offset(-xoffset, yoffset+voxelSizeY*y+(usePeriodic ? 0.0f : miny), voxelSizeZ*z+(usePeriodic ? 0.0f : minz), 0);
                 for (int k = 0; k < (int) blockAtoms.size(); k++) {
                     const float* atomPos = &atomLocations[4*blockAtoms[k]];
                     fvec4 posVec(atomPos);
@@ -244,7 +253,8 @@ public:
                         delta2 -= round(delta2*invBoxSize)*boxSize;
                     }
                     fvec4 delta = min(abs(delta1), abs(delta2));
-                    float dy = (y == atomVoxelIndex[k].y ? 0.0f : delta[1]);
+                    bool insideY = (y == atomVoxelIndex[k].y || (delta1[1] <= 0.0f && delta2[1] >= 0.0f));
+                    float dy = (insideY ? 0.0f : delta[1]);
                     float dz = (z == atomVoxelIndex[k].z ? 0.0f : delta[2]);
                     float dist2 = maxDistanceSquared-dy*dy-dz*dz;
                     if (dist2 > 0) {
@@ -279,6 +289,12 @@ public:
                     rangeEnd[0] = findUpperBound(voxelIndex.y, voxelIndex.z, maxx);
                 }
                 bool periodicRectangular = (needPeriodic && !triclinic);
+
+                // In a triclinic box, reducing the offset from the block center does not always select the same
+                // periodic image as reducing the offset from each atom, so the distance to the center is not a
+                // lower bound on the distance between atoms.  Check every atom pair instead.
+
+                bool periodicTriclinic = (needPeriodic && triclinic);
                 
                 // Loop over atoms and check to see if they are neighbors of this block.
                 
@@ -303,10 +319,10 @@ public:
                         }
                         delta = max(0.0f, abs(delta)-blockWidth);
                         float dSquared = dot3(delta, delta);
-                        if (dSquared > maxDistanceSquared)
+                        if (dSquared > maxDistanceSquared && !periodicTriclinic)
                             continue;
                         
-                        if (dSquared > refineCutoffSquared) {
+                        if (dSquared > refineCutoffSquared || periodicTriclinic) {
                             // The distance is large enough that there might not be any actual interactions.
                             // Check individual atom pairs to be sure.
                             
@@ -346,6 +362,21 @@ public:
                 }
             }
         }
+        if (usePeriodic && triclinic) {
+            // Remove atoms that were found in more than one periodic image.
+
+            vector<pair<int, char> > found(neighbors.size());
+            for (int i = 0; i < (int) neighbors.size(); i++)
+                found[i] = make_pair(neighbors[i], exclusions[i]);
+            sort(found.begin(), found.end());
+            found.erase(unique(found.begin(), found.end()), found.end());
+            neighbors.resize(found.size());
+            exclusions.resize(found.size());
+            for (int i = 0; i < (int) found.size(); i++) {
+                neighbors[i] = found[i].first;
+                exclusions[i] = found[i].second;
+            }
+        }
     }
 
 private:
@@ -373,8 +404,30 @@ public:
 CpuNeighborList::CpuNeighborList(int blockSize) : blockSize(blockSize) {
 }
 
+void CpuNeighborList::setExclusions(const vector<set<int> >& exclusions) {
+    // Flatten the exclusions into a single array.  Iterating over each set yields the excluded atoms
+    // in increasing order, which the merge in threadComputeNeighborList() depends on.
+
+    int numAtoms = exclusions.size();
+    exclusionStart.resize(numAtoms+1);
+    exclusionAtoms.resize(0);
+    for (int i = 0; i < numAtoms; i++) {
+        exclusionStart[i] = exclusionAtoms.size();
+        exclusionAtoms.insert(exclusionAtoms.end(), exclusions[i].begin(), exclusions[i].end());
+    }
+    exclusionStart[numAtoms] = exclusionAtoms.size();
+}
+
 void CpuNeighborList::computeNeighborList(int numAtoms, const AlignedArray<float>& atomLocations, const vector<set<int> >& exclusions,
             const RealVec* periodicBoxVectors, bool usePeriodic, float maxDistance, ThreadPool& threads) {
+    setExclusions(exclusions);
+    computeNeighborList(numAtoms, atomLocations, periodicBoxVectors, usePeriodic, maxDistance, threads);
+}
+
+void CpuNeighborList::computeNeighborList(int numAtoms, const AlignedArray<float>& atomLocations, const RealVec* periodicBoxVectors,
+            bool usePeriodic, float maxDistance, ThreadPool& threads) {
+    if ((int) exclusionStart.size() != numAtoms+1)
+        throw OpenMMException("CpuNeighborList: exclusions have not been set for the correct number of atoms");
     int numBlocks = (numAtoms+blockSize-1)/blockSize;
     blockNeighbors.resize(numBlocks);
     blockExclusions.resize(numBlocks);
@@ -382,7 +435,6 @@ void CpuNeighborList::computeNeighborList(int numAtoms, const AlignedArray<float
     
     // Record the parameters for the threads.
     
-    this->exclusions = &exclusions;
     this->atomLocations = &atomLocations[0];
     this->periodicBoxVectors[0] = periodicBoxVectors[0];
     this->periodicBoxVectors[1] = periodicBoxVectors[1];
@@ -451,6 +503,10 @@ void CpuNeighborList::computeNeighborList(int numAtoms, const AlignedArray<float
     }
 }
 
+int CpuNeighborList::getBlockSize() const {
+    return blockSize;
+}
+
 int CpuNeighborList::getNumBlocks() const {
     return sortedAtoms.size()/blockSize;
 }
@@ -490,6 +546,7 @@ void CpuNeighborList::threadComputeNeighborList(ThreadPool& threads, int threadI
     int numBlocks = blockNeighbors.size();
     vector<int> blockAtoms;
     vector<VoxelIndex> atomVoxelIndex;
+    vector<pair<int, int> > sortedNeighbors;
     for (int i = threadIndex; i < numBlocks; i += numThreads) {
         // Find the atoms in this block and compute their bounding box.
         
@@ -510,15 +567,33 @@ void CpuNeighborList::threadComputeNeighborList(ThreadPool& threads, int threadI
         }
         voxels->getNeighbors(blockNeighbors[i], i, (maxPos+minPos)*0.5f, (maxPos-minPos)*0.5f, sortedAtoms, blockExclusions[i], maxDistance, blockAtoms, atomLocations, atomVoxelIndex);
 
-        // Record the exclusions for this block.
+        // Record the exclusions for this block.  Sort the neighbors by atom index, then merge each atom's
+        // (already sorted) exclusions against them.
 
+        const vector<int>& neighbors = blockNeighbors[i];
+        vector<char>& exclusionMasks = blockExclusions[i];
+        int numNeighbors = neighbors.size();
+        sortedNeighbors.resize(numNeighbors);
+        for (int k = 0; k < numNeighbors; k++)
+            sortedNeighbors[k] = make_pair(neighbors[k], k);
+        sort(sortedNeighbors.begin(), sortedNeighbors.end());
         for (int j = 0; j < atomsInBlock; j++) {
-            const set<int>& atomExclusions = (*exclusions)[sortedAtoms[firstIndex+j]];
+            int atom = sortedAtoms[firstIndex+j];
+            if (exclusionStart[atom] == exclusionStart[atom+1])
+                continue;
+            const int* excluded = &exclusionAtoms[exclusionStart[atom]];
+            const int* excludedEnd = excluded+(exclusionStart[atom+1]-exclusionStart[atom]);
             char mask = 1<<j;
-            for (int k = 0; k < (int) blockNeighbors[i].size(); k++) {
-                int atomIndex = blockNeighbors[i][k];
-                if (atomExclusions.find(atomIndex) != atomExclusions.end())
-                    blockExclusions[i][k] |= mask;
+            vector<pair<int, int> >::const_iterator neighbor = lower_bound(sortedNeighbors.begin(), sortedNeighbors.end(), make_pair(*excluded, 0));
+            while (neighbor != sortedNeighbors.end() && excluded != excludedEnd) {
+                if (neighbor->first < *excluded)
+                    ++neighbor;
+                else if (*excluded < neighbor->first)
+                    ++excluded;
+                else {
+                    exclusionMasks[neighbor->second] |= mask;
+                    ++neighbor;
+                }
             }
         }
     }
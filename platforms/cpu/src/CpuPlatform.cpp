@@ -61,14 +61,24 @@ map<const ContextImpl*, CpuPlatform::PlatformData*> CpuPlatform::contextData;
 CpuPlatform::CpuPlatform() {
     CpuKernelFactory* factory = new CpuKernelFactory();
     registerKernelFactory(CalcForcesAndEnergyKernel::Name(), factory);
+    registerKernelFactory(UpdateStateDataKernel::Name(), factory);
     registerKernelFactory(CalcPeriodicTorsionForceKernel::Name(), factory);
     registerKernelFactory(CalcRBTorsionForceKernel::Name(), factory);
     registerKernelFactory(CalcNonbondedForceKernel::Name(), factory);
     registerKernelFactory(CalcCustomNonbondedForceKernel::Name(), factory);
+    registerKernelFactory(CalcCustomExternalForceKernel::Name(), factory);
+    registerKernelFactory(CalcCustomHbondForceKernel::Name(), factory);
+    registerKernelFactory(CalcCustomCompoundBondForceKernel::Name(), factory);
     registerKernelFactory(CalcCustomManyParticleForceKernel::Name(), factory);
     registerKernelFactory(CalcGBSAOBCForceKernel::Name(), factory);
+    registerKernelFactory(CalcGBVIForceKernel::Name(), factory);
     registerKernelFactory(CalcCustomGBForceKernel::Name(), factory);
     registerKernelFactory(IntegrateLangevinStepKernel::Name(), factory);
+    registerKernelFactory(IntegrateBrownianStepKernel::Name(), factory);
+    registerKernelFactory(IntegrateVariableLangevinStepKernel::Name(), factory);
+    registerKernelFactory(IntegrateVariableVerletStepKernel::Name(), factory);
+    registerKernelFactory(ApplyAndersenThermostatKernel::Name(), factory);
+    registerKernelFactory(RemoveCMMotionKernel::Name(), factory);
     platformProperties.push_back(CpuThreads());
     int threads = getNumProcessors();
     char* threadsEnv = getenv("OPENMM_CPU_THREADS");
@@ -77,6 +87,8 @@ CpuPlatform::CpuPlatform() {
     stringstream defaultThreads;
     defaultThreads << threads;
     setPropertyDefaultValue(CpuThreads(), defaultThreads.str());
+    platformProperties.push_back(CpuCustomNonbondedTableTolerance());
+    setPropertyDefaultValue(CpuCustomNonbondedTableTolerance(), "0");
 }
 
 const string& CpuPlatform::getPropertyValue(const Context& context, const string& property) const {
@@ -108,6 +120,8 @@ void CpuPlatform::contextCreated(ContextImpl& context, const map<string, string>
     stringstream(threadsPropValue) >> numThreads;
     PlatformData* data = new PlatformData(context.getSystem().getNumParticles(), numThreads);
     contextData[&context] = data;
+    data->propertyValues[CpuCustomNonbondedTableTolerance()] = (properties.find(CpuCustomNonbondedTableTolerance()) == properties.end() ?
+            getPropertyDefaultValue(CpuCustomNonbondedTableTolerance()) : properties.find(CpuCustomNonbondedTableTolerance())->second);
     ReferenceConstraints& constraints = *(ReferenceConstraints*) reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData())->constraints;
     if (constraints.settle != NULL) {
         CpuSETTLE* parallelSettle = new CpuSETTLE(context.getSystem(), *(ReferenceSETTLEAlgorithm*) constraints.settle, data->threads);
@@ -136,7 +150,35 @@ CpuPlatform::PlatformData::PlatformData(int numParticles, int numThreads) : posq
     for (int i = 0; i < numThreads; i++)
         threadForce[i].resize(4*numParticles);
     isPeriodic = false;
+    sharedNeighborList = NULL;
     stringstream threadsProperty;
     threadsProperty << numThreads;
     propertyValues[CpuThreads()] = threadsProperty.str();
 }
+
+void CpuPlatform::PlatformData::setSharedNeighborList(const CpuNeighborList& list, double cutoff, double paddedCutoff, const vector<RealVec>& listPositions) {
+    if (sharedNeighborList != NULL)
+        return;
+    sharedNeighborList = &list;
+    sharedNeighborListCutoff = cutoff;
+    sharedNeighborListPadding = paddedCutoff-cutoff;
+    sharedNeighborListPositions = &listPositions;
+}
+
+const CpuNeighborList* CpuPlatform::PlatformData::getSharedNeighborList(double cutoff, const vector<RealVec>& positions) const {
+    if (sharedNeighborList == NULL || cutoff != sharedNeighborListCutoff)
+        return NULL;
+
+    // If no particle has moved more than half the padding distance, every pair that is now inside the
+    // cutoff was inside the padded cutoff when the list was built.
+
+    const vector<RealVec>& listPositions = *sharedNeighborListPositions;
+    double maxMove2 = 0.25*sharedNeighborListPadding*sharedNeighborListPadding;
+    int numParticles = positions.size();
+    for (int i = 0; i < numParticles; i++) {
+        RealVec delta = positions[i]-listPositions[i];
+        if (delta.dot(delta) > maxMove2)
+            return NULL;
+    }
+    return sharedNeighborList;
+}
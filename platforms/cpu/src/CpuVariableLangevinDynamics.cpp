@@ -0,0 +1,163 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SimTKOpenMMUtilities.h"
+#include "CpuVariableLangevinDynamics.h"
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuVariableLangevinDynamics::ErrorTask : public ThreadPool::Task {
+public:
+    ErrorTask(CpuVariableLangevinDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeError(threadIndex);
+    }
+    CpuVariableLangevinDynamics& owner;
+};
+
+class CpuVariableLangevinDynamics::Update1Task : public ThreadPool::Task {
+public:
+    Update1Task(CpuVariableLangevinDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadUpdate1(threadIndex);
+    }
+    CpuVariableLangevinDynamics& owner;
+};
+
+class CpuVariableLangevinDynamics::Update2Task : public ThreadPool::Task {
+public:
+    Update2Task(CpuVariableLangevinDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadUpdate2(threadIndex);
+    }
+    CpuVariableLangevinDynamics& owner;
+};
+
+CpuVariableLangevinDynamics::CpuVariableLangevinDynamics(int numberOfAtoms, RealOpenMM tau, RealOpenMM temperature, RealOpenMM accuracy, ThreadPool& threads, CpuRandom& random) :
+           ReferenceVariableStochasticDynamics(numberOfAtoms, tau, temperature, accuracy), threads(threads), random(random) {
+    threadError.resize(threads.getNumThreads());
+}
+
+CpuVariableLangevinDynamics::~CpuVariableLangevinDynamics() {
+}
+
+RealOpenMM CpuVariableLangevinDynamics::computeErrorNorm(int numberOfAtoms, vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->forces = &forces[0];
+    this->inverseMasses = &inverseMasses[0];
+
+    // Signal the threads to start running and wait for them to finish.
+
+    ErrorTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+
+    // Combine the results from all the threads.
+
+    double error = 0.0;
+    for (int i = 0; i < (int) threadError.size(); i++)
+        error += threadError[i];
+    return SQRT(error/(numberOfAtoms*3));
+}
+
+void CpuVariableLangevinDynamics::updatePart1(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                              vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->atomCoordinates = &atomCoordinates[0];
+    this->velocities = &velocities[0];
+    this->forces = &forces[0];
+    this->inverseMasses = &inverseMasses[0];
+    this->xPrime = &xPrime[0];
+
+    // Signal the threads to start running and wait for them to finish.
+
+    Update1Task task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+}
+
+void CpuVariableLangevinDynamics::updatePart2(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                              vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->atomCoordinates = &atomCoordinates[0];
+    this->velocities = &velocities[0];
+    this->forces = &forces[0];
+    this->inverseMasses = &inverseMasses[0];
+    this->xPrime = &xPrime[0];
+
+    // Signal the threads to start running and wait for them to finish.
+
+    Update2Task task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+}
+
+void CpuVariableLangevinDynamics::threadComputeError(int threadIndex) {
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+    double error = 0.0;
+    for (int i = start; i < end; i++) {
+        RealVec xerror = forces[i]*inverseMasses[i];
+        error += xerror.dot(xerror);
+    }
+    threadError[threadIndex] = error;
+}
+
+void CpuVariableLangevinDynamics::threadUpdate1(int threadIndex) {
+    const RealOpenMM tau = getTau();
+    const RealOpenMM vscale = EXP(-getDeltaT()/tau);
+    const RealOpenMM fscale = (1-vscale)*tau;
+    const RealOpenMM kT = BOLTZ*getTemperature();
+    const RealOpenMM noisescale = SQRT(2*kT/tau)*SQRT(0.5*(1-vscale*vscale)*tau);
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+
+    for (int i = start; i < end; i++) {
+        if (inverseMasses[i] != 0.0) {
+            RealOpenMM sqrtInvMass = SQRT(inverseMasses[i]);
+            RealVec noise(random.getGaussianRandom(threadIndex), random.getGaussianRandom(threadIndex), random.getGaussianRandom(threadIndex));
+            velocities[i] = velocities[i]*vscale + forces[i]*(fscale*inverseMasses[i]) + noise*(noisescale*sqrtInvMass);
+        }
+    }
+}
+
+void CpuVariableLangevinDynamics::threadUpdate2(int threadIndex) {
+    const RealOpenMM dt = getDeltaT();
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+
+    for (int i = start; i < end; i++)
+        if (inverseMasses[i] != 0.0)
+            xPrime[i] = atomCoordinates[i]+velocities[i]*dt;
+}
@@ -0,0 +1,162 @@
+
+/* Portions copyright (c) 2009-2015 Stanford University and Simbios.
+ * Contributors: Peter Eastman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject
+ * to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "SimTKOpenMMUtilities.h"
+#include "CpuVariableVerletDynamics.h"
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuVariableVerletDynamics::ErrorTask : public ThreadPool::Task {
+public:
+    ErrorTask(CpuVariableVerletDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeError(threadIndex);
+    }
+    CpuVariableVerletDynamics& owner;
+};
+
+class CpuVariableVerletDynamics::Update1Task : public ThreadPool::Task {
+public:
+    Update1Task(CpuVariableVerletDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadUpdate1(threadIndex);
+    }
+    CpuVariableVerletDynamics& owner;
+};
+
+class CpuVariableVerletDynamics::Update2Task : public ThreadPool::Task {
+public:
+    Update2Task(CpuVariableVerletDynamics& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadUpdate2(threadIndex);
+    }
+    CpuVariableVerletDynamics& owner;
+};
+
+CpuVariableVerletDynamics::CpuVariableVerletDynamics(int numberOfAtoms, RealOpenMM accuracy, ThreadPool& threads) :
+           ReferenceVariableVerletDynamics(numberOfAtoms, accuracy), threads(threads) {
+    threadError.resize(threads.getNumThreads());
+}
+
+CpuVariableVerletDynamics::~CpuVariableVerletDynamics() {
+}
+
+RealOpenMM CpuVariableVerletDynamics::computeErrorNorm(int numberOfAtoms, vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->forces = &forces[0];
+    this->inverseMasses = &inverseMasses[0];
+
+    // Signal the threads to start running and wait for them to finish.
+
+    ErrorTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+
+    // Combine the results from all the threads.
+
+    double error = 0.0;
+    for (int i = 0; i < (int) threadError.size(); i++)
+        error += threadError[i];
+    return SQRT(error/(numberOfAtoms*3));
+}
+
+void CpuVariableVerletDynamics::updatePart1(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                            vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime,
+                                            RealOpenMM vstep) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->atomCoordinates = &atomCoordinates[0];
+    this->velocities = &velocities[0];
+    this->forces = &forces[0];
+    this->inverseMasses = &inverseMasses[0];
+    this->xPrime = &xPrime[0];
+    this->vstep = vstep;
+
+    // Signal the threads to start running and wait for them to finish.
+
+    Update1Task task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+}
+
+void CpuVariableVerletDynamics::updatePart2(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                            vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
+    // Record the parameters for the threads.
+
+    this->numberOfAtoms = numberOfAtoms;
+    this->atomCoordinates = &atomCoordinates[0];
+    this->velocities = &velocities[0];
+    this->inverseMasses = &inverseMasses[0];
+    this->xPrime = &xPrime[0];
+
+    // Signal the threads to start running and wait for them to finish.
+
+    Update2Task task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+}
+
+void CpuVariableVerletDynamics::threadComputeError(int threadIndex) {
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+    double error = 0.0;
+    for (int i = start; i < end; i++) {
+        RealVec xerror = forces[i]*inverseMasses[i];
+        error += xerror.dot(xerror);
+    }
+    threadError[threadIndex] = error;
+}
+
+void CpuVariableVerletDynamics::threadUpdate1(int threadIndex) {
+    const RealOpenMM dt = getDeltaT();
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+
+    for (int i = start; i < end; i++) {
+        if (inverseMasses[i] != 0.0) {
+            RealVec vPrime = velocities[i] + forces[i]*(inverseMasses[i]*vstep);
+            xPrime[i] = atomCoordinates[i] + vPrime*dt;
+        }
+    }
+}
+
+void CpuVariableVerletDynamics::threadUpdate2(int threadIndex) {
+    const RealOpenMM velocityScale = 1.0/getDeltaT();
+    int start = threadIndex*numberOfAtoms/threads.getNumThreads();
+    int end = (threadIndex+1)*numberOfAtoms/threads.getNumThreads();
+
+    for (int i = start; i < end; i++) {
+        if (inverseMasses[i] != 0.0) {
+            velocities[i] = (xPrime[i]-atomCoordinates[i])*velocityScale;
+            atomCoordinates[i] = xPrime[i];
+        }
+    }
+}
@@ -330,6 +330,33 @@ void testExclusions() {
     validateAxilrodTeller(force, positions, expectedSets, 2.0, false);
 }
 
+void testCutoffExclusions() {
+    CustomManyParticleForce* force = new CustomManyParticleForce(3,
+        "C*(1+3*cos(theta1)*cos(theta2)*cos(theta3))/(r12*r13*r23)^3;"
+        "theta1=angle(p1,p2,p3); theta2=angle(p2,p3,p1); theta3=angle(p3,p1,p2);"
+        "r12=distance(p1,p2); r13=distance(p1,p3); r23=distance(p2,p3)");
+    force->addGlobalParameter("C", 1.5);
+    force->setNonbondedMethod(CustomManyParticleForce::CutoffNonPeriodic);
+    force->setCutoffDistance(1.55);
+    vector<double> params;
+    force->addParticle(params);
+    force->addParticle(params);
+    force->addParticle(params);
+    force->addParticle(params);
+    force->addParticle(params);
+    vector<Vec3> positions;
+    positions.push_back(Vec3(0, 0, 0));
+    positions.push_back(Vec3(1, 0, 0));
+    positions.push_back(Vec3(0, 1.1, 0.3));
+    positions.push_back(Vec3(0.4, 0, -0.8));
+    positions.push_back(Vec3(0.2, 0.5, -0.1));
+    force->addExclusion(0, 2);
+    force->addExclusion(0, 3);
+    int sets[3][3] = {{0,1,4}, {1,2,4}, {1,3,4}};
+    vector<const int*> expectedSets(&sets[0], &sets[3]);
+    validateAxilrodTeller(force, positions, expectedSets, 2.0, false);
+}
+
 void testAllTerms() {
     int numParticles = 4;
     CpuPlatform platform;
@@ -723,6 +750,7 @@ int main() {
         testPeriodic();
         testTriclinic();
         testExclusions();
+        testCutoffExclusions();
         testAllTerms();
         testParameters();
         testTabulatedFunctions();
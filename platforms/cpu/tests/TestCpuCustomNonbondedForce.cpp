@@ -900,6 +900,146 @@ void testInteractionGroupLongRangeCorrection() {
     ASSERT_EQUAL_TOL(expected, energy2-energy1, 1e-4);
 }
 
+void testLargeMagnitudes() {
+    // Expressions are evaluated in single precision, several interactions at a time.  Compare to the
+    // Reference platform for parameters and energies of very different sizes, with a number of interactions
+    // that leaves the last batch only partly filled.
+
+    const int numParticles = 7;
+    System system;
+    CustomNonbondedForce* nonbonded = new CustomNonbondedForce("a1*a2/r+b*exp(-r/c); b=b1*b2; c=0.5*(c1+c2)");
+    nonbonded->addPerParticleParameter("a");
+    nonbonded->addPerParticleParameter("b");
+    nonbonded->addPerParticleParameter("c");
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<double> params(3);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        params[0] = (i%2 == 0 ? 1.0 : -1.0)*1000.0*(i+1);
+        params[1] = 1e4*(1.0+genrand_real2(sfmt));
+        params[2] = 0.1+0.5*genrand_real2(sfmt);
+        nonbonded->addParticle(params);
+        positions[i] = Vec3(2.0*genrand_real2(sfmt), 2.0*genrand_real2(sfmt), 2.0*genrand_real2(sfmt));
+    }
+    nonbonded->addExclusion(0, 3);
+    nonbonded->setCutoffDistance(2.5);
+    system.addForce(nonbonded);
+    for (int method = 0; method < 2; method++) {
+        nonbonded->setNonbondedMethod(method == 0 ? CustomNonbondedForce::NoCutoff : CustomNonbondedForce::CutoffNonPeriodic);
+        VerletIntegrator integrator1(0.01);
+        VerletIntegrator integrator2(0.01);
+        Context context1(system, integrator1, Platform::getPlatformByName("Reference"));
+        Context context2(system, integrator2, platform);
+        context1.setPositions(positions);
+        context2.setPositions(positions);
+        State state1 = context1.getState(State::Forces | State::Energy);
+        State state2 = context2.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), TOL);
+        for (int i = 0; i < numParticles; i++)
+            ASSERT_EQUAL_VEC(state1.getForces()[i], state2.getForces()[i], TOL);
+    }
+}
+
+void testInteractionGroupForces() {
+    // Three interactions, which do not fill a batch.
+
+    const int numParticles = 5;
+    System system;
+    CustomNonbondedForce* nonbonded = new CustomNonbondedForce("k1*k2*(r-1)^2");
+    nonbonded->addPerParticleParameter("k");
+    vector<double> params(1);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        params[0] = i+1.0;
+        nonbonded->addParticle(params);
+    }
+    set<int> set1, set2;
+    set1.insert(0);
+    set2.insert(1);
+    set2.insert(3);
+    set2.insert(4);
+    nonbonded->addInteractionGroup(set1, set2);
+    system.addForce(nonbonded);
+    vector<Vec3> positions(numParticles);
+    positions[0] = Vec3(0, 0, 0);
+    positions[1] = Vec3(2, 0, 0);
+    positions[2] = Vec3(0, 5, 0);
+    positions[3] = Vec3(0, 0, 3);
+    positions[4] = Vec3(0, 0.5, 0);
+    VerletIntegrator integrator(0.01);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    State state = context.getState(State::Forces | State::Energy);
+    ASSERT_EQUAL_TOL(2.0*1.0 + 4.0*4.0 + 5.0*0.25, state.getPotentialEnergy(), TOL);
+    ASSERT_EQUAL_VEC(Vec3(2.0*2.0, -5.0*2.0*0.5, 4.0*2.0*2.0), state.getForces()[0], TOL);
+    ASSERT_EQUAL_VEC(Vec3(-2.0*2.0, 0, 0), state.getForces()[1], TOL);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, 0), state.getForces()[2], TOL);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, -4.0*2.0*2.0), state.getForces()[3], TOL);
+    ASSERT_EQUAL_VEC(Vec3(0, 5.0*2.0*0.5, 0), state.getForces()[4], TOL);
+}
+
+void testTabulation() {
+    // Compare tabulated interactions to the Reference platform.
+
+    const int gridSize = 4;
+    const int numParticles = gridSize*gridSize*gridSize;
+    const double spacing = 0.6;
+    const double boxSize = gridSize*spacing;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    CustomNonbondedForce* nonbonded = new CustomNonbondedForce("scale*4*eps*((sigma/r)^12-(sigma/r)^6)+138.935456*q1*q2/r; sigma=0.5*(sigma1+sigma2); eps=sqrt(eps1*eps2)");
+    nonbonded->addPerParticleParameter("q");
+    nonbonded->addPerParticleParameter("sigma");
+    nonbonded->addPerParticleParameter("eps");
+    nonbonded->addGlobalParameter("scale", 1.0);
+    vector<Vec3> positions;
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    vector<double> params(3);
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                int type = positions.size()%3;
+                params[0] = (type == 0 ? 0.5 : type == 1 ? -0.5 : 0.0);
+                params[1] = 0.2+0.05*type;
+                params[2] = 0.5+type;
+                system.addParticle(1.0);
+                nonbonded->addParticle(params);
+                positions.push_back(Vec3(i*spacing, j*spacing, k*spacing)+Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*0.3);
+            }
+    
+    // Put one pair close enough that it is computed from the expression rather than the tables.
+    
+    positions[1] = positions[0]+Vec3(0.1, 0, 0);
+    nonbonded->setNonbondedMethod(CustomNonbondedForce::CutoffPeriodic);
+    nonbonded->setCutoffDistance(1.1);
+    system.addForce(nonbonded);
+    VerletIntegrator integrator1(0.01);
+    VerletIntegrator integrator2(0.01);
+    map<string, string> properties;
+    properties[CpuPlatform::CpuCustomNonbondedTableTolerance()] = "1e-5";
+    Context context1(system, integrator1, Platform::getPlatformByName("Reference"));
+    Context context2(system, integrator2, platform, properties);
+    ASSERT_EQUAL(string("1e-5"), platform.getPropertyValue(context2, CpuPlatform::CpuCustomNonbondedTableTolerance()));
+    context1.setPositions(positions);
+    context2.setPositions(positions);
+    for (int i = 0; i < 2; i++) {
+        // The second time, change the global parameter so the tables need to be rebuilt.
+        
+        if (i == 1) {
+            context1.setParameter("scale", 0.5);
+            context2.setParameter("scale", 0.5);
+        }
+        State state1 = context1.getState(State::Forces | State::Energy);
+        State state2 = context2.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-4);
+        for (int j = 0; j < numParticles; j++)
+            ASSERT_EQUAL_VEC(state1.getForces()[j], state2.getForces()[j], 1e-4);
+    }
+}
+
 int main() {
     try {
         if (!CpuPlatform::isProcessorSupported()) {
@@ -924,6 +1064,9 @@ int main() {
         testInteractionGroups();
         testLargeInteractionGroup();
         testInteractionGroupLongRangeCorrection();
+        testLargeMagnitudes();
+        testInteractionGroupForces();
+        testTabulation();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
@@ -248,6 +248,54 @@ void testForce(int numParticles, NonbondedForce::NonbondedMethod method, GBSAOBC
     }
 }
 
+void testSharedNeighborList(double gbsaCutoff) {
+    // Take several steps so the GBSAOBCForce can reuse the neighbor list built by the NonbondedForce (when the
+    // cutoffs match), and check that the results agree with the Reference platform after each one.
+
+    const int numParticles = 300;
+    const double boxSize = 4.0;
+    CpuPlatform platform;
+    ReferencePlatform reference;
+    System system;
+    system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    NonbondedForce* nonbonded = new NonbondedForce();
+    GBSAOBCForce* gbsa = new GBSAOBCForce();
+    for (int i = 0; i < numParticles; ++i) {
+        system.addParticle(1.0);
+        double charge = i%2 == 0 ? -1 : 1;
+        nonbonded->addParticle(charge, 0.2, 0.1);
+        gbsa->addParticle(charge, 0.15+0.05*(i%3), 0.5+0.1*(i%4));
+        if (i%2 == 1)
+            nonbonded->addException(i-1, i, 0, 1, 0);
+    }
+    nonbonded->setNonbondedMethod(NonbondedForce::CutoffPeriodic);
+    gbsa->setNonbondedMethod(GBSAOBCForce::CutoffPeriodic);
+    nonbonded->setCutoffDistance(1.2);
+    gbsa->setCutoffDistance(gbsaCutoff);
+    system.addForce(nonbonded);
+    system.addForce(gbsa);
+    LangevinIntegrator integrator1(0, 0.1, 0.001);
+    LangevinIntegrator integrator2(0, 0.1, 0.001);
+    Context context(system, integrator1, platform);
+    Context refContext(system, integrator2, reference);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; ++i)
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    for (int step = 0; step < 5; step++) {
+        for (int i = 0; i < numParticles; ++i)
+            positions[i] += Vec3(0.02*genrand_real2(sfmt), 0.02*genrand_real2(sfmt), 0.02*genrand_real2(sfmt));
+        context.setPositions(positions);
+        refContext.setPositions(positions);
+        State state = context.getState(State::Forces | State::Energy);
+        State refState = refContext.getState(State::Forces | State::Energy);
+        for (int i = 0; i < numParticles; ++i)
+            ASSERT_EQUAL_VEC(refState.getForces()[i], state.getForces()[i], 1e-3);
+        ASSERT_EQUAL_TOL(refState.getPotentialEnergy(), state.getPotentialEnergy(), 1e-3);
+    }
+}
+
 int main() {
     try {
         if (!CpuPlatform::isProcessorSupported()) {
@@ -262,6 +310,8 @@ int main() {
             testForce(i*i*i, NonbondedForce::CutoffNonPeriodic, GBSAOBCForce::CutoffNonPeriodic);
             testForce(i*i*i, NonbondedForce::CutoffPeriodic, GBSAOBCForce::CutoffPeriodic);
         }
+        testSharedNeighborList(1.2);
+        testSharedNeighborList(1.0);
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
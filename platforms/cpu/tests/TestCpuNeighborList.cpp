@@ -48,9 +48,7 @@
 using namespace OpenMM;
 using namespace std;
 
-void testNeighborList(bool periodic, bool triclinic) {
-    const int numParticles = 500;
-    const float cutoff = 2.0f;
+void testNeighborList(bool periodic, bool triclinic, int numParticles, float cutoff) {
     RealVec boxVectors[3];
     if (triclinic) {
         boxVectors[0] = RealVec(20, 0, 0);
@@ -125,9 +123,11 @@ int main() {
             cout << "CPU is not supported.  Exiting." << endl;
             return 0;
         }
-        testNeighborList(false, false);
-        testNeighborList(true, false);
-        testNeighborList(true, true);
+        testNeighborList(false, false, 500, 2.0f);
+        testNeighborList(true, false, 500, 2.0f);
+        testNeighborList(true, true, 500, 2.0f);
+        testNeighborList(true, true, 5000, 2.0f);
+        testNeighborList(true, true, 500, 7.0f);
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
@@ -29,9 +29,9 @@
 
 namespace OpenMM {
 
-class ReferenceBrownianDynamics : public ReferenceDynamics {
+class OPENMM_EXPORT ReferenceBrownianDynamics : public ReferenceDynamics {
 
-   private:
+   protected:
 
       std::vector<OpenMM::RealVec> xPrime;
       std::vector<RealOpenMM> inverseMasses;
@@ -85,6 +85,37 @@ class ReferenceBrownianDynamics : public ReferenceDynamics {
      
       void update(const OpenMM::System& system, std::vector<OpenMM::RealVec>& atomCoordinates,
                   std::vector<OpenMM::RealVec>& velocities, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& masses, RealOpenMM tolerance);
+
+      /**---------------------------------------------------------------------------------------
+      
+         First update: compute the unconstrained positions at the end of the step
+      
+         @param numberOfAtoms       number of atoms
+         @param atomCoordinates     atom coordinates
+         @param forces              forces
+         @param inverseMasses       inverse atom masses
+         @param xPrime              xPrime
+      
+         --------------------------------------------------------------------------------------- */
+     
+      virtual void updatePart1(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& forces,
+                               std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime);
+
+      /**---------------------------------------------------------------------------------------
+      
+         Second update: after constraints have been applied, compute the velocities and
+         copy xPrime to the atom coordinates
+      
+         @param numberOfAtoms       number of atoms
+         @param atomCoordinates     atom coordinates
+         @param velocities          velocities
+         @param inverseMasses       inverse atom masses
+         @param xPrime              xPrime
+      
+         --------------------------------------------------------------------------------------- */
+     
+      virtual void updatePart2(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                               std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime);
       
 };
 
@@ -29,9 +29,9 @@
 
 namespace OpenMM {
 
-class ReferenceVariableStochasticDynamics : public ReferenceDynamics {
+class OPENMM_EXPORT ReferenceVariableStochasticDynamics : public ReferenceDynamics {
 
-   private:
+   protected:
 
       std::vector<OpenMM::RealVec> xPrime;
       std::vector<RealOpenMM> inverseMasses;
@@ -105,6 +105,20 @@ class ReferenceVariableStochasticDynamics : public ReferenceDynamics {
       void update(const OpenMM::System& system, std::vector<OpenMM::RealVec>& atomCoordinates,
                   std::vector<OpenMM::RealVec>& velocities, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& masses, RealOpenMM maxStepSize, RealOpenMM tolerance);
 
+      /**---------------------------------------------------------------------------------------
+
+         Compute the RMS acceleration, which is used to estimate the integration error
+
+         @param numberOfAtoms       number of atoms
+         @param forces              forces
+         @param inverseMasses       inverse atom masses
+
+         @return the error estimate
+
+         --------------------------------------------------------------------------------------- */
+
+      virtual RealOpenMM computeErrorNorm(int numberOfAtoms, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses);
+
       /**---------------------------------------------------------------------------------------
 
          First update; based on code in update.c do_update_sd() Gromacs 3.1.4
@@ -113,16 +127,14 @@ class ReferenceVariableStochasticDynamics : public ReferenceDynamics {
          @param atomCoordinates     atom coordinates
          @param velocities          velocities
          @param forces              forces
-         @param masses              atom masses
          @param inverseMasses       inverse atom masses
          @param xPrime              xPrime
-         @param maxStepSize         maximum time step
 
          --------------------------------------------------------------------------------------- */
 
-      void updatePart1(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
-                       std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& masses, std::vector<RealOpenMM>& inverseMasses,
-                       std::vector<OpenMM::RealVec>& xPrime, RealOpenMM maxStepSize);
+      virtual void updatePart1(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                       std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses,
+                       std::vector<OpenMM::RealVec>& xPrime);
 
       /**---------------------------------------------------------------------------------------
 
@@ -136,7 +148,7 @@ class ReferenceVariableStochasticDynamics : public ReferenceDynamics {
 
          --------------------------------------------------------------------------------------- */
 
-      void updatePart2(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+      virtual void updatePart2(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
                        std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses,
                        std::vector<OpenMM::RealVec>& xPrime);
       
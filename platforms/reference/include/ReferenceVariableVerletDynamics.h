@@ -29,9 +29,9 @@
 
 namespace OpenMM {
 
-class ReferenceVariableVerletDynamics : public ReferenceDynamics {
+class OPENMM_EXPORT ReferenceVariableVerletDynamics : public ReferenceDynamics {
 
-   private:
+   protected:
 
       std::vector<OpenMM::RealVec> xPrime;
       std::vector<RealOpenMM> inverseMasses;
@@ -93,6 +93,54 @@ class ReferenceVariableVerletDynamics : public ReferenceDynamics {
       void update(const OpenMM::System& system, std::vector<OpenMM::RealVec>& atomCoordinates,
                   std::vector<OpenMM::RealVec>& velocities, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& masses, RealOpenMM maxStepSize, RealOpenMM tolerance);
 
+      /**---------------------------------------------------------------------------------------
+
+         Compute the RMS acceleration, which is used to estimate the integration error
+
+         @param numberOfAtoms       number of atoms
+         @param forces              forces
+         @param inverseMasses       inverse atom masses
+
+         @return the error estimate
+
+         --------------------------------------------------------------------------------------- */
+
+      virtual RealOpenMM computeErrorNorm(int numberOfAtoms, std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses);
+
+      /**---------------------------------------------------------------------------------------
+
+         First update: advance the velocities and compute the unconstrained positions
+
+         @param numberOfAtoms       number of atoms
+         @param atomCoordinates     atom coordinates
+         @param velocities          velocities
+         @param forces              forces
+         @param inverseMasses       inverse atom masses
+         @param xPrime              xPrime
+         @param vstep               the time interval by which to advance the velocities
+
+         --------------------------------------------------------------------------------------- */
+
+      virtual void updatePart1(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                               std::vector<OpenMM::RealVec>& forces, std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime,
+                               RealOpenMM vstep);
+
+      /**---------------------------------------------------------------------------------------
+
+         Second update: after constraints have been applied, compute the velocities and
+         copy xPrime to the atom coordinates
+
+         @param numberOfAtoms       number of atoms
+         @param atomCoordinates     atom coordinates
+         @param velocities          velocities
+         @param inverseMasses       inverse atom masses
+         @param xPrime              xPrime
+
+         --------------------------------------------------------------------------------------- */
+
+      virtual void updatePart2(int numberOfAtoms, std::vector<OpenMM::RealVec>& atomCoordinates, std::vector<OpenMM::RealVec>& velocities,
+                               std::vector<RealOpenMM>& inverseMasses, std::vector<OpenMM::RealVec>& xPrime);
+
 };
 
 } // namespace OpenMM
@@ -137,28 +137,63 @@ void ReferenceBrownianDynamics::update(const OpenMM::System& system, vector<Real
    
    // Perform the integration.
    
+   updatePart1(numberOfAtoms, atomCoordinates, forces, inverseMasses, xPrime);
+   ReferenceConstraintAlgorithm* referenceConstraintAlgorithm = getReferenceConstraintAlgorithm();
+   if (referenceConstraintAlgorithm)
+      referenceConstraintAlgorithm->apply(atomCoordinates, xPrime, inverseMasses, tolerance);
+   
+   // Update the positions and velocities.
+   
+   updatePart2(numberOfAtoms, atomCoordinates, velocities, inverseMasses, xPrime);
+   ReferenceVirtualSites::computePositions(system, atomCoordinates);
+   incrementTimeStep();
+}
+
+/**---------------------------------------------------------------------------------------
+
+   First update: compute the unconstrained positions at the end of the step
+
+   @param numberOfAtoms       number of atoms
+   @param atomCoordinates     atom coordinates
+   @param forces              forces
+   @param inverseMasses       inverse atom masses
+   @param xPrime              xPrime
+
+   --------------------------------------------------------------------------------------- */
+
+void ReferenceBrownianDynamics::updatePart1(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& forces,
+                                            vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
    const RealOpenMM noiseAmplitude = static_cast<RealOpenMM>(sqrt(2.0*BOLTZ*getTemperature()*getDeltaT()/getFriction()));
    const RealOpenMM forceScale = getDeltaT()/getFriction();
    for (int i = 0; i < numberOfAtoms; ++i) {
-       if (masses[i] != zero)
+       if (inverseMasses[i] != 0.0)
            for (int j = 0; j < 3; ++j) {
                xPrime[i][j] = atomCoordinates[i][j] + forceScale*inverseMasses[i]*forces[i][j] + noiseAmplitude*SQRT(inverseMasses[i])*SimTKOpenMMUtilities::getNormallyDistributedRandomNumber();
            }
    }
-   ReferenceConstraintAlgorithm* referenceConstraintAlgorithm = getReferenceConstraintAlgorithm();
-   if (referenceConstraintAlgorithm)
-      referenceConstraintAlgorithm->apply(atomCoordinates, xPrime, inverseMasses, tolerance);
-   
-   // Update the positions and velocities.
-   
+}
+
+/**---------------------------------------------------------------------------------------
+
+   Second update: after constraints have been applied, compute the velocities and
+   copy xPrime to the atom coordinates
+
+   @param numberOfAtoms       number of atoms
+   @param atomCoordinates     atom coordinates
+   @param velocities          velocities
+   @param inverseMasses       inverse atom masses
+   @param xPrime              xPrime
+
+   --------------------------------------------------------------------------------------- */
+
+void ReferenceBrownianDynamics::updatePart2(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                            vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
    RealOpenMM velocityScale = static_cast<RealOpenMM>(1.0/getDeltaT());
    for (int i = 0; i < numberOfAtoms; ++i) {
-       if (masses[i] != zero)
+       if (inverseMasses[i] != 0.0)
            for (int j = 0; j < 3; ++j) {
                velocities[i][j] = velocityScale*(xPrime[i][j] - atomCoordinates[i][j]);
                atomCoordinates[i][j] = xPrime[i][j];
            }
    }
-   ReferenceVirtualSites::computePositions(system, atomCoordinates);
-   incrementTimeStep();
 }
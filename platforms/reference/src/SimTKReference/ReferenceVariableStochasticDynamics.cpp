@@ -118,6 +118,29 @@ RealOpenMM ReferenceVariableStochasticDynamics::getTau() const {
    return _tau;
 }
 
+/**---------------------------------------------------------------------------------------
+
+   Compute the RMS acceleration, which is used to estimate the integration error
+
+   @param numberOfAtoms       number of atoms
+   @param forces              forces
+   @param inverseMasses       inverse atom masses
+
+   @return the error estimate
+
+   --------------------------------------------------------------------------------------- */
+
+RealOpenMM ReferenceVariableStochasticDynamics::computeErrorNorm(int numberOfAtoms, vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses) {
+    RealOpenMM error = 0;
+    for (int i = 0; i < numberOfAtoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            RealOpenMM xerror = inverseMasses[i]*forces[i][j];
+            error += xerror*xerror;
+        }
+    }
+    return SQRT(error/(numberOfAtoms*3));
+}
+
 /**---------------------------------------------------------------------------------------
 
    First SD update; based on code in update.c do_update_sd() Gromacs 3.1.4
@@ -126,17 +149,15 @@ RealOpenMM ReferenceVariableStochasticDynamics::getTau() const {
    @param atomCoordinates     atom coordinates
    @param velocities          velocities
    @param forces              forces
-   @param masses              atom masses
    @param inverseMasses       inverse atom masses
    @param xPrime              xPrime
-   @param maxStepSize         maximum time step
 
    --------------------------------------------------------------------------------------- */
 
 void ReferenceVariableStochasticDynamics::updatePart1(int numberOfAtoms, vector<RealVec>& atomCoordinates,
                                               vector<RealVec>& velocities,
-                                              vector<RealVec>& forces, vector<RealOpenMM>& masses, vector<RealOpenMM>& inverseMasses,
-                                              vector<RealVec>& xPrime, RealOpenMM maxStepSize) {
+                                              vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses,
+                                              vector<RealVec>& xPrime) {
 
    // ---------------------------------------------------------------------------------------
 
@@ -144,39 +165,7 @@ void ReferenceVariableStochasticDynamics::updatePart1(int numberOfAtoms, vector<
 
    // ---------------------------------------------------------------------------------------
 
-
-   // first-time-through initialization
-
-   if (getTimeStep() == 0) {
-      // invert masses
-
-      for (int ii = 0; ii < numberOfAtoms; ii++) {
-         if (masses[ii] == 0)
-             inverseMasses[ii] = 0;
-         else
-             inverseMasses[ii] = 1/masses[ii];
-      }
-   }
-
-   // Select the step size to use
-    RealOpenMM error = 0;
-    for (int i = 0; i < numberOfAtoms; ++i) {
-        for (int j = 0; j < 3; ++j) {
-            RealOpenMM xerror = inverseMasses[i]*forces[i][j];
-            error += xerror*xerror;
-        }
-    }
-    error = SQRT(error/(numberOfAtoms*3));
-    RealOpenMM newStepSize = SQRT(getAccuracy()/error);
-    if (getDeltaT() > 0.0f)
-        newStepSize = std::min(newStepSize, getDeltaT()*2.0f); // For safety, limit how quickly dt can increase.
-    if (newStepSize > getDeltaT() && newStepSize < 1.2f*getDeltaT())
-        newStepSize = getDeltaT(); // Keeping dt constant between steps improves the behavior of the integrator.
-    if (newStepSize > maxStepSize)
-        newStepSize = maxStepSize;
-    setDeltaT(newStepSize);
- 
-    // perform first update
+   // perform first update
 
    RealOpenMM tau = getTau();
    const RealOpenMM vscale = EXP(-getDeltaT()/tau);
@@ -185,7 +174,7 @@ void ReferenceVariableStochasticDynamics::updatePart1(int numberOfAtoms, vector<
    const RealOpenMM noisescale = SQRT(2*kT/tau)*SQRT(0.5*(1-vscale*vscale)*tau);
 
    for (int ii = 0; ii < numberOfAtoms; ii++) {
-       if (masses[ii] != 0) {
+       if (inverseMasses[ii] != 0) {
            RealOpenMM sqrtInvMass = SQRT(inverseMasses[ii]);
            for (int jj = 0; jj < 3; jj++) {
                velocities[ii][jj]  = vscale*velocities[ii][jj] + fscale*inverseMasses[ii]*forces[ii][jj] + noisescale*sqrtInvMass*SimTKOpenMMUtilities::getNormallyDistributedRandomNumber();
@@ -251,10 +240,35 @@ void ReferenceVariableStochasticDynamics::update(const OpenMM::System& system, v
 
    // ---------------------------------------------------------------------------------------
 
-   // 1st update
+   // first-time-through initialization
 
    int numberOfAtoms = system.getNumParticles();
-   updatePart1(numberOfAtoms, atomCoordinates, velocities, forces, masses, inverseMasses, xPrime, maxStepSize);
+   if (getTimeStep() == 0) {
+      // invert masses
+
+      for (int ii = 0; ii < numberOfAtoms; ii++) {
+         if (masses[ii] == 0)
+             inverseMasses[ii] = 0;
+         else
+             inverseMasses[ii] = 1/masses[ii];
+      }
+   }
+
+   // Select the step size to use
+
+    RealOpenMM error = computeErrorNorm(numberOfAtoms, forces, inverseMasses);
+    RealOpenMM newStepSize = SQRT(getAccuracy()/error);
+    if (getDeltaT() > 0.0f)
+        newStepSize = std::min(newStepSize, getDeltaT()*2.0f); // For safety, limit how quickly dt can increase.
+    if (newStepSize > getDeltaT() && newStepSize < 1.2f*getDeltaT())
+        newStepSize = getDeltaT(); // Keeping dt constant between steps improves the behavior of the integrator.
+    if (newStepSize > maxStepSize)
+        newStepSize = maxStepSize;
+    setDeltaT(newStepSize);
+
+   // 1st update
+
+   updatePart1(numberOfAtoms, atomCoordinates, velocities, forces, inverseMasses, xPrime);
 
    // 2nd update
 
@@ -128,14 +128,7 @@ void ReferenceVariableVerletDynamics::update(const OpenMM::System& system, vecto
        }
     }
 
-    RealOpenMM error = zero;
-    for (int i = 0; i < numberOfAtoms; ++i) {
-        for (int j = 0; j < 3; ++j) {
-            RealOpenMM xerror = inverseMasses[i]*forces[i][j];
-            error += xerror*xerror;
-        }
-    }
-    error = SQRT(error/(numberOfAtoms*3));
+    RealOpenMM error = computeErrorNorm(numberOfAtoms, forces, inverseMasses);
     RealOpenMM newStepSize = SQRT(getAccuracy()/error);
     if (getDeltaT() > 0.0f)
         newStepSize = std::min(newStepSize, getDeltaT()*2.0f); // For safety, limit how quickly dt can increase.
@@ -145,29 +138,88 @@ void ReferenceVariableVerletDynamics::update(const OpenMM::System& system, vecto
         newStepSize = maxStepSize;
     RealOpenMM vstep = 0.5f*(newStepSize+getDeltaT()); // The time interval by which to advance the velocities
     setDeltaT(newStepSize);
-    for (int i = 0; i < numberOfAtoms; ++i) {
-        if (masses[i] != zero)
-            for (int j = 0; j < 3; ++j) {
-                RealOpenMM vPrime = velocities[i][j] + inverseMasses[i]*forces[i][j]*vstep;
-                xPrime[i][j] = atomCoordinates[i][j] + vPrime*getDeltaT();
-            }
-    }
+    updatePart1(numberOfAtoms, atomCoordinates, velocities, forces, inverseMasses, xPrime, vstep);
     ReferenceConstraintAlgorithm* referenceConstraintAlgorithm = getReferenceConstraintAlgorithm();
     if (referenceConstraintAlgorithm)
         referenceConstraintAlgorithm->apply(atomCoordinates, xPrime, inverseMasses, tolerance);
 
    // Update the positions and velocities.
 
-   RealOpenMM velocityScale = one/getDeltaT();
-   for (int i = 0; i < numberOfAtoms; ++i) {
-       if (masses[i] != zero)
-           for (int j = 0; j < 3; ++j) {
-               velocities[i][j] = velocityScale*(xPrime[i][j] - atomCoordinates[i][j]);
-               atomCoordinates[i][j] = xPrime[i][j];
-           }
-   }
+   updatePart2(numberOfAtoms, atomCoordinates, velocities, inverseMasses, xPrime);
    ReferenceVirtualSites::computePositions(system, atomCoordinates);
    incrementTimeStep();
 }
 
+/**---------------------------------------------------------------------------------------
+
+   Compute the RMS acceleration, which is used to estimate the integration error
+
+   @param numberOfAtoms       number of atoms
+   @param forces              forces
+   @param inverseMasses       inverse atom masses
+
+   @return the error estimate
+
+   --------------------------------------------------------------------------------------- */
+
+RealOpenMM ReferenceVariableVerletDynamics::computeErrorNorm(int numberOfAtoms, vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses) {
+    RealOpenMM error = 0.0;
+    for (int i = 0; i < numberOfAtoms; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            RealOpenMM xerror = inverseMasses[i]*forces[i][j];
+            error += xerror*xerror;
+        }
+    }
+    return SQRT(error/(numberOfAtoms*3));
+}
+
+/**---------------------------------------------------------------------------------------
 
+   First update: advance the velocities and compute the unconstrained positions
+
+   @param numberOfAtoms       number of atoms
+   @param atomCoordinates     atom coordinates
+   @param velocities          velocities
+   @param forces              forces
+   @param inverseMasses       inverse atom masses
+   @param xPrime              xPrime
+   @param vstep               the time interval by which to advance the velocities
+
+   --------------------------------------------------------------------------------------- */
+
+void ReferenceVariableVerletDynamics::updatePart1(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                                  vector<RealVec>& forces, vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime,
+                                                  RealOpenMM vstep) {
+    for (int i = 0; i < numberOfAtoms; ++i) {
+        if (inverseMasses[i] != 0.0)
+            for (int j = 0; j < 3; ++j) {
+                RealOpenMM vPrime = velocities[i][j] + inverseMasses[i]*forces[i][j]*vstep;
+                xPrime[i][j] = atomCoordinates[i][j] + vPrime*getDeltaT();
+            }
+    }
+}
+
+/**---------------------------------------------------------------------------------------
+
+   Second update: after constraints have been applied, compute the velocities and
+   copy xPrime to the atom coordinates
+
+   @param numberOfAtoms       number of atoms
+   @param atomCoordinates     atom coordinates
+   @param velocities          velocities
+   @param inverseMasses       inverse atom masses
+   @param xPrime              xPrime
+
+   --------------------------------------------------------------------------------------- */
+
+void ReferenceVariableVerletDynamics::updatePart2(int numberOfAtoms, vector<RealVec>& atomCoordinates, vector<RealVec>& velocities,
+                                                  vector<RealOpenMM>& inverseMasses, vector<RealVec>& xPrime) {
+    RealOpenMM velocityScale = 1.0/getDeltaT();
+    for (int i = 0; i < numberOfAtoms; ++i) {
+        if (inverseMasses[i] != 0.0)
+            for (int j = 0; j < 3; ++j) {
+                velocities[i][j] = velocityScale*(xPrime[i][j] - atomCoordinates[i][j]);
+                atomCoordinates[i][j] = xPrime[i][j];
+            }
+    }
+}
@@ -176,10 +176,57 @@ void testSetState() {
     }
 }
 
+void testAsyncCheckpoint() {
+    const int numParticles = 10;
+    const double boxSize = 3.0;
+    System system;
+    NonbondedForce* nonbonded = new NonbondedForce();
+    system.addForce(nonbonded);
+    nonbonded->setNonbondedMethod(NonbondedForce::CutoffPeriodic);
+    vector<Vec3> positions(numParticles);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(1.0);
+        nonbonded->addParticle(i%2 == 0 ? 0.1 : -0.1, 0.2, 0.1);
+        positions[i] = Vec3(boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt), boxSize*genrand_real2(sfmt));
+    }
+    VerletIntegrator integrator(0.001);
+    Context context(system, integrator, platform);
+    context.setPositions(positions);
+    context.setPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    integrator.step(10);
+    
+    // Write a checkpoint asynchronously, keep simulating while it is written, and then write
+    // another one.
+    
+    State s1 = context.getState(State::Positions | State::Velocities | State::Parameters);
+    stringstream sync1(ios_base::out | ios_base::in | ios_base::binary);
+    stringstream async1(ios_base::out | ios_base::in | ios_base::binary);
+    stringstream async2(ios_base::out | ios_base::in | ios_base::binary);
+    context.createCheckpoint(sync1);
+    context.createCheckpointAsync(async1);
+    integrator.step(10);
+    State s2 = context.getState(State::Positions | State::Velocities | State::Parameters);
+    context.createCheckpointAsync(async2);
+    context.waitForCheckpoint();
+    
+    // The data should be identical to a synchronous checkpoint, and loading it should restore the state.
+    
+    ASSERT(sync1.str() == async1.str());
+    context.loadCheckpoint(async1);
+    State s3 = context.getState(State::Positions | State::Velocities | State::Parameters);
+    compareStates(s1, s3);
+    context.loadCheckpoint(async2);
+    State s4 = context.getState(State::Positions | State::Velocities | State::Parameters);
+    compareStates(s2, s4);
+}
+
 int main() {
     try {
         testCheckpoint();
         testSetState();
+        testAsyncCheckpoint();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
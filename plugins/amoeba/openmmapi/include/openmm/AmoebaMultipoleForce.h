@@ -79,7 +79,14 @@ public:
         /**
          * Direct polarization
          */
-        Direct = 1
+        Direct = 1,
+
+        /**
+         * Extrapolated perturbation theory approximation to mutual polarization.  The induced dipoles are
+         * a fixed linear combination of the first few terms of the perturbation series for the mutual
+         * dipoles, so no iterative solve is needed.  See setExtrapolationCoefficients().
+         */
+        Extrapolated = 2
     };
 
     enum MultipoleAxisTypes { ZThenX = 0, Bisector = 1, ZBisect = 2, ThreeFold = 3, ZOnly = 4, NoAxisType = 5, LastAxisTypeIndex = 6 };
@@ -282,6 +289,26 @@ public:
      */
     void setMutualInducedTargetEpsilon(double inputMutualInducedTargetEpsilon);
 
+    /**
+     * Get the coefficients used for extrapolated polarization.  Element k is the weight given to the k'th
+     * order approximation to the mutual induced dipoles, where order 0 is the direct dipoles and each higher
+     * order applies one more step of the perturbation series.  Computing the dipoles requires one induced
+     * dipole field evaluation per coefficient after the first.
+     *
+     * @param coefficients    output vector of extrapolation coefficients
+     */
+    void getExtrapolationCoefficients(std::vector<double>& coefficients) const;
+
+    /**
+     * Set the coefficients used for extrapolated polarization.  Element k is the weight given to the k'th
+     * order approximation to the mutual induced dipoles, where order 0 is the direct dipoles and each higher
+     * order applies one more step of the perturbation series.  The default values correspond to the OPT3
+     * scheme of Simmonett et al.
+     *
+     * @param coefficients    the extrapolation coefficients
+     */
+    void setExtrapolationCoefficients(const std::vector<double>& coefficients);
+
     /**
      * Get the error tolerance for Ewald summation.  This corresponds to the fractional error in the forces
      * which is acceptable.  This value is used to select the grid dimensions and separation (alpha)
@@ -369,6 +396,7 @@ private:
     std::vector<int> pmeGridDimension;
     int mutualInducedMaxIterations;
     double mutualInducedTargetEpsilon;
+    std::vector<double> extrapolationCoefficients;
     double scalingDistanceCutoff;
     double electricConstant;
     double ewaldErrorTol;
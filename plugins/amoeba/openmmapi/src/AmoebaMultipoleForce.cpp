@@ -43,6 +43,10 @@ AmoebaMultipoleForce::AmoebaMultipoleForce() : nonbondedMethod(NoCutoff), polari
                                                mutualInducedTargetEpsilon(1.0e-02), scalingDistanceCutoff(100.0), electricConstant(138.9354558456), aewald(0.0) {
     pmeGridDimension.resize(3);
     pmeGridDimension[0] = pmeGridDimension[1] = pmeGridDimension[2];
+    extrapolationCoefficients.push_back(-0.154);
+    extrapolationCoefficients.push_back(0.017);
+    extrapolationCoefficients.push_back(0.658);
+    extrapolationCoefficients.push_back(0.474);
 }
 
 AmoebaMultipoleForce::NonbondedMethod AmoebaMultipoleForce::getNonbondedMethod() const {
@@ -119,6 +123,14 @@ void AmoebaMultipoleForce::setMutualInducedTargetEpsilon(double inputMutualInduc
     mutualInducedTargetEpsilon = inputMutualInducedTargetEpsilon;
 }
 
+void AmoebaMultipoleForce::getExtrapolationCoefficients(std::vector<double>& coefficients) const {
+    coefficients = extrapolationCoefficients;
+}
+
+void AmoebaMultipoleForce::setExtrapolationCoefficients(const std::vector<double>& coefficients) {
+    extrapolationCoefficients = coefficients;
+}
+
 double AmoebaMultipoleForce::getEwaldErrorTolerance() const {
     return ewaldErrorTol;
 }
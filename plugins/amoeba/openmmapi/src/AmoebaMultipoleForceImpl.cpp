@@ -63,6 +63,13 @@ void AmoebaMultipoleForceImpl::initialize(ContextImpl& context) {
             throw OpenMMException("AmoebaMultipoleForce: The cutoff distance cannot be greater than half the periodic box size.");
     }   
 
+    if (owner.getPolarizationType() == AmoebaMultipoleForce::Extrapolated) {
+        std::vector<double> coefficients;
+        owner.getExtrapolationCoefficients(coefficients);
+        if (coefficients.size() == 0)
+            throw OpenMMException("AmoebaMultipoleForce: Extrapolated polarization requires at least one extrapolation coefficient.");
+    }
+
     double quadrupoleValidationTolerance = 1.0e-05;
     for (int ii = 0; ii < system.getNumParticles(); ii++) {
 
@@ -0,0 +1,89 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "AmoebaCpuKernelFactory.h"
+#include "CpuAmoebaKernels.h"
+#include "CpuPlatform.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/OpenMMException.h"
+
+using namespace OpenMM;
+
+/**
+ * This library links against the reference AMOEBA library, which also exports registerKernelFactories(),
+ * so do the work in a function with internal linkage to be sure the right one gets called.
+ */
+static void registerCpuKernelFactories() {
+    for (int i = 0; i < Platform::getNumPlatforms(); i++) {
+        Platform& platform = Platform::getPlatform(i);
+        if (dynamic_cast<CpuPlatform*>(&platform) != NULL) {
+            AmoebaCpuKernelFactory* factory = new AmoebaCpuKernelFactory();
+            platform.registerKernelFactory(CalcAmoebaBondForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaAngleForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaInPlaneAngleForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaPiTorsionForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaStretchBendForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaOutOfPlaneBendForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaTorsionTorsionForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaMultipoleForceKernel::Name(), factory);
+            platform.registerKernelFactory(CalcAmoebaVdwForceKernel::Name(), factory);
+        }
+    }
+}
+
+extern "C" OPENMM_EXPORT void registerPlatforms() {
+}
+
+extern "C" OPENMM_EXPORT void registerKernelFactories() {
+    registerCpuKernelFactories();
+}
+
+extern "C" OPENMM_EXPORT void registerAmoebaCpuKernelFactories() {
+    registerCpuKernelFactories();
+}
+
+KernelImpl* AmoebaCpuKernelFactory::createKernelImpl(std::string name, const Platform& platform, ContextImpl& context) const {
+    CpuPlatform::PlatformData& data = CpuPlatform::getPlatformData(context);
+    if (name == CalcAmoebaBondForceKernel::Name())
+        return new CpuCalcAmoebaBondForceKernel(name, platform, data);
+    if (name == CalcAmoebaAngleForceKernel::Name())
+        return new CpuCalcAmoebaAngleForceKernel(name, platform, data);
+    if (name == CalcAmoebaInPlaneAngleForceKernel::Name())
+        return new CpuCalcAmoebaInPlaneAngleForceKernel(name, platform, data);
+    if (name == CalcAmoebaPiTorsionForceKernel::Name())
+        return new CpuCalcAmoebaPiTorsionForceKernel(name, platform, data);
+    if (name == CalcAmoebaStretchBendForceKernel::Name())
+        return new CpuCalcAmoebaStretchBendForceKernel(name, platform, data);
+    if (name == CalcAmoebaOutOfPlaneBendForceKernel::Name())
+        return new CpuCalcAmoebaOutOfPlaneBendForceKernel(name, platform, data);
+    if (name == CalcAmoebaTorsionTorsionForceKernel::Name())
+        return new CpuCalcAmoebaTorsionTorsionForceKernel(name, platform, data);
+    if (name == CalcAmoebaMultipoleForceKernel::Name())
+        return new CpuCalcAmoebaMultipoleForceKernel(name, platform, context.getSystem(), data);
+    if (name == CalcAmoebaVdwForceKernel::Name())
+        return new CpuCalcAmoebaVdwForceKernel(name, platform, data);
+    throw OpenMMException((std::string("Tried to create kernel with illegal kernel name '")+name+"'").c_str());
+}
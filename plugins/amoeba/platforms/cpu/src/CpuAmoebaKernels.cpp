@@ -0,0 +1,776 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+#include "CpuAmoebaKernels.h"
+#include "CpuAmoebaMultipoleForce.h"
+#include "CpuAmoebaPmeMultipoleForce.h"
+#include "AmoebaReferenceBondForce.h"
+#include "AmoebaReferenceAngleForce.h"
+#include "AmoebaReferenceInPlaneAngleForce.h"
+#include "AmoebaReferencePiTorsionForce.h"
+#include "AmoebaReferenceStretchBendForce.h"
+#include "AmoebaReferenceOutOfPlaneBendForce.h"
+#include "AmoebaReferenceTorsionTorsionForce.h"
+#include "ReferenceBondIxn.h"
+#include "ReferencePlatform.h"
+#include "openmm/internal/AmoebaTorsionTorsionForceImpl.h"
+#include "openmm/internal/AmoebaVdwForceImpl.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/OpenMMException.h"
+#include <cmath>
+#include <set>
+
+using namespace OpenMM;
+using namespace std;
+
+static vector<RealVec>& extractPositions(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->positions);
+}
+
+static vector<RealVec>& extractForces(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->forces);
+}
+
+static RealVec* extractBoxVectors(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return (RealVec*) data->periodicBoxVectors;
+}
+
+/**
+ * Allocate the arrays of atom indices and parameters used by CpuBondForce.
+ */
+static void allocateBondArrays(int numBonds, int numAtomsPerBond, int numParams, int**& indexArray, RealOpenMM**& paramArray) {
+    indexArray = new int*[numBonds];
+    paramArray = new RealOpenMM*[numBonds];
+    for (int i = 0; i < numBonds; i++) {
+        indexArray[i] = new int[numAtomsPerBond];
+        paramArray[i] = new RealOpenMM[numParams];
+    }
+}
+
+static void deleteBondArrays(int numBonds, int** indexArray, RealOpenMM** paramArray) {
+    if (indexArray != NULL) {
+        for (int i = 0; i < numBonds; i++) {
+            delete[] indexArray[i];
+            delete[] paramArray[i];
+        }
+        delete[] indexArray;
+        delete[] paramArray;
+    }
+}
+
+/**
+ * The following classes adapt the per-interaction routines of the reference AMOEBA forces to the ReferenceBondIxn
+ * interface expected by CpuBondForce.  Each one adds the forces with the same sign convention as the corresponding
+ * reference loop.
+ */
+
+class CpuAmoebaBondIxn : public ReferenceBondIxn, private AmoebaReferenceBondForce {
+public:
+    CpuAmoebaBondIxn(RealOpenMM cubic, RealOpenMM quartic) : cubic(cubic), quartic(quartic) {
+    }
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec bondForces[2];
+        RealOpenMM energy = AmoebaReferenceBondForce::calculateBondIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                parameters[0], parameters[1], cubic, quartic, bondForces);
+        for (int i = 0; i < 2; i++)
+            forces[atomIndices[i]] += bondForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+private:
+    RealOpenMM cubic, quartic;
+};
+
+class CpuAmoebaAngleIxn : public ReferenceBondIxn, private AmoebaReferenceAngleForce {
+public:
+    CpuAmoebaAngleIxn(RealOpenMM cubic, RealOpenMM quartic, RealOpenMM pentic, RealOpenMM sextic) :
+            cubic(cubic), quartic(quartic), pentic(pentic), sextic(sextic) {
+    }
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec angleForces[3];
+        RealOpenMM energy = AmoebaReferenceAngleForce::calculateAngleIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], parameters[0], parameters[1], cubic, quartic, pentic, sextic, angleForces);
+        for (int i = 0; i < 3; i++)
+            forces[atomIndices[i]] += angleForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+private:
+    RealOpenMM cubic, quartic, pentic, sextic;
+};
+
+class CpuAmoebaInPlaneAngleIxn : public ReferenceBondIxn, private AmoebaReferenceInPlaneAngleForce {
+public:
+    CpuAmoebaInPlaneAngleIxn(RealOpenMM cubic, RealOpenMM quartic, RealOpenMM pentic, RealOpenMM sextic) :
+            cubic(cubic), quartic(quartic), pentic(pentic), sextic(sextic) {
+    }
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec angleForces[4];
+        RealOpenMM energy = AmoebaReferenceInPlaneAngleForce::calculateAngleIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], atomCoordinates[atomIndices[3]], parameters[0], parameters[1], cubic, quartic, pentic, sextic, angleForces);
+        for (int i = 0; i < 4; i++)
+            forces[atomIndices[i]] -= angleForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+private:
+    RealOpenMM cubic, quartic, pentic, sextic;
+};
+
+class CpuAmoebaPiTorsionIxn : public ReferenceBondIxn, private AmoebaReferencePiTorsionForce {
+public:
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec torsionForces[6];
+        RealOpenMM energy = AmoebaReferencePiTorsionForce::calculatePiTorsionIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], atomCoordinates[atomIndices[3]], atomCoordinates[atomIndices[4]], atomCoordinates[atomIndices[5]],
+                parameters[0], torsionForces);
+        for (int i = 0; i < 6; i++)
+            forces[atomIndices[i]] -= torsionForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+};
+
+class CpuAmoebaStretchBendIxn : public ReferenceBondIxn, private AmoebaReferenceStretchBendForce {
+public:
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec stretchBendForces[3];
+        RealOpenMM energy = AmoebaReferenceStretchBendForce::calculateStretchBendIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], parameters[0], parameters[1], parameters[2], parameters[3], parameters[4], stretchBendForces);
+        for (int i = 0; i < 3; i++)
+            forces[atomIndices[i]] -= stretchBendForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+};
+
+class CpuAmoebaOutOfPlaneBendIxn : public ReferenceBondIxn, private AmoebaReferenceOutOfPlaneBendForce {
+public:
+    CpuAmoebaOutOfPlaneBendIxn(RealOpenMM cubic, RealOpenMM quartic, RealOpenMM pentic, RealOpenMM sextic) :
+            cubic(cubic), quartic(quartic), pentic(pentic), sextic(sextic) {
+    }
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec bendForces[4];
+        RealOpenMM energy = AmoebaReferenceOutOfPlaneBendForce::calculateOutOfPlaneBendIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], atomCoordinates[atomIndices[3]], parameters[0], cubic, quartic, pentic, sextic, bendForces);
+        for (int i = 0; i < 4; i++)
+            forces[atomIndices[i]] -= bendForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+private:
+    RealOpenMM cubic, quartic, pentic, sextic;
+};
+
+/**
+ * The parameters for a torsion-torsion are the index of the chiral check atom (or -1 if there is none) and the
+ * index of the grid.
+ */
+class CpuAmoebaTorsionTorsionIxn : public ReferenceBondIxn, private AmoebaReferenceTorsionTorsionForce {
+public:
+    CpuAmoebaTorsionTorsionIxn(const vector<vector<vector<vector<RealOpenMM> > > >& grids) : grids(grids) {
+    }
+    void calculateBondIxn(int* atomIndices, vector<RealVec>& atomCoordinates, RealOpenMM* parameters, vector<RealVec>& forces, RealOpenMM* totalEnergy) const {
+        RealVec torsionForces[5];
+        int chiralCheckAtomIndex = (int) parameters[0];
+        int gridIndex = (int) parameters[1];
+        const RealVec* chiralCheckAtom = (chiralCheckAtomIndex > -1 ? &atomCoordinates[chiralCheckAtomIndex] : NULL);
+        RealOpenMM energy = AmoebaReferenceTorsionTorsionForce::calculateTorsionTorsionIxn(atomCoordinates[atomIndices[0]], atomCoordinates[atomIndices[1]],
+                atomCoordinates[atomIndices[2]], atomCoordinates[atomIndices[3]], atomCoordinates[atomIndices[4]], chiralCheckAtom,
+                grids[gridIndex], torsionForces);
+        for (int i = 0; i < 5; i++)
+            forces[atomIndices[i]] -= torsionForces[i];
+        if (totalEnergy != NULL)
+            *totalEnergy += energy;
+    }
+private:
+    const vector<vector<vector<vector<RealOpenMM> > > >& grids;
+};
+
+/* -------------------------------------------------------------------------- *
+ *                               AmoebaBond                                   *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaBondForceKernel::~CpuCalcAmoebaBondForceKernel() {
+    deleteBondArrays(numBonds, bondIndexArray, bondParamArray);
+}
+
+void CpuCalcAmoebaBondForceKernel::initialize(const System& system, const AmoebaBondForce& force) {
+    numBonds = force.getNumBonds();
+    allocateBondArrays(numBonds, 2, 2, bondIndexArray, bondParamArray);
+    for (int i = 0; i < numBonds; i++) {
+        int particle1, particle2;
+        double length, k;
+        force.getBondParameters(i, particle1, particle2, length, k);
+        bondIndexArray[i][0] = particle1;
+        bondIndexArray[i][1] = particle2;
+        bondParamArray[i][0] = (RealOpenMM) length;
+        bondParamArray[i][1] = (RealOpenMM) k;
+    }
+    globalBondCubic = (RealOpenMM) force.getAmoebaGlobalBondCubic();
+    globalBondQuartic = (RealOpenMM) force.getAmoebaGlobalBondQuartic();
+    bondForce.initialize(system.getNumParticles(), numBonds, 2, bondIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaBondForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaBondIxn bondIxn(globalBondCubic, globalBondQuartic);
+    bondForce.calculateForce(posData, bondParamArray, forceData, includeEnergy ? &energy : NULL, bondIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaBondForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaBondForce& force) {
+    if (numBonds != force.getNumBonds())
+        throw OpenMMException("updateParametersInContext: The number of bonds has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numBonds; i++) {
+        int particle1, particle2;
+        double length, k;
+        force.getBondParameters(i, particle1, particle2, length, k);
+        if (particle1 != bondIndexArray[i][0] || particle2 != bondIndexArray[i][1])
+            throw OpenMMException("updateParametersInContext: The set of particles in a bond has changed");
+        bondParamArray[i][0] = (RealOpenMM) length;
+        bondParamArray[i][1] = (RealOpenMM) k;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                               AmoebaAngle                                  *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaAngleForceKernel::~CpuCalcAmoebaAngleForceKernel() {
+    deleteBondArrays(numAngles, angleIndexArray, angleParamArray);
+}
+
+void CpuCalcAmoebaAngleForceKernel::initialize(const System& system, const AmoebaAngleForce& force) {
+    numAngles = force.getNumAngles();
+    allocateBondArrays(numAngles, 3, 2, angleIndexArray, angleParamArray);
+    for (int i = 0; i < numAngles; i++) {
+        int particle1, particle2, particle3;
+        double angle, k;
+        force.getAngleParameters(i, particle1, particle2, particle3, angle, k);
+        angleIndexArray[i][0] = particle1;
+        angleIndexArray[i][1] = particle2;
+        angleIndexArray[i][2] = particle3;
+        angleParamArray[i][0] = (RealOpenMM) angle;
+        angleParamArray[i][1] = (RealOpenMM) k;
+    }
+    globalAngleCubic = (RealOpenMM) force.getAmoebaGlobalAngleCubic();
+    globalAngleQuartic = (RealOpenMM) force.getAmoebaGlobalAngleQuartic();
+    globalAnglePentic = (RealOpenMM) force.getAmoebaGlobalAnglePentic();
+    globalAngleSextic = (RealOpenMM) force.getAmoebaGlobalAngleSextic();
+    bondForce.initialize(system.getNumParticles(), numAngles, 3, angleIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaAngleForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaAngleIxn angleIxn(globalAngleCubic, globalAngleQuartic, globalAnglePentic, globalAngleSextic);
+    bondForce.calculateForce(posData, angleParamArray, forceData, includeEnergy ? &energy : NULL, angleIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaAngleForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaAngleForce& force) {
+    if (numAngles != force.getNumAngles())
+        throw OpenMMException("updateParametersInContext: The number of angles has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numAngles; i++) {
+        int particle1, particle2, particle3;
+        double angle, k;
+        force.getAngleParameters(i, particle1, particle2, particle3, angle, k);
+        if (particle1 != angleIndexArray[i][0] || particle2 != angleIndexArray[i][1] || particle3 != angleIndexArray[i][2])
+            throw OpenMMException("updateParametersInContext: The set of particles in an angle has changed");
+        angleParamArray[i][0] = (RealOpenMM) angle;
+        angleParamArray[i][1] = (RealOpenMM) k;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                            AmoebaInPlaneAngle                              *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaInPlaneAngleForceKernel::~CpuCalcAmoebaInPlaneAngleForceKernel() {
+    deleteBondArrays(numAngles, angleIndexArray, angleParamArray);
+}
+
+void CpuCalcAmoebaInPlaneAngleForceKernel::initialize(const System& system, const AmoebaInPlaneAngleForce& force) {
+    numAngles = force.getNumAngles();
+    allocateBondArrays(numAngles, 4, 2, angleIndexArray, angleParamArray);
+    for (int i = 0; i < numAngles; i++) {
+        int particle1, particle2, particle3, particle4;
+        double angle, k;
+        force.getAngleParameters(i, particle1, particle2, particle3, particle4, angle, k);
+        angleIndexArray[i][0] = particle1;
+        angleIndexArray[i][1] = particle2;
+        angleIndexArray[i][2] = particle3;
+        angleIndexArray[i][3] = particle4;
+        angleParamArray[i][0] = (RealOpenMM) angle;
+        angleParamArray[i][1] = (RealOpenMM) k;
+    }
+    globalAngleCubic = (RealOpenMM) force.getAmoebaGlobalInPlaneAngleCubic();
+    globalAngleQuartic = (RealOpenMM) force.getAmoebaGlobalInPlaneAngleQuartic();
+    globalAnglePentic = (RealOpenMM) force.getAmoebaGlobalInPlaneAnglePentic();
+    globalAngleSextic = (RealOpenMM) force.getAmoebaGlobalInPlaneAngleSextic();
+    bondForce.initialize(system.getNumParticles(), numAngles, 4, angleIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaInPlaneAngleForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaInPlaneAngleIxn angleIxn(globalAngleCubic, globalAngleQuartic, globalAnglePentic, globalAngleSextic);
+    bondForce.calculateForce(posData, angleParamArray, forceData, includeEnergy ? &energy : NULL, angleIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaInPlaneAngleForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaInPlaneAngleForce& force) {
+    if (numAngles != force.getNumAngles())
+        throw OpenMMException("updateParametersInContext: The number of angles has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numAngles; i++) {
+        int particle1, particle2, particle3, particle4;
+        double angle, k;
+        force.getAngleParameters(i, particle1, particle2, particle3, particle4, angle, k);
+        if (particle1 != angleIndexArray[i][0] || particle2 != angleIndexArray[i][1] || particle3 != angleIndexArray[i][2] || particle4 != angleIndexArray[i][3])
+            throw OpenMMException("updateParametersInContext: The set of particles in an angle has changed");
+        angleParamArray[i][0] = (RealOpenMM) angle;
+        angleParamArray[i][1] = (RealOpenMM) k;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                              AmoebaPiTorsion                               *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaPiTorsionForceKernel::~CpuCalcAmoebaPiTorsionForceKernel() {
+    deleteBondArrays(numPiTorsions, piTorsionIndexArray, piTorsionParamArray);
+}
+
+void CpuCalcAmoebaPiTorsionForceKernel::initialize(const System& system, const AmoebaPiTorsionForce& force) {
+    numPiTorsions = force.getNumPiTorsions();
+    allocateBondArrays(numPiTorsions, 6, 1, piTorsionIndexArray, piTorsionParamArray);
+    for (int i = 0; i < numPiTorsions; i++) {
+        int particles[6];
+        double k;
+        force.getPiTorsionParameters(i, particles[0], particles[1], particles[2], particles[3], particles[4], particles[5], k);
+        for (int j = 0; j < 6; j++)
+            piTorsionIndexArray[i][j] = particles[j];
+        piTorsionParamArray[i][0] = (RealOpenMM) k;
+    }
+    bondForce.initialize(system.getNumParticles(), numPiTorsions, 6, piTorsionIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaPiTorsionForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaPiTorsionIxn piTorsionIxn;
+    bondForce.calculateForce(posData, piTorsionParamArray, forceData, includeEnergy ? &energy : NULL, piTorsionIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaPiTorsionForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaPiTorsionForce& force) {
+    if (numPiTorsions != force.getNumPiTorsions())
+        throw OpenMMException("updateParametersInContext: The number of torsions has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numPiTorsions; i++) {
+        int particles[6];
+        double k;
+        force.getPiTorsionParameters(i, particles[0], particles[1], particles[2], particles[3], particles[4], particles[5], k);
+        for (int j = 0; j < 6; j++)
+            if (particles[j] != piTorsionIndexArray[i][j])
+                throw OpenMMException("updateParametersInContext: The set of particles in a torsion has changed");
+        piTorsionParamArray[i][0] = (RealOpenMM) k;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                             AmoebaStretchBend                              *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaStretchBendForceKernel::~CpuCalcAmoebaStretchBendForceKernel() {
+    deleteBondArrays(numStretchBends, stretchBendIndexArray, stretchBendParamArray);
+}
+
+void CpuCalcAmoebaStretchBendForceKernel::initialize(const System& system, const AmoebaStretchBendForce& force) {
+    numStretchBends = force.getNumStretchBends();
+    allocateBondArrays(numStretchBends, 3, 5, stretchBendIndexArray, stretchBendParamArray);
+    for (int i = 0; i < numStretchBends; i++) {
+        int particle1, particle2, particle3;
+        double lengthAB, lengthCB, angle, k1, k2;
+        force.getStretchBendParameters(i, particle1, particle2, particle3, lengthAB, lengthCB, angle, k1, k2);
+        stretchBendIndexArray[i][0] = particle1;
+        stretchBendIndexArray[i][1] = particle2;
+        stretchBendIndexArray[i][2] = particle3;
+        stretchBendParamArray[i][0] = (RealOpenMM) lengthAB;
+        stretchBendParamArray[i][1] = (RealOpenMM) lengthCB;
+        stretchBendParamArray[i][2] = (RealOpenMM) angle;
+        stretchBendParamArray[i][3] = (RealOpenMM) k1;
+        stretchBendParamArray[i][4] = (RealOpenMM) k2;
+    }
+    bondForce.initialize(system.getNumParticles(), numStretchBends, 3, stretchBendIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaStretchBendForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaStretchBendIxn stretchBendIxn;
+    bondForce.calculateForce(posData, stretchBendParamArray, forceData, includeEnergy ? &energy : NULL, stretchBendIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaStretchBendForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaStretchBendForce& force) {
+    if (numStretchBends != force.getNumStretchBends())
+        throw OpenMMException("updateParametersInContext: The number of stretch-bends has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numStretchBends; i++) {
+        int particle1, particle2, particle3;
+        double lengthAB, lengthCB, angle, k1, k2;
+        force.getStretchBendParameters(i, particle1, particle2, particle3, lengthAB, lengthCB, angle, k1, k2);
+        if (particle1 != stretchBendIndexArray[i][0] || particle2 != stretchBendIndexArray[i][1] || particle3 != stretchBendIndexArray[i][2])
+            throw OpenMMException("updateParametersInContext: The set of particles in a stretch-bend has changed");
+        stretchBendParamArray[i][0] = (RealOpenMM) lengthAB;
+        stretchBendParamArray[i][1] = (RealOpenMM) lengthCB;
+        stretchBendParamArray[i][2] = (RealOpenMM) angle;
+        stretchBendParamArray[i][3] = (RealOpenMM) k1;
+        stretchBendParamArray[i][4] = (RealOpenMM) k2;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                           AmoebaOutOfPlaneBend                             *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaOutOfPlaneBendForceKernel::~CpuCalcAmoebaOutOfPlaneBendForceKernel() {
+    deleteBondArrays(numOutOfPlaneBends, outOfPlaneBendIndexArray, outOfPlaneBendParamArray);
+}
+
+void CpuCalcAmoebaOutOfPlaneBendForceKernel::initialize(const System& system, const AmoebaOutOfPlaneBendForce& force) {
+    numOutOfPlaneBends = force.getNumOutOfPlaneBends();
+    allocateBondArrays(numOutOfPlaneBends, 4, 1, outOfPlaneBendIndexArray, outOfPlaneBendParamArray);
+    for (int i = 0; i < numOutOfPlaneBends; i++) {
+        int particle1, particle2, particle3, particle4;
+        double k;
+        force.getOutOfPlaneBendParameters(i, particle1, particle2, particle3, particle4, k);
+        outOfPlaneBendIndexArray[i][0] = particle1;
+        outOfPlaneBendIndexArray[i][1] = particle2;
+        outOfPlaneBendIndexArray[i][2] = particle3;
+        outOfPlaneBendIndexArray[i][3] = particle4;
+        outOfPlaneBendParamArray[i][0] = (RealOpenMM) k;
+    }
+    globalOutOfPlaneBendCubic = (RealOpenMM) force.getAmoebaGlobalOutOfPlaneBendCubic();
+    globalOutOfPlaneBendQuartic = (RealOpenMM) force.getAmoebaGlobalOutOfPlaneBendQuartic();
+    globalOutOfPlaneBendPentic = (RealOpenMM) force.getAmoebaGlobalOutOfPlaneBendPentic();
+    globalOutOfPlaneBendSextic = (RealOpenMM) force.getAmoebaGlobalOutOfPlaneBendSextic();
+    bondForce.initialize(system.getNumParticles(), numOutOfPlaneBends, 4, outOfPlaneBendIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaOutOfPlaneBendForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaOutOfPlaneBendIxn bendIxn(globalOutOfPlaneBendCubic, globalOutOfPlaneBendQuartic, globalOutOfPlaneBendPentic, globalOutOfPlaneBendSextic);
+    bondForce.calculateForce(posData, outOfPlaneBendParamArray, forceData, includeEnergy ? &energy : NULL, bendIxn);
+    return energy;
+}
+
+void CpuCalcAmoebaOutOfPlaneBendForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaOutOfPlaneBendForce& force) {
+    if (numOutOfPlaneBends != force.getNumOutOfPlaneBends())
+        throw OpenMMException("updateParametersInContext: The number of out-of-plane bends has changed");
+
+    // Record the values.
+
+    for (int i = 0; i < numOutOfPlaneBends; i++) {
+        int particle1, particle2, particle3, particle4;
+        double k;
+        force.getOutOfPlaneBendParameters(i, particle1, particle2, particle3, particle4, k);
+        if (particle1 != outOfPlaneBendIndexArray[i][0] || particle2 != outOfPlaneBendIndexArray[i][1] ||
+                particle3 != outOfPlaneBendIndexArray[i][2] || particle4 != outOfPlaneBendIndexArray[i][3])
+            throw OpenMMException("updateParametersInContext: The set of particles in an out-of-plane bend has changed");
+        outOfPlaneBendParamArray[i][0] = (RealOpenMM) k;
+    }
+}
+
+/* -------------------------------------------------------------------------- *
+ *                           AmoebaTorsionTorsion                             *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaTorsionTorsionForceKernel::~CpuCalcAmoebaTorsionTorsionForceKernel() {
+    deleteBondArrays(numTorsionTorsions, torsionTorsionIndexArray, torsionTorsionParamArray);
+}
+
+void CpuCalcAmoebaTorsionTorsionForceKernel::initialize(const System& system, const AmoebaTorsionTorsionForce& force) {
+    numTorsionTorsions = force.getNumTorsionTorsions();
+    allocateBondArrays(numTorsionTorsions, 5, 2, torsionTorsionIndexArray, torsionTorsionParamArray);
+    for (int i = 0; i < numTorsionTorsions; i++) {
+        int particles[5], chiralCheckAtom, gridIndex;
+        force.getTorsionTorsionParameters(i, particles[0], particles[1], particles[2], particles[3], particles[4], chiralCheckAtom, gridIndex);
+        for (int j = 0; j < 5; j++)
+            torsionTorsionIndexArray[i][j] = particles[j];
+        torsionTorsionParamArray[i][0] = (RealOpenMM) chiralCheckAtom;
+        torsionTorsionParamArray[i][1] = (RealOpenMM) gridIndex;
+    }
+
+    // Record the grids, reordering them if necessary so the x angle is the slow index.
+
+    int numGrids = force.getNumTorsionTorsionGrids();
+    torsionTorsionGrids.resize(numGrids);
+    for (int i = 0; i < numGrids; i++) {
+        const TorsionTorsionGrid& inputGrid = force.getTorsionTorsionGrid(i);
+        TorsionTorsionGrid reorderedGrid;
+        bool reorder = (inputGrid[0][0][0] != inputGrid[0][1][0]);
+        if (reorder)
+            AmoebaTorsionTorsionForceImpl::reorderGrid(inputGrid, reorderedGrid);
+        const TorsionTorsionGrid& grid = (reorder ? reorderedGrid : inputGrid);
+        torsionTorsionGrids[i].resize(grid.size());
+        for (int j = 0; j < (int) grid.size(); j++) {
+            torsionTorsionGrids[i][j].resize(grid[j].size());
+            for (int k = 0; k < (int) grid[j].size(); k++) {
+                torsionTorsionGrids[i][j][k].resize(grid[j][k].size());
+                for (int m = 0; m < (int) grid[j][k].size(); m++)
+                    torsionTorsionGrids[i][j][k][m] = (RealOpenMM) grid[j][k][m];
+            }
+        }
+    }
+    bondForce.initialize(system.getNumParticles(), numTorsionTorsions, 5, torsionTorsionIndexArray, data.threads);
+}
+
+double CpuCalcAmoebaTorsionTorsionForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& forceData = extractForces(context);
+    RealOpenMM energy = 0;
+    CpuAmoebaTorsionTorsionIxn torsionTorsionIxn(torsionTorsionGrids);
+    bondForce.calculateForce(posData, torsionTorsionParamArray, forceData, includeEnergy ? &energy : NULL, torsionTorsionIxn);
+    return energy;
+}
+
+/* -------------------------------------------------------------------------- *
+ *                             AmoebaMultipole                                *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaMultipoleForceKernel::CpuCalcAmoebaMultipoleForceKernel(string name, const Platform& platform, const System& system, CpuPlatform::PlatformData& data) :
+        ReferenceCalcAmoebaMultipoleForceKernel(name, platform, system), data(data), neighborList(NULL) {
+}
+
+CpuCalcAmoebaMultipoleForceKernel::~CpuCalcAmoebaMultipoleForceKernel() {
+    if (neighborList != NULL)
+        delete neighborList;
+}
+
+AmoebaReferenceMultipoleForce* CpuCalcAmoebaMultipoleForceKernel::createNoCutoffMultipoleForce(ContextImpl& context) {
+    return new CpuAmoebaMultipoleForce<AmoebaReferenceMultipoleForce>(data.threads, NULL);
+}
+
+AmoebaReferencePmeMultipoleForce* CpuCalcAmoebaMultipoleForceKernel::createPmeMultipoleForce(ContextImpl& context) {
+    // Convert the positions to single precision and wrap them into the periodic box.
+
+    vector<RealVec>& posData = extractPositions(context);
+    RealVec* boxVectors = extractBoxVectors(context);
+    int numParticles = posData.size();
+    if (positions.size() < 4*numParticles)
+        positions.resize(4*numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        RealVec pos = posData[i];
+        pos -= boxVectors[2]*floor(pos[2]/boxVectors[2][2]);
+        pos -= boxVectors[1]*floor(pos[1]/boxVectors[1][1]);
+        pos -= boxVectors[0]*floor(pos[0]/boxVectors[0][0]);
+        positions[4*i] = (float) pos[0];
+        positions[4*i+1] = (float) pos[1];
+        positions[4*i+2] = (float) pos[2];
+        positions[4*i+3] = 0.0f;
+    }
+
+    // Build the neighbor list.  Covalently bonded pairs interact with scaled strength rather than being omitted,
+    // so it contains no exclusions.  It is padded slightly to make sure no pair is lost to single precision
+    // rounding; the exact cutoff is applied when the interactions are computed.
+
+    if (neighborList == NULL) {
+        neighborList = new CpuNeighborList(4);
+        neighborList->setExclusions(vector<set<int> >(numParticles));
+    }
+    neighborList->computeNeighborList(numParticles, positions, boxVectors, true, (float) (1.01*cutoffDistance), data.threads);
+    return new CpuAmoebaPmeMultipoleForce(data.threads, neighborList);
+}
+
+/* -------------------------------------------------------------------------- *
+ *                                AmoebaVdw                                   *
+ * -------------------------------------------------------------------------- */
+
+CpuCalcAmoebaVdwForceKernel::~CpuCalcAmoebaVdwForceKernel() {
+    if (neighborList != NULL)
+        delete neighborList;
+}
+
+void CpuCalcAmoebaVdwForceKernel::initialize(const System& system, const AmoebaVdwForce& force) {
+    numParticles = force.getNumParticles();
+    exclusions.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        vector<int> particleExclusions;
+        force.getParticleExclusions(i, particleExclusions);
+        for (int j = 0; j < (int) particleExclusions.size(); j++) {
+            exclusions[i].insert(particleExclusions[j]);
+            exclusions[particleExclusions[j]].insert(i);
+        }
+    }
+    setParticleParameters(force);
+    vdw.setCombiningRules(force.getSigmaCombiningRule(), force.getEpsilonCombiningRule());
+    useCutoff = (force.getNonbondedMethod() != AmoebaVdwForce::NoCutoff);
+    usePeriodic = (force.getNonbondedMethod() == AmoebaVdwForce::CutoffPeriodic);
+    cutoff = force.getCutoff();
+    if (useCutoff) {
+        neighborList = new CpuNeighborList(4);
+        neighborList->setExclusions(exclusions);
+    }
+    lastPositions.resize(numParticles, Vec3(1e10, 1e10, 1e10));
+    if (force.getUseDispersionCorrection())
+        dispersionCoefficient = AmoebaVdwForceImpl::calcDispersionCorrection(system, force);
+    else
+        dispersionCoefficient = 0.0;
+}
+
+void CpuCalcAmoebaVdwForceKernel::setParticleParameters(const AmoebaVdwForce& force) {
+    vector<int> indexIVs(numParticles);
+    vector<float> sigmas(numParticles), epsilons(numParticles), reductions(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        double sigma, epsilon, reduction;
+        force.getParticleParameters(i, indexIVs[i], sigma, epsilon, reduction);
+        sigmas[i] = (float) sigma;
+        epsilons[i] = (float) epsilon;
+        reductions[i] = (float) reduction;
+    }
+    vdw.setParticleParameters(indexIVs, sigmas, epsilons, reductions, exclusions);
+}
+
+double CpuCalcAmoebaVdwForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    vector<RealVec>& posData = extractPositions(context);
+    RealVec* boxVectors = extractBoxVectors(context);
+    vdw.computeSitePositions(posData, sitePositions);
+    if (usePeriodic) {
+        double minAllowedSize = 1.999999*cutoff;
+        if (boxVectors[0][0] < minAllowedSize || boxVectors[1][1] < minAllowedSize || boxVectors[2][2] < minAllowedSize)
+            throw OpenMMException("The periodic box size has decreased to less than twice the cutoff.");
+        vdw.setPeriodic(boxVectors);
+    }
+
+    // Convert the site positions to single precision, wrapping them into the periodic box if necessary.
+
+    if (sitePosq.size() < 4*numParticles)
+        sitePosq.resize(4*numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        RealVec pos = sitePositions[i];
+        if (usePeriodic) {
+            pos -= boxVectors[2]*floor(pos[2]/boxVectors[2][2]);
+            pos -= boxVectors[1]*floor(pos[1]/boxVectors[1][1]);
+            pos -= boxVectors[0]*floor(pos[0]/boxVectors[0][0]);
+        }
+        sitePosq[4*i] = (float) pos[0];
+        sitePosq[4*i+1] = (float) pos[1];
+        sitePosq[4*i+2] = (float) pos[2];
+        sitePosq[4*i+3] = 0.0f;
+    }
+    if (useCutoff) {
+        // Determine whether we need to recompute the neighbor list.  It includes all pairs of sites within the
+        // cutoff plus a padding distance, so it remains valid until some pair that was outside the padded
+        // cutoff when it was built has moved inside the cutoff.
+
+        double padding = 0.15*cutoff;
+        bool needRecompute = false;
+        double closeCutoff2 = 0.25*padding*padding;
+        double farCutoff2 = 0.5*padding*padding;
+        int maxNumMoved = numParticles/10;
+        vector<int> moved;
+        for (int i = 0; i < numParticles; i++) {
+            RealVec delta = sitePositions[i]-lastPositions[i];
+            double dist2 = delta.dot(delta);
+            if (dist2 > closeCutoff2) {
+                moved.push_back(i);
+                if (dist2 > farCutoff2 || moved.size() > maxNumMoved) {
+                    needRecompute = true;
+                    break;
+                }
+            }
+        }
+        if (!needRecompute && moved.size() > 0) {
+            // Some sites have moved further than half the padding distance.  Look for pairs
+            // that are missing from the neighbor list.
+
+            int numMoved = moved.size();
+            double cutoff2 = cutoff*cutoff;
+            double paddedCutoff2 = (cutoff+padding)*(cutoff+padding);
+            for (int i = 1; i < numMoved && !needRecompute; i++)
+                for (int j = 0; j < i; j++) {
+                    RealVec delta = sitePositions[moved[i]]-sitePositions[moved[j]];
+                    if (delta.dot(delta) < cutoff2) {
+                        // These sites should interact.  See if they are in the neighbor list.
+                        
+                        RealVec oldDelta = lastPositions[moved[i]]-lastPositions[moved[j]];
+                        if (oldDelta.dot(oldDelta) > paddedCutoff2) {
+                            needRecompute = true;
+                            break;
+                        }
+                    }
+                }
+        }
+        if (needRecompute) {
+            neighborList->computeNeighborList(numParticles, sitePosq, boxVectors, usePeriodic, (float) (cutoff+padding), data.threads);
+            lastPositions = sitePositions;
+        }
+        vdw.setUseCutoff((float) cutoff, *neighborList);
+    }
+    double energy = 0.0;
+    vdw.computeForce(sitePosq, data.threadForce, includeEnergy ? &energy : NULL, data.threads);
+    if (usePeriodic)
+        energy += dispersionCoefficient/(boxVectors[0][0]*boxVectors[1][1]*boxVectors[2][2]);
+    return energy;
+}
+
+void CpuCalcAmoebaVdwForceKernel::copyParametersToContext(ContextImpl& context, const AmoebaVdwForce& force) {
+    if (numParticles != force.getNumParticles())
+        throw OpenMMException("updateParametersInContext: The number of particles has changed");
+    setParticleParameters(force);
+    if (force.getUseDispersionCorrection())
+        dispersionCoefficient = AmoebaVdwForceImpl::calcDispersionCorrection(context.getSystem(), force);
+    
+    // The sites may have moved, so make sure the neighbor list gets rebuilt.
+
+    lastPositions.assign(numParticles, Vec3(1e10, 1e10, 1e10));
+}
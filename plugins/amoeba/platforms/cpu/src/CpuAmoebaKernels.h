@@ -0,0 +1,396 @@
+#ifndef AMOEBA_CPU_KERNELS_H_
+#define AMOEBA_CPU_KERNELS_H_
+
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "AmoebaReferenceKernels.h"
+#include "CpuAmoebaVdwForce.h"
+#include "CpuBondForce.h"
+#include "CpuNeighborList.h"
+#include "CpuPlatform.h"
+#include "openmm/amoebaKernels.h"
+#include "openmm/AmoebaBondForce.h"
+#include "openmm/AmoebaAngleForce.h"
+#include "openmm/AmoebaInPlaneAngleForce.h"
+#include "openmm/AmoebaPiTorsionForce.h"
+#include "openmm/AmoebaStretchBendForce.h"
+#include "openmm/AmoebaOutOfPlaneBendForce.h"
+#include "openmm/AmoebaTorsionTorsionForce.h"
+#include "openmm/AmoebaVdwForce.h"
+#include "RealVec.h"
+#include <set>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This kernel is invoked by AmoebaBondForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaBondForceKernel : public CalcAmoebaBondForceKernel {
+public:
+    CpuCalcAmoebaBondForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaBondForceKernel(name, platform), data(data), bondIndexArray(NULL), bondParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaBondForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaBondForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaBondForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaBondForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaBondForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numBonds;
+    int **bondIndexArray;
+    RealOpenMM **bondParamArray;
+    RealOpenMM globalBondCubic, globalBondQuartic;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaAngleForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaAngleForceKernel : public CalcAmoebaAngleForceKernel {
+public:
+    CpuCalcAmoebaAngleForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaAngleForceKernel(name, platform), data(data), angleIndexArray(NULL), angleParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaAngleForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaAngleForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaAngleForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaAngleForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaAngleForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numAngles;
+    int **angleIndexArray;
+    RealOpenMM **angleParamArray;
+    RealOpenMM globalAngleCubic, globalAngleQuartic, globalAnglePentic, globalAngleSextic;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaInPlaneAngleForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaInPlaneAngleForceKernel : public CalcAmoebaInPlaneAngleForceKernel {
+public:
+    CpuCalcAmoebaInPlaneAngleForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaInPlaneAngleForceKernel(name, platform), data(data), angleIndexArray(NULL), angleParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaInPlaneAngleForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaInPlaneAngleForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaInPlaneAngleForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaInPlaneAngleForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaInPlaneAngleForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numAngles;
+    int **angleIndexArray;
+    RealOpenMM **angleParamArray;
+    RealOpenMM globalAngleCubic, globalAngleQuartic, globalAnglePentic, globalAngleSextic;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaPiTorsionForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaPiTorsionForceKernel : public CalcAmoebaPiTorsionForceKernel {
+public:
+    CpuCalcAmoebaPiTorsionForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaPiTorsionForceKernel(name, platform), data(data), piTorsionIndexArray(NULL), piTorsionParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaPiTorsionForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaPiTorsionForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaPiTorsionForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaPiTorsionForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaPiTorsionForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numPiTorsions;
+    int **piTorsionIndexArray;
+    RealOpenMM **piTorsionParamArray;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaStretchBendForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaStretchBendForceKernel : public CalcAmoebaStretchBendForceKernel {
+public:
+    CpuCalcAmoebaStretchBendForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaStretchBendForceKernel(name, platform), data(data), stretchBendIndexArray(NULL), stretchBendParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaStretchBendForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaStretchBendForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaStretchBendForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaStretchBendForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaStretchBendForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numStretchBends;
+    int **stretchBendIndexArray;
+    RealOpenMM **stretchBendParamArray;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaOutOfPlaneBendForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaOutOfPlaneBendForceKernel : public CalcAmoebaOutOfPlaneBendForceKernel {
+public:
+    CpuCalcAmoebaOutOfPlaneBendForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaOutOfPlaneBendForceKernel(name, platform), data(data), outOfPlaneBendIndexArray(NULL), outOfPlaneBendParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaOutOfPlaneBendForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaOutOfPlaneBendForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaOutOfPlaneBendForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaOutOfPlaneBendForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaOutOfPlaneBendForce& force);
+private:
+    CpuPlatform::PlatformData& data;
+    int numOutOfPlaneBends;
+    int **outOfPlaneBendIndexArray;
+    RealOpenMM **outOfPlaneBendParamArray;
+    RealOpenMM globalOutOfPlaneBendCubic, globalOutOfPlaneBendQuartic, globalOutOfPlaneBendPentic, globalOutOfPlaneBendSextic;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaTorsionTorsionForce to calculate the forces acting on the system and the energy of the system.
+ */
+class CpuCalcAmoebaTorsionTorsionForceKernel : public CalcAmoebaTorsionTorsionForceKernel {
+public:
+    CpuCalcAmoebaTorsionTorsionForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaTorsionTorsionForceKernel(name, platform), data(data), torsionTorsionIndexArray(NULL), torsionTorsionParamArray(NULL) {
+    }
+    ~CpuCalcAmoebaTorsionTorsionForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaTorsionTorsionForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaTorsionTorsionForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+private:
+    CpuPlatform::PlatformData& data;
+    int numTorsionTorsions;
+    int **torsionTorsionIndexArray;
+    RealOpenMM **torsionTorsionParamArray;
+    std::vector<std::vector<std::vector<std::vector<RealOpenMM> > > > torsionTorsionGrids;
+    CpuBondForce bondForce;
+};
+
+/**
+ * This kernel is invoked by AmoebaMultipoleForce to calculate the forces acting on the system and the energy of the system.
+ * It reuses all of the setup and bookkeeping of the reference kernel, but evaluates the particle pair loops (fixed multipole
+ * field, induced dipole field, and electrostatic interactions) in parallel.  With PME, the direct space pairs are taken from
+ * a neighbor list that is rebuilt each time the force is evaluated.
+ */
+class CpuCalcAmoebaMultipoleForceKernel : public ReferenceCalcAmoebaMultipoleForceKernel {
+public:
+    CpuCalcAmoebaMultipoleForceKernel(std::string name, const Platform& platform, const System& system, CpuPlatform::PlatformData& data);
+    ~CpuCalcAmoebaMultipoleForceKernel();
+protected:
+    AmoebaReferenceMultipoleForce* createNoCutoffMultipoleForce(ContextImpl& context);
+    AmoebaReferencePmeMultipoleForce* createPmeMultipoleForce(ContextImpl& context);
+private:
+    CpuPlatform::PlatformData& data;
+    CpuNeighborList* neighborList;
+    AlignedArray<float> positions;
+};
+
+/**
+ * This kernel is invoked by AmoebaVdwForce to calculate the forces acting on the system and the energy of the system.
+ * With a cutoff, it keeps a neighbor list of interaction sites from one step to the next, and only rebuilds it when
+ * the sites have moved far enough that some pair might be missing from it.
+ */
+class CpuCalcAmoebaVdwForceKernel : public CalcAmoebaVdwForceKernel {
+public:
+    CpuCalcAmoebaVdwForceKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            CalcAmoebaVdwForceKernel(name, platform), data(data), neighborList(NULL) {
+    }
+    ~CpuCalcAmoebaVdwForceKernel();
+    /**
+     * Initialize the kernel.
+     * 
+     * @param system     the System this kernel will be applied to
+     * @param force      the AmoebaVdwForce this kernel will be used for
+     */
+    void initialize(const System& system, const AmoebaVdwForce& force);
+    /**
+     * Execute the kernel to calculate the forces and/or energy.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param includeForces  true if forces should be calculated
+     * @param includeEnergy  true if the energy should be calculated
+     * @return the potential energy due to the force
+     */
+    double execute(ContextImpl& context, bool includeForces, bool includeEnergy);
+    /**
+     * Copy changed parameters over to a context.
+     *
+     * @param context    the context to copy parameters to
+     * @param force      the AmoebaVdwForce to copy the parameters from
+     */
+    void copyParametersToContext(ContextImpl& context, const AmoebaVdwForce& force);
+private:
+    void setParticleParameters(const AmoebaVdwForce& force);
+    CpuPlatform::PlatformData& data;
+    int numParticles;
+    bool useCutoff, usePeriodic;
+    double cutoff, dispersionCoefficient;
+    std::vector<std::set<int> > exclusions;
+    std::vector<RealVec> sitePositions, lastPositions;
+    AlignedArray<float> sitePosq;
+    CpuNeighborList* neighborList;
+    CpuAmoebaVdwForce vdw;
+};
+
+} // namespace OpenMM
+
+#endif /*AMOEBA_CPU_KERNELS_H_*/
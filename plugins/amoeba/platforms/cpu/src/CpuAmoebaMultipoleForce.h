@@ -0,0 +1,262 @@
+#ifndef OPENMM_CPU_AMOEBA_MULTIPOLE_FORCE_H_
+#define OPENMM_CPU_AMOEBA_MULTIPOLE_FORCE_H_
+
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "AmoebaReferenceMultipoleForce.h"
+#include "CpuNeighborList.h"
+#include "gmx_atomic.h"
+#include "openmm/internal/ThreadPool.h"
+#include <algorithm>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class parallelizes the particle pair loops of an AmoebaReferenceMultipoleForce: the fixed multipole
+ * field, the field due to induced dipoles (evaluated on every iteration of the induced dipole solver), and
+ * the electrostatic forces and torques.  Everything else is inherited unchanged from BASE, which should be
+ * either AmoebaReferenceMultipoleForce (for no cutoff) or AmoebaReferencePmeMultipoleForce.  The reciprocal
+ * space part of PME is parallelized by the CpuAmoebaPmeMultipoleForce subclass.
+ *
+ * Each thread accumulates its contributions into its own buffers, which are then summed.  If a neighbor list
+ * is provided, only the pairs it contains are visited.  It must have been built without exclusions, since
+ * covalently bonded pairs still interact (with scale factors).  Otherwise all pairs are visited.
+ */
+template <class BASE>
+class CpuAmoebaMultipoleForce : public BASE {
+public:
+    class ComputeTask;
+    /**
+     * Create a CpuAmoebaMultipoleForce.
+     *
+     * @param threads       the thread pool to use
+     * @param neighborList  the neighbor list containing all pairs within the cutoff, or NULL to loop over all pairs
+     */
+    CpuAmoebaMultipoleForce(ThreadPool& threads, const CpuNeighborList* neighborList) : threads(threads), neighborList(neighborList) {
+    }
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputePairs(ThreadPool& threads, int threadIndex);
+protected:
+    typedef typename BASE::MultipoleParticleData MultipoleParticleData;
+    typedef typename BASE::UpdateInducedDipoleFieldStruct UpdateInducedDipoleFieldStruct;
+    void calculateFixedMultipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData);
+    void calculateInducedDipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData,
+                                          std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
+    RealOpenMM calculateElectrostaticPairs(const std::vector<MultipoleParticleData>& particleData,
+                                           std::vector<RealVec>& torques, std::vector<RealVec>& forces);
+    ThreadPool& threads;
+private:
+    enum PairCalculation {FixedField, InducedField, Electrostatic};
+    void computePairs(PairCalculation calculation);
+    void computePair(int threadIndex, int particleI, int particleJ);
+    const CpuNeighborList* neighborList;
+    std::vector<std::vector<RealVec> > threadVectors1, threadVectors2;
+    std::vector<std::vector<UpdateInducedDipoleFieldStruct> > threadInducedDipoleFields;
+    std::vector<std::vector<RealOpenMM> > threadScaleFactors;
+    std::vector<RealOpenMM> threadEnergy;
+    // The following variables are used to make information accessible to the individual threads.
+    PairCalculation calculation;
+    const std::vector<MultipoleParticleData>* particleData;
+    std::vector<UpdateInducedDipoleFieldStruct>* updateInducedDipoleFields;
+    std::vector<RealVec>* output1;
+    std::vector<RealVec>* output2;
+    void* atomicCounter;
+};
+
+template <class BASE>
+class CpuAmoebaMultipoleForce<BASE>::ComputeTask : public ThreadPool::Task {
+public:
+    ComputeTask(CpuAmoebaMultipoleForce<BASE>& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputePairs(threads, threadIndex);
+    }
+    CpuAmoebaMultipoleForce<BASE>& owner;
+};
+
+template <class BASE>
+void CpuAmoebaMultipoleForce<BASE>::calculateFixedMultipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData) {
+    this->particleData = &particleData;
+    output1 = &this->_fixedMultipoleField;
+    output2 = &this->_fixedMultipoleFieldPolar;
+    computePairs(FixedField);
+}
+
+template <class BASE>
+void CpuAmoebaMultipoleForce<BASE>::calculateInducedDipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                                     std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields) {
+    this->particleData = &particleData;
+    this->updateInducedDipoleFields = &updateInducedDipoleFields;
+    computePairs(InducedField);
+}
+
+template <class BASE>
+RealOpenMM CpuAmoebaMultipoleForce<BASE>::calculateElectrostaticPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                                      std::vector<RealVec>& torques, std::vector<RealVec>& forces) {
+    this->particleData = &particleData;
+    output1 = &forces;
+    output2 = &torques;
+    computePairs(Electrostatic);
+    RealOpenMM energy = 0;
+    for (int i = 0; i < (int) threadEnergy.size(); i++)
+        energy += threadEnergy[i];
+    return energy;
+}
+
+template <class BASE>
+void CpuAmoebaMultipoleForce<BASE>::computePairs(PairCalculation calculation) {
+    int numThreads = threads.getNumThreads();
+    threadVectors1.resize(numThreads);
+    threadVectors2.resize(numThreads);
+    threadInducedDipoleFields.resize(numThreads);
+    threadScaleFactors.resize(numThreads);
+    threadEnergy.resize(numThreads);
+    this->calculation = calculation;
+    gmx_atomic_t counter;
+    gmx_atomic_set(&counter, 0);
+    atomicCounter = &counter;
+    ComputeTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+    threads.resumeThreads();
+    threads.waitForThreads();
+}
+
+template <class BASE>
+void CpuAmoebaMultipoleForce<BASE>::threadComputePairs(ThreadPool& threads, int threadIndex) {
+    // Clear this thread's buffers.
+
+    int numParticles = particleData->size();
+    RealVec zero(0.0, 0.0, 0.0);
+    if (calculation == InducedField) {
+        std::vector<UpdateInducedDipoleFieldStruct>& fields = threadInducedDipoleFields[threadIndex];
+        fields = *updateInducedDipoleFields;
+        for (int i = 0; i < (int) fields.size(); i++) {
+            std::fill(fields[i].inducedDipoleField.begin(), fields[i].inducedDipoleField.end(), zero);
+            std::fill(fields[i].inducedDipoleFieldGradient.begin(), fields[i].inducedDipoleFieldGradient.end(), 0.0);
+        }
+    }
+    else {
+        threadVectors1[threadIndex].assign(numParticles, zero);
+        threadVectors2[threadIndex].assign(numParticles, zero);
+        threadScaleFactors[threadIndex].resize(BASE::LAST_SCALE_TYPE_INDEX);
+        threadEnergy[threadIndex] = 0;
+    }
+
+    // Loop over pairs.  Work is handed out in small pieces to balance the load between threads.
+
+    if (neighborList == NULL) {
+        while (true) {
+            int i = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+            if (i >= numParticles)
+                break;
+            for (int j = i+1; j < numParticles; j++)
+                computePair(threadIndex, i, j);
+        }
+    }
+    else {
+        int blockSize = neighborList->getBlockSize();
+        const std::vector<int>& sortedAtoms = neighborList->getSortedAtoms();
+        while (true) {
+            int block = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+            if (block >= neighborList->getNumBlocks())
+                break;
+            const int* blockAtom = &sortedAtoms[blockSize*block];
+            int atomsInBlock = std::min(blockSize, numParticles-blockSize*block);
+            const std::vector<int>& neighbors = neighborList->getBlockNeighbors(block);
+            const std::vector<char>& exclusions = neighborList->getBlockExclusions(block);
+            for (int k = 0; k < (int) neighbors.size(); k++) {
+                int neighbor = neighbors[k];
+                for (int m = 0; m < atomsInBlock; m++)
+                    if ((exclusions[k] & (1<<m)) == 0)
+                        computePair(threadIndex, std::min(blockAtom[m], neighbor), std::max(blockAtom[m], neighbor));
+            }
+        }
+    }
+    threads.syncThreads();
+
+    // Sum the contributions from all threads.
+
+    int numThreads = threads.getNumThreads();
+    int start = threadIndex*numParticles/numThreads;
+    int end = (threadIndex+1)*numParticles/numThreads;
+    if (calculation == InducedField) {
+        for (int field = 0; field < (int) updateInducedDipoleFields->size(); field++) {
+            std::vector<RealVec>& output = (*updateInducedDipoleFields)[field].inducedDipoleField;
+            for (int j = 0; j < numThreads; j++) {
+                const std::vector<RealVec>& input = threadInducedDipoleFields[j][field].inducedDipoleField;
+                for (int i = start; i < end; i++)
+                    output[i] += input[i];
+            }
+            std::vector<RealOpenMM>& outputGradient = (*updateInducedDipoleFields)[field].inducedDipoleFieldGradient;
+            if (outputGradient.size() > 0) {
+                for (int j = 0; j < numThreads; j++) {
+                    const std::vector<RealOpenMM>& input = threadInducedDipoleFields[j][field].inducedDipoleFieldGradient;
+                    for (int i = 6*start; i < 6*end; i++)
+                        outputGradient[i] += input[i];
+                }
+            }
+        }
+    }
+    else {
+        for (int j = 0; j < numThreads; j++)
+            for (int i = start; i < end; i++) {
+                (*output1)[i] += threadVectors1[j][i];
+                (*output2)[i] += threadVectors2[j][i];
+            }
+    }
+}
+
+template <class BASE>
+void CpuAmoebaMultipoleForce<BASE>::computePair(int threadIndex, int particleI, int particleJ) {
+    const MultipoleParticleData& dataI = (*particleData)[particleI];
+    const MultipoleParticleData& dataJ = (*particleData)[particleJ];
+    bool scaled = (particleJ <= (int) this->_maxScaleIndex[particleI]);
+    if (calculation == FixedField) {
+        RealOpenMM dScale = 1.0, pScale = 1.0;
+        if (scaled)
+            this->getDScaleAndPScale(particleI, particleJ, dScale, pScale);
+        this->calculateFixedMultipoleFieldPairIxn(dataI, dataJ, dScale, pScale, threadVectors1[threadIndex], threadVectors2[threadIndex]);
+    }
+    else if (calculation == InducedField)
+        this->calculateInducedDipolePairIxns(dataI, dataJ, threadInducedDipoleFields[threadIndex]);
+    else {
+        std::vector<RealOpenMM>& scaleFactors = threadScaleFactors[threadIndex];
+        if (scaled)
+            this->getMultipoleScaleFactors(particleI, particleJ, scaleFactors);
+        else
+            std::fill(scaleFactors.begin(), scaleFactors.end(), 1.0);
+        threadEnergy[threadIndex] += this->calculateElectrostaticPairIxn(dataI, dataJ, scaleFactors, threadVectors1[threadIndex], threadVectors2[threadIndex]);
+    }
+}
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_AMOEBA_MULTIPOLE_FORCE_H_
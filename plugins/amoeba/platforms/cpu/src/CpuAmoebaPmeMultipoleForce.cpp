@@ -0,0 +1,184 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuAmoebaPmeMultipoleForce.h"
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuAmoebaPmeMultipoleForce::ReciprocalTask : public ThreadPool::Task {
+public:
+    ReciprocalTask(CpuAmoebaPmeMultipoleForce& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeReciprocal(threads, threadIndex);
+    }
+    CpuAmoebaPmeMultipoleForce& owner;
+};
+
+CpuAmoebaPmeMultipoleForce::CpuAmoebaPmeMultipoleForce(ThreadPool& threads, const CpuNeighborList* neighborList) :
+        CpuAmoebaMultipoleForce<AmoebaReferencePmeMultipoleForce>(threads, neighborList) {
+}
+
+CpuAmoebaPmeMultipoleForce::~CpuAmoebaPmeMultipoleForce() {
+    for (int i = 0; i < (int) threadFFTPlans.size(); i++)
+        fftpack_destroy(threadFFTPlans[i]);
+}
+
+void CpuAmoebaPmeMultipoleForce::computeReciprocal(ReciprocalCalculation calculation) {
+    reciprocalCalculation = calculation;
+    ReciprocalTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+}
+
+void CpuAmoebaPmeMultipoleForce::resizeThreadGrids() {
+    // Thread 0 spreads directly onto the PME grid, so only the other threads need grids of their own.
+
+    int numThreads = threads.getNumThreads();
+    threadGrids.resize(numThreads);
+    for (int i = 1; i < numThreads; i++)
+        threadGrids[i].resize(_totalGridSize);
+}
+
+void CpuAmoebaPmeMultipoleForce::computeAmoebaBsplines(const vector<MultipoleParticleData>& particleData) {
+    reciprocalParticleData = &particleData;
+    computeReciprocal(Bsplines);
+}
+
+void CpuAmoebaPmeMultipoleForce::spreadFixedMultipolesOntoGrid(const vector<MultipoleParticleData>& particleData) {
+    transformMultipolesToFractionalCoordinates(particleData);
+    resizeThreadGrids();
+    computeReciprocal(SpreadFixed);
+    computeReciprocal(SumGrids);
+}
+
+void CpuAmoebaPmeMultipoleForce::spreadInducedDipolesOnGrid(const vector<RealVec>& inputInducedDipole,
+                                                            const vector<RealVec>& inputInducedDipolePolar) {
+    inducedDipoles = &inputInducedDipole;
+    inducedDipolesPolar = &inputInducedDipolePolar;
+    resizeThreadGrids();
+    computeReciprocal(SpreadInduced);
+    computeReciprocal(SumGrids);
+}
+
+void CpuAmoebaPmeMultipoleForce::transformPmeGrid(fftpack_direction direction) {
+    if (threadFFTPlans.size() == 0) {
+        int numThreads = threads.getNumThreads();
+        int maxDimension = max(_pmeGridDimensions[0], max(_pmeGridDimensions[1], _pmeGridDimensions[2]));
+        threadFFTPlans.resize(3*numThreads);
+        threadFFTBuffers.resize(numThreads);
+        for (int i = 0; i < numThreads; i++) {
+            for (int j = 0; j < 3; j++)
+                fftpack_init_1d(&threadFFTPlans[3*i+j], _pmeGridDimensions[j]);
+            threadFFTBuffers[i].resize(maxDimension);
+        }
+    }
+    fftDirection = direction;
+    computeReciprocal(TransformZ);
+    computeReciprocal(TransformY);
+    computeReciprocal(TransformX);
+}
+
+void CpuAmoebaPmeMultipoleForce::performAmoebaReciprocalConvolution() {
+    computeReciprocal(Convolution);
+}
+
+void CpuAmoebaPmeMultipoleForce::computeFixedPotentialFromGrid() {
+    computeReciprocal(FixedPotential);
+}
+
+void CpuAmoebaPmeMultipoleForce::computeInducedPotentialFromGrid() {
+    computeReciprocal(InducedPotential);
+}
+
+void CpuAmoebaPmeMultipoleForce::transformLines(fftpack_t plan, t_complex* buffer, int firstLine, int lastLine, int lineLength,
+                                                int lineStride, int blockLength, int blockStride) {
+    // Line i starts at (i/blockLength)*blockStride + i%blockLength.  Lines whose elements are not contiguous
+    // are copied to a buffer, transformed, and copied back.
+
+    for (int line = firstLine; line < lastLine; line++) {
+        t_complex* data = &_pmeGrid[(line/blockLength)*blockStride + line%blockLength];
+        if (lineStride == 1)
+            fftpack_exec_1d(plan, fftDirection, data, data);
+        else {
+            for (int i = 0; i < lineLength; i++)
+                buffer[i] = data[i*lineStride];
+            fftpack_exec_1d(plan, fftDirection, buffer, buffer);
+            for (int i = 0; i < lineLength; i++)
+                data[i*lineStride] = buffer[i];
+        }
+    }
+}
+
+void CpuAmoebaPmeMultipoleForce::threadComputeReciprocal(ThreadPool& threads, int threadIndex) {
+    int numThreads = threads.getNumThreads();
+    int start = threadIndex*_numParticles/numThreads;
+    int end = (threadIndex+1)*_numParticles/numThreads;
+    int gridStart = (int) ((threadIndex*(long long) _totalGridSize)/numThreads);
+    int gridEnd = (int) (((threadIndex+1)*(long long) _totalGridSize)/numThreads);
+    int nx = _pmeGridDimensions[0];
+    int ny = _pmeGridDimensions[1];
+    int nz = _pmeGridDimensions[2];
+    switch (reciprocalCalculation) {
+        case Bsplines:
+            computeAmoebaBsplinesForParticles(*reciprocalParticleData, start, end);
+            break;
+        case SpreadFixed:
+            spreadFixedMultipolesForParticles(start, end, threadIndex == 0 ? _pmeGrid : &threadGrids[threadIndex][0]);
+            break;
+        case SpreadInduced:
+            spreadInducedDipolesForParticles(*inducedDipoles, *inducedDipolesPolar, start, end, threadIndex == 0 ? _pmeGrid : &threadGrids[threadIndex][0]);
+            break;
+        case SumGrids:
+            for (int i = 1; i < numThreads; i++) {
+                const t_complex* input = &threadGrids[i][0];
+                for (int j = gridStart; j < gridEnd; j++) {
+                    _pmeGrid[j].re += input[j].re;
+                    _pmeGrid[j].im += input[j].im;
+                }
+            }
+            break;
+        case TransformZ:
+            transformLines(threadFFTPlans[3*threadIndex+2], &threadFFTBuffers[threadIndex][0], threadIndex*nx*ny/numThreads, (threadIndex+1)*nx*ny/numThreads, nz, 1, 1, nz);
+            break;
+        case TransformY:
+            transformLines(threadFFTPlans[3*threadIndex+1], &threadFFTBuffers[threadIndex][0], threadIndex*nx*nz/numThreads, (threadIndex+1)*nx*nz/numThreads, ny, nz, nz, ny*nz);
+            break;
+        case TransformX:
+            transformLines(threadFFTPlans[3*threadIndex], &threadFFTBuffers[threadIndex][0], threadIndex*ny*nz/numThreads, (threadIndex+1)*ny*nz/numThreads, nx, ny*nz, ny*nz, 0);
+            break;
+        case Convolution:
+            performAmoebaReciprocalConvolutionForGridPoints(gridStart, gridEnd);
+            break;
+        case FixedPotential:
+            computeFixedPotentialForParticles(start, end);
+            break;
+        case InducedPotential:
+            computeInducedPotentialForParticles(start, end);
+            break;
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef OPENMM_CPU_AMOEBA_PME_MULTIPOLE_FORCE_H_
+#define OPENMM_CPU_AMOEBA_PME_MULTIPOLE_FORCE_H_
+
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuAmoebaMultipoleForce.h"
+#include "fftpack.h"
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class extends CpuAmoebaMultipoleForce to also parallelize the reciprocal space part of PME: computing
+ * B-spline coefficients, spreading the fixed multipoles and induced dipoles onto the grid, the FFTs, the
+ * convolution, and interpolating the potential back to the particles.  The induced dipole part is repeated
+ * on every iteration of the induced dipole solver, so it often dominates the cost of the calculation.
+ *
+ * Each thread spreads its particles onto its own copy of the grid, and the copies are then summed.  The 3D FFT
+ * is done as a series of 1D transforms along each axis, with the lines along each axis divided between threads.
+ */
+class CpuAmoebaPmeMultipoleForce : public CpuAmoebaMultipoleForce<AmoebaReferencePmeMultipoleForce> {
+public:
+    class ReciprocalTask;
+    /**
+     * Create a CpuAmoebaPmeMultipoleForce.
+     *
+     * @param threads       the thread pool to use
+     * @param neighborList  the neighbor list containing all pairs within the cutoff
+     */
+    CpuAmoebaPmeMultipoleForce(ThreadPool& threads, const CpuNeighborList* neighborList);
+    ~CpuAmoebaPmeMultipoleForce();
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputeReciprocal(ThreadPool& threads, int threadIndex);
+protected:
+    void computeAmoebaBsplines(const std::vector<MultipoleParticleData>& particleData);
+    void spreadFixedMultipolesOntoGrid(const std::vector<MultipoleParticleData>& particleData);
+    void spreadInducedDipolesOnGrid(const std::vector<RealVec>& inputInducedDipole,
+                                    const std::vector<RealVec>& inputInducedDipolePolar);
+    void transformPmeGrid(fftpack_direction direction);
+    void performAmoebaReciprocalConvolution();
+    void computeFixedPotentialFromGrid();
+    void computeInducedPotentialFromGrid();
+private:
+    enum ReciprocalCalculation {Bsplines, SpreadFixed, SpreadInduced, SumGrids, TransformZ, TransformY, TransformX,
+                                Convolution, FixedPotential, InducedPotential};
+    void computeReciprocal(ReciprocalCalculation calculation);
+    void resizeThreadGrids();
+    void transformLines(fftpack_t plan, t_complex* buffer, int firstLine, int lastLine, int lineLength, int lineStride,
+                        int blockLength, int blockStride);
+    std::vector<std::vector<t_complex> > threadGrids;
+    std::vector<fftpack_t> threadFFTPlans;
+    std::vector<std::vector<t_complex> > threadFFTBuffers;
+    // The following variables are used to make information accessible to the individual threads.
+    ReciprocalCalculation reciprocalCalculation;
+    const std::vector<MultipoleParticleData>* reciprocalParticleData;
+    const std::vector<RealVec>* inducedDipoles;
+    const std::vector<RealVec>* inducedDipolesPolar;
+    fftpack_direction fftDirection;
+};
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_AMOEBA_PME_MULTIPOLE_FORCE_H_
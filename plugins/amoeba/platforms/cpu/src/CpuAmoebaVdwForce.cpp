@@ -0,0 +1,382 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuAmoebaVdwForce.h"
+#include "gmx_atomic.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+using namespace OpenMM;
+using namespace std;
+
+class CpuAmoebaVdwForce::ComputeTask : public ThreadPool::Task {
+public:
+    ComputeTask(CpuAmoebaVdwForce& owner) : owner(owner) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.threadComputeForce(threads, threadIndex);
+    }
+    CpuAmoebaVdwForce& owner;
+};
+
+CpuAmoebaVdwForce::CpuAmoebaVdwForce() : sigmaCombiningRule(ArithmeticSigma), epsilonCombiningRule(GeometricEpsilon), cutoff(false),
+        periodic(false), triclinic(false), neighborList(NULL) {
+}
+
+void CpuAmoebaVdwForce::setCombiningRules(const string& sigmaRule, const string& epsilonRule) {
+    string sigma = sigmaRule;
+    string epsilon = epsilonRule;
+    transform(sigma.begin(), sigma.end(), sigma.begin(), (int(*)(int)) toupper);
+    transform(epsilon.begin(), epsilon.end(), epsilon.begin(), (int(*)(int)) toupper);
+    if (sigma == "GEOMETRIC")
+        sigmaCombiningRule = GeometricSigma;
+    else if (sigma == "CUBIC-MEAN")
+        sigmaCombiningRule = CubicMeanSigma;
+    else
+        sigmaCombiningRule = ArithmeticSigma;
+    if (epsilon == "ARITHMETIC")
+        epsilonCombiningRule = ArithmeticEpsilon;
+    else if (epsilon == "HARMONIC")
+        epsilonCombiningRule = HarmonicEpsilon;
+    else if (epsilon == "HHG")
+        epsilonCombiningRule = HhgEpsilon;
+    else
+        epsilonCombiningRule = GeometricEpsilon;
+}
+
+void CpuAmoebaVdwForce::setParticleParameters(const vector<int>& indexIVs, const vector<float>& sigmas, const vector<float>& epsilons,
+            const vector<float>& reductions, const vector<set<int> >& exclusions) {
+    this->indexIVs = indexIVs;
+    this->sigmas = sigmas;
+    this->epsilons = epsilons;
+    this->reductions = reductions;
+    this->exclusions = exclusions;
+    int numParticles = indexIVs.size();
+    
+    // Record the fraction of each site's force that is applied to the particle itself.  The rest goes to
+    // the particle its site is reduced towards.
+
+    siteWeights.resize(numParticles);
+    allSites.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        siteWeights[i] = (indexIVs[i] == i ? 1.0f : reductions[i]);
+        allSites[i] = i;
+    }
+}
+
+void CpuAmoebaVdwForce::setUseCutoff(float distance, const CpuNeighborList& neighbors) {
+    cutoff = true;
+    cutoffDistance = distance;
+    neighborList = &neighbors;
+    taperCutoff = 0.9f*distance;
+    double delta = taperCutoff-distance;
+    taperC3 = (float) (10.0/(delta*delta*delta));
+    taperC4 = (float) (15.0/(delta*delta*delta*delta));
+    taperC5 = (float) (6.0/(delta*delta*delta*delta*delta));
+}
+
+void CpuAmoebaVdwForce::setPeriodic(RealVec* periodicBoxVectors) {
+    periodic = true;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++)
+            this->periodicBoxVectors[i][j] = (float) periodicBoxVectors[i][j];
+        periodicBoxSize[i] = (float) periodicBoxVectors[i][i];
+        recipBoxSize[i] = (float) (1.0/periodicBoxVectors[i][i]);
+    }
+    triclinic = (periodicBoxVectors[0][1] != 0.0 || periodicBoxVectors[0][2] != 0.0 ||
+                 periodicBoxVectors[1][0] != 0.0 || periodicBoxVectors[1][2] != 0.0 ||
+                 periodicBoxVectors[2][0] != 0.0 || periodicBoxVectors[2][1] != 0.0);
+}
+
+void CpuAmoebaVdwForce::computeSitePositions(const vector<RealVec>& positions, vector<RealVec>& sitePositions) const {
+    int numParticles = indexIVs.size();
+    sitePositions.resize(numParticles);
+    for (int i = 0; i < numParticles; i++) {
+        if (reductions[i] != 0.0f) {
+            const RealVec& parentPos = positions[indexIVs[i]];
+            sitePositions[i] = parentPos+(positions[i]-parentPos)*reductions[i];
+        }
+        else
+            sitePositions[i] = positions[i];
+    }
+}
+
+void CpuAmoebaVdwForce::computeForce(const AlignedArray<float>& sitePositions, vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads) {
+    // Record the parameters for the threads.
+    
+    int numParticles = indexIVs.size();
+    int numThreads = threads.getNumThreads();
+    this->posq = &sitePositions[0];
+    this->threadForce = &threadForce;
+    includeEnergy = (totalEnergy != NULL);
+    threadEnergy.resize(numThreads);
+    threadSiteForce.resize(numThreads);
+    for (int i = 0; i < numThreads; i++)
+        threadSiteForce[i].resize(4*numParticles);
+    if (!cutoff) {
+        threadExclusions.resize(numThreads);
+        for (int i = 0; i < numThreads; i++)
+            threadExclusions[i].resize(numParticles);
+    }
+    gmx_atomic_t counter;
+    gmx_atomic_set(&counter, 0);
+    this->atomicCounter = &counter;
+    
+    // Signal the threads to start running and wait for them to finish.
+    
+    ComputeTask task(*this);
+    threads.execute(task);
+    threads.waitForThreads();
+    
+    // Combine the energies from all the threads.
+    
+    if (totalEnergy != NULL) {
+        double energy = 0;
+        for (int i = 0; i < numThreads; i++)
+            energy += threadEnergy[i];
+        *totalEnergy += energy;
+    }
+}
+
+void CpuAmoebaVdwForce::threadComputeForce(ThreadPool& threads, int threadIndex) {
+    int numParticles = indexIVs.size();
+    float* siteForce = &threadSiteForce[threadIndex][0];
+    for (int i = 0; i < 4*numParticles; i++)
+        siteForce[i] = 0.0f;
+    double energy = 0.0;
+    if (cutoff) {
+        // Compute the interactions from the neighbor list.
+
+        while (true) {
+            int nextBlock = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 1);
+            if (nextBlock >= neighborList->getNumBlocks())
+                break;
+            const int* blockAtom = &neighborList->getSortedAtoms()[4*nextBlock];
+            const vector<int>& neighbors = neighborList->getBlockNeighbors(nextBlock);
+            const vector<char>& blockExclusions = neighborList->getBlockExclusions(nextBlock);
+            if (neighbors.size() > 0)
+                calculateBlockIxn(blockAtom, &neighbors[0], &blockExclusions[0], neighbors.size(), siteForce, energy);
+        }
+    }
+    else {
+        // Loop over all pairs of sites.  Each block of four consecutive sites interacts with every later site
+        // it is not excluded from.
+
+        vector<char>& blockExclusions = threadExclusions[threadIndex];
+        while (true) {
+            int blockStart = gmx_atomic_fetch_add(reinterpret_cast<gmx_atomic_t*>(atomicCounter), 4);
+            if (blockStart >= numParticles)
+                break;
+            int numInBlock = min(4, numParticles-blockStart);
+            int blockAtom[4];
+            for (int k = 0; k < 4; k++)
+                blockAtom[k] = (k < numInBlock ? blockStart+k : blockStart);
+            int numNeighbors = numParticles-blockStart;
+            for (int j = 0; j < numNeighbors; j++) {
+                char excl = 0;
+                for (int k = 0; k < 4; k++)
+                    if (k >= numInBlock || j <= k)
+                        excl |= 1<<k;
+                blockExclusions[j] = excl;
+            }
+            for (int k = 0; k < numInBlock; k++)
+                for (set<int>::const_iterator iter = exclusions[blockStart+k].begin(); iter != exclusions[blockStart+k].end(); ++iter)
+                    if (*iter >= blockStart)
+                        blockExclusions[*iter-blockStart] |= 1<<k;
+            calculateBlockIxn(blockAtom, &allSites[blockStart], &blockExclusions[0], numNeighbors, siteForce, energy);
+        }
+    }
+    threadEnergy[threadIndex] = energy;
+
+    // Divide the force on each site between the particle and the particle its site is reduced towards.
+    // Each thread only touches its own force array, so this needs no synchronization.
+
+    float* forces = &(*threadForce)[threadIndex][0];
+    for (int i = 0; i < numParticles; i++) {
+        fvec4 f(siteForce+4*i);
+        if (siteWeights[i] == 1.0f)
+            (fvec4(forces+4*i)+f).store(forces+4*i);
+        else {
+            int parent = indexIVs[i];
+            (fvec4(forces+4*i)+f*siteWeights[i]).store(forces+4*i);
+            (fvec4(forces+4*parent)+f*(1.0f-siteWeights[i])).store(forces+4*parent);
+        }
+    }
+}
+
+void CpuAmoebaVdwForce::calculateBlockIxn(const int* blockAtom, const int* neighbors, const char* neighborExclusions, int numNeighbors, float* forces, double& energy) {
+    const float dhal = 0.07f;
+    const float ghal = 0.12f;
+    
+    // Load the positions and parameters of the sites in the block.
+
+    fvec4 blockAtomPos[4];
+    for (int i = 0; i < 4; i++)
+        blockAtomPos[i] = fvec4(posq+4*blockAtom[i]);
+    fvec4 blockAtomX = fvec4(blockAtomPos[0][0], blockAtomPos[1][0], blockAtomPos[2][0], blockAtomPos[3][0]);
+    fvec4 blockAtomY = fvec4(blockAtomPos[0][1], blockAtomPos[1][1], blockAtomPos[2][1], blockAtomPos[3][1]);
+    fvec4 blockAtomZ = fvec4(blockAtomPos[0][2], blockAtomPos[1][2], blockAtomPos[2][2], blockAtomPos[3][2]);
+    fvec4 blockAtomSigma(sigmas[blockAtom[0]], sigmas[blockAtom[1]], sigmas[blockAtom[2]], sigmas[blockAtom[3]]);
+    fvec4 blockAtomEpsilon(epsilons[blockAtom[0]], epsilons[blockAtom[1]], epsilons[blockAtom[2]], epsilons[blockAtom[3]]);
+    fvec4 blockAtomSigma2 = blockAtomSigma*blockAtomSigma;
+    fvec4 blockAtomSqrtEpsilon = sqrt(blockAtomEpsilon);
+    ivec4 blockAtomHasSigma = (blockAtomSigma != 0.0f);
+    ivec4 blockAtomHasEpsilon = (blockAtomEpsilon != 0.0f);
+    fvec4 blockAtomForceX(0.0f), blockAtomForceY(0.0f), blockAtomForceZ(0.0f);
+    fvec4 boxSize(periodicBoxSize[0], periodicBoxSize[1], periodicBoxSize[2], 0);
+    fvec4 invBoxSize(recipBoxSize[0], recipBoxSize[1], recipBoxSize[2], 0);
+    bool needPeriodic = (periodic && (any(blockAtomX < cutoffDistance) || any(blockAtomY < cutoffDistance) || any(blockAtomZ < cutoffDistance) ||
+            any(blockAtomX > boxSize[0]-cutoffDistance) || any(blockAtomY > boxSize[1]-cutoffDistance) || any(blockAtomZ > boxSize[2]-cutoffDistance)));
+    const float cutoff2 = cutoffDistance*cutoffDistance;
+    const fvec4 one(1.0f);
+    
+    // Loop over neighbors for this block.
+    
+    for (int i = 0; i < numNeighbors; i++) {
+        // Compute the distances to the block sites.
+
+        int atom = neighbors[i];
+        fvec4 dx, dy, dz, r2;
+        getDeltaR(posq+4*atom, blockAtomX, blockAtomY, blockAtomZ, dx, dy, dz, r2, needPeriodic, boxSize, invBoxSize);
+        ivec4 include;
+        char excl = neighborExclusions[i];
+        if (excl == 0)
+            include = -1;
+        else
+            include = ivec4(excl&1 ? 0 : -1, excl&2 ? 0 : -1, excl&4 ? 0 : -1, excl&8 ? 0 : -1);
+        if (cutoff)
+            include = include & (r2 < cutoff2);
+        if (!any(include))
+            continue; // No interactions to compute.
+
+        // Apply the combining rules.
+
+        float atomSigma = sigmas[atom];
+        float atomEpsilon = epsilons[atom];
+        fvec4 sigma, epsilon;
+        if (sigmaCombiningRule == ArithmeticSigma)
+            sigma = blockAtomSigma+atomSigma;
+        else if (sigmaCombiningRule == GeometricSigma)
+            sigma = 2.0f*sqrt(blockAtomSigma*atomSigma);
+        else {
+            float atomSigma2 = atomSigma*atomSigma;
+            sigma = 2.0f*(blockAtomSigma2*blockAtomSigma+atomSigma2*atomSigma)/(blockAtomSigma2+atomSigma2);
+            sigma = blend(0.0f, sigma, blockAtomHasSigma & ivec4(atomSigma != 0.0f ? -1 : 0));
+        }
+        if (epsilonCombiningRule == ArithmeticEpsilon)
+            epsilon = 0.5f*(blockAtomEpsilon+atomEpsilon);
+        else if (epsilonCombiningRule == GeometricEpsilon)
+            epsilon = blockAtomSqrtEpsilon*sqrtf(atomEpsilon);
+        else if (epsilonCombiningRule == HarmonicEpsilon)
+            epsilon = 2.0f*(blockAtomEpsilon*atomEpsilon)/(blockAtomEpsilon+atomEpsilon);
+        else {
+            fvec4 denominator = blockAtomSqrtEpsilon+sqrtf(atomEpsilon);
+            epsilon = 4.0f*(blockAtomEpsilon*atomEpsilon)/(denominator*denominator);
+        }
+        if (epsilonCombiningRule == HarmonicEpsilon || epsilonCombiningRule == HhgEpsilon) {
+            if (atomEpsilon == 0.0f)
+                continue;
+            epsilon = blend(0.0f, epsilon, blockAtomHasEpsilon);
+        }
+
+        // Compute the buffered 14-7 interaction.
+
+        fvec4 r = sqrt(r2);
+        fvec4 sigma7 = sigma*sigma*sigma;
+        sigma7 = sigma7*sigma7*sigma;
+        fvec4 r6 = r2*r2*r2;
+        fvec4 rho = r6*r + ghal*sigma7;
+        fvec4 tau = (dhal+1.0f)/(r + dhal*sigma);
+        fvec4 tau7 = tau*tau*tau;
+        tau7 = tau7*tau7*tau;
+        fvec4 dtau = tau/(dhal+1.0f);
+        fvec4 ratio = sigma7/rho;
+        fvec4 gtau = epsilon*tau7*r6*(ghal+1.0f)*ratio*ratio;
+        fvec4 pairEnergy = epsilon*tau7*sigma7*((ghal+1.0f)*ratio - 2.0f);
+        fvec4 dEdR = -7.0f*(dtau*pairEnergy + gtau);
+        if (cutoff) {
+            // Smoothly taper the interaction to zero at the cutoff.
+
+            fvec4 t = blend(0.0f, r-taperCutoff, r > taperCutoff);
+            fvec4 taper = 1.0f + t*t*t*(taperC3 + t*(taperC4 + t*taperC5));
+            fvec4 dtaper = t*t*(3.0f*taperC3 + t*(4.0f*taperC4 + t*5.0f*taperC5));
+            dEdR = pairEnergy*dtaper + dEdR*taper;
+            pairEnergy *= taper;
+        }
+
+        // Accumulate energies.
+
+        if (includeEnergy)
+            energy += dot4(blend(0.0f, pairEnergy, include), one);
+
+        // Accumulate forces.
+
+        dEdR = blend(0.0f, dEdR/r, include);
+        fvec4 fx = dx*dEdR;
+        fvec4 fy = dy*dEdR;
+        fvec4 fz = dz*dEdR;
+        blockAtomForceX -= fx;
+        blockAtomForceY -= fy;
+        blockAtomForceZ -= fz;
+        float* atomForce = forces+4*atom;
+        atomForce[0] += dot4(fx, one);
+        atomForce[1] += dot4(fy, one);
+        atomForce[2] += dot4(fz, one);
+    }
+
+    // Record the forces on the block sites.
+
+    fvec4 f[4] = {blockAtomForceX, blockAtomForceY, blockAtomForceZ, 0.0f};
+    transpose(f[0], f[1], f[2], f[3]);
+    for (int j = 0; j < 4; j++)
+        (fvec4(forces+4*blockAtom[j])+f[j]).store(forces+4*blockAtom[j]);
+}
+
+void CpuAmoebaVdwForce::getDeltaR(const float* posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const {
+    dx = x-posI[0];
+    dy = y-posI[1];
+    dz = z-posI[2];
+    if (periodic) {
+        if (triclinic) {
+            fvec4 scale3 = floor(dz*recipBoxSize[2]+0.5f);
+            dx -= scale3*periodicBoxVectors[2][0];
+            dy -= scale3*periodicBoxVectors[2][1];
+            dz -= scale3*periodicBoxVectors[2][2];
+            fvec4 scale2 = floor(dy*recipBoxSize[1]+0.5f);
+            dx -= scale2*periodicBoxVectors[1][0];
+            dy -= scale2*periodicBoxVectors[1][1];
+            fvec4 scale1 = floor(dx*recipBoxSize[0]+0.5f);
+            dx -= scale1*periodicBoxVectors[0][0];
+        }
+        else {
+            dx -= round(dx*invBoxSize[0])*boxSize[0];
+            dy -= round(dy*invBoxSize[1])*boxSize[1];
+            dz -= round(dz*invBoxSize[2])*boxSize[2];
+        }
+    }
+    r2 = dx*dx + dy*dy + dz*dz;
+}
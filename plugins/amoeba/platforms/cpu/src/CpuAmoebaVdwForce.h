@@ -0,0 +1,144 @@
+#ifndef OPENMM_CPU_AMOEBA_VDW_FORCE_H_
+#define OPENMM_CPU_AMOEBA_VDW_FORCE_H_
+
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+
+#include "AlignedArray.h"
+#include "CpuNeighborList.h"
+#include "RealVec.h"
+#include "openmm/internal/ThreadPool.h"
+#include "openmm/internal/vectorize.h"
+#include <set>
+#include <string>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * This class computes the buffered 14-7 van der Waals interaction used by AMOEBA.  Interactions are computed between
+ * interaction sites, which for atoms with a nonzero reduction factor lie part way along the bond to the parent atom.
+ * The forces on each site are then divided between the atom and its parent.
+ *
+ * With a cutoff, the site pairs are taken from a CpuNeighborList built from the site positions.  Without one, every
+ * pair of sites is computed.  In both cases the work is divided between threads, and each thread computes the
+ * interactions between a block of four sites and one other site at a time using SIMD operations.
+ */
+class CpuAmoebaVdwForce {
+public:
+    class ComputeTask;
+    CpuAmoebaVdwForce();
+    /**
+     * Set the combining rules used to compute sigma and epsilon for each pair of sites.
+     *
+     * @param sigmaCombiningRule    the sigma combining rule: ARITHMETIC, GEOMETRIC, or CUBIC-MEAN
+     * @param epsilonCombiningRule  the epsilon combining rule: ARITHMETIC, GEOMETRIC, HARMONIC, or HHG
+     */
+    void setCombiningRules(const std::string& sigmaCombiningRule, const std::string& epsilonCombiningRule);
+    /**
+     * Set the per-particle parameters.
+     *
+     * @param indexIVs    the index of the atom each particle's interaction site is reduced towards
+     * @param sigmas      the sigma of each particle
+     * @param epsilons    the epsilon of each particle
+     * @param reductions  the reduction factor of each particle
+     * @param exclusions  the particles each particle does not interact with
+     */
+    void setParticleParameters(const std::vector<int>& indexIVs, const std::vector<float>& sigmas, const std::vector<float>& epsilons,
+                               const std::vector<float>& reductions, const std::vector<std::set<int> >& exclusions);
+    /**
+     * Set the force to use a cutoff.  Interactions beyond 90% of the cutoff are smoothly tapered to zero.
+     *
+     * @param distance    the cutoff distance
+     * @param neighbors   the neighbor list to use.  It must be built from the site positions with no exclusions
+     *                    other than the ones passed to setParticleParameters().
+     */
+    void setUseCutoff(float distance, const CpuNeighborList& neighbors);
+    /**
+     * Set the force to use periodic boundary conditions.  This requires that a cutoff has already been set, and
+     * the smallest side of the periodic box is at least twice the cutoff distance.
+     *
+     * @param periodicBoxVectors    the vectors defining the periodic box
+     */
+    void setPeriodic(RealVec* periodicBoxVectors);
+    /**
+     * Compute the position of each particle's interaction site.
+     *
+     * @param positions       the positions of the particles
+     * @param sitePositions   on exit, the positions of the interaction sites
+     */
+    void computeSitePositions(const std::vector<RealVec>& positions, std::vector<RealVec>& sitePositions) const;
+    /**
+     * Compute the forces and energy.
+     *
+     * @param sitePositions   the interaction site positions, stored as 4 floats per site.  If periodic boundary
+     *                        conditions are used, they must have been wrapped into the periodic box.
+     * @param threadForce     forces on particles are added to these arrays (one for each thread)
+     * @param totalEnergy     if not NULL, the energy is added to this
+     * @param threads         the thread pool to use
+     */
+    void computeForce(const AlignedArray<float>& sitePositions, std::vector<AlignedArray<float> >& threadForce, double* totalEnergy, ThreadPool& threads);
+    /**
+     * This routine contains the code executed by each thread.
+     */
+    void threadComputeForce(ThreadPool& threads, int threadIndex);
+private:
+    enum SigmaCombiningRule {ArithmeticSigma, GeometricSigma, CubicMeanSigma};
+    enum EpsilonCombiningRule {ArithmeticEpsilon, GeometricEpsilon, HarmonicEpsilon, HhgEpsilon};
+    SigmaCombiningRule sigmaCombiningRule;
+    EpsilonCombiningRule epsilonCombiningRule;
+    bool cutoff, periodic, triclinic;
+    float cutoffDistance, taperCutoff, taperC3, taperC4, taperC5;
+    float periodicBoxSize[3], recipBoxSize[3];
+    float periodicBoxVectors[3][3];
+    std::vector<int> indexIVs;
+    std::vector<float> sigmas, epsilons, reductions, siteWeights;
+    std::vector<std::set<int> > exclusions;
+    std::vector<int> allSites;
+    const CpuNeighborList* neighborList;
+    std::vector<AlignedArray<float> > threadSiteForce;
+    std::vector<std::vector<char> > threadExclusions;
+    std::vector<double> threadEnergy;
+    // The following variables are used to make information accessible to the individual threads.
+    float const* posq;
+    std::vector<AlignedArray<float> >* threadForce;
+    bool includeEnergy;
+    void* atomicCounter;
+
+    /**
+     * Compute the interactions between a block of four sites and a list of other sites.  Bit k of each exclusion
+     * flag indicates that the corresponding site should be skipped for block site k.
+     */
+    void calculateBlockIxn(const int* blockAtom, const int* neighbors, const char* neighborExclusions, int numNeighbors, float* forces, double& energy);
+    /**
+     * Compute the displacements from one site to each of four other sites, applying periodic boundary conditions if requested.
+     */
+    void getDeltaR(const float* posI, const fvec4& x, const fvec4& y, const fvec4& z, fvec4& dx, fvec4& dy, fvec4& dz, fvec4& r2, bool periodic, const fvec4& boxSize, const fvec4& invBoxSize) const;
+};
+
+} // namespace OpenMM
+
+#endif // OPENMM_CPU_AMOEBA_VDW_FORCE_H_
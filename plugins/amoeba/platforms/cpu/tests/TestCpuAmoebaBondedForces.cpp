@@ -0,0 +1,186 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+/**
+ * This tests the CPU implementations of the AMOEBA bonded forces by comparing them to the Reference platform.
+ */
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "CpuPlatform.h"
+#include "openmm/AmoebaAngleForce.h"
+#include "openmm/AmoebaBondForce.h"
+#include "openmm/AmoebaInPlaneAngleForce.h"
+#include "openmm/AmoebaOutOfPlaneBendForce.h"
+#include "openmm/AmoebaPiTorsionForce.h"
+#include "openmm/AmoebaStretchBendForce.h"
+#include "openmm/AmoebaTorsionTorsionForce.h"
+#include "openmm/Context.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "sfmt/SFMT.h"
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerAmoebaReferenceKernelFactories();
+extern "C" OPENMM_EXPORT void registerAmoebaCpuKernelFactories();
+
+const int numParticles = 200;
+
+/**
+ * Compute the forces and energy with both platforms, using several numbers of threads for the CPU platform,
+ * and check that they agree.
+ */
+static void compareToReference(System& system, const vector<Vec3>& positions) {
+    VerletIntegrator integrator1(0.001);
+    Context referenceContext(system, integrator1, Platform::getPlatformByName("Reference"));
+    referenceContext.setPositions(positions);
+    State referenceState = referenceContext.getState(State::Forces | State::Energy);
+    const char* numThreads[] = {"1", "3", "4"};
+    for (int i = 0; i < 3; i++) {
+        map<string, string> properties;
+        properties[CpuPlatform::CpuThreads()] = numThreads[i];
+        VerletIntegrator integrator2(0.001);
+        Context cpuContext(system, integrator2, Platform::getPlatformByName("CPU"), properties);
+        cpuContext.setPositions(positions);
+        State cpuState = cpuContext.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(referenceState.getPotentialEnergy(), cpuState.getPotentialEnergy(), 1e-5);
+        for (int j = 0; j < system.getNumParticles(); j++)
+            ASSERT_EQUAL_VEC(referenceState.getForces()[j], cpuState.getForces()[j], 1e-5);
+    }
+}
+
+/**
+ * Create a System containing a long, irregular helical chain of particles.
+ */
+static void createChain(System& system, vector<Vec3>& positions, OpenMM_SFMT::SFMT& sfmt) {
+    for (int i = 0; i < numParticles; i++) {
+        system.addParticle(12.0);
+        double theta = 1.9*i;
+        Vec3 offset(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt));
+        positions.push_back(Vec3(0.12*cos(theta), 0.12*sin(theta), 0.05*i) + offset*0.03);
+    }
+}
+
+void testBondAndAngle() {
+    System system;
+    vector<Vec3> positions;
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    createChain(system, positions, sfmt);
+    AmoebaBondForce* bonds = new AmoebaBondForce();
+    bonds->setAmoebaGlobalBondCubic(-25.5);
+    bonds->setAmoebaGlobalBondQuartic(379.3);
+    AmoebaAngleForce* angles = new AmoebaAngleForce();
+    angles->setAmoebaGlobalAngleCubic(-0.014);
+    angles->setAmoebaGlobalAngleQuartic(0.000056);
+    angles->setAmoebaGlobalAnglePentic(-0.0000007);
+    angles->setAmoebaGlobalAngleSextic(0.000000022);
+    AmoebaInPlaneAngleForce* inPlaneAngles = new AmoebaInPlaneAngleForce();
+    inPlaneAngles->setAmoebaGlobalInPlaneAngleCubic(-0.014);
+    inPlaneAngles->setAmoebaGlobalInPlaneAngleQuartic(0.000056);
+    inPlaneAngles->setAmoebaGlobalInPlaneAnglePentic(-0.0000007);
+    inPlaneAngles->setAmoebaGlobalInPlaneAngleSextic(0.000000022);
+    AmoebaStretchBendForce* stretchBends = new AmoebaStretchBendForce();
+    for (int i = 0; i < numParticles-1; i++)
+        bonds->addBond(i, i+1, 0.1+0.02*genrand_real2(sfmt), 100000.0*(1+genrand_real2(sfmt)));
+    for (int i = 0; i < numParticles-2; i++) {
+        angles->addAngle(i, i+1, i+2, 100.0+20.0*genrand_real2(sfmt), 0.05*(1+genrand_real2(sfmt)));
+        stretchBends->addStretchBend(i, i+1, i+2, 0.11, 0.12, (100.0+20.0*genrand_real2(sfmt))*M_PI/180.0, 10.0*genrand_real2(sfmt), 10.0*genrand_real2(sfmt));
+    }
+    for (int i = 0; i < numParticles-3; i++)
+        inPlaneAngles->addAngle(i, i+1, i+2, i+3, 110.0+20.0*genrand_real2(sfmt), 0.05*(1+genrand_real2(sfmt)));
+    system.addForce(bonds);
+    system.addForce(angles);
+    system.addForce(inPlaneAngles);
+    system.addForce(stretchBends);
+    compareToReference(system, positions);
+}
+
+void testTorsions() {
+    System system;
+    vector<Vec3> positions;
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(1, sfmt);
+    createChain(system, positions, sfmt);
+    AmoebaPiTorsionForce* piTorsions = new AmoebaPiTorsionForce();
+    for (int i = 0; i < numParticles-5; i++)
+        piTorsions->addPiTorsion(i, i+1, i+2, i+3, i+4, i+5, 10.0*genrand_real2(sfmt));
+    AmoebaOutOfPlaneBendForce* outOfPlaneBends = new AmoebaOutOfPlaneBendForce();
+    outOfPlaneBends->setAmoebaGlobalOutOfPlaneBendCubic(-0.014);
+    outOfPlaneBends->setAmoebaGlobalOutOfPlaneBendQuartic(0.000056);
+    outOfPlaneBends->setAmoebaGlobalOutOfPlaneBendPentic(-0.0000007);
+    outOfPlaneBends->setAmoebaGlobalOutOfPlaneBendSextic(0.000000022);
+    for (int i = 0; i < numParticles-3; i++)
+        outOfPlaneBends->addOutOfPlaneBend(i, i+1, i+2, i+3, 0.05*genrand_real2(sfmt));
+    AmoebaTorsionTorsionForce* torsionTorsions = new AmoebaTorsionTorsionForce();
+    for (int i = 0; i < numParticles-5; i++)
+        torsionTorsions->addTorsionTorsion(i, i+1, i+2, i+3, i+4, (i%2 == 0 ? i+5 : -1), i%2);
+    for (int g = 0; g < 2; g++) {
+        TorsionTorsionGrid grid(25);
+        for (int i = 0; i < 25; i++) {
+            grid[i].resize(25);
+            for (int j = 0; j < 25; j++) {
+                double x = -180.0+15.0*i, y = -180.0+15.0*j;
+                grid[i][j].resize(3);
+                grid[i][j][0] = x;
+                grid[i][j][1] = y;
+                grid[i][j][2] = (g+1)*cos(x*M_PI/180.0)+sin(y*M_PI/180.0)+0.5*cos((x-y)*M_PI/180.0);
+            }
+        }
+        torsionTorsions->setTorsionTorsionGrid(g, grid);
+    }
+    system.addForce(piTorsions);
+    system.addForce(outOfPlaneBends);
+    system.addForce(torsionTorsions);
+    compareToReference(system, positions);
+}
+
+int main() {
+    try {
+        if (!CpuPlatform::isProcessorSupported()) {
+            cout << "CPU is not supported.  Exiting." << endl;
+            return 0;
+        }
+        Platform::registerPlatform(new CpuPlatform());
+        registerAmoebaReferenceKernelFactories();
+        registerAmoebaCpuKernelFactories();
+        testBondAndAngle();
+        testTorsions();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        std::cout << "FAIL - ERROR.  Test failed." << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,183 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+/**
+ * This tests the CPU implementation of AmoebaMultipoleForce by comparing it to the Reference platform.
+ */
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "CpuPlatform.h"
+#include "openmm/AmoebaMultipoleForce.h"
+#include "openmm/Context.h"
+#include "openmm/LangevinIntegrator.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "sfmt/SFMT.h"
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerAmoebaReferenceKernelFactories();
+extern "C" OPENMM_EXPORT void registerAmoebaCpuKernelFactories();
+
+/**
+ * Build a box of AMOEBA water molecules on a slightly perturbed lattice.
+ */
+static void buildWaterBox(System& system, vector<Vec3>& positions, AmoebaMultipoleForce::NonbondedMethod method,
+        AmoebaMultipoleForce::PolarizationType polarization, bool triclinic) {
+    const int gridSize = 4;
+    const double spacing = 0.31;
+    double boxSize = gridSize*spacing;
+    if (triclinic)
+        system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0.2*boxSize, boxSize, 0), Vec3(-0.1*boxSize, 0.3*boxSize, boxSize));
+    else
+        system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    AmoebaMultipoleForce* force = new AmoebaMultipoleForce();
+    system.addForce(force);
+    force->setNonbondedMethod(method);
+    force->setPolarizationType(polarization);
+    force->setCutoffDistance(0.55);
+    force->setMutualInducedTargetEpsilon(1e-6);
+    double o_charge = -0.51966, h_charge = 0.25983;
+    vector<double> o_dipole(3, 0.0), h_dipole(3, 0.0), o_quadrupole(9, 0.0), h_quadrupole(9, 0.0);
+    o_dipole[2] = 0.00755612136146;
+    h_dipole[0] = -0.00204209484795;
+    h_dipole[2] = -0.00307875299958;
+    o_quadrupole[0] = 0.000354030721139;
+    o_quadrupole[4] = -0.000390257077096;
+    o_quadrupole[8] = 3.6226355957e-05;
+    h_quadrupole[0] = -3.42537283615e-05;
+    h_quadrupole[2] = h_quadrupole[6] = -1.89170730064e-05;
+    h_quadrupole[4] = -0.000100180946379;
+    h_quadrupole[8] = 0.000134434674741;
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                int atom1 = system.getNumParticles();
+                int atom2 = atom1+1, atom3 = atom1+2;
+                system.addParticle(16.0);
+                system.addParticle(1.0);
+                system.addParticle(1.0);
+                force->addMultipole(o_charge, o_dipole, o_quadrupole, AmoebaMultipoleForce::Bisector, atom2, atom3, -1, 0.39, pow(0.000837, 1.0/6.0), 0.000837);
+                force->addMultipole(h_charge, h_dipole, h_quadrupole, AmoebaMultipoleForce::ZThenX, atom1, atom3, -1, 0.39, pow(0.000496, 1.0/6.0), 0.000496);
+                force->addMultipole(h_charge, h_dipole, h_quadrupole, AmoebaMultipoleForce::ZThenX, atom1, atom2, -1, 0.39, pow(0.000496, 1.0/6.0), 0.000496);
+                vector<int> bonded(2);
+                bonded[0] = atom2;
+                bonded[1] = atom3;
+                force->setCovalentMap(atom1, AmoebaMultipoleForce::Covalent12, bonded);
+                vector<int> oxygen(1, atom1);
+                force->setCovalentMap(atom2, AmoebaMultipoleForce::Covalent12, oxygen);
+                force->setCovalentMap(atom3, AmoebaMultipoleForce::Covalent12, oxygen);
+                force->setCovalentMap(atom2, AmoebaMultipoleForce::Covalent13, vector<int>(1, atom3));
+                force->setCovalentMap(atom3, AmoebaMultipoleForce::Covalent13, vector<int>(1, atom2));
+                vector<int> molecule(3);
+                molecule[0] = atom1;
+                molecule[1] = atom2;
+                molecule[2] = atom3;
+                for (int m = 0; m < 3; m++)
+                    force->setCovalentMap(atom1+m, AmoebaMultipoleForce::PolarizationCovalent11, molecule);
+                Vec3 center = Vec3(i, j, k)*spacing + Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*0.05;
+                positions.push_back(center);
+                positions.push_back(center+Vec3(0.0757, 0.0586, 0.01*genrand_real2(sfmt)));
+                positions.push_back(center+Vec3(-0.0757, 0.0586, 0.01*genrand_real2(sfmt)));
+            }
+}
+
+static void compareToReference(AmoebaMultipoleForce::NonbondedMethod method, AmoebaMultipoleForce::PolarizationType polarization, bool triclinic) {
+    System system;
+    vector<Vec3> positions;
+    buildWaterBox(system, positions, method, polarization, triclinic);
+    AmoebaMultipoleForce* force = dynamic_cast<AmoebaMultipoleForce*>(&system.getForce(0));
+    LangevinIntegrator integrator1(0.0, 0.1, 0.01);
+    Context referenceContext(system, integrator1, Platform::getPlatformByName("Reference"));
+    referenceContext.setPositions(positions);
+    State referenceState = referenceContext.getState(State::Forces | State::Energy);
+    vector<Vec3> referenceDipoles;
+    force->getInducedDipoles(referenceContext, referenceDipoles);
+    
+    // Try it with different numbers of threads.
+    
+    const char* numThreads[] = {"1", "3", "4"};
+    for (int i = 0; i < 3; i++) {
+        map<string, string> properties;
+        properties[CpuPlatform::CpuThreads()] = numThreads[i];
+        LangevinIntegrator integrator2(0.0, 0.1, 0.01);
+        Context cpuContext(system, integrator2, Platform::getPlatformByName("CPU"), properties);
+        cpuContext.setPositions(positions);
+        State cpuState = cpuContext.getState(State::Forces | State::Energy);
+        ASSERT_EQUAL_TOL(referenceState.getPotentialEnergy(), cpuState.getPotentialEnergy(), 1e-5);
+        for (int j = 0; j < system.getNumParticles(); j++)
+            ASSERT_EQUAL_VEC(referenceState.getForces()[j], cpuState.getForces()[j], 1e-5);
+        vector<Vec3> cpuDipoles;
+        force->getInducedDipoles(cpuContext, cpuDipoles);
+        for (int j = 0; j < system.getNumParticles(); j++)
+            ASSERT_EQUAL_VEC(referenceDipoles[j], cpuDipoles[j], 1e-5);
+    }
+}
+
+void testNoCutoff() {
+    compareToReference(AmoebaMultipoleForce::NoCutoff, AmoebaMultipoleForce::Direct, false);
+    compareToReference(AmoebaMultipoleForce::NoCutoff, AmoebaMultipoleForce::Mutual, false);
+    compareToReference(AmoebaMultipoleForce::NoCutoff, AmoebaMultipoleForce::Extrapolated, false);
+}
+
+void testPME() {
+    compareToReference(AmoebaMultipoleForce::PME, AmoebaMultipoleForce::Direct, false);
+    compareToReference(AmoebaMultipoleForce::PME, AmoebaMultipoleForce::Mutual, false);
+    compareToReference(AmoebaMultipoleForce::PME, AmoebaMultipoleForce::Extrapolated, false);
+}
+
+void testTriclinic() {
+    compareToReference(AmoebaMultipoleForce::PME, AmoebaMultipoleForce::Mutual, true);
+}
+
+int main() {
+    try {
+        if (!CpuPlatform::isProcessorSupported()) {
+            cout << "CPU is not supported.  Exiting." << endl;
+            return 0;
+        }
+        Platform::registerPlatform(new CpuPlatform());
+        registerAmoebaReferenceKernelFactories();
+        registerAmoebaCpuKernelFactories();
+        testNoCutoff();
+        testPME();
+        testTriclinic();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        std::cout << "FAIL - ERROR.  Test failed." << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -0,0 +1,169 @@
+/* -------------------------------------------------------------------------- *
+ *                              OpenMMAmoeba                                  *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * This program is free software: you can redistribute it and/or modify       *
+ * it under the terms of the GNU Lesser General Public License as published   *
+ * by the Free Software Foundation, either version 3 of the License, or       *
+ * (at your option) any later version.                                        *
+ *                                                                            *
+ * This program is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the              *
+ * GNU Lesser General Public License for more details.                        *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public License   *
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.      *
+ * -------------------------------------------------------------------------- */
+/**
+ * This tests the CPU implementation of AmoebaVdwForce.
+ */
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "CpuPlatform.h"
+#include "openmm/AmoebaVdwForce.h"
+#include "openmm/Context.h"
+#include "openmm/LangevinIntegrator.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "sfmt/SFMT.h"
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace OpenMM;
+using namespace std;
+
+extern "C" OPENMM_EXPORT void registerAmoebaReferenceKernelFactories();
+extern "C" OPENMM_EXPORT void registerAmoebaCpuKernelFactories();
+
+/**
+ * Build a box of water molecules on a slightly perturbed lattice.  The hydrogens have their interaction
+ * sites reduced towards the oxygens.
+ */
+static void buildWaterBox(System& system, vector<Vec3>& positions, AmoebaVdwForce::NonbondedMethod method, bool triclinic) {
+    const int gridSize = 6;
+    const double spacing = 0.31;
+    double boxSize = gridSize*spacing;
+    if (triclinic)
+        system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0.2*boxSize, boxSize, 0), Vec3(-0.1*boxSize, 0.3*boxSize, boxSize));
+    else
+        system.setDefaultPeriodicBoxVectors(Vec3(boxSize, 0, 0), Vec3(0, boxSize, 0), Vec3(0, 0, boxSize));
+    AmoebaVdwForce* force = new AmoebaVdwForce();
+    system.addForce(force);
+    force->setNonbondedMethod(method);
+    force->setCutoff(0.7);
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(0, sfmt);
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            for (int k = 0; k < gridSize; k++) {
+                int atom1 = system.getNumParticles();
+                system.addParticle(16.0);
+                system.addParticle(1.0);
+                system.addParticle(1.0);
+                force->addParticle(atom1, 0.17025, 0.46024, 0.0);
+                force->addParticle(atom1, 0.13275, 0.056484, 0.91);
+                force->addParticle(atom1, 0.13275, 0.056484, 0.91);
+                vector<int> molecule(3);
+                molecule[0] = atom1;
+                molecule[1] = atom1+1;
+                molecule[2] = atom1+2;
+                for (int m = 0; m < 3; m++)
+                    force->setParticleExclusions(atom1+m, molecule);
+                Vec3 center = Vec3(i, j, k)*spacing + Vec3(genrand_real2(sfmt), genrand_real2(sfmt), genrand_real2(sfmt))*0.05;
+                positions.push_back(center);
+                positions.push_back(center+Vec3(0.0757, 0.0586, 0.01*genrand_real2(sfmt)));
+                positions.push_back(center+Vec3(-0.0757, 0.0586, 0.01*genrand_real2(sfmt)));
+            }
+}
+
+/**
+ * Compare the forces and energy to the Reference platform.  The positions are changed several times, mostly by
+ * small amounts, so the neighbor list must correctly decide when it needs to be rebuilt.
+ */
+static void compareToReference(AmoebaVdwForce::NonbondedMethod method, bool triclinic, const string& sigmaCombiningRule, const string& epsilonCombiningRule) {
+    System system;
+    vector<Vec3> positions;
+    buildWaterBox(system, positions, method, triclinic);
+    AmoebaVdwForce* force = dynamic_cast<AmoebaVdwForce*>(&system.getForce(0));
+    force->setSigmaCombiningRule(sigmaCombiningRule);
+    force->setEpsilonCombiningRule(epsilonCombiningRule);
+    LangevinIntegrator integrator1(0.0, 0.1, 0.01);
+    Context referenceContext(system, integrator1, Platform::getPlatformByName("Reference"));
+    OpenMM_SFMT::SFMT sfmt;
+    init_gen_rand(1, sfmt);
+    
+    // Try it with different numbers of threads.
+    
+    const char* numThreads[] = {"1", "3", "4"};
+    for (int i = 0; i < 3; i++) {
+        map<string, string> properties;
+        properties[CpuPlatform::CpuThreads()] = numThreads[i];
+        LangevinIntegrator integrator2(0.0, 0.1, 0.01);
+        Context cpuContext(system, integrator2, Platform::getPlatformByName("CPU"), properties);
+        vector<Vec3> currentPositions = positions;
+        for (int step = 0; step < 5; step++) {
+            double maxDisplacement = (step == 3 ? 0.1 : 0.01);
+            for (int j = 0; j < (int) currentPositions.size(); j++)
+                currentPositions[j] += Vec3(genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5, genrand_real2(sfmt)-0.5)*maxDisplacement;
+            referenceContext.setPositions(currentPositions);
+            cpuContext.setPositions(currentPositions);
+            State referenceState = referenceContext.getState(State::Forces | State::Energy);
+            State cpuState = cpuContext.getState(State::Forces | State::Energy);
+            ASSERT_EQUAL_TOL(referenceState.getPotentialEnergy(), cpuState.getPotentialEnergy(), 1e-4);
+            for (int j = 0; j < system.getNumParticles(); j++)
+                ASSERT_EQUAL_VEC(referenceState.getForces()[j], cpuState.getForces()[j], 1e-4);
+        }
+    }
+}
+
+void testNoCutoff() {
+    compareToReference(AmoebaVdwForce::NoCutoff, false, "ARITHMETIC", "GEOMETRIC");
+}
+
+void testCutoff() {
+    compareToReference(AmoebaVdwForce::CutoffPeriodic, false, "ARITHMETIC", "GEOMETRIC");
+}
+
+void testTriclinic() {
+    compareToReference(AmoebaVdwForce::CutoffPeriodic, true, "ARITHMETIC", "GEOMETRIC");
+}
+
+void testCombiningRules() {
+    compareToReference(AmoebaVdwForce::CutoffPeriodic, false, "GEOMETRIC", "ARITHMETIC");
+    compareToReference(AmoebaVdwForce::CutoffPeriodic, false, "CUBIC-MEAN", "HARMONIC");
+    compareToReference(AmoebaVdwForce::NoCutoff, false, "CUBIC-MEAN", "HHG");
+}
+
+int main() {
+    try {
+        if (!CpuPlatform::isProcessorSupported()) {
+            cout << "CPU is not supported.  Exiting." << endl;
+            return 0;
+        }
+        Platform::registerPlatform(new CpuPlatform());
+        registerAmoebaReferenceKernelFactories();
+        registerAmoebaCpuKernelFactories();
+        testNoCutoff();
+        testCutoff();
+        testTriclinic();
+        testCombiningRules();
+    }
+    catch(const std::exception& e) {
+        std::cout << "exception: " << e.what() << std::endl;
+        std::cout << "FAIL - ERROR.  Test failed." << std::endl;
+        return 1;
+    }
+    std::cout << "Done" << std::endl;
+    return 0;
+}
@@ -1049,6 +1049,8 @@ void CudaCalcAmoebaMultipoleForceKernel::initialize(const System& system, const
     
     // Record other options.
     
+    if (force.getPolarizationType() == AmoebaMultipoleForce::Extrapolated)
+        throw OpenMMException("The CUDA platform does not support extrapolated polarization");
     if (force.getPolarizationType() == AmoebaMultipoleForce::Mutual) {
         maxInducedIterations = force.getMutualInducedMaxIterations();
         inducedEpsilon = force.getMutualInducedTargetEpsilon();
@@ -32,31 +32,43 @@
 
 using namespace OpenMM;
 
-extern "C" OPENMM_EXPORT void registerPlatforms() {
-}
-
-extern "C" OPENMM_EXPORT void registerKernelFactories() {
+/**
+ * Other AMOEBA plugins may link against this library and export their own registerKernelFactories(),
+ * so do the work in a function with internal linkage to be sure the right one gets called.
+ */
+static void registerReferenceKernelFactories() {
     for (int i = 0; i < Platform::getNumPlatforms(); i++) {
         Platform& platform = Platform::getPlatform(i);
         if (dynamic_cast<ReferencePlatform*>(&platform) != NULL) {
-             AmoebaReferenceKernelFactory* factory = new AmoebaReferenceKernelFactory();
-             platform.registerKernelFactory(CalcAmoebaBondForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaAngleForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaInPlaneAngleForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaPiTorsionForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaStretchBendForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaOutOfPlaneBendForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaTorsionTorsionForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaVdwForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaMultipoleForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaGeneralizedKirkwoodForceKernel::Name(), factory);
-             platform.registerKernelFactory(CalcAmoebaWcaDispersionForceKernel::Name(), factory);
+            // Platforms derived from ReferencePlatform may provide their own implementations, which
+            // should not be replaced if their plugin happened to be loaded first.
+
+            AmoebaReferenceKernelFactory* factory = NULL;
+            std::string kernelNames[] = {CalcAmoebaBondForceKernel::Name(), CalcAmoebaAngleForceKernel::Name(),
+                    CalcAmoebaInPlaneAngleForceKernel::Name(), CalcAmoebaPiTorsionForceKernel::Name(),
+                    CalcAmoebaStretchBendForceKernel::Name(), CalcAmoebaOutOfPlaneBendForceKernel::Name(),
+                    CalcAmoebaTorsionTorsionForceKernel::Name(), CalcAmoebaVdwForceKernel::Name(),
+                    CalcAmoebaMultipoleForceKernel::Name(), CalcAmoebaGeneralizedKirkwoodForceKernel::Name(),
+                    CalcAmoebaWcaDispersionForceKernel::Name()};
+            for (int j = 0; j < 11; j++)
+                if (platform.getName() == "Reference" || !platform.supportsKernels(std::vector<std::string>(1, kernelNames[j]))) {
+                    if (factory == NULL)
+                        factory = new AmoebaReferenceKernelFactory();
+                    platform.registerKernelFactory(kernelNames[j], factory);
+                }
         }
     }
 }
 
+extern "C" OPENMM_EXPORT void registerPlatforms() {
+}
+
+extern "C" OPENMM_EXPORT void registerKernelFactories() {
+    registerReferenceKernelFactories();
+}
+
 extern "C" OPENMM_EXPORT void registerAmoebaReferenceKernelFactories() {
-    registerKernelFactories();
+    registerReferenceKernelFactories();
 }
 
 KernelImpl* AmoebaReferenceKernelFactory::createKernelImpl(std::string name, const Platform& platform, ContextImpl& context) const {
@@ -565,6 +565,12 @@ void ReferenceCalcAmoebaMultipoleForceKernel::initialize(const System& system, c
     if (polarizationType == AmoebaMultipoleForce::Mutual) {
         mutualInducedMaxIterations = force.getMutualInducedMaxIterations();
         mutualInducedTargetEpsilon = force.getMutualInducedTargetEpsilon();
+    } else if (polarizationType == AmoebaMultipoleForce::Extrapolated) {
+        vector<double> coefficients;
+        force.getExtrapolationCoefficients(coefficients);
+        extrapolationCoefficients.resize(coefficients.size());
+        for (int i = 0; i < (int) coefficients.size(); i++)
+            extrapolationCoefficients[i] = static_cast<RealOpenMM>(coefficients[i]);
     }
 
     // PME
@@ -611,10 +617,13 @@ AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::setupAmo
     AmoebaReferenceMultipoleForce* amoebaReferenceMultipoleForce = NULL;
     if (gkKernel) {
 
+        if (polarizationType == AmoebaMultipoleForce::Extrapolated)
+            throw OpenMMException("AmoebaGeneralizedKirkwoodForce does not support extrapolated polarization");
+
         // amoebaReferenceGeneralizedKirkwoodForce is deleted in AmoebaReferenceGeneralizedKirkwoodMultipoleForce
         // destructor
 
-        AmoebaReferenceGeneralizedKirkwoodForce* amoebaReferenceGeneralizedKirkwoodForce = new AmoebaReferenceGeneralizedKirkwoodForce();
+        AmoebaReferenceGeneralizedKirkwoodForce* amoebaReferenceGeneralizedKirkwoodForce = createGeneralizedKirkwoodForce(context);
         amoebaReferenceGeneralizedKirkwoodForce->setNumParticles(gkKernel->getNumParticles());
         amoebaReferenceGeneralizedKirkwoodForce->setSoluteDielectric(gkKernel->getSoluteDielectric());
         amoebaReferenceGeneralizedKirkwoodForce->setSolventDielectric(gkKernel->getSolventDielectric());
@@ -639,11 +648,11 @@ AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::setupAmo
         vector<RealVec>& posData   = extractPositions(context);
         amoebaReferenceGeneralizedKirkwoodForce->calculateGrycukBornRadii(posData);
 
-        amoebaReferenceMultipoleForce = new AmoebaReferenceGeneralizedKirkwoodMultipoleForce(amoebaReferenceGeneralizedKirkwoodForce);
+        amoebaReferenceMultipoleForce = createGeneralizedKirkwoodMultipoleForce(context, amoebaReferenceGeneralizedKirkwoodForce);
 
     } else if (usePme) {
 
-        AmoebaReferencePmeMultipoleForce* amoebaReferencePmeMultipoleForce = new AmoebaReferencePmeMultipoleForce();
+        AmoebaReferencePmeMultipoleForce* amoebaReferencePmeMultipoleForce = createPmeMultipoleForce(context);
         amoebaReferencePmeMultipoleForce->setAlphaEwald(alphaEwald);
         amoebaReferencePmeMultipoleForce->setCutoffDistance(cutoffDistance);
         amoebaReferencePmeMultipoleForce->setPmeGridDimensions(pmeGridDimension);
@@ -656,7 +665,7 @@ AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::setupAmo
         amoebaReferenceMultipoleForce = static_cast<AmoebaReferenceMultipoleForce*>(amoebaReferencePmeMultipoleForce);
 
     } else {
-         amoebaReferenceMultipoleForce = new AmoebaReferenceMultipoleForce(AmoebaReferenceMultipoleForce::NoCutoff);
+         amoebaReferenceMultipoleForce = createNoCutoffMultipoleForce(context);
     }
 
     // set polarization type
@@ -665,8 +674,15 @@ AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::setupAmo
         amoebaReferenceMultipoleForce->setPolarizationType(AmoebaReferenceMultipoleForce::Mutual);
         amoebaReferenceMultipoleForce->setMutualInducedDipoleTargetEpsilon(mutualInducedTargetEpsilon);
         amoebaReferenceMultipoleForce->setMaximumMutualInducedDipoleIterations(mutualInducedMaxIterations);
+
+        // start from the dipoles found by the previous calculation
+
+        amoebaReferenceMultipoleForce->setInitialInducedDipoles(lastInducedDipoles, lastInducedDipolesPolar);
     } else if (polarizationType == AmoebaMultipoleForce::Direct) {
         amoebaReferenceMultipoleForce->setPolarizationType(AmoebaReferenceMultipoleForce::Direct);
+    } else if (polarizationType == AmoebaMultipoleForce::Extrapolated) {
+        amoebaReferenceMultipoleForce->setPolarizationType(AmoebaReferenceMultipoleForce::Extrapolated);
+        amoebaReferenceMultipoleForce->setExtrapolationCoefficients(extrapolationCoefficients);
     } else {
         throw OpenMMException("Polarization type not recognzied.");
     }
@@ -675,6 +691,23 @@ AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::setupAmo
 
 }
 
+AmoebaReferenceMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::createNoCutoffMultipoleForce(ContextImpl& context) {
+    return new AmoebaReferenceMultipoleForce(AmoebaReferenceMultipoleForce::NoCutoff);
+}
+
+AmoebaReferencePmeMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::createPmeMultipoleForce(ContextImpl& context) {
+    return new AmoebaReferencePmeMultipoleForce();
+}
+
+AmoebaReferenceGeneralizedKirkwoodForce* ReferenceCalcAmoebaMultipoleForceKernel::createGeneralizedKirkwoodForce(ContextImpl& context) {
+    return new AmoebaReferenceGeneralizedKirkwoodForce();
+}
+
+AmoebaReferenceGeneralizedKirkwoodMultipoleForce* ReferenceCalcAmoebaMultipoleForceKernel::createGeneralizedKirkwoodMultipoleForce(ContextImpl& context,
+                                                                                                                                 AmoebaReferenceGeneralizedKirkwoodForce* gkForce) {
+    return new AmoebaReferenceGeneralizedKirkwoodMultipoleForce(gkForce);
+}
+
 double ReferenceCalcAmoebaMultipoleForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
 
     AmoebaReferenceMultipoleForce* amoebaReferenceMultipoleForce = setupAmoebaReferenceMultipoleForce(context);
@@ -685,6 +718,7 @@ double ReferenceCalcAmoebaMultipoleForceKernel::execute(ContextImpl& context, bo
                                                                                          dampingFactors, polarity, axisTypes, 
                                                                                          multipoleAtomZs, multipoleAtomXs, multipoleAtomYs,
                                                                                          multipoleAtomCovalentInfo, forceData);
+    amoebaReferenceMultipoleForce->getInducedDipoles(lastInducedDipoles, lastInducedDipolesPolar);
 
     delete amoebaReferenceMultipoleForce;
 
@@ -705,6 +739,7 @@ void ReferenceCalcAmoebaMultipoleForceKernel::getInducedDipoles(ContextImpl& con
     vector<RealVec> inducedDipoles;
     amoebaReferenceMultipoleForce->calculateInducedDipoles(posData, charges, dipoles, quadrupoles, tholes,
             dampingFactors, polarity, axisTypes, multipoleAtomZs, multipoleAtomXs, multipoleAtomYs, multipoleAtomCovalentInfo, inducedDipoles);
+    amoebaReferenceMultipoleForce->getInducedDipoles(lastInducedDipoles, lastInducedDipolesPolar);
     for (int i = 0; i < numParticles; i++)
         outputDipoles[i] = inducedDipoles[i];
     delete amoebaReferenceMultipoleForce;
@@ -976,7 +1011,17 @@ double ReferenceCalcAmoebaVdwForceKernel::execute(ContextImpl& context, bool inc
     RealOpenMM energy;
     if (useCutoff) {
         vdwForce.setCutoff(cutoff);
-        computeNeighborListVoxelHash(*neighborList, numParticles, posData, allExclusions, extractBoxVectors(context), usePBC, cutoff, 0.0);
+
+        // The interactions are computed between the reduced interaction sites, so build the neighbor list from them.
+
+        vector<RealVec> sitePositions(numParticles);
+        for (int ii = 0; ii < numParticles; ii++) {
+            if (reductions[ii] != 0.0)
+                sitePositions[ii] = posData[indexIVs[ii]]+(posData[ii]-posData[indexIVs[ii]])*reductions[ii];
+            else
+                sitePositions[ii] = posData[ii];
+        }
+        computeNeighborListVoxelHash(*neighborList, numParticles, sitePositions, allExclusions, extractBoxVectors(context), usePBC, cutoff, 0.0);
         if (usePBC) {
             vdwForce.setNonbondedMethod(AmoebaReferenceVdwForce::CutoffPeriodic);
             RealVec* boxVectors = extractBoxVectors(context);
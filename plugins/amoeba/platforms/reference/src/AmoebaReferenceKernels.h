@@ -404,7 +404,38 @@ public:
      */
     void copyParametersToContext(ContextImpl& context, const AmoebaMultipoleForce& force);
 
-private:
+protected:
+    /**
+     * Create the object used to compute multipole interactions without a cutoff.  Subclasses may
+     * override this to provide an optimized implementation.
+     *
+     * @param context        the current context
+     */
+    virtual AmoebaReferenceMultipoleForce* createNoCutoffMultipoleForce(ContextImpl& context);
+    /**
+     * Create the object used to compute multipole interactions with PME.  Subclasses may override
+     * this to provide an optimized implementation.  The returned object is configured by the caller.
+     *
+     * @param context        the current context
+     */
+    virtual AmoebaReferencePmeMultipoleForce* createPmeMultipoleForce(ContextImpl& context);
+    /**
+     * Create the object used to compute Grycuk Born radii for the Generalized Kirkwood model.  Subclasses
+     * may override this to provide an optimized implementation.  The returned object is configured by the caller.
+     *
+     * @param context        the current context
+     */
+    virtual AmoebaReferenceGeneralizedKirkwoodForce* createGeneralizedKirkwoodForce(ContextImpl& context);
+    /**
+     * Create the object used to compute multipole interactions with the Generalized Kirkwood model.  Subclasses
+     * may override this to provide an optimized implementation.
+     *
+     * @param context        the current context
+     * @param gkForce        the object returned by createGeneralizedKirkwoodForce(), with the Born radii already
+     *                       computed.  The returned object takes ownership of it.
+     */
+    virtual AmoebaReferenceGeneralizedKirkwoodMultipoleForce* createGeneralizedKirkwoodMultipoleForce(ContextImpl& context,
+                                                                                                      AmoebaReferenceGeneralizedKirkwoodForce* gkForce);
 
     int numMultipoles;
     AmoebaMultipoleForce::NonbondedMethod nonbondedMethod;
@@ -423,6 +454,9 @@ private:
 
     int mutualInducedMaxIterations;
     RealOpenMM mutualInducedTargetEpsilon;
+    std::vector<RealOpenMM> extrapolationCoefficients;
+    std::vector<RealVec> lastInducedDipoles;
+    std::vector<RealVec> lastInducedDipolesPolar;
 
     bool usePme;
     RealOpenMM alphaEwald;
@@ -84,7 +84,7 @@ public:
                                        RealOpenMM globalAngleSextic,
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
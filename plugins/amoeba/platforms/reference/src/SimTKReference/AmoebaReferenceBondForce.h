@@ -77,7 +77,7 @@ public:
                                        RealOpenMM bondCubic, RealOpenMM bondQuartic,
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
-private:
+protected:
 
      /**---------------------------------------------------------------------------------------
      
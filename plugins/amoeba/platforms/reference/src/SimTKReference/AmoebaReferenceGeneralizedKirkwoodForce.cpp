@@ -133,6 +133,16 @@ void AmoebaReferenceGeneralizedKirkwoodForce::getGrycukBornRadii(vector<RealOpen
 
 void AmoebaReferenceGeneralizedKirkwoodForce::calculateGrycukBornRadii(const vector<RealVec>& particlePositions) {
 
+    _bornRadii.resize(_numParticles);
+    for (unsigned int ii = 0; ii < _numParticles; ii++) {
+        _bornRadii[ii] = calculateGrycukBornRadius(ii, particlePositions);
+    }
+
+    return;
+}
+
+RealOpenMM AmoebaReferenceGeneralizedKirkwoodForce::calculateGrycukBornRadius(unsigned int ii, const vector<RealVec>& particlePositions) const {
+
     const RealOpenMM zero      = 0.0;
     const RealOpenMM one       = 1.0;
     const RealOpenMM three     = 3.0;
@@ -142,64 +152,57 @@ void AmoebaReferenceGeneralizedKirkwoodForce::calculateGrycukBornRadii(const vec
     const RealOpenMM oneThird  = 1.0/3.0;
     const RealOpenMM bigRadius = 1000.0;
 
-    _bornRadii.resize(_numParticles);
-    for (unsigned int ii = 0; ii < _numParticles; ii++) {
-
-        if (_atomicRadii[ii] <= zero) {
-            _bornRadii[ii] = bigRadius;
-            continue;
-        }
-
-        RealOpenMM bornSum = zero;
-        for (unsigned int jj = 0; jj < _numParticles; jj++) {
-
-            if (ii == jj || _atomicRadii[jj] < zero)continue;
-          
-            RealOpenMM xr       = particlePositions[jj][0] - particlePositions[ii][0];
-            RealOpenMM yr       = particlePositions[jj][1] - particlePositions[ii][1];
-            RealOpenMM zr       = particlePositions[jj][2] - particlePositions[ii][2];
-
-            RealOpenMM r2       = xr*xr + yr*yr + zr*zr;
-            RealOpenMM r        = SQRT(r2);
-
-            RealOpenMM sk       = _atomicRadii[jj]*_scaleFactors[jj];
-            RealOpenMM sk2      = sk*sk;
-
-            if ((_atomicRadii[ii] + r) < sk) {
-                RealOpenMM lik       = _atomicRadii[ii];
-                RealOpenMM uik       = sk - r;  
-                RealOpenMM lik3      = lik*lik*lik;
-                RealOpenMM uik3      = uik*uik*uik;
-                bornSum             -= (one/uik3 - one/lik3);
-            }   
-        
-            RealOpenMM uik = r + sk; 
-            RealOpenMM lik;
-            if ((_atomicRadii[ii] + r) < sk) {
-                lik = sk - r;  
-            } else if (r < (_atomicRadii[ii] + sk)) {
-                lik = _atomicRadii[ii];
-            } else {
-                lik = r - sk; 
-            }   
-        
-            RealOpenMM l2          = lik*lik; 
-            RealOpenMM l4          = l2*l2;
-            RealOpenMM lr          = lik*r;
-            RealOpenMM l4r         = l4*r;
-        
-            RealOpenMM u2          = uik*uik;
-            RealOpenMM u4          = u2*u2;
-            RealOpenMM ur          = uik*r;
-            RealOpenMM u4r         = u4*r;
-        
-            RealOpenMM term        = (three*(r2-sk2) + six*u2 - eight*ur)/u4r - (three*(r2-sk2) + six*l2 - eight*lr)/l4r;
-            bornSum               += term/sixteen;
-        
-        }
-        bornSum        = one/(_atomicRadii[ii]*_atomicRadii[ii]*_atomicRadii[ii]) - bornSum;
-        _bornRadii[ii] = (bornSum <= zero) ? bigRadius : POW(bornSum, -oneThird);
+    if (_atomicRadii[ii] <= zero) {
+        return bigRadius;
     }
 
-    return;
+    RealOpenMM bornSum = zero;
+    for (unsigned int jj = 0; jj < _numParticles; jj++) {
+
+        if (ii == jj || _atomicRadii[jj] < zero)continue;
+      
+        RealOpenMM xr       = particlePositions[jj][0] - particlePositions[ii][0];
+        RealOpenMM yr       = particlePositions[jj][1] - particlePositions[ii][1];
+        RealOpenMM zr       = particlePositions[jj][2] - particlePositions[ii][2];
+
+        RealOpenMM r2       = xr*xr + yr*yr + zr*zr;
+        RealOpenMM r        = SQRT(r2);
+
+        RealOpenMM sk       = _atomicRadii[jj]*_scaleFactors[jj];
+        RealOpenMM sk2      = sk*sk;
+
+        if ((_atomicRadii[ii] + r) < sk) {
+            RealOpenMM lik       = _atomicRadii[ii];
+            RealOpenMM uik       = sk - r;  
+            RealOpenMM lik3      = lik*lik*lik;
+            RealOpenMM uik3      = uik*uik*uik;
+            bornSum             -= (one/uik3 - one/lik3);
+        }   
+    
+        RealOpenMM uik = r + sk; 
+        RealOpenMM lik;
+        if ((_atomicRadii[ii] + r) < sk) {
+            lik = sk - r;  
+        } else if (r < (_atomicRadii[ii] + sk)) {
+            lik = _atomicRadii[ii];
+        } else {
+            lik = r - sk; 
+        }   
+    
+        RealOpenMM l2          = lik*lik; 
+        RealOpenMM l4          = l2*l2;
+        RealOpenMM lr          = lik*r;
+        RealOpenMM l4r         = l4*r;
+    
+        RealOpenMM u2          = uik*uik;
+        RealOpenMM u4          = u2*u2;
+        RealOpenMM ur          = uik*r;
+        RealOpenMM u4r         = u4*r;
+    
+        RealOpenMM term        = (three*(r2-sk2) + six*u2 - eight*ur)/u4r - (three*(r2-sk2) + six*l2 - eight*lr)/l4r;
+        bornSum               += term/sixteen;
+    
+    }
+    bornSum = one/(_atomicRadii[ii]*_atomicRadii[ii]*_atomicRadii[ii]) - bornSum;
+    return (bornSum <= zero) ? bigRadius : POW(bornSum, -oneThird);
 }
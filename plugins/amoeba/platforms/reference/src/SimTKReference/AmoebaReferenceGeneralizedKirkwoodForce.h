@@ -47,7 +47,7 @@ public:
      *  Destructor
      *  
      */
-    ~AmoebaReferenceGeneralizedKirkwoodForce() {};
+    virtual ~AmoebaReferenceGeneralizedKirkwoodForce() {};
  
     /**
      *  Get number of particles 
@@ -221,7 +221,7 @@ public:
      * @param particlePositions particle positions
      *
      */
-    void calculateGrycukBornRadii(const vector<RealVec>& particlePositions);
+    virtual void calculateGrycukBornRadii(const vector<RealVec>& particlePositions);
          
     /**
      * Get Grycik Born radii (must have called calculateGrycukBornRadii())
@@ -231,7 +231,19 @@ public:
      */
     void getGrycukBornRadii(vector<RealOpenMM>& bornRadii) const;     
 
-private:
+protected:
+
+    /**
+     * Calculate the Grycuk Born radius of one particle
+     *
+     * @param particleI         index of the particle
+     * @param particlePositions particle positions
+     *
+     * @return Born radius
+     *
+     */
+    RealOpenMM calculateGrycukBornRadius(unsigned int particleI, const vector<RealVec>& particlePositions) const;
+
 
     int _numParticles;
     int _includeCavityTerm;
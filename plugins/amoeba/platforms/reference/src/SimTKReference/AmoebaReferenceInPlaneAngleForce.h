@@ -86,7 +86,7 @@ public:
                                        RealOpenMM globalAngleSextic,
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
@@ -167,6 +167,32 @@ void AmoebaReferenceMultipoleForce::setMutualInducedDipoleTargetEpsilon(RealOpen
     _mutualInducedDipoleTargetEpsilon = mutualInducedDipoleTargetEpsilon;
 }
 
+void AmoebaReferenceMultipoleForce::setExtrapolationCoefficients(const vector<RealOpenMM>& coefficients)
+{
+    // The dipoles are combined as sum_k b_k*mu_k, where mu_k is the k'th term of the perturbation series
+    // and b_k is the sum of the coefficients of order k and higher.
+
+    int numOrders = coefficients.size();
+    _extPartCoefficients.resize(numOrders);
+    RealOpenMM sum = 0.0;
+    for (int k = numOrders-1; k >= 0; k--) {
+        sum += coefficients[k];
+        _extPartCoefficients[k] = sum;
+    }
+}
+
+void AmoebaReferenceMultipoleForce::setInitialInducedDipoles(const vector<RealVec>& inducedDipoles, const vector<RealVec>& inducedDipolesPolar)
+{
+    _initialInducedDipole      = inducedDipoles;
+    _initialInducedDipolePolar = inducedDipolesPolar;
+}
+
+void AmoebaReferenceMultipoleForce::getInducedDipoles(vector<RealVec>& inducedDipoles, vector<RealVec>& inducedDipolesPolar) const
+{
+    inducedDipoles      = _inducedDipole;
+    inducedDipolesPolar = _inducedDipolePolar;
+}
+
 void AmoebaReferenceMultipoleForce::setupScaleMaps(const vector< vector< vector<int> > >& multipoleParticleCovalentInfo)
 {
 
@@ -183,6 +209,7 @@ void AmoebaReferenceMultipoleForce::setupScaleMaps(const vector< vector< vector<
 
     _scaleMaps.resize(multipoleParticleCovalentInfo.size());
     _maxScaleIndex.resize(multipoleParticleCovalentInfo.size());
+    _polarizationGroupPartners.resize(multipoleParticleCovalentInfo.size());
 
     for (unsigned int ii = 0; ii < multipoleParticleCovalentInfo.size(); ii++) {
 
@@ -191,6 +218,14 @@ void AmoebaReferenceMultipoleForce::setupScaleMaps(const vector< vector< vector<
         const vector< vector<int> >& covalentInfo = multipoleParticleCovalentInfo[ii];
         const vector<int> covalentListP11              = covalentInfo[AmoebaMultipoleForce::PolarizationCovalent11];
 
+        // other members of the polarization group, used by the induced dipole preconditioner
+
+        _polarizationGroupPartners[ii].clear();
+        for (unsigned int kk = 0; kk < covalentListP11.size(); kk++) {
+            if (covalentListP11[kk] > static_cast<int>(ii))
+                _polarizationGroupPartners[ii].push_back(static_cast<unsigned int>(covalentListP11[kk]));
+        }
+
         // pScale & mScale
 
         for (unsigned jj = 0; jj < AmoebaMultipoleForce::PolarizationCovalent11; jj++) {
@@ -234,7 +269,7 @@ void AmoebaReferenceMultipoleForce::setupScaleMaps(const vector< vector< vector<
 RealOpenMM AmoebaReferenceMultipoleForce::getMultipoleScaleFactor(unsigned int particleI, unsigned int particleJ, ScaleType scaleType) const 
 {
 
-    MapIntRealOpenMM  scaleMap   = _scaleMaps[particleI][scaleType];
+    const MapIntRealOpenMM& scaleMap = _scaleMaps[particleI][scaleType];
     MapIntRealOpenMMCI isPresent = scaleMap.find(particleJ);
     if (isPresent != scaleMap.end()) {
         return isPresent->second;
@@ -544,7 +579,9 @@ void AmoebaReferenceMultipoleForce::getAndScaleInverseRs(RealOpenMM dampI, RealO
 
 void AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI,
                                                                         const MultipoleParticleData& particleJ,
-                                                                        RealOpenMM dScale, RealOpenMM pScale) 
+                                                                        RealOpenMM dScale, RealOpenMM pScale,
+                                                                        vector<RealVec>& fixedMultipoleField,
+                                                                        vector<RealVec>& fixedMultipoleFieldPolar) 
 {
 
     if (particleI.particleIndex == particleJ.particleIndex)
@@ -577,8 +614,8 @@ void AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairIxn(const Mu
     RealVec field                               = deltaR*factor + particleJ.dipole*rr3 - qDotDelta*rr5_2;
 
     unsigned int particleIndex                  = particleI.particleIndex;
-    _fixedMultipoleField[particleIndex]        -= field*dScale;
-    _fixedMultipoleFieldPolar[particleIndex]   -= field*pScale;
+    fixedMultipoleField[particleIndex]         -= field*dScale;
+    fixedMultipoleFieldPolar[particleIndex]    -= field*pScale;
  
     // field at particle J due multipoles at particle I
 
@@ -592,8 +629,8 @@ void AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairIxn(const Mu
  
     field                                       = deltaR*factor - particleI.dipole*rr3 - qDotDelta*rr5_2;
     particleIndex                               = particleJ.particleIndex;
-    _fixedMultipoleField[particleIndex]        += field*dScale;
-    _fixedMultipoleFieldPolar[particleIndex]   += field*pScale;
+    fixedMultipoleField[particleIndex]         += field*dScale;
+    fixedMultipoleFieldPolar[particleIndex]    += field*pScale;
 }
 
 void AmoebaReferenceMultipoleForce::calculateFixedMultipoleField(const vector<MultipoleParticleData>& particleData)
@@ -601,6 +638,12 @@ void AmoebaReferenceMultipoleForce::calculateFixedMultipoleField(const vector<Mu
 
     // calculate fixed multipole fields
 
+    calculateFixedMultipoleFieldPairs(particleData);
+}
+
+void AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairs(const vector<MultipoleParticleData>& particleData)
+{
+
     // loop includes diagonal term ii == jj for GK ixn; other calculateFixedMultipoleFieldPairIxn() methods
     // skip calculations for this case
 
@@ -616,7 +659,7 @@ void AmoebaReferenceMultipoleForce::calculateFixedMultipoleField(const vector<Mu
             } else {
                 dScale = pScale = 1.0;
             }
-            calculateFixedMultipoleFieldPairIxn(particleData[ii], particleData[jj], dScale, pScale);
+            calculateFixedMultipoleFieldPairIxn(particleData[ii], particleData[jj], dScale, pScale, _fixedMultipoleField, _fixedMultipoleFieldPolar);
         }
     }
 }
@@ -629,9 +672,14 @@ void AmoebaReferenceMultipoleForce::initializeInducedDipoles(vector<UpdateInduce
     _inducedDipole.resize(_numParticles);
     _inducedDipolePolar.resize(_numParticles);
 
+    // start from the dipoles supplied by the caller (e.g., the previous step) if available;
+    // otherwise use the direct induced dipoles
+
+    bool warmStart = (getPolarizationType() == AmoebaReferenceMultipoleForce::Mutual &&
+                      _initialInducedDipole.size() == _numParticles && _initialInducedDipolePolar.size() == _numParticles);
     for (unsigned int ii = 0; ii < _numParticles; ii++) {
-        _inducedDipole[ii]       = _fixedMultipoleField[ii];
-        _inducedDipolePolar[ii]  = _fixedMultipoleFieldPolar[ii];
+        _inducedDipole[ii]       = (warmStart ? _initialInducedDipole[ii]      : _fixedMultipoleField[ii]);
+        _inducedDipolePolar[ii]  = (warmStart ? _initialInducedDipolePolar[ii] : _fixedMultipoleFieldPolar[ii]);
     }
 }
 
@@ -650,6 +698,36 @@ void AmoebaReferenceMultipoleForce::calculateInducedDipolePairIxn(unsigned int p
     field[particleJ]               += inducedDipole[particleI]*rr3 + deltaR*dDotDelta;
 }
 
+void AmoebaReferenceMultipoleForce::calculateInducedDipolePairGradientIxn(unsigned int particleI, 
+                                                                          unsigned int particleJ,
+                                                                          RealOpenMM rr5,
+                                                                          RealOpenMM rr7,
+                                                                          const RealVec& deltaR,
+                                                                          const vector<RealVec>& inducedDipole,
+                                                                          vector<RealOpenMM>& fieldGradient) const 
+{
+
+    // The field gradient is odd in deltaR, so the contribution at particle I has the opposite sign.
+
+    const RealVec& dipoleJ = inducedDipole[particleJ];
+    RealOpenMM dDotDelta   = dipoleJ.dot(deltaR);
+    fieldGradient[6*particleI+0] -= rr5*(2*dipoleJ[0]*deltaR[0] + dDotDelta) - rr7*deltaR[0]*deltaR[0]*dDotDelta;
+    fieldGradient[6*particleI+1] -= rr5*(2*dipoleJ[1]*deltaR[1] + dDotDelta) - rr7*deltaR[1]*deltaR[1]*dDotDelta;
+    fieldGradient[6*particleI+2] -= rr5*(2*dipoleJ[2]*deltaR[2] + dDotDelta) - rr7*deltaR[2]*deltaR[2]*dDotDelta;
+    fieldGradient[6*particleI+3] -= rr5*(dipoleJ[0]*deltaR[1] + dipoleJ[1]*deltaR[0]) - rr7*deltaR[0]*deltaR[1]*dDotDelta;
+    fieldGradient[6*particleI+4] -= rr5*(dipoleJ[0]*deltaR[2] + dipoleJ[2]*deltaR[0]) - rr7*deltaR[0]*deltaR[2]*dDotDelta;
+    fieldGradient[6*particleI+5] -= rr5*(dipoleJ[1]*deltaR[2] + dipoleJ[2]*deltaR[1]) - rr7*deltaR[1]*deltaR[2]*dDotDelta;
+
+    const RealVec& dipoleI = inducedDipole[particleI];
+    dDotDelta              = dipoleI.dot(deltaR);
+    fieldGradient[6*particleJ+0] += rr5*(2*dipoleI[0]*deltaR[0] + dDotDelta) - rr7*deltaR[0]*deltaR[0]*dDotDelta;
+    fieldGradient[6*particleJ+1] += rr5*(2*dipoleI[1]*deltaR[1] + dDotDelta) - rr7*deltaR[1]*deltaR[1]*dDotDelta;
+    fieldGradient[6*particleJ+2] += rr5*(2*dipoleI[2]*deltaR[2] + dDotDelta) - rr7*deltaR[2]*deltaR[2]*dDotDelta;
+    fieldGradient[6*particleJ+3] += rr5*(dipoleI[0]*deltaR[1] + dipoleI[1]*deltaR[0]) - rr7*deltaR[0]*deltaR[1]*dDotDelta;
+    fieldGradient[6*particleJ+4] += rr5*(dipoleI[0]*deltaR[2] + dipoleI[2]*deltaR[0]) - rr7*deltaR[0]*deltaR[2]*dDotDelta;
+    fieldGradient[6*particleJ+5] += rr5*(dipoleI[1]*deltaR[2] + dipoleI[2]*deltaR[1]) - rr7*deltaR[1]*deltaR[2]*dDotDelta;
+}
+
 void AmoebaReferenceMultipoleForce::calculateInducedDipolePairIxns(const MultipoleParticleData& particleI, 
                                                                    const MultipoleParticleData& particleJ,
                                                                    vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields)
@@ -660,7 +738,8 @@ void AmoebaReferenceMultipoleForce::calculateInducedDipolePairIxns(const Multipo
 
     RealVec deltaR       = particleJ.position - particleI.position;
     RealOpenMM r         =  SQRT(deltaR.dot(deltaR));
-    vector<RealOpenMM> rrI(2);
+    bool computeGradient = (updateInducedDipoleFields[0].inducedDipoleFieldGradient.size() > 0);
+    vector<RealOpenMM> rrI(computeGradient ? 3 : 2);
   
     getAndScaleInverseRs(particleI.dampingFactor, particleJ.dampingFactor,
                           particleI.thole, particleJ.thole, r, rrI);
@@ -671,6 +750,9 @@ void AmoebaReferenceMultipoleForce::calculateInducedDipolePairIxns(const Multipo
     for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++) {
         calculateInducedDipolePairIxn(particleI.particleIndex, particleJ.particleIndex, rr3, rr5, deltaR,
                                        *updateInducedDipoleFields[ii].inducedDipoles, updateInducedDipoleFields[ii].inducedDipoleField);
+        if (computeGradient)
+            calculateInducedDipolePairGradientIxn(particleI.particleIndex, particleJ.particleIndex, rr5, rrI[2], deltaR,
+                                                  *updateInducedDipoleFields[ii].inducedDipoles, updateInducedDipoleFields[ii].inducedDipoleFieldGradient);
     }
 }
 
@@ -678,11 +760,19 @@ void AmoebaReferenceMultipoleForce::calculateInducedDipoleFields(const vector<Mu
     // Initialize the fields to zero.
     
     RealVec zeroVec(0.0, 0.0, 0.0);
-    for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++)
+    for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++) {
         std::fill(updateInducedDipoleFields[ii].inducedDipoleField.begin(), updateInducedDipoleFields[ii].inducedDipoleField.end(), zeroVec);
+        std::fill(updateInducedDipoleFields[ii].inducedDipoleFieldGradient.begin(), updateInducedDipoleFields[ii].inducedDipoleFieldGradient.end(), 0.0);
+    }
 
     // Add fields from all induced dipoles.
     
+    calculateInducedDipoleFieldPairs(particleData, updateInducedDipoleFields);
+}
+
+void AmoebaReferenceMultipoleForce::calculateInducedDipoleFieldPairs(const vector<MultipoleParticleData>& particleData,
+                                                                     vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields)
+{
     for (unsigned int ii = 0; ii < particleData.size(); ii++)
         for (unsigned int jj = ii; jj < particleData.size(); jj++)
             calculateInducedDipolePairIxns(particleData[ii], particleData[jj], updateInducedDipoleFields);
@@ -826,6 +916,239 @@ void AmoebaReferenceMultipoleForce::convergeInduceDipolesByDIIS(const vector<Mul
     }
 }
 
+void AmoebaReferenceMultipoleForce::findInducedDipolePreconditionerPairs(const vector<MultipoleParticleData>& particleData,
+                                                                        vector<InducedDipolePreconditionerPair>& pairs)
+{
+    vector<RealOpenMM> rrI(2);
+    for (unsigned int ii = 0; ii < _numParticles; ii++) {
+        if (particleData[ii].polarity == 0.0)
+            continue;
+        for (unsigned int kk = 0; kk < _polarizationGroupPartners[ii].size(); kk++) {
+            unsigned int jj = _polarizationGroupPartners[ii][kk];
+            if (particleData[jj].polarity == 0.0)
+                continue;
+            RealVec deltaR = particleData[jj].position - particleData[ii].position;
+            getPeriodicDelta(deltaR);
+            getAndScaleInverseRs(particleData[ii].dampingFactor, particleData[jj].dampingFactor,
+                                 particleData[ii].thole, particleData[jj].thole, SQRT(deltaR.dot(deltaR)), rrI);
+            InducedDipolePreconditionerPair pair;
+            pair.particleI = ii;
+            pair.particleJ = jj;
+            pair.rr3       = -rrI[0];
+            pair.rr5       = rrI[1];
+            pair.deltaR    = deltaR;
+            pairs.push_back(pair);
+        }
+    }
+}
+
+void AmoebaReferenceMultipoleForce::applyInducedDipolePreconditioner(const vector<MultipoleParticleData>& particleData,
+                                                                     const vector<InducedDipolePreconditionerPair>& pairs,
+                                                                     const vector<RealVec>& residual,
+                                                                     vector<RealVec>& output) const
+{
+    // output = residual + alpha*T_local*residual
+
+    output = residual;
+    for (unsigned int ii = 0; ii < pairs.size(); ii++) {
+        const InducedDipolePreconditionerPair& pair = pairs[ii];
+        unsigned int i = pair.particleI;
+        unsigned int j = pair.particleJ;
+        output[i] += (residual[j]*pair.rr3 + pair.deltaR*(pair.rr5*residual[j].dot(pair.deltaR)))*particleData[i].polarity;
+        output[j] += (residual[i]*pair.rr3 + pair.deltaR*(pair.rr5*residual[i].dot(pair.deltaR)))*particleData[j].polarity;
+    }
+}
+
+void AmoebaReferenceMultipoleForce::convergeInduceDipolesByPCG(const vector<MultipoleParticleData>& particleData,
+                                                               vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleField)
+{
+    // Solve (1/alpha - T) mu = E for each set of dipoles by preconditioned conjugate gradients.  The
+    // preconditioner keeps the first two terms of (1/alpha - T)^-1 = alpha + alpha*T*alpha + ..., with T
+    // restricted to the damped interactions within each polarization group.
+    // The residuals are stored multiplied by alpha: y = alpha*(E + T*mu) - mu is the same error measure
+    // used by the other solvers.  Sites with zero polarity keep zero dipoles.
+
+    int numFields = updateInducedDipoleField.size();
+    setMutualInducedDipoleConverged(false);
+    vector<InducedDipolePreconditionerPair> preconditionerPairs;
+    findInducedDipolePreconditionerPairs(particleData, preconditionerPairs);
+
+    // Compute the residuals for the initial dipoles.
+
+    calculateInducedDipoleFields(particleData, updateInducedDipoleField);
+    vector<vector<RealVec> > residual(numFields, vector<RealVec>(_numParticles));
+    vector<vector<RealVec> > preconditioned(numFields);
+    vector<vector<RealVec> > searchDirection(numFields);
+    vector<RealOpenMM> residualDotProduct(numFields, 0.0);
+    RealOpenMM maxEpsilon = 0.0;
+    for (int k = 0; k < numFields; k++) {
+        UpdateInducedDipoleFieldStruct& field = updateInducedDipoleField[k];
+        RealOpenMM epsilon = 0.0;
+        for (unsigned int i = 0; i < _numParticles; i++) {
+            RealOpenMM polarity = particleData[i].polarity;
+            if (polarity != 0.0)
+                residual[k][i] = (*field.fixedMultipoleField)[i] + field.inducedDipoleField[i]*polarity - (*field.inducedDipoles)[i];
+            epsilon += residual[k][i].dot(residual[k][i]);
+        }
+        maxEpsilon = (epsilon > maxEpsilon ? epsilon : maxEpsilon);
+    }
+    maxEpsilon = _debye*SQRT(maxEpsilon/_numParticles);
+
+    // If strong coupling within a polarization group makes the preconditioner indefinite,
+    // fall back to the diagonal preconditioner.
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool positiveDefinite = true;
+        for (int k = 0; k < numFields; k++) {
+            applyInducedDipolePreconditioner(particleData, preconditionerPairs, residual[k], preconditioned[k]);
+            searchDirection[k] = preconditioned[k];
+            residualDotProduct[k] = 0.0;
+            for (unsigned int i = 0; i < _numParticles; i++)
+                if (particleData[i].polarity != 0.0)
+                    residualDotProduct[k] += residual[k][i].dot(preconditioned[k][i])/particleData[i].polarity;
+            if (residualDotProduct[k] < 0.0)
+                positiveDefinite = false;
+        }
+        if (positiveDefinite)
+            break;
+        preconditionerPairs.clear();
+    }
+
+    // The fields of the search directions are computed in a separate set of structs so the
+    // fixed fields and dipoles are left untouched.
+
+    vector<UpdateInducedDipoleFieldStruct> searchField;
+    for (int k = 0; k < numFields; k++)
+        searchField.push_back(UpdateInducedDipoleFieldStruct(*updateInducedDipoleField[k].fixedMultipoleField, searchDirection[k]));
+
+    int iteration = 0;
+    while (maxEpsilon >= getMutualInducedDipoleTargetEpsilon() && iteration < getMaximumMutualInducedDipoleIterations()) {
+        calculateInducedDipoleFields(particleData, searchField);
+        iteration++;
+        maxEpsilon = 0.0;
+        for (int k = 0; k < numFields; k++) {
+            vector<RealVec>& p = searchDirection[k];
+            const vector<RealVec>& fieldP = searchField[k].inducedDipoleField;
+            vector<RealVec>& inducedDipoles = *updateInducedDipoleField[k].inducedDipoles;
+
+            // alpha*A*p = p - alpha*T*p, so p.A.p can be formed without dividing the fields.
+
+            RealOpenMM pAp = 0.0;
+            for (unsigned int i = 0; i < _numParticles; i++) {
+                RealOpenMM polarity = particleData[i].polarity;
+                if (polarity != 0.0)
+                    pAp += p[i].dot(p[i]/polarity - fieldP[i]);
+            }
+            if (pAp == 0.0)
+                continue;
+            RealOpenMM stepSize = residualDotProduct[k]/pAp;
+            RealOpenMM epsilon = 0.0;
+            for (unsigned int i = 0; i < _numParticles; i++) {
+                RealOpenMM polarity = particleData[i].polarity;
+                if (polarity == 0.0)
+                    continue;
+                inducedDipoles[i] += p[i]*stepSize;
+                residual[k][i] -= (p[i] - fieldP[i]*polarity)*stepSize;
+                epsilon += residual[k][i].dot(residual[k][i]);
+            }
+            applyInducedDipolePreconditioner(particleData, preconditionerPairs, residual[k], preconditioned[k]);
+            RealOpenMM newResidualDotProduct = 0.0;
+            for (unsigned int i = 0; i < _numParticles; i++)
+                if (particleData[i].polarity != 0.0)
+                    newResidualDotProduct += residual[k][i].dot(preconditioned[k][i])/particleData[i].polarity;
+            RealOpenMM beta = newResidualDotProduct/residualDotProduct[k];
+            residualDotProduct[k] = newResidualDotProduct;
+            for (unsigned int i = 0; i < _numParticles; i++)
+                p[i] = preconditioned[k][i] + p[i]*beta;
+            maxEpsilon = (epsilon > maxEpsilon ? epsilon : maxEpsilon);
+        }
+        maxEpsilon = _debye*SQRT(maxEpsilon/_numParticles);
+    }
+    if (maxEpsilon < getMutualInducedDipoleTargetEpsilon())
+        setMutualInducedDipoleConverged(true);
+    setMutualInducedDipoleEpsilon(maxEpsilon);
+    setMutualInducedDipoleIterations(iteration);
+    if (iteration > 0)
+        finalizeInducedDipoles(updateInducedDipoleField);
+}
+
+void AmoebaReferenceMultipoleForce::computeExtrapolatedDipoles(const vector<MultipoleParticleData>& particleData,
+                                                               vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleField)
+{
+    // The direct dipoles are order 0.  Each higher order is alpha times the field of the previous one.
+
+    int numOrders = _extPartCoefficients.size();
+    _ptDipoleD.resize(numOrders);
+    _ptDipoleP.resize(numOrders);
+    _ptDipoleFieldGradientD.resize(numOrders-1);
+    _ptDipoleFieldGradientP.resize(numOrders-1);
+    _ptDipoleD[0] = _inducedDipole;
+    _ptDipoleP[0] = _inducedDipolePolar;
+    for (unsigned int ii = 0; ii < updateInducedDipoleField.size(); ii++)
+        updateInducedDipoleField[ii].inducedDipoleFieldGradient.resize(6*_numParticles);
+    for (int order = 1; order < numOrders; order++) {
+        calculateInducedDipoleFields(particleData, updateInducedDipoleField);
+        _ptDipoleFieldGradientD[order-1] = updateInducedDipoleField[0].inducedDipoleFieldGradient;
+        _ptDipoleFieldGradientP[order-1] = updateInducedDipoleField[1].inducedDipoleFieldGradient;
+        for (unsigned int ii = 0; ii < _numParticles; ii++) {
+            _inducedDipole[ii]      = updateInducedDipoleField[0].inducedDipoleField[ii]*particleData[ii].polarity;
+            _inducedDipolePolar[ii] = updateInducedDipoleField[1].inducedDipoleField[ii]*particleData[ii].polarity;
+        }
+        _ptDipoleD[order] = _inducedDipole;
+        _ptDipoleP[order] = _inducedDipolePolar;
+    }
+
+    // Combine the orders to get the final dipoles.
+
+    RealVec zeroVec(0.0, 0.0, 0.0);
+    std::fill(_inducedDipole.begin(), _inducedDipole.end(), zeroVec);
+    std::fill(_inducedDipolePolar.begin(), _inducedDipolePolar.end(), zeroVec);
+    for (int order = 0; order < numOrders; order++) {
+        for (unsigned int ii = 0; ii < _numParticles; ii++) {
+            _inducedDipole[ii]      += _ptDipoleD[order][ii]*_extPartCoefficients[order];
+            _inducedDipolePolar[ii] += _ptDipoleP[order][ii]*_extPartCoefficients[order];
+        }
+    }
+    for (unsigned int ii = 0; ii < updateInducedDipoleField.size(); ii++)
+        updateInducedDipoleField[ii].inducedDipoleFieldGradient.clear();
+    finalizeInducedDipoles(updateInducedDipoleField);
+    setMutualInducedDipoleConverged(true);
+    setMutualInducedDipoleIterations(numOrders-1);
+}
+
+void AmoebaReferenceMultipoleForce::calculateExtrapolatedDipoleForces(vector<RealVec>& forces) const
+{
+    // The energy depends on the positions through the dipoles of each order, giving a force
+    // 0.5*b_(l+m+1)*mu_l.grad(E(mu_m)) for every pair of orders l and m.
+
+    RealOpenMM prefactor = _electric/_dielectric;
+    int numOrders = _extPartCoefficients.size();
+    for (int l = 0; l < numOrders-1; l++) {
+        for (int m = 0; m < numOrders-1-l; m++) {
+            RealOpenMM scale = 0.5*prefactor*_extPartCoefficients[l+m+1];
+            if (scale == 0.0)
+                continue;
+            const vector<RealVec>& dipoleD = _ptDipoleD[l];
+            const vector<RealVec>& dipoleP = _ptDipoleP[l];
+            const vector<RealOpenMM>& gradientD = _ptDipoleFieldGradientD[m];
+            const vector<RealOpenMM>& gradientP = _ptDipoleFieldGradientP[m];
+            for (unsigned int ii = 0; ii < _numParticles; ii++) {
+                const RealOpenMM* gp = &gradientP[6*ii];
+                const RealOpenMM* gd = &gradientD[6*ii];
+                const RealVec& d = dipoleD[ii];
+                const RealVec& p = dipoleP[ii];
+                forces[ii][0] += scale*(d[0]*gp[0] + d[1]*gp[3] + d[2]*gp[4] + p[0]*gd[0] + p[1]*gd[3] + p[2]*gd[4]);
+                forces[ii][1] += scale*(d[0]*gp[3] + d[1]*gp[1] + d[2]*gp[5] + p[0]*gd[3] + p[1]*gd[1] + p[2]*gd[5]);
+                forces[ii][2] += scale*(d[0]*gp[4] + d[1]*gp[5] + d[2]*gp[2] + p[0]*gd[4] + p[1]*gd[5] + p[2]*gd[2]);
+            }
+        }
+    }
+}
+
+void AmoebaReferenceMultipoleForce::finalizeInducedDipoles(vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields)
+{
+}
+
 void AmoebaReferenceMultipoleForce::computeDIISCoefficients(const vector<vector<RealVec> >& prevErrors, vector<RealOpenMM>& coefficients) const {
     int steps = coefficients.size();
     if (steps == 1) {
@@ -895,10 +1218,15 @@ void AmoebaReferenceMultipoleForce::calculateInducedDipoles(const vector<Multipo
         return;
     }
 
+    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Extrapolated) {
+        computeExtrapolatedDipoles(particleData, updateInducedDipoleField);
+        return;
+    }
+
     // UpdateInducedDipoleFieldStruct contains induced dipole, fixed multipole fields and fields
     // due to other induced dipoles at each site
 
-    convergeInduceDipolesByDIIS(particleData, updateInducedDipoleField);
+    convergeInduceDipolesByPCG(particleData, updateInducedDipoleField);
 }
 
 RealOpenMM AmoebaReferenceMultipoleForce::calculateElectrostaticPairIxn(const MultipoleParticleData& particleI,
@@ -1200,9 +1528,10 @@ RealOpenMM AmoebaReferenceMultipoleForce::calculateElectrostaticPairIxn(const Mu
 
     ftm2i -= (fridmp + findmp)*0.5;
 
-    // correction to convert mutual to direct polarization force
+    // correction to convert mutual to direct polarization force; extrapolated polarization adds
+    // its mutual terms separately in calculateExtrapolatedDipoleForces()
 
-    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Direct) {
+    if (getPolarizationType() != AmoebaReferenceMultipoleForce::Mutual) {
        RealOpenMM gfd   = (rr5*scip[1]*scale3i - rr7*(scip[2]*sci[3]+sci[2]*scip[3])*scale5i);
        temp5            = rr5*scale5i;
 
@@ -1503,14 +1832,25 @@ RealOpenMM AmoebaReferenceMultipoleForce::calculateElectrostatic(const vector<Mu
                                                                  vector<RealVec>& forces)
 {
 
+    // main loop over particle pairs
+
+    RealOpenMM energy = calculateElectrostaticPairs(particleData, torques, forces);
+    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Extrapolated)
+        calculateExtrapolatedDipoleForces(forces);
+    return energy;
+}
+
+RealOpenMM AmoebaReferenceMultipoleForce::calculateElectrostaticPairs(const vector<MultipoleParticleData>& particleData,
+                                                                      vector<RealVec>& torques,
+                                                                      vector<RealVec>& forces)
+{
+
     RealOpenMM energy = 0.0;
     vector<RealOpenMM> scaleFactors(LAST_SCALE_TYPE_INDEX);
     for (unsigned int kk = 0; kk < scaleFactors.size(); kk++) {
         scaleFactors[kk] = 1.0;
     }   
 
-    // main loop over particle pairs
-
     for (unsigned int ii = 0; ii < particleData.size(); ii++) {
         for (unsigned int jj = ii+1; jj < particleData.size(); jj++) {
 
@@ -1881,10 +2221,20 @@ void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::zeroFixedMultipoleFields(
 
 void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI,
                                                                                            const MultipoleParticleData& particleJ,
-                                                                                           RealOpenMM dScale, RealOpenMM pScale)
+                                                                                           RealOpenMM dScale, RealOpenMM pScale,
+                                                                                           vector<RealVec>& fixedMultipoleField,
+                                                                                           vector<RealVec>& fixedMultipoleFieldPolar)
 {
 
-    this->AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairIxn(particleI, particleJ, dScale, pScale);
+    this->AmoebaReferenceMultipoleForce::calculateFixedMultipoleFieldPairIxn(particleI, particleJ, dScale, pScale,
+                                                                             fixedMultipoleField, fixedMultipoleFieldPolar);
+    calculateFixedGkFieldPairIxn(particleI, particleJ, _gkField);
+}
+
+void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateFixedGkFieldPairIxn(const MultipoleParticleData& particleI,
+                                                                                    const MultipoleParticleData& particleJ,
+                                                                                    vector<RealVec>& gkField) const
+{
 
     // get deltaR, R2, and R between 2 atoms
  
@@ -2105,9 +2455,9 @@ void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateFixedMultipoleFi
                                    + 2.0*(qxyi*gqxy[4]+qxzi*gqxz[4]
                                    + qyzi*gqyz[4]));
 
-    _gkField[particleI.particleIndex] += fid;
+    gkField[particleI.particleIndex] += fid;
     if (particleI.particleIndex != particleJ.particleIndex) {
-        _gkField[particleJ.particleIndex] += fjd;
+        gkField[particleJ.particleIndex] += fjd;
     }
 }
 
@@ -2241,7 +2591,7 @@ void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateInducedDipoles(c
     updateInducedDipoleField.push_back(UpdateInducedDipoleFieldStruct(_gkField,             _inducedDipoleS));
     updateInducedDipoleField.push_back(UpdateInducedDipoleFieldStruct(gkFieldPolar,         _inducedDipolePolarS));
 
-    convergeInduceDipolesByDIIS(particleData, updateInducedDipoleField);
+    convergeInduceDipolesByPCG(particleData, updateInducedDipoleField);
 }
 
 RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateKirkwoodPairIxn(const MultipoleParticleData& particleI,
@@ -3667,11 +4017,7 @@ RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateElectrosta
 
     // Kirkwood loop over particle pairs
 
-    for (unsigned int ii = 0; ii < particleData.size(); ii++) {
-        for (unsigned int jj = ii; jj < particleData.size(); jj++) {
-            energy += calculateKirkwoodPairIxn(particleData[ii], particleData[jj], forces, torques, dBorn);
-        }
-    }
+    energy += calculateKirkwoodPairs(particleData, forces, torques, dBorn);
 
     // cavity term
 
@@ -3679,7 +4025,38 @@ RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateElectrosta
         energy += calculateCavityTermEnergyAndForces(dBorn);
     }
 
-    // apply Born chain rule; skip diagonal terms since these make no contribution to forces
+    // apply Born chain rule
+
+    calculateGrycukChainRulePairs(particleData, dBorn, forces);
+
+    // correct vacuum to SCRF derivatives (ediff1 in TINKER)
+
+    RealOpenMM eDiffEnergy = calculateKirkwoodEDiffPairs(particleData, forces, torques);
+    energy += (_electric/_dielectric)*eDiffEnergy;
+
+    return energy;
+}
+
+RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateKirkwoodPairs(const vector<MultipoleParticleData>& particleData,
+                                                                                    vector<RealVec>& forces,
+                                                                                    vector<RealVec>& torques,
+                                                                                    vector<RealOpenMM>& dBorn)
+{
+    RealOpenMM energy = 0.0;
+    for (unsigned int ii = 0; ii < particleData.size(); ii++) {
+        for (unsigned int jj = ii; jj < particleData.size(); jj++) {
+            energy += calculateKirkwoodPairIxn(particleData[ii], particleData[jj], forces, torques, dBorn);
+        }
+    }
+    return energy;
+}
+
+void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateGrycukChainRulePairs(const vector<MultipoleParticleData>& particleData,
+                                                                                     const vector<RealOpenMM>& dBorn,
+                                                                                     vector<RealVec>& forces)
+{
+
+    // skip diagonal terms since these make no contribution to forces
 
     for (unsigned int ii = 0; ii < particleData.size(); ii++) {
         for (unsigned int jj = ii+1; jj < particleData.size(); jj++) {
@@ -3687,9 +4064,12 @@ RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateElectrosta
             calculateGrycukChainRulePairIxn(particleData[jj], particleData[ii], dBorn, forces);
         }
     }
+}
 
-    // correct vacuum to SCRF derivatives (ediff1 in TINKER)
-
+RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateKirkwoodEDiffPairs(const vector<MultipoleParticleData>& particleData,
+                                                                                         vector<RealVec>& forces,
+                                                                                         vector<RealVec>& torques)
+{
     vector<RealOpenMM> scaleFactors(LAST_SCALE_TYPE_INDEX);
     for (unsigned int kk = 0; kk < scaleFactors.size(); kk++) {
         scaleFactors[kk] = 1.0;
@@ -3713,9 +4093,7 @@ RealOpenMM AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateElectrosta
             }
         }
     }
-    energy += (_electric/_dielectric)*eDiffEnergy;
-
-    return energy;
+    return eDiffEnergy;
 }
 
 void AmoebaReferenceGeneralizedKirkwoodMultipoleForce::calculateGrycukChainRulePairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
@@ -4738,7 +5116,9 @@ void AmoebaReferencePmeMultipoleForce::initializeBSplineModuli()
 
 void AmoebaReferencePmeMultipoleForce::calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI,
                                                                            const MultipoleParticleData& particleJ,
-                                                                           RealOpenMM dscale, RealOpenMM pscale)
+                                                                           RealOpenMM dscale, RealOpenMM pscale,
+                                                                           vector<RealVec>& fixedMultipoleField,
+                                                                           vector<RealVec>& fixedMultipoleFieldPolar)
 {
 
     // compute the real space portion of the Ewald summation
@@ -4818,11 +5198,11 @@ void AmoebaReferencePmeMultipoleForce::calculateFixedMultipoleFieldPairIxn(const
     unsigned int iIndex    = particleI.particleIndex;
     unsigned int jIndex    = particleJ.particleIndex;
 
-    _fixedMultipoleField[iIndex]      += fim - fid;
-    _fixedMultipoleField[jIndex]      += fjm - fjd;
+    fixedMultipoleField[iIndex]      += fim - fid;
+    fixedMultipoleField[jIndex]      += fjm - fjd;
 
-    _fixedMultipoleFieldPolar[iIndex] += fim - fip;
-    _fixedMultipoleFieldPolar[jIndex] += fjm - fjp;
+    fixedMultipoleFieldPolar[iIndex] += fim - fip;
+    fixedMultipoleFieldPolar[jIndex] += fjm - fjp;
 }
 
 void AmoebaReferencePmeMultipoleForce::calculateFixedMultipoleField(const vector<MultipoleParticleData>& particleData)
@@ -4834,9 +5214,9 @@ void AmoebaReferencePmeMultipoleForce::calculateFixedMultipoleField(const vector
     computeAmoebaBsplines(particleData);
     initializePmeGrid();
     spreadFixedMultipolesOntoGrid(particleData);
-    fftpack_exec_3d(_fftplan, FFTPACK_FORWARD, _pmeGrid, _pmeGrid);
+    transformPmeGrid(FFTPACK_FORWARD);
     performAmoebaReciprocalConvolution();
-    fftpack_exec_3d(_fftplan, FFTPACK_BACKWARD, _pmeGrid, _pmeGrid);
+    transformPmeGrid(FFTPACK_BACKWARD);
     computeFixedPotentialFromGrid();
     recordFixedMultipoleField();
 
@@ -4852,7 +5232,7 @@ void AmoebaReferencePmeMultipoleForce::calculateFixedMultipoleField(const vector
 
     // include direct space fixed multipole fields
 
-    this->AmoebaReferenceMultipoleForce::calculateFixedMultipoleField(particleData);
+    calculateFixedMultipoleFieldPairs(particleData);
 }
 
 #define ARRAY(x,y) array[(x)-1+((y)-1)*AMOEBA_PME_ORDER]
@@ -4935,10 +5315,15 @@ void AmoebaReferencePmeMultipoleForce::computeBSplinePoint(vector<RealOpenMM4>&
  * Compute b-spline coefficients.
  */
 void AmoebaReferencePmeMultipoleForce::computeAmoebaBsplines(const vector<MultipoleParticleData>& particleData) 
+{
+    computeAmoebaBsplinesForParticles(particleData, 0, _numParticles);
+}
+
+void AmoebaReferencePmeMultipoleForce::computeAmoebaBsplinesForParticles(const vector<MultipoleParticleData>& particleData, int start, int end) 
 {
     //  get the B-spline coefficients for each multipole site
 
-    for (unsigned int ii = 0; ii < _numParticles; ii++) {
+    for (int ii = start; ii < end; ii++) {
         RealVec position  = particleData[ii].position;
         getPeriodicDelta(position);
         IntVec igrid;
@@ -5043,15 +5428,19 @@ void AmoebaReferencePmeMultipoleForce::spreadFixedMultipolesOntoGrid(const vecto
 {
 
     transformMultipolesToFractionalCoordinates(particleData);
+    spreadFixedMultipolesForParticles(0, _numParticles, _pmeGrid);
+}
 
+void AmoebaReferencePmeMultipoleForce::spreadFixedMultipolesForParticles(int start, int end, t_complex* grid) 
+{
     // Clear the grid.
     
     for (int gridIndex = 0; gridIndex < _totalGridSize; gridIndex++)
-        _pmeGrid[gridIndex] = t_complex(0, 0);
+        grid[gridIndex] = t_complex(0, 0);
     
     // Loop over atoms and spread them on the grid.
     
-    for (int atomIndex = 0; atomIndex < _numParticles; atomIndex++) {
+    for (int atomIndex = start; atomIndex < end; atomIndex++) {
         RealOpenMM atomCharge       = _transformed[atomIndex].charge;
         RealVec atomDipole          = RealVec(_transformed[atomIndex].dipole[0],
                                               _transformed[atomIndex].dipole[1],
@@ -5076,7 +5465,7 @@ void AmoebaReferencePmeMultipoleForce::spreadFixedMultipolesOntoGrid(const vecto
                     RealOpenMM term0 = atomCharge*u[0]*v[0] + atomDipole[1]*u[1]*v[0] + atomDipole[2]*u[0]*v[1] + atomQuadrupoleYY*u[2]*v[0] + atomQuadrupoleZZ*u[0]*v[2] + atomQuadrupoleYZ*u[1]*v[1];
                     RealOpenMM term1 = atomDipole[0]*u[0]*v[0] + atomQuadrupoleXY*u[1]*v[0] + atomQuadrupoleXZ*u[0]*v[1];
                     RealOpenMM term2 = atomQuadrupoleXX * u[0] * v[0];
-                    t_complex& gridValue = _pmeGrid[x*_pmeGridDimensions[1]*_pmeGridDimensions[2]+y*_pmeGridDimensions[2]+z];
+                    t_complex& gridValue = grid[x*_pmeGridDimensions[1]*_pmeGridDimensions[2]+y*_pmeGridDimensions[2]+z];
                     gridValue.re += term0*t[0] + term1*t[1] + term2*t[2];
                 }
             }
@@ -5084,13 +5473,23 @@ void AmoebaReferencePmeMultipoleForce::spreadFixedMultipolesOntoGrid(const vecto
     }
 }
 
+void AmoebaReferencePmeMultipoleForce::transformPmeGrid(fftpack_direction direction)
+{
+    fftpack_exec_3d(_fftplan, direction, _pmeGrid, _pmeGrid);
+}
+
 void AmoebaReferencePmeMultipoleForce::performAmoebaReciprocalConvolution()
+{
+    performAmoebaReciprocalConvolutionForGridPoints(0, _totalGridSize);
+}
+
+void AmoebaReferencePmeMultipoleForce::performAmoebaReciprocalConvolutionForGridPoints(int start, int end)
 {
 
     RealOpenMM expFactor   = (M_PI*M_PI)/(_alphaEwald*_alphaEwald);
     RealOpenMM scaleFactor = 1.0/(M_PI*_periodicBoxVectors[0][0]*_periodicBoxVectors[1][1]*_periodicBoxVectors[2][2]);
 
-    for (int index = 0; index < _totalGridSize; index++)
+    for (int index = start; index < end; index++)
     {
         int kx = index/(_pmeGridDimensions[1]*_pmeGridDimensions[2]);
         int remainder = index-kx*_pmeGridDimensions[1]*_pmeGridDimensions[2];
@@ -5124,10 +5523,15 @@ void AmoebaReferencePmeMultipoleForce::performAmoebaReciprocalConvolution()
 }
 
 void AmoebaReferencePmeMultipoleForce::computeFixedPotentialFromGrid()
+{
+    computeFixedPotentialForParticles(0, _numParticles);
+}
+
+void AmoebaReferencePmeMultipoleForce::computeFixedPotentialForParticles(int start, int end)
 {
     // extract the permanent multipole field at each site
 
-    for (int m = 0; m < _numParticles; m++) {
+    for (int m = start; m < end; m++) {
         IntVec gridPoint = _iGrid[m];
         RealOpenMM tuv000 = 0.0;
         RealOpenMM tuv001 = 0.0;
@@ -5233,6 +5637,12 @@ void AmoebaReferencePmeMultipoleForce::computeFixedPotentialFromGrid()
 
 void AmoebaReferencePmeMultipoleForce::spreadInducedDipolesOnGrid(const vector<RealVec>& inputInducedDipole,
                                                                   const vector<RealVec>& inputInducedDipolePolar) {
+    spreadInducedDipolesForParticles(inputInducedDipole, inputInducedDipolePolar, 0, _numParticles, _pmeGrid);
+}
+
+void AmoebaReferencePmeMultipoleForce::spreadInducedDipolesForParticles(const vector<RealVec>& inputInducedDipole,
+                                                                        const vector<RealVec>& inputInducedDipolePolar,
+                                                                        int start, int end, t_complex* grid) {
     // Create the matrix to convert from Cartesian to fractional coordinates.
     
     RealVec cartToFrac[3];
@@ -5243,11 +5653,11 @@ void AmoebaReferencePmeMultipoleForce::spreadInducedDipolesOnGrid(const vector<R
     // Clear the grid.
     
     for (int gridIndex = 0; gridIndex < _totalGridSize; gridIndex++)
-        _pmeGrid[gridIndex] = t_complex(0, 0);
+        grid[gridIndex] = t_complex(0, 0);
     
     // Loop over atoms and spread them on the grid.
     
-    for (int atomIndex = 0; atomIndex < _numParticles; atomIndex++) {
+    for (int atomIndex = start; atomIndex < end; atomIndex++) {
         RealVec inducedDipole = RealVec(inputInducedDipole[atomIndex][0]*cartToFrac[0][0] + inputInducedDipole[atomIndex][1]*cartToFrac[0][1] + inputInducedDipole[atomIndex][2]*cartToFrac[0][2],
                                         inputInducedDipole[atomIndex][0]*cartToFrac[1][0] + inputInducedDipole[atomIndex][1]*cartToFrac[1][1] + inputInducedDipole[atomIndex][2]*cartToFrac[1][2],
                                         inputInducedDipole[atomIndex][0]*cartToFrac[2][0] + inputInducedDipole[atomIndex][1]*cartToFrac[2][1] + inputInducedDipole[atomIndex][2]*cartToFrac[2][2]);
@@ -5271,7 +5681,7 @@ void AmoebaReferencePmeMultipoleForce::spreadInducedDipolesOnGrid(const vector<R
                     RealOpenMM term02 = inducedDipolePolar[1]*u[1]*v[0] + inducedDipolePolar[2]*u[0]*v[1];
                     RealOpenMM term12 = inducedDipolePolar[0]*u[0]*v[0];
 
-                    t_complex& gridValue = _pmeGrid[x*_pmeGridDimensions[1]*_pmeGridDimensions[2]+y*_pmeGridDimensions[2]+z];
+                    t_complex& gridValue = grid[x*_pmeGridDimensions[1]*_pmeGridDimensions[2]+y*_pmeGridDimensions[2]+z];
                     gridValue.re += term01*t[0] + term11*t[1];
                     gridValue.im += term02*t[0] + term12*t[1];
                 }
@@ -5281,10 +5691,15 @@ void AmoebaReferencePmeMultipoleForce::spreadInducedDipolesOnGrid(const vector<R
 }
 
 void AmoebaReferencePmeMultipoleForce::computeInducedPotentialFromGrid()
+{
+    computeInducedPotentialForParticles(0, _numParticles);
+}
+
+void AmoebaReferencePmeMultipoleForce::computeInducedPotentialForParticles(int start, int end)
 {
     // extract the induced dipole field at each site
 
-    for (int m = 0; m < _numParticles; m++) {
+    for (int m = start; m < end; m++) {
         IntVec gridPoint = _iGrid[m];
         RealOpenMM tuv100_1 = 0.0;
         RealOpenMM tuv010_1 = 0.0;
@@ -5690,6 +6105,17 @@ void AmoebaReferencePmeMultipoleForce::initializeInducedDipoles(vector<UpdateInd
 {
 
     this->AmoebaReferenceMultipoleForce::initializeInducedDipoles(updateInducedDipoleFields);
+
+    // for mutual polarization the solver computes the reciprocal space field itself
+
+    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Direct)
+        calculateReciprocalSpaceInducedDipoleField(updateInducedDipoleFields);
+}
+
+void AmoebaReferencePmeMultipoleForce::finalizeInducedDipoles(vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields)
+{
+    // the reciprocal space induced dipole forces use the potential of the final dipoles
+
     calculateReciprocalSpaceInducedDipoleField(updateInducedDipoleFields);
 }
 
@@ -5717,11 +6143,41 @@ void AmoebaReferencePmeMultipoleForce::calculateReciprocalSpaceInducedDipoleFiel
 
     initializePmeGrid();
     spreadInducedDipolesOnGrid(*updateInducedDipoleFields[0].inducedDipoles, *updateInducedDipoleFields[1].inducedDipoles);
-    fftpack_exec_3d(_fftplan, FFTPACK_FORWARD, _pmeGrid, _pmeGrid);
+    transformPmeGrid(FFTPACK_FORWARD);
     performAmoebaReciprocalConvolution();
-    fftpack_exec_3d(_fftplan, FFTPACK_BACKWARD, _pmeGrid, _pmeGrid);
+    transformPmeGrid(FFTPACK_BACKWARD);
     computeInducedPotentialFromGrid();
     recordInducedDipoleField(updateInducedDipoleFields[0].inducedDipoleField, updateInducedDipoleFields[1].inducedDipoleField);
+    if (updateInducedDipoleFields[0].inducedDipoleFieldGradient.size() > 0)
+        recordInducedDipoleFieldGradient(updateInducedDipoleFields[0].inducedDipoleFieldGradient, updateInducedDipoleFields[1].inducedDipoleFieldGradient);
+}
+
+void AmoebaReferencePmeMultipoleForce::recordInducedDipoleFieldGradient(vector<RealOpenMM>& fieldGradient, vector<RealOpenMM>& fieldGradientPolar)
+{
+    // The field gradient is minus the second derivative of the potential, which _phid and _phip
+    // hold in fractional coordinates.
+
+    RealVec fracToCart[3];
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            fracToCart[i][j] = _pmeGridDimensions[j]*_recipBoxVectors[i][j];
+    const int component[3][3] = {{4, 7, 8}, {7, 5, 9}, {8, 9, 6}};
+    const int gradientIndex[6][2] = {{0, 0}, {1, 1}, {2, 2}, {0, 1}, {0, 2}, {1, 2}};
+    for (int i = 0; i < _numParticles; i++) {
+        for (int m = 0; m < 6; m++) {
+            int a = gradientIndex[m][0];
+            int b = gradientIndex[m][1];
+            RealOpenMM gradient = 0.0, gradientPolar = 0.0;
+            for (int k = 0; k < 3; k++)
+                for (int l = 0; l < 3; l++) {
+                    RealOpenMM scale = fracToCart[a][k]*fracToCart[b][l];
+                    gradient        += scale*_phid[10*i+component[k][l]];
+                    gradientPolar   += scale*_phip[10*i+component[k][l]];
+                }
+            fieldGradient[6*i+m]      -= gradient;
+            fieldGradientPolar[6*i+m] -= gradientPolar;
+        }
+    }
 }
 
 void AmoebaReferencePmeMultipoleForce::calculateInducedDipoleFields(const vector<MultipoleParticleData>& particleData,
@@ -5730,16 +6186,14 @@ void AmoebaReferencePmeMultipoleForce::calculateInducedDipoleFields(const vector
     // Initialize the fields to zero.
     
     RealVec zeroVec(0.0, 0.0, 0.0);
-    for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++)
+    for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++) {
         std::fill(updateInducedDipoleFields[ii].inducedDipoleField.begin(), updateInducedDipoleFields[ii].inducedDipoleField.end(), zeroVec);
+        std::fill(updateInducedDipoleFields[ii].inducedDipoleFieldGradient.begin(), updateInducedDipoleFields[ii].inducedDipoleFieldGradient.end(), 0.0);
+    }
 
     // Add fields from direct space interactions.
     
-    for (unsigned int ii = 0; ii < particleData.size(); ii++) {
-        for (unsigned int jj = ii + 1; jj < particleData.size(); jj++) {
-            calculateDirectInducedDipolePairIxns(particleData[ii], particleData[jj], updateInducedDipoleFields);
-        }
-    }
+    calculateInducedDipoleFieldPairs(particleData, updateInducedDipoleFields);
 
     // reciprocal space ixns
 
@@ -5843,6 +6297,34 @@ void AmoebaReferencePmeMultipoleForce::calculateDirectInducedDipolePairIxns(cons
                                             *updateInducedDipoleFields[ii].inducedDipoles,
                                             updateInducedDipoleFields[ii].inducedDipoleField);
     }    
+
+    // field gradients, needed for extrapolated polarization
+
+    if (updateInducedDipoleFields[0].inducedDipoleFieldGradient.size() > 0) {
+        alsq2n                *= alsq2;
+        RealOpenMM bn3         = (5.0*bn2+alsq2n*exp2a)/r2;
+        RealOpenMM scale7      = 1.0;
+        if (damp != 0.0 && damp > -50.0)
+            scale7             = 1.0 - expf(damp)*(1.0-damp+0.6*damp*damp);
+        RealOpenMM rr7         = 15.0*(1.0-uscale*scale7)/(r5*r2);
+        RealOpenMM preFactor3  = bn3 - rr7;
+        for (unsigned int ii = 0; ii < updateInducedDipoleFields.size(); ii++) {
+            calculateInducedDipolePairGradientIxn(particleI.particleIndex, particleJ.particleIndex, preFactor2, preFactor3, deltaR,
+                                                  *updateInducedDipoleFields[ii].inducedDipoles,
+                                                  updateInducedDipoleFields[ii].inducedDipoleFieldGradient);
+        }
+    }
+}
+
+void AmoebaReferencePmeMultipoleForce::calculateInducedDipolePairIxns(const MultipoleParticleData& particleI,
+                                                                      const MultipoleParticleData& particleJ,
+                                                                      vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields)
+{
+
+    if (particleI.particleIndex == particleJ.particleIndex)
+        return;
+
+    calculateDirectInducedDipolePairIxns(particleI, particleJ, updateInducedDipoleFields);
 }
 
 RealOpenMM AmoebaReferencePmeMultipoleForce::calculatePmeSelfEnergy(const vector<MultipoleParticleData>& particleData) const 
@@ -6418,9 +6900,10 @@ RealOpenMM AmoebaReferencePmeMultipoleForce::calculatePmeDirectElectrostaticPair
     ftm2i2       -= (fridmp2 + findmp2);
     ftm2i3       -= (fridmp3 + findmp3);
 
-    // correction to convert mutual to direct polarization force
+    // correction to convert mutual to direct polarization force; extrapolated polarization adds
+    // its mutual terms separately in calculateExtrapolatedDipoleForces()
 
-    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Direct) {
+    if (getPolarizationType() != AmoebaReferenceMultipoleForce::Mutual) {
 
        RealOpenMM gfd     = 0.5 * (bn2*scip2 - bn3*(scip3*sci4+sci3*scip4));
        ftm2i1       -= gfd*xr + 0.5*bn2*(sci4*_inducedDipolePolar[iIndex][0]+scip4*_inducedDipole[iIndex][0]+sci3*_inducedDipolePolar[jIndex][0]+scip3*_inducedDipole[jIndex][0]);
@@ -6583,39 +7066,29 @@ RealOpenMM AmoebaReferencePmeMultipoleForce::calculatePmeDirectElectrostaticPair
 
 }
 
+RealOpenMM AmoebaReferencePmeMultipoleForce::calculateElectrostaticPairIxn(const MultipoleParticleData& particleI,
+                                                                           const MultipoleParticleData& particleJ,
+                                                                           const vector<RealOpenMM>& scalingFactors,
+                                                                           vector<RealVec>& forces,
+                                                                           vector<RealVec>& torques) const
+{
+    return calculatePmeDirectElectrostaticPairIxn(particleI, particleJ, scalingFactors, forces, torques);
+}
+
 RealOpenMM AmoebaReferencePmeMultipoleForce::calculateElectrostatic(const vector<MultipoleParticleData>& particleData,
                                                                     vector<RealVec>& torques, vector<RealVec>& forces)
 {
 
-    RealOpenMM energy = 0.0;
-    vector<RealOpenMM> scaleFactors(LAST_SCALE_TYPE_INDEX);
-    for (unsigned int kk = 0; kk < scaleFactors.size(); kk++) {
-        scaleFactors[kk] = 1.0;
-    }   
-
     // loop over particle pairs for direct space interactions
 
-    for (unsigned int ii = 0; ii < particleData.size(); ii++) {
-        for (unsigned int jj = ii+1; jj < particleData.size(); jj++) {
-
-            if (jj <= _maxScaleIndex[ii]) {
-                getMultipoleScaleFactors(ii, jj, scaleFactors);
-            }
-
-            energy += calculatePmeDirectElectrostaticPairIxn(particleData[ii], particleData[jj], scaleFactors, forces, torques);
-
-            if (jj <= _maxScaleIndex[ii]) {
-                for (unsigned int kk = 0; kk < LAST_SCALE_TYPE_INDEX; kk++) {
-                    scaleFactors[kk] = 1.0;
-                }
-            }
-        }
-    }
+    RealOpenMM energy = calculateElectrostaticPairs(particleData, torques, forces);
 
     calculatePmeSelfTorque(particleData, torques);
     energy += computeReciprocalSpaceInducedDipoleForceAndEnergy(getPolarizationType(), particleData, forces, torques);
     energy += computeReciprocalSpaceFixedMultipoleForceAndEnergy(particleData, forces, torques);
     energy += calculatePmeSelfEnergy(particleData);
+    if (getPolarizationType() == AmoebaReferenceMultipoleForce::Extrapolated)
+        calculateExtrapolatedDipoleForces(forces);
 
     return energy;
 }
@@ -238,22 +238,22 @@ class AmoebaReferenceMultipoleForce {
     *                                                      GK case includes the following calls:
     *
     *                                                          AmoebaReferenceMultipoleForce::calculateElectrostatic()
-    *                                                               loop over particle pairs: calculateElectrostaticPairIxn()
+    *                                                               loop over particle pairs [calculateElectrostaticPairs()]: calculateElectrostaticPairIxn()
     *
-    *                                                          TINKER's egk1a: calculateKirkwoodPairIxn()
+    *                                                          TINKER's egk1a: loop over particle pairs [calculateKirkwoodPairs()]: calculateKirkwoodPairIxn()
     *
     *                                                          SASA force and energy: calculateCavityTermEnergyAndForces()
     *
-    *                                                          TINKER's born1 (Born chain rule term): loop over particle pairs: calculateGrycukChainRulePairIxn()
+    *                                                          TINKER's born1 (Born chain rule term): loop over particle pairs [calculateGrycukChainRulePairs()]: calculateGrycukChainRulePairIxn()
     *
-    *                                                          TINKER's ediff1: loop over particle pairs: calculateKirkwoodEDiffPairIxn()
+    *                                                          TINKER's ediff1: loop over particle pairs [calculateKirkwoodEDiffPairs()]: calculateKirkwoodEDiffPairIxn()
     *                                                       
     *                                                      PME case includes the following calls:
     *
     *                                                          reciprocal [computeReciprocalSpaceInducedDipoleForceAndEnergy(),
     *                                                                      computeReciprocalSpaceFixedMultipoleForceAndEnergy]
     *
-    *                                                          direct space calculations [calculatePmeDirectElectrostaticPairIxn()]
+    *                                                          direct space calculations [calculateElectrostaticPairs(): calculatePmeDirectElectrostaticPairIxn()]
     *
     *                                                          self-energy [calculatePmeSelfEnergy()]
     *
@@ -285,15 +285,16 @@ class AmoebaReferenceMultipoleForce {
     *                                                       gkField also calculated for GK
     *                                                       for PME, reciprocal, direct space (particle pair loop) and self terms calculated
     *                                                       
+    *       virtual calculateFixedMultipoleFieldPairs()     loop over particle pairs; overridden by platforms that parallelize the loop
     * 
     *         virtual calculateFixedMultipoleFieldPairIxn() pair ixn for fixed multipole
-    *                                                       gkField also calculated for GK
+    *                                                       gkField also calculated for GK [calculateFixedGkFieldPairIxn()]
     *                                                       for PME, direct space ixn calculated here
     * 
     *     virtual initializeInducedDipoles()                initialize induced dipoles; for PME, calculateReciprocalSpaceInducedDipoleField()
     *                                                       called in case polarization type == Direct
     *
-    *     convergeInduceDipoles()                           loop until induced dipoles converge
+    *     convergeInduceDipolesByPCG()                      loop until induced dipoles converge (preconditioned conjugate gradients)
     *
     *         updateInducedDipoleFields()                   update fields at each site due other induced dipoles
     *
@@ -301,7 +302,10 @@ class AmoebaReferenceMultipoleForce {
     *                                                       for PME includes reciprocal space calculation calculateReciprocalSpaceInducedDipoleField(), 
     *                                                       direct space calculateDirectInducedDipolePairIxns() and self terms
     *
+    *             virtual calculateInducedDipoleFieldPairs() loop over particle pairs; overridden by platforms that parallelize the loop
+    *
     *              virtual calculateInducedDipolePairIxns() field at particle i due particle j's induced dipole and vice versa; for GK includes GK field
+    *                                                       for PME, calculateDirectInducedDipolePairIxns()
     */
 
 public:
@@ -334,7 +338,12 @@ public:
         /** 
          * Direct polarization
          */
-        Direct = 1 
+        Direct = 1,
+
+        /** 
+         * Extrapolated perturbation theory approximation to mutual polarization
+         */
+        Extrapolated = 2
     };  
 
     /**
@@ -440,6 +449,32 @@ public:
      */
     int getMaximumMutualInducedDipoleIterations() const;
 
+    /**
+     * Set the coefficients used for extrapolated polarization.  Element k is the weight of the
+     * k'th order perturbation theory approximation to the mutual induced dipoles.
+     *
+     * @param coefficients      the extrapolation coefficients
+     */
+    void setExtrapolationCoefficients(const std::vector<RealOpenMM>& coefficients);
+
+    /**
+     * Set the induced dipoles used as the starting point when converging mutual induced dipoles,
+     * typically the converged dipoles from the previous time step.  If the vectors are empty or
+     * their size does not match the number of particles, the direct induced dipoles are used instead.
+     *
+     * @param inducedDipoles        initial induced dipoles
+     * @param inducedDipolesPolar   initial polar induced dipoles
+     */
+    void setInitialInducedDipoles(const std::vector<RealVec>& inducedDipoles, const std::vector<RealVec>& inducedDipolesPolar);
+
+    /**
+     * Get the induced dipoles computed by the most recent calculation.
+     *
+     * @param inducedDipoles        output induced dipoles
+     * @param inducedDipolesPolar   output polar induced dipoles
+     */
+    void getInducedDipoles(std::vector<RealVec>& inducedDipoles, std::vector<RealVec>& inducedDipolesPolar) const;
+
     /**
      * Calculate force and energy.
      *
@@ -612,6 +647,20 @@ protected:
             std::vector<OpenMM::RealVec>* fixedMultipoleField;
             std::vector<OpenMM::RealVec>* inducedDipoles;
             std::vector<OpenMM::RealVec> inducedDipoleField;
+            // gradient of inducedDipoleField (xx, yy, zz, xy, xz, yz for each particle); only computed if nonempty
+            std::vector<RealOpenMM> inducedDipoleFieldGradient;
+    };
+
+    /* 
+     * A pair of polarizable sites in the same polarization group, whose damped interaction is included
+     * in the preconditioner used when converging induced dipoles
+     */
+    struct InducedDipolePreconditionerPair {
+            unsigned int particleI;
+            unsigned int particleJ;
+            RealOpenMM rr3;
+            RealOpenMM rr5;
+            RealVec deltaR;
     };
 
     unsigned int _numParticles;
@@ -625,6 +674,7 @@ protected:
     enum ScaleType { D_SCALE, P_SCALE, M_SCALE, U_SCALE, LAST_SCALE_TYPE_INDEX };
     std::vector<  std::vector< MapIntRealOpenMM > > _scaleMaps;
     std::vector<unsigned int> _maxScaleIndex;
+    std::vector< std::vector<unsigned int> > _polarizationGroupPartners;
     RealOpenMM _dScale[5];
     RealOpenMM _pScale[5];
     RealOpenMM _mScale[5];
@@ -635,6 +685,17 @@ protected:
     std::vector<RealVec> _fixedMultipoleFieldPolar;
     std::vector<RealVec> _inducedDipole;
     std::vector<RealVec> _inducedDipolePolar;
+    std::vector<RealVec> _initialInducedDipole;
+    std::vector<RealVec> _initialInducedDipolePolar;
+
+    // extrapolated polarization: partial sums of the extrapolation coefficients, the dipoles of each
+    // perturbation theory order, and the gradients of the fields they produce
+
+    std::vector<RealOpenMM> _extPartCoefficients;
+    std::vector< std::vector<RealVec> > _ptDipoleD;
+    std::vector< std::vector<RealVec> > _ptDipoleP;
+    std::vector< std::vector<RealOpenMM> > _ptDipoleFieldGradientD;
+    std::vector< std::vector<RealOpenMM> > _ptDipoleFieldGradientP;
 
     int _mutualInducedDipoleConverged;
     int _mutualInducedDipoleIterations;
@@ -823,9 +884,20 @@ protected:
      * @param particleJ               positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
      * @param dScale                  d-scale value for i-j interaction
      * @param pScale                  p-scale value for i-j interaction
+     * @param field                   fixed multipole field to be updated
+     * @param fieldPolar              fixed multipole polar field to be updated
      */
     virtual void calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
-                                                     RealOpenMM dScale, RealOpenMM pScale);
+                                                     RealOpenMM dScale, RealOpenMM pScale,
+                                                     std::vector<RealVec>& field, std::vector<RealVec>& fieldPolar);
+
+    /**
+     * Loop over particle pairs, adding the contribution of each pair to _fixedMultipoleField and
+     * _fixedMultipoleFieldPolar.
+     * 
+     * @param particleData            vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     */
+    virtual void calculateFixedMultipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData);
 
     /**
      * Initialize induced dipoles
@@ -851,6 +923,22 @@ protected:
                                        const std::vector<RealVec>& inducedDipole,
                                        std::vector<RealVec>& field) const;
 
+    /**
+     * Calculate the gradient of the field at particle I due induced dipole at particle J and vice versa.
+     * 
+     * @param particleI               index of particle I
+     * @param particleJ               index of particle J
+     * @param rr5                     damped 3/r^5 factor
+     * @param rr7                     damped 15/r^7 factor
+     * @param delta                   delta of particle positions: particleJ.x - particleI.x, ...
+     * @param inducedDipole           vector of induced dipoles
+     * @param fieldGradient           field gradients (xx, yy, zz, xy, xz, yz for each particle)
+     */
+    void calculateInducedDipolePairGradientIxn(unsigned int particleI, unsigned int particleJ,
+                                               RealOpenMM rr5, RealOpenMM rr7, const RealVec& delta,
+                                               const std::vector<RealVec>& inducedDipole,
+                                               std::vector<RealOpenMM>& fieldGradient) const;
+
     /**
      * Calculate fields due induced dipoles at each site.
      * 
@@ -869,6 +957,15 @@ protected:
      */
     virtual void calculateInducedDipoleFields(const std::vector<MultipoleParticleData>& particleData,
                                               std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
+
+    /**
+     * Loop over particle pairs, adding the field at each site due to the induced dipoles at the other sites.
+     * 
+     * @param particleData              vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing input induced dipoles and output fields
+     */
+    virtual void calculateInducedDipoleFieldPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                  std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
     /**
      * Converge induced dipoles.
      * 
@@ -885,6 +982,68 @@ protected:
      */
     void convergeInduceDipolesByDIIS(const std::vector<MultipoleParticleData>& particleData,
                                      std::vector<UpdateInducedDipoleFieldStruct>& calculateInducedDipoleField);
+
+    /**
+     * Compute induced dipoles for extrapolated polarization.  The dipoles of order k+1 are alpha times the field
+     * of the order k dipoles, starting from the direct dipoles, and the final dipoles are a linear combination
+     * of the orders.  The field gradients needed for the forces are recorded along the way.
+     * 
+     * @param particleData              vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing input induced dipoles and output fields
+     */
+    void computeExtrapolatedDipoles(const std::vector<MultipoleParticleData>& particleData,
+                                    std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
+
+    /**
+     * Add the forces for extrapolated polarization that are not included in the pair interactions: the
+     * derivatives of the interactions between the dipoles of different perturbation theory orders.
+     * 
+     * @param forces                    add forces to this vector
+     */
+    void calculateExtrapolatedDipoleForces(std::vector<OpenMM::RealVec>& forces) const;
+
+    /**
+     * Converge induced dipoles with a preconditioned conjugate gradient solver.  The induced
+     * dipoles satisfy (1/alpha - T) mu = E, where T is the dipole field tensor and E the fixed
+     * multipole field.  The preconditioner combines the site polarizabilities with the interactions
+     * inside each polarization group.  Every iteration costs one evaluation of the induced dipole field.
+     * 
+     * @param particleData              vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing input induced dipoles and output fields
+     */
+    void convergeInduceDipolesByPCG(const std::vector<MultipoleParticleData>& particleData,
+                                    std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
+
+    /**
+     * Find the pairs of polarizable sites in the same polarization group, whose interactions are
+     * included in the induced dipole preconditioner.
+     * 
+     * @param particleData  vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param pairs         the pairs are appended to this
+     */
+    void findInducedDipolePreconditionerPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                      std::vector<InducedDipolePreconditionerPair>& pairs);
+
+    /**
+     * Apply the induced dipole preconditioner to a residual that has already been multiplied by the polarities.
+     * 
+     * @param particleData  vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param pairs         the pairs included in the preconditioner
+     * @param residual      the residual to precondition
+     * @param output        the preconditioned residual
+     */
+    void applyInducedDipolePreconditioner(const std::vector<MultipoleParticleData>& particleData,
+                                          const std::vector<InducedDipolePreconditionerPair>& pairs,
+                                          const std::vector<RealVec>& residual, std::vector<RealVec>& output) const;
+
+    /**
+     * Called once the induced dipoles have been converged by a solver whose last field evaluation was
+     * not for the final dipoles.  Subclasses that cache quantities derived from the induced dipoles
+     * should recompute them here.
+     * 
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing the converged induced dipoles
+     */
+    virtual void finalizeInducedDipoles(std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
     
     /**
      * Use DIIS to compute the weighting coefficients for the new induced dipoles.
@@ -968,8 +1127,21 @@ protected:
      * @param forces            vector of particle forces to be updated
      * @param torque            vector of particle torques to be updated
      */
-    RealOpenMM calculateElectrostaticPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleK,
-                                             const std::vector<RealOpenMM>& scalingFactors, std::vector<OpenMM::RealVec>& forces, std::vector<RealVec>& torque) const;
+    virtual RealOpenMM calculateElectrostaticPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleK,
+                                                     const std::vector<RealOpenMM>& scalingFactors, std::vector<OpenMM::RealVec>& forces, std::vector<RealVec>& torque) const;
+
+    /**
+     * Loop over particle pairs, calculating the electrostatic interaction between each pair.
+     * 
+     * @param particleData      vector of parameters (charge, labFrame dipoles, quadrupoles, ...) for particles
+     * @param torques           vector of particle torques to be updated
+     * @param forces            vector of particle forces to be updated
+     *
+     * @return energy
+     */
+    virtual RealOpenMM calculateElectrostaticPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                   std::vector<OpenMM::RealVec>& torques,
+                                                   std::vector<OpenMM::RealVec>& forces);
 
     /**
      * Map particle torque to force.
@@ -1123,7 +1295,7 @@ public:
      */
     RealOpenMM getDielectricOffset() const;
 
-private:
+protected:
 
     AmoebaReferenceGeneralizedKirkwoodForce* _amoebaReferenceGeneralizedKirkwoodForce;
 
@@ -1160,9 +1332,23 @@ private:
      * @param particleJ               positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
      * @param dScale                  d-scale value for i-j interaction
      * @param pScale                  p-scale value for i-j interaction
+     * @param field                   fixed multipole field to be updated
+     * @param fieldPolar              fixed multipole polar field to be updated
      */
     void calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
-                                             RealOpenMM dScale, RealOpenMM pScale);
+                                             RealOpenMM dScale, RealOpenMM pScale,
+                                             std::vector<RealVec>& field, std::vector<RealVec>& fieldPolar);
+
+    /**
+     * Calculate GK field at particle I due fixed multipoles at particle J and vice versa.  Unlike the
+     * vacuum field, this includes the self term particleI == particleJ.
+     * 
+     * @param particleI               positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle I
+     * @param particleJ               positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
+     * @param gkField                 GK field to be updated
+     */
+    void calculateFixedGkFieldPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
+                                      std::vector<RealVec>& gkField) const;
 
     /**
      * Calculate induced dipoles.
@@ -1222,6 +1408,21 @@ private:
                                         std::vector<RealVec>& torques,
                                         std::vector<RealOpenMM>& dBorn) const;
 
+    /**
+     * Loop over particle pairs (including each particle with itself), calculating the Kirkwood interaction.
+     * 
+     * @param particleData            vector of parameters (charge, labFrame dipoles, quadrupoles, ...) for particles
+     * @param forces                  add Kirkwood force to forces
+     * @param torques                 add Kirkwood torque to torques
+     * @param dBorn                   chain-rule factor
+     *
+     * @return energy
+     */
+    virtual RealOpenMM calculateKirkwoodPairs(const std::vector<MultipoleParticleData>& particleData,
+                                              std::vector<RealVec>& forces, 
+                                              std::vector<RealVec>& torques,
+                                              std::vector<RealOpenMM>& dBorn);
+
     /**
      * Calculate Grycuk 'chain-rule' force.
      * 
@@ -1234,6 +1435,17 @@ private:
     void calculateGrycukChainRulePairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
                                          const std::vector<RealOpenMM>& dBorn, std::vector<RealVec>& forces) const;
 
+    /**
+     * Loop over particle pairs, calculating the Grycuk 'chain-rule' force.
+     * 
+     * @param particleData            vector of parameters (charge, labFrame dipoles, quadrupoles, ...) for particles
+     * @param dBorn                   chain-rule Born force factor
+     * @param forces                  add Kirkwood force to forces
+     *
+     */
+    virtual void calculateGrycukChainRulePairs(const std::vector<MultipoleParticleData>& particleData,
+                                               const std::vector<RealOpenMM>& dBorn, std::vector<RealVec>& forces);
+
     /**
      * Calculate TINKER's ACE approximation to non-polar cavity term. 
      * 
@@ -1260,6 +1472,18 @@ private:
                                              RealOpenMM pscale, RealOpenMM dscale, 
                                              std::vector<RealVec>& forces, std::vector<RealVec>& torques) const;
 
+    /**
+     * Loop over particle pairs, correcting vacuum to SCRF derivatives.
+     * 
+     * @param particleData            vector of parameters (charge, labFrame dipoles, quadrupoles, ...) for particles
+     * @param forces                  force accumulator
+     * @param torques                 torque accumulator
+     *
+     * @return energy, before conversion by the electric constant
+     */
+    virtual RealOpenMM calculateKirkwoodEDiffPairs(const std::vector<MultipoleParticleData>& particleData,
+                                                   std::vector<RealVec>& forces, std::vector<RealVec>& torques);
+
 };
 
 class AmoebaReferencePmeMultipoleForce : public AmoebaReferenceMultipoleForce {
@@ -1334,7 +1558,7 @@ public:
      */
      void setPeriodicBoxSize(OpenMM::RealVec* vectors);
 
-private:
+protected:
 
     static const int AMOEBA_PME_ORDER;
     static const RealOpenMM SQRT_PI;
@@ -1410,9 +1634,12 @@ private:
      * @param particleJ               positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
      * @param dScale                  d-scale value for i-j interaction
      * @param pScale                  p-scale value for i-j interaction
+     * @param field                   fixed multipole field to be updated
+     * @param fieldPolar              fixed multipole polar field to be updated
      */
     void calculateFixedMultipoleFieldPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
-                                             RealOpenMM dscale, RealOpenMM pscale);
+                                             RealOpenMM dscale, RealOpenMM pscale,
+                                             std::vector<RealVec>& field, std::vector<RealVec>& fieldPolar);
     
     /**
      * Calculate fixed multipole fields.
@@ -1435,7 +1662,16 @@ private:
      *
      * @param particleData   vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
      */
-    void computeAmoebaBsplines(const std::vector<MultipoleParticleData>& particleData);
+    virtual void computeAmoebaBsplines(const std::vector<MultipoleParticleData>& particleData);
+
+    /**
+     * Compute bspline coefficients for a range of particles.
+     *
+     * @param particleData   vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
+     * @param start          the index of the first particle to process
+     * @param end            one past the index of the last particle to process
+     */
+    void computeAmoebaBsplinesForParticles(const std::vector<MultipoleParticleData>& particleData, int start, int end);
 
     /**
      * Transform multipoles from cartesian coordinates to fractional coordinates.
@@ -1452,25 +1688,66 @@ private:
      * 
      * @param particleData vector of particle positions and parameters (charge, labFrame dipoles, quadrupoles, ...)
      */
-    void spreadFixedMultipolesOntoGrid(const vector<MultipoleParticleData>& particleData);
+    virtual void spreadFixedMultipolesOntoGrid(const vector<MultipoleParticleData>& particleData);
+
+    /**
+     * Spread the fractional coordinate multipoles of a range of particles onto a grid.  The grid is
+     * cleared first.  transformMultipolesToFractionalCoordinates() must have been called already.
+     *
+     * @param start  the index of the first particle to spread
+     * @param end    one past the index of the last particle to spread
+     * @param grid   the grid to spread the multipoles onto
+     */
+    void spreadFixedMultipolesForParticles(int start, int end, t_complex* grid);
+
+    /**
+     * Perform a 3D FFT of the PME grid in place.
+     *
+     * @param direction  the direction of the transform
+     */
+    virtual void transformPmeGrid(fftpack_direction direction);
 
     /**
      * Perform reciprocal convolution.
      * 
      */
-    void performAmoebaReciprocalConvolution();
+    virtual void performAmoebaReciprocalConvolution();
+
+    /**
+     * Perform reciprocal convolution for a range of grid points.
+     *
+     * @param start  the index of the first grid point to process
+     * @param end    one past the index of the last grid point to process
+     */
+    void performAmoebaReciprocalConvolutionForGridPoints(int start, int end);
 
     /**
      * Compute reciprocal potential due fixed multipoles at each particle site.
      * 
      */
-    void computeFixedPotentialFromGrid(void);
+    virtual void computeFixedPotentialFromGrid(void);
+
+    /**
+     * Compute reciprocal potential due fixed multipoles at a range of particle sites.
+     *
+     * @param start  the index of the first particle to process
+     * @param end    one past the index of the last particle to process
+     */
+    void computeFixedPotentialForParticles(int start, int end);
 
     /**
      * Compute reciprocal potential due fixed multipoles at each particle site.
      * 
      */
-    void computeInducedPotentialFromGrid();
+    virtual void computeInducedPotentialFromGrid();
+
+    /**
+     * Compute reciprocal potential due induced dipoles at a range of particle sites.
+     *
+     * @param start  the index of the first particle to process
+     * @param end    one past the index of the last particle to process
+     */
+    void computeInducedPotentialForParticles(int start, int end);
 
     /**
      * Calculate reciprocal space energy and force due to fixed multipoles.
@@ -1525,6 +1802,17 @@ private:
                                               const MultipoleParticleData& particleJ,
                                               std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
 
+    /**
+     * Calculate direct space fields due induced dipoles at each site; the pair loop in the base class
+     * calls this, which delegates to calculateDirectInducedDipolePairIxns().
+     * 
+     * @param particleI                 positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle I
+     * @param particleJ                 positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing input induced dipoles and output fields
+     */
+    void calculateInducedDipolePairIxns(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
+                                        std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields);
+
     /**
      * Initialize induced dipoles
      *
@@ -1532,14 +1820,34 @@ private:
      */
     void initializeInducedDipoles(std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields); 
 
+    /**
+     * Recompute the reciprocal space potential of the converged induced dipoles.
+     *
+     * @param updateInducedDipoleFields vector of UpdateInducedDipoleFieldStruct containing the converged induced dipoles
+     */
+    void finalizeInducedDipoles(std::vector<UpdateInducedDipoleFieldStruct>& updateInducedDipoleFields); 
+
     /**
      * Spread induced dipoles onto grid.
      *
      * @param inputInducedDipole      induced dipole value
      * @param inputInducedDipolePolar induced dipole polar value
      */
-    void spreadInducedDipolesOnGrid(const std::vector<RealVec>& inputInducedDipole,
-                                    const std::vector<RealVec>& inputInducedDipolePolar);
+    virtual void spreadInducedDipolesOnGrid(const std::vector<RealVec>& inputInducedDipole,
+                                            const std::vector<RealVec>& inputInducedDipolePolar);
+
+    /**
+     * Spread the induced dipoles of a range of particles onto a grid.  The grid is cleared first.
+     *
+     * @param inputInducedDipole      induced dipole value
+     * @param inputInducedDipolePolar induced dipole polar value
+     * @param start                   the index of the first particle to spread
+     * @param end                     one past the index of the last particle to spread
+     * @param grid                    the grid to spread the dipoles onto
+     */
+    void spreadInducedDipolesForParticles(const std::vector<RealVec>& inputInducedDipole,
+                                          const std::vector<RealVec>& inputInducedDipolePolar,
+                                          int start, int end, t_complex* grid);
 
     /**
      * Calculate induced dipole fields.
@@ -1559,6 +1867,14 @@ private:
      */
     void recordInducedDipoleField(vector<RealVec>& field, vector<RealVec>& fieldPolar);
 
+    /**
+     * Add the reciprocal space gradients of the induced dipole fields.
+     *
+     * @param fieldGradient       output gradient of the induced dipole field at each site
+     * @param fieldGradientPolar  output gradient of the induced dipole polar field at each site
+     */
+    void recordInducedDipoleFieldGradient(vector<RealOpenMM>& fieldGradient, vector<RealOpenMM>& fieldGradientPolar);
+
     /**
      * Compute Pme self energy.
      *
@@ -1587,6 +1903,20 @@ private:
                                                       const std::vector<RealOpenMM>& scalingFactors,
                                                       std::vector<RealVec>& forces, std::vector<RealVec>& torques) const;
 
+    /**
+     * Calculate direct space electrostatic interaction between particles I and J; the pair loop in the base class
+     * calls this, which delegates to calculatePmeDirectElectrostaticPairIxn().
+     * 
+     * @param particleI         positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle I
+     * @param particleJ         positions and parameters (charge, labFrame dipoles, quadrupoles, ...) for particle J
+     * @param scalingFactors    scaling factors for interaction
+     * @param forces            vector of particle forces to be updated
+     * @param torques           vector of particle torques to be updated
+     */
+    RealOpenMM calculateElectrostaticPairIxn(const MultipoleParticleData& particleI, const MultipoleParticleData& particleJ,
+                                             const std::vector<RealOpenMM>& scalingFactors,
+                                             std::vector<RealVec>& forces, std::vector<RealVec>& torques) const;
+
     /**
      * Calculate reciprocal space energy/force/torque for dipole interaction.
      * 
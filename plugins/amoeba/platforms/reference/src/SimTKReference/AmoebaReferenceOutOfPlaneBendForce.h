@@ -84,7 +84,7 @@ public:
                                        RealOpenMM angleSextic,
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
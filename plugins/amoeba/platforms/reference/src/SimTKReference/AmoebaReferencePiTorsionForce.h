@@ -83,7 +83,7 @@ public:
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
@@ -82,7 +82,7 @@ public:
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
@@ -82,7 +82,7 @@ public:
                                        const std::vector< std::vector< std::vector< std::vector<RealOpenMM> > > >& torsionTorsionGrids,
                                        std::vector<OpenMM::RealVec>& forceData) const;
 
-private:
+protected:
 
     /**---------------------------------------------------------------------------------------
     
@@ -2578,6 +2578,92 @@ static void testParticleInducedDipoles() {
         ASSERT_EQUAL_VEC(expectedDipole[i], dipole[i], 1e-4);
 }
 
+// test that starting from the previous step's induced dipoles gives the same results as starting from scratch
+
+static void testWarmStartInducedDipoles() {
+    int numberOfParticles     = 8;
+    System system;
+    AmoebaMultipoleForce* amoebaMultipoleForce = new AmoebaMultipoleForce();;
+    setupMultipoleAmmonia(system, amoebaMultipoleForce, AmoebaMultipoleForce::NoCutoff, AmoebaMultipoleForce::Mutual, 9000000.0, 0);
+    amoebaMultipoleForce->setMutualInducedTargetEpsilon(1.0e-06);
+    LangevinIntegrator integrator1(0.0, 0.1, 0.01);
+    Context context1(system, integrator1, Platform::getPlatformByName("Reference"));
+    std::vector<Vec3> forces;
+    double energy;
+    getForcesEnergyMultipoleAmmonia(context1, forces, energy);
+
+    // Displace the particles and recompute in the same context, which starts from the old dipoles.
+
+    std::vector<Vec3> positions = context1.getState(State::Positions).getPositions();
+    for (int i = 0; i < numberOfParticles; i++)
+        positions[i] += Vec3(0.002*((i%3)-1), 0.001*((i%2)-0.5), -0.0015*((i%4)-1.5));
+    context1.setPositions(positions);
+    State state1 = context1.getState(State::Forces | State::Energy);
+    std::vector<Vec3> dipole1;
+    amoebaMultipoleForce->getInducedDipoles(context1, dipole1);
+
+    // Compare to a new context.
+
+    LangevinIntegrator integrator2(0.0, 0.1, 0.01);
+    Context context2(system, integrator2, Platform::getPlatformByName("Reference"));
+    context2.setPositions(positions);
+    State state2 = context2.getState(State::Forces | State::Energy);
+    std::vector<Vec3> dipole2;
+    amoebaMultipoleForce->getInducedDipoles(context2, dipole2);
+    ASSERT_EQUAL_TOL(state2.getPotentialEnergy(), state1.getPotentialEnergy(), 1e-5);
+    for (int i = 0; i < numberOfParticles; i++) {
+        ASSERT_EQUAL_VEC(state2.getForces()[i], state1.getForces()[i], 1e-4);
+        ASSERT_EQUAL_VEC(dipole2[i], dipole1[i], 1e-4);
+    }
+}
+
+// check that extrapolated polarization gives forces consistent with the energy, and
+// is close to mutual polarization
+
+static void testExtrapolatedPolarization(AmoebaMultipoleForce::NonbondedMethod nonbondedMethod) {
+    int numberOfParticles     = 8;
+    System system;
+    AmoebaMultipoleForce* amoebaMultipoleForce = new AmoebaMultipoleForce();;
+    setupMultipoleAmmonia(system, amoebaMultipoleForce, nonbondedMethod, AmoebaMultipoleForce::Extrapolated, 0.25, 24);
+    LangevinIntegrator integrator(0.0, 0.1, 0.01);
+    Context context(system, integrator, Platform::getPlatformByName("Reference"));
+    std::vector<Vec3> forces;
+    double energy;
+    getForcesEnergyMultipoleAmmonia(context, forces, energy);
+
+    // Take a small step in the direction of the force and see whether the energy changes by the expected amount.
+
+    std::vector<Vec3> positions = context.getState(State::Positions).getPositions();
+    double norm = 0.0;
+    for (int i = 0; i < numberOfParticles; i++)
+        norm += forces[i].dot(forces[i]);
+    norm = std::sqrt(norm);
+    const double stepSize = 1e-4;
+    double step = 0.5*stepSize/norm;
+    std::vector<Vec3> positions2(numberOfParticles), positions3(numberOfParticles);
+    for (int i = 0; i < numberOfParticles; i++) {
+        positions2[i] = positions[i]-forces[i]*step;
+        positions3[i] = positions[i]+forces[i]*step;
+    }
+    context.setPositions(positions2);
+    double energy2 = context.getState(State::Energy).getPotentialEnergy();
+    context.setPositions(positions3);
+    double energy3 = context.getState(State::Energy).getPotentialEnergy();
+    ASSERT_EQUAL_TOL(norm, (energy2-energy3)/stepSize, 1e-3);
+
+    // Compare to mutual polarization.
+
+    amoebaMultipoleForce->setPolarizationType(AmoebaMultipoleForce::Mutual);
+    amoebaMultipoleForce->setMutualInducedTargetEpsilon(1.0e-06);
+    context.reinitialize();
+    std::vector<Vec3> mutualForces;
+    double mutualEnergy;
+    getForcesEnergyMultipoleAmmonia(context, mutualForces, mutualEnergy);
+    ASSERT_EQUAL_TOL(mutualEnergy, energy, 1e-2);
+    for (int i = 0; i < numberOfParticles; i++)
+        ASSERT_EQUAL_VEC(mutualForces[i], forces[i], 5e-2);
+}
+
 // test computation of system multipole moments
 
 static void testSystemMultipoleMoments() {
@@ -2875,6 +2961,15 @@ int main(int numberOfArguments, char* argv[]) {
         
         testParticleInducedDipoles();
 
+        // test starting induced dipoles from the previous calculation
+
+        testWarmStartInducedDipoles();
+
+        // test extrapolated polarization
+
+        testExtrapolatedPolarization(AmoebaMultipoleForce::NoCutoff);
+        testExtrapolatedPolarization(AmoebaMultipoleForce::PME);
+
         // test mutual polarization, no cutoff
 
         testMultipoleAmmoniaMutualPolarization();
@@ -68,7 +68,7 @@ void loadCovalentMap(const SerializationNode& map, std::vector< int >& covalentM
 }
 
 void AmoebaMultipoleForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 2);
+    node.setIntProperty("version", 3);
     const AmoebaMultipoleForce& force = *reinterpret_cast<const AmoebaMultipoleForce*>(object);
 
     node.setIntProperty("nonbondedMethod",                  force.getNonbondedMethod());
@@ -88,6 +88,12 @@ void AmoebaMultipoleForceProxy::serialize(const void* object, SerializationNode&
     SerializationNode& gridDimensionsNode  = node.createChildNode("MultipoleParticleGridDimension");
     gridDimensionsNode.setIntProperty("d0", gridDimensions[0]).setIntProperty("d1", gridDimensions[1]).setIntProperty("d2", gridDimensions[2]); 
 
+    SerializationNode& coefficientsNode = node.createChildNode("ExtrapolationCoefficients");
+    std::vector<double> coefficients;
+    force.getExtrapolationCoefficients(coefficients);
+    for (unsigned int ii = 0; ii < coefficients.size(); ii++)
+        coefficientsNode.createChildNode("Coefficient").setDoubleProperty("c", coefficients[ii]);
+
     std::vector<std::string> covalentTypes;
     getCovalentTypes(covalentTypes);
 
@@ -124,14 +130,14 @@ void AmoebaMultipoleForceProxy::serialize(const void* object, SerializationNode&
 }
 
 void* AmoebaMultipoleForceProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") > 2)
+    if (node.getIntProperty("version") > 3)
         throw OpenMMException("Unsupported version number");
     AmoebaMultipoleForce* force = new AmoebaMultipoleForce();
 
     try {
 
         force->setNonbondedMethod(static_cast<AmoebaMultipoleForce::NonbondedMethod>(node.getIntProperty("nonbondedMethod")));
-        if (node.getIntProperty("version") == 2) {
+        if (node.getIntProperty("version") >= 2) {
             force->setPolarizationType(static_cast<AmoebaMultipoleForce::PolarizationType>(node.getIntProperty("polarizationType")));
         }
         //force->setPmeBSplineOrder(node.getIntProperty("pmeBSplineOrder"));
@@ -150,6 +156,14 @@ void* AmoebaMultipoleForceProxy::deserialize(const SerializationNode& node) cons
         gridDimensions.push_back(gridDimensionsNode.getIntProperty("d1"));
         gridDimensions.push_back(gridDimensionsNode.getIntProperty("d2"));
         force->setPmeGridDimensions(gridDimensions);
+
+        if (node.getIntProperty("version") >= 3) {
+            std::vector<double> coefficients;
+            const SerializationNode& coefficientsNode = node.getChildNode("ExtrapolationCoefficients");
+            for (unsigned int ii = 0; ii < coefficientsNode.getChildren().size(); ii++)
+                coefficients.push_back(coefficientsNode.getChildren()[ii].getDoubleProperty("c"));
+            force->setExtrapolationCoefficients(coefficients);
+        }
     
         std::vector<std::string> covalentTypes;
         getCovalentTypes(covalentTypes);
@@ -74,6 +74,12 @@ void testSerialization() {
     force1.setMutualInducedTargetEpsilon(1.0e-05); 
     //force1.setElectricConstant(138.93); 
     force1.setEwaldErrorTolerance(1.0e-05); 
+    force1.setPolarizationType(AmoebaMultipoleForce::Extrapolated);
+    std::vector<double> coefficients;
+    coefficients.push_back(0.1);
+    coefficients.push_back(0.3);
+    coefficients.push_back(0.6);
+    force1.setExtrapolationCoefficients(coefficients);
 
     std::vector<std::string> covalentTypes;
     getCovalentTypes(covalentTypes);
@@ -114,6 +120,13 @@ void testSerialization() {
     ASSERT_EQUAL(force1.getMutualInducedTargetEpsilon(),    force2.getMutualInducedTargetEpsilon());
     //ASSERT_EQUAL(force1.getElectricConstant(),              force2.getElectricConstant());
     ASSERT_EQUAL(force1.getEwaldErrorTolerance(),           force2.getEwaldErrorTolerance());
+    ASSERT_EQUAL(force1.getPolarizationType(),              force2.getPolarizationType());
+    std::vector<double> coefficients1, coefficients2;
+    force1.getExtrapolationCoefficients(coefficients1);
+    force2.getExtrapolationCoefficients(coefficients2);
+    ASSERT_EQUAL(coefficients1.size(), coefficients2.size());
+    for (unsigned int ii = 0; ii < coefficients1.size(); ii++)
+        ASSERT_EQUAL(coefficients1[ii], coefficients2[ii]);
 
 
     std::vector<int> gridDimension1;
@@ -73,6 +73,46 @@ public:
     void setMinimizationErrorTolerance(double tol) {
         tolerance = tol;
     }
+    /**
+     * Get the order of the predictor used to choose the starting positions of Drude particles for the minimization.
+     * The displacement of each Drude particle from its parent particle is extrapolated from the displacements
+     * at the previous order+2 time steps using the always stable predictor-corrector (ASPC) coefficients of Kolafa.
+     * A good starting point reduces the number of force evaluations needed to reach the error tolerance.  A
+     * negative value disables the predictor, so the minimization starts from the positions produced by the
+     * time step.
+     */
+    int getPredictorOrder() const {
+        return predictorOrder;
+    }
+    /**
+     * Set the order of the predictor used to choose the starting positions of Drude particles for the minimization.
+     * The displacement of each Drude particle from its parent particle is extrapolated from the displacements
+     * at the previous order+2 time steps using the always stable predictor-corrector (ASPC) coefficients of Kolafa.
+     * A good starting point reduces the number of force evaluations needed to reach the error tolerance.  A
+     * negative value disables the predictor, so the minimization starts from the positions produced by the
+     * time step.  The default value is 2.
+     */
+    void setPredictorOrder(int order) {
+        predictorOrder = order;
+    }
+    /**
+     * Get a bit flag specifying which force groups to evaluate while minimizing the energy with respect to the
+     * Drude particle positions.  Group i will be included if (groups&(1<<i)) != 0.  Only groups whose energy depends
+     * on the positions of Drude particles need to be included.  Every group is still evaluated once per time step
+     * to compute the forces on the other particles.
+     */
+    int getMinimizationForceGroups() const {
+        return minimizationGroups;
+    }
+    /**
+     * Set a bit flag specifying which force groups to evaluate while minimizing the energy with respect to the
+     * Drude particle positions.  Group i will be included if (groups&(1<<i)) != 0.  Only groups whose energy depends
+     * on the positions of Drude particles need to be included.  Every group is still evaluated once per time step
+     * to compute the forces on the other particles.  The default value includes all groups.
+     */
+    void setMinimizationForceGroups(int groups) {
+        minimizationGroups = groups;
+    }
     /**
      * Advance a simulation through time by taking a series of time steps.
      *
@@ -105,6 +145,7 @@ protected:
     double computeKineticEnergy();
 private:
     double tolerance;
+    int predictorOrder, minimizationGroups;
     Kernel kernel;
 };
 
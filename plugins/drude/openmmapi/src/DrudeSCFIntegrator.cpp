@@ -45,6 +45,8 @@ using std::vector;
 DrudeSCFIntegrator::DrudeSCFIntegrator(double stepSize) {
     setStepSize(stepSize);
     setMinimizationErrorTolerance(0.1);
+    setPredictorOrder(2);
+    setMinimizationForceGroups(0xFFFFFFFF);
     setConstraintTolerance(1e-5);
 }
 
@@ -0,0 +1,429 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuDrudeKernels.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/ContextImpl.h"
+#include "openmm/internal/vectorize.h"
+#include "ReferenceConstraints.h"
+#include "ReferenceVirtualSites.h"
+#include "SimTKOpenMMUtilities.h"
+#include <cmath>
+#include <set>
+
+using namespace OpenMM;
+using namespace std;
+
+static vector<RealVec>& extractPositions(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->positions);
+}
+
+static vector<RealVec>& extractVelocities(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->velocities);
+}
+
+static vector<RealVec>& extractForces(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->forces);
+}
+
+static ReferenceConstraints& extractConstraints(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *(ReferenceConstraints*) data->constraints;
+}
+
+static void addForce(float* forces, int atom, const RealVec& f) {
+    fvec4 result = fvec4(forces+4*atom)+fvec4((float) f[0], (float) f[1], (float) f[2], 0.0f);
+    result.store(forces+4*atom);
+}
+
+class CpuCalcDrudeForceKernel::ComputeForceTask : public ThreadPool::Task {
+public:
+    ComputeForceTask(CpuCalcDrudeForceKernel& owner, const vector<RealVec>& pos) : owner(owner), pos(pos) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numThreads = threads.getNumThreads();
+        int numParticles = owner.particle.size();
+        int numPairs = owner.pair1.size();
+        float* forces = &owner.data.threadForce[threadIndex][0];
+        double& energy = owner.threadEnergy[threadIndex];
+        energy = 0.0;
+        owner.computeSpringForces(threadIndex*numParticles/numThreads, (threadIndex+1)*numParticles/numThreads, pos, forces, energy);
+        owner.computeScreenedPairForces(threadIndex*numPairs/numThreads, (threadIndex+1)*numPairs/numThreads, pos, forces, energy);
+    }
+    CpuCalcDrudeForceKernel& owner;
+    const vector<RealVec>& pos;
+};
+
+void CpuCalcDrudeForceKernel::initialize(const System& system, const DrudeForce& force) {
+    // Initialize particle parameters.
+    
+    int numParticles = force.getNumParticles();
+    particle.resize(numParticles);
+    particle1.resize(numParticles);
+    particle2.resize(numParticles);
+    particle3.resize(numParticles);
+    particle4.resize(numParticles);
+    charge.resize(numParticles);
+    polarizability.resize(numParticles);
+    aniso12.resize(numParticles);
+    aniso34.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        force.getParticleParameters(i, particle[i], particle1[i], particle2[i], particle3[i], particle4[i], charge[i], polarizability[i], aniso12[i], aniso34[i]);
+    
+    // Initialize screened pair parameters.
+    
+    int numPairs = force.getNumScreenedPairs();
+    pair1.resize(numPairs);
+    pair2.resize(numPairs);
+    pairThole.resize(numPairs);
+    for (int i = 0; i < numPairs; i++)
+        force.getScreenedPairParameters(i, pair1[i], pair2[i], pairThole[i]);
+    computeScreeningParameters();
+    threadEnergy.resize(data.threads.getNumThreads());
+}
+
+void CpuCalcDrudeForceKernel::computeScreeningParameters() {
+    int numPairs = pair1.size();
+    pairScale.resize(numPairs);
+    for (int i = 0; i < numPairs; i++)
+        pairScale[i] = pairThole[i]/pow(polarizability[pair1[i]]*polarizability[pair2[i]], 1.0/6.0);
+}
+
+double CpuCalcDrudeForceKernel::execute(ContextImpl& context, bool includeForces, bool includeEnergy) {
+    ComputeForceTask task(*this, extractPositions(context));
+    data.threads.execute(task);
+    data.threads.waitForThreads();
+    double energy = 0.0;
+    for (int i = 0; i < (int) threadEnergy.size(); i++)
+        energy += threadEnergy[i];
+    return energy;
+}
+
+void CpuCalcDrudeForceKernel::computeSpringForces(int start, int end, const vector<RealVec>& pos, float* forces, double& energy) {
+    for (int i = start; i < end; i++) {
+        int p = particle[i];
+        int p1 = particle1[i];
+        int p2 = particle2[i];
+        int p3 = particle3[i];
+        int p4 = particle4[i];
+        
+        RealOpenMM a1 = (p2 == -1 ? 1 : aniso12[i]);
+        RealOpenMM a2 = (p3 == -1 || p4 == -1 ? 1 : aniso34[i]);
+        RealOpenMM a3 = 3-a1-a2;
+        RealOpenMM k3 = ONE_4PI_EPS0*charge[i]*charge[i]/(polarizability[i]*a3);
+        RealOpenMM k1 = ONE_4PI_EPS0*charge[i]*charge[i]/(polarizability[i]*a1) - k3;
+        RealOpenMM k2 = ONE_4PI_EPS0*charge[i]*charge[i]/(polarizability[i]*a2) - k3;
+        
+        // Compute the isotropic force.
+        
+        RealVec delta = pos[p]-pos[p1];
+        RealOpenMM r2 = delta.dot(delta);
+        energy += 0.5*k3*r2;
+        RealVec fp = -delta*k3;
+        RealVec fp1 = delta*k3;
+        
+        // Compute the first anisotropic force.
+        
+        if (p2 != -1) {
+            RealVec dir = pos[p1]-pos[p2];
+            RealOpenMM invDist = 1.0/sqrt(dir.dot(dir));
+            dir *= invDist;
+            RealOpenMM rprime = dir.dot(delta);
+            energy += 0.5*k1*rprime*rprime;
+            RealVec f1 = dir*(k1*rprime); 
+            RealVec f2 = (delta-dir*rprime)*(k1*rprime*invDist);
+            fp -= f1;
+            fp1 += f1-f2;
+            addForce(forces, p2, f2);
+        }
+        
+        // Compute the second anisotropic force.
+        
+        if (p3 != -1 && p4 != -1) {
+            RealVec dir = pos[p3]-pos[p4];
+            RealOpenMM invDist = 1.0/sqrt(dir.dot(dir));
+            dir *= invDist;
+            RealOpenMM rprime = dir.dot(delta);
+            energy += 0.5*k2*rprime*rprime;
+            RealVec f1 = dir*(k2*rprime);
+            RealVec f2 = (delta-dir*rprime)*(k2*rprime*invDist);
+            fp -= f1;
+            fp1 += f1;
+            addForce(forces, p3, -f2);
+            addForce(forces, p4, f2);
+        }
+        addForce(forces, p, fp);
+        addForce(forces, p1, fp1);
+    }
+}
+
+void CpuCalcDrudeForceKernel::computeScreenedPairForces(int start, int end, const vector<RealVec>& pos, float* forces, double& energy) {
+    // The four charge-charge interactions of each pair are evaluated in double precision, since the
+    // screened interactions between nearby dipoles largely cancel.  Only the accumulation into the
+    // single precision force buffers is vectorized.
+    
+    for (int i = start; i < end; i++) {
+        int dipole1 = pair1[i];
+        int dipole2 = pair2[i];
+        int dipole1Particles[] = {particle[dipole1], particle1[dipole1]};
+        int dipole2Particles[] = {particle[dipole2], particle1[dipole2]};
+        RealOpenMM uscale = pairScale[i];
+        RealVec dipole1Force[2], dipole2Force[2];
+        for (int j = 0; j < 2; j++)
+            for (int k = 0; k < 2; k++) {
+                int p1 = dipole1Particles[j];
+                int p2 = dipole2Particles[k];
+                RealOpenMM chargeProduct = charge[dipole1]*charge[dipole2]*(j == k ? 1 : -1);
+                RealVec delta = pos[p1]-pos[p2];
+                RealOpenMM r = sqrt(delta.dot(delta));
+                RealOpenMM u = r*uscale;
+                RealOpenMM expu = exp(-u);
+                RealOpenMM screening = 1.0 - (1.0+0.5*u)*expu;
+                energy += ONE_4PI_EPS0*chargeProduct*screening/r;
+                RealVec f = delta*(ONE_4PI_EPS0*chargeProduct/(r*r))*(screening/r-0.5*(1+u)*expu*uscale);
+                dipole1Force[j] += f;
+                dipole2Force[k] -= f;
+            }
+        for (int j = 0; j < 2; j++) {
+            addForce(forces, dipole1Particles[j], dipole1Force[j]);
+            addForce(forces, dipole2Particles[j], dipole2Force[j]);
+        }
+    }
+}
+
+void CpuCalcDrudeForceKernel::copyParametersToContext(ContextImpl& context, const DrudeForce& force) {
+    if (force.getNumParticles() != particle.size())
+        throw OpenMMException("updateParametersInContext: The number of Drude particles has changed");
+    if (force.getNumScreenedPairs() != pair1.size())
+        throw OpenMMException("updateParametersInContext: The number of screened pairs has changed");
+    for (int i = 0; i < force.getNumParticles(); i++) {
+        int p, p1, p2, p3, p4;
+        force.getParticleParameters(i, p, p1, p2, p3, p4, charge[i], polarizability[i], aniso12[i], aniso34[i]);
+        if (p != particle[i] || p1 != particle1[i] || p2 != particle2[i] || p3 != particle3[i] || p4 != particle4[i])
+            throw OpenMMException("updateParametersInContext: A particle index has changed");
+    }
+    for (int i = 0; i < force.getNumScreenedPairs(); i++) {
+        int p1, p2;
+        force.getScreenedPairParameters(i, p1, p2, pairThole[i]);
+        if (p1 != pair1[i] || p2 != pair2[i])
+            throw OpenMMException("updateParametersInContext: A particle index for a screened pair has changed");
+    }
+    computeScreeningParameters();
+}
+
+class CpuIntegrateDrudeLangevinStepKernel::UpdateVelocitiesTask : public ThreadPool::Task {
+public:
+    UpdateVelocitiesTask(CpuIntegrateDrudeLangevinStepKernel& owner, const DrudeLangevinIntegrator& integrator, vector<RealVec>& vel, const vector<RealVec>& force) :
+            owner(owner), integrator(integrator), vel(vel), force(force) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        owner.updateVelocities(threadIndex, integrator, vel, force);
+    }
+    CpuIntegrateDrudeLangevinStepKernel& owner;
+    const DrudeLangevinIntegrator& integrator;
+    vector<RealVec>& vel;
+    const vector<RealVec>& force;
+};
+
+class CpuIntegrateDrudeLangevinStepKernel::UpdatePositionsTask : public ThreadPool::Task {
+public:
+    UpdatePositionsTask(CpuIntegrateDrudeLangevinStepKernel& owner, vector<RealVec>& pos, vector<RealVec>& vel, RealOpenMM dt, bool constrained) :
+            owner(owner), pos(pos), vel(vel), dt(dt), constrained(constrained) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        const vector<RealOpenMM>& invMass = owner.particleInvMass;
+        vector<RealVec>& xPrime = owner.xPrime;
+        int numParticles = invMass.size();
+        int start = threadIndex*numParticles/threads.getNumThreads();
+        int end = (threadIndex+1)*numParticles/threads.getNumThreads();
+        if (constrained) {
+            // Record the constrained positions and velocities.
+            
+            RealOpenMM dtInv = 1.0/dt;
+            for (int i = start; i < end; i++)
+                if (invMass[i] != 0.0) {
+                    vel[i] = (xPrime[i]-pos[i])*dtInv;
+                    pos[i] = xPrime[i];
+                }
+        }
+        else {
+            for (int i = start; i < end; i++)
+                xPrime[i] = (invMass[i] != 0.0 ? pos[i]+vel[i]*dt : pos[i]);
+        }
+    }
+    CpuIntegrateDrudeLangevinStepKernel& owner;
+    vector<RealVec>& pos;
+    vector<RealVec>& vel;
+    RealOpenMM dt;
+    bool constrained;
+};
+
+void CpuIntegrateDrudeLangevinStepKernel::initialize(const System& system, const DrudeLangevinIntegrator& integrator, const DrudeForce& force) {
+    data.random.initialize(integrator.getRandomNumberSeed(), data.threads.getNumThreads());
+    
+    // Identify particle pairs and ordinary particles.
+    
+    set<int> particles;
+    for (int i = 0; i < system.getNumParticles(); i++) {
+        particles.insert(i);
+        double mass = system.getParticleMass(i);
+        particleInvMass.push_back(mass == 0.0 ? 0.0 : 1.0/mass);
+    }
+    for (int i = 0; i < force.getNumParticles(); i++) {
+        int p, p1, p2, p3, p4;
+        double charge, polarizability, aniso12, aniso34;
+        force.getParticleParameters(i, p, p1, p2, p3, p4, charge, polarizability, aniso12, aniso34);
+        particles.erase(p);
+        particles.erase(p1);
+        pairParticles.push_back(make_pair(p, p1));
+        double m1 = system.getParticleMass(p);
+        double m2 = system.getParticleMass(p1);
+        pairInvTotalMass.push_back(1.0/(m1+m2));
+        pairInvReducedMass.push_back((m1+m2)/(m1*m2));
+    }
+    normalParticles.insert(normalParticles.begin(), particles.begin(), particles.end());
+    xPrime.resize(system.getNumParticles());
+}
+
+void CpuIntegrateDrudeLangevinStepKernel::updateVelocities(int threadIndex, const DrudeLangevinIntegrator& integrator, vector<RealVec>& vel, const vector<RealVec>& force) {
+    int numThreads = data.threads.getNumThreads();
+    
+    // Update velocities of ordinary particles.
+    
+    const RealOpenMM vscale = exp(-integrator.getStepSize()*integrator.getFriction());
+    const RealOpenMM fscale = (1-vscale)/integrator.getFriction();
+    const RealOpenMM kT = BOLTZ*integrator.getTemperature();
+    const RealOpenMM noisescale = sqrt(2*kT*integrator.getFriction())*sqrt(0.5*(1-vscale*vscale)/integrator.getFriction());
+    int numNormal = normalParticles.size();
+    int start = threadIndex*numNormal/numThreads;
+    int end = (threadIndex+1)*numNormal/numThreads;
+    for (int i = start; i < end; i++) {
+        int index = normalParticles[i];
+        RealOpenMM invMass = particleInvMass[index];
+        if (invMass != 0.0) {
+            RealOpenMM sqrtInvMass = sqrt(invMass);
+            for (int j = 0; j < 3; j++)
+                vel[index][j] = vscale*vel[index][j] + fscale*invMass*force[index][j] + noisescale*sqrtInvMass*data.random.getGaussianRandom(threadIndex);
+        }
+    }
+    
+    // Update velocities of Drude particle pairs.
+    
+    const RealOpenMM vscaleDrude = exp(-integrator.getStepSize()*integrator.getDrudeFriction());
+    const RealOpenMM fscaleDrude = (1-vscaleDrude)/integrator.getDrudeFriction();
+    const RealOpenMM kTDrude = BOLTZ*integrator.getDrudeTemperature();
+    const RealOpenMM noisescaleDrude = sqrt(2*kTDrude*integrator.getDrudeFriction())*sqrt(0.5*(1-vscaleDrude*vscaleDrude)/integrator.getDrudeFriction());
+    int numPairs = pairParticles.size();
+    start = threadIndex*numPairs/numThreads;
+    end = (threadIndex+1)*numPairs/numThreads;
+    for (int i = start; i < end; i++) {
+        int p1 = pairParticles[i].first;
+        int p2 = pairParticles[i].second;
+        RealOpenMM mass1fract = pairInvTotalMass[i]/particleInvMass[p1];
+        RealOpenMM mass2fract = pairInvTotalMass[i]/particleInvMass[p2];
+        RealOpenMM sqrtInvTotalMass = sqrt(pairInvTotalMass[i]);
+        RealOpenMM sqrtInvReducedMass = sqrt(pairInvReducedMass[i]);
+        RealVec cmVel = vel[p1]*mass1fract+vel[p2]*mass2fract;
+        RealVec relVel = vel[p2]-vel[p1];
+        RealVec cmForce = force[p1]+force[p2];
+        RealVec relForce = force[p2]*mass1fract - force[p1]*mass2fract;
+        for (int j = 0; j < 3; j++) {
+            cmVel[j] = vscale*cmVel[j] + fscale*pairInvTotalMass[i]*cmForce[j] + noisescale*sqrtInvTotalMass*data.random.getGaussianRandom(threadIndex);
+            relVel[j] = vscaleDrude*relVel[j] + fscaleDrude*pairInvReducedMass[i]*relForce[j] + noisescaleDrude*sqrtInvReducedMass*data.random.getGaussianRandom(threadIndex);
+        }
+        vel[p1] = cmVel-relVel*mass2fract;
+        vel[p2] = cmVel+relVel*mass1fract;
+    }
+}
+
+void CpuIntegrateDrudeLangevinStepKernel::execute(ContextImpl& context, const DrudeLangevinIntegrator& integrator) {
+    vector<RealVec>& pos = extractPositions(context);
+    vector<RealVec>& vel = extractVelocities(context);
+    vector<RealVec>& force = extractForces(context);
+    RealOpenMM dt = integrator.getStepSize();
+    
+    // Update the velocities, then compute the new positions.
+    
+    UpdateVelocitiesTask velocityTask(*this, integrator, vel, force);
+    data.threads.execute(velocityTask);
+    data.threads.waitForThreads();
+    UpdatePositionsTask positionTask(*this, pos, vel, dt, false);
+    data.threads.execute(positionTask);
+    data.threads.waitForThreads();
+    
+    // Apply constraints.
+    
+    extractConstraints(context).apply(pos, xPrime, particleInvMass, integrator.getConstraintTolerance());
+    
+    // Record the constrained positions and velocities.
+    
+    UpdatePositionsTask recordTask(*this, pos, vel, dt, true);
+    data.threads.execute(recordTask);
+    data.threads.waitForThreads();
+    ReferenceVirtualSites::computePositions(context.getSystem(), pos);
+    ReferencePlatform::PlatformData* refData = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    refData->time += dt;
+    refData->stepCount++;
+}
+
+double CpuIntegrateDrudeLangevinStepKernel::computeKineticEnergy(ContextImpl& context, const DrudeLangevinIntegrator& integrator) {
+    const System& system = context.getSystem();
+    int numParticles = system.getNumParticles();
+    vector<RealVec>& posData = extractPositions(context);
+    vector<RealVec>& velData = extractVelocities(context);
+    vector<RealVec>& forceData = extractForces(context);
+    double timeShift = 0.5*integrator.getStepSize();
+    
+    // Compute the shifted velocities.
+    
+    vector<RealVec> shiftedVel(numParticles);
+    for (int i = 0; i < numParticles; ++i) {
+        if (particleInvMass[i] > 0)
+            shiftedVel[i] = velData[i]+forceData[i]*(timeShift*particleInvMass[i]);
+        else
+            shiftedVel[i] = velData[i];
+    }
+    
+    // Apply constraints to them.
+    
+    extractConstraints(context).applyToVelocities(posData, shiftedVel, particleInvMass, 1e-4);
+    
+    // Compute the kinetic energy.
+    
+    double energy = 0.0;
+    for (int i = 0; i < numParticles; ++i)
+        if (particleInvMass[i] > 0)
+            energy += (shiftedVel[i].dot(shiftedVel[i]))/particleInvMass[i];
+    return 0.5*energy;
+}
@@ -39,10 +39,17 @@ extern "C" OPENMM_EXPORT void registerKernelFactories() {
     for (int i = 0; i < Platform::getNumPlatforms(); i++) {
         Platform& platform = Platform::getPlatform(i);
         if (dynamic_cast<ReferencePlatform*>(&platform) != NULL) {
-            ReferenceDrudeKernelFactory* factory = new ReferenceDrudeKernelFactory();
-            platform.registerKernelFactory(CalcDrudeForceKernel::Name(), factory);
-            platform.registerKernelFactory(IntegrateDrudeLangevinStepKernel::Name(), factory);
-            platform.registerKernelFactory(IntegrateDrudeSCFStepKernel::Name(), factory);
+            // Platforms derived from ReferencePlatform may provide their own implementations, which
+            // should not be replaced if their plugin happened to be loaded first.
+
+            ReferenceDrudeKernelFactory* factory = NULL;
+            std::string kernelNames[] = {CalcDrudeForceKernel::Name(), IntegrateDrudeLangevinStepKernel::Name(), IntegrateDrudeSCFStepKernel::Name()};
+            for (int j = 0; j < 3; j++)
+                if (platform.getName() == "Reference" || !platform.supportsKernels(std::vector<std::string>(1, kernelNames[j]))) {
+                    if (factory == NULL)
+                        factory = new ReferenceDrudeKernelFactory();
+                    platform.registerKernelFactory(kernelNames[j], factory);
+                }
         }
     }
 }
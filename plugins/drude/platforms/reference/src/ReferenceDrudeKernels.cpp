@@ -36,6 +36,7 @@
 #include "SimTKOpenMMUtilities.h"
 #include "ReferenceConstraints.h"
 #include "ReferenceVirtualSites.h"
+#include <algorithm>
 #include <set>
 
 using namespace OpenMM;
@@ -334,6 +335,13 @@ double ReferenceIntegrateDrudeLangevinStepKernel::computeKineticEnergy(ContextIm
     return computeShiftedKineticEnergy(context, particleInvMass, 0.5*integrator.getStepSize());
 }
 
+static double binomial(int n, int k) {
+    double result = 1.0;
+    for (int i = 1; i <= k; i++)
+        result = result*(n-k+i)/i;
+    return result;
+}
+
 ReferenceIntegrateDrudeSCFStepKernel::~ReferenceIntegrateDrudeSCFStepKernel() {
     if (minimizerPos != NULL)
         lbfgs_free(minimizerPos);
@@ -342,11 +350,14 @@ ReferenceIntegrateDrudeSCFStepKernel::~ReferenceIntegrateDrudeSCFStepKernel() {
 void ReferenceIntegrateDrudeSCFStepKernel::initialize(const System& system, const DrudeSCFIntegrator& integrator, const DrudeForce& force) {
     // Identify Drude particles.
     
+    maxSpringConstant = 0.0;
     for (int i = 0; i < force.getNumParticles(); i++) {
         int p, p1, p2, p3, p4;
         double charge, polarizability, aniso12, aniso34;
         force.getParticleParameters(i, p, p1, p2, p3, p4, charge, polarizability, aniso12, aniso34);
         drudeParticles.push_back(p);
+        drudeParents.push_back(p1);
+        maxSpringConstant = max(maxSpringConstant, ONE_4PI_EPS0*charge*charge/polarizability);
     }
 
     // Record particle masses.
@@ -365,6 +376,7 @@ void ReferenceIntegrateDrudeSCFStepKernel::initialize(const System& system, cons
         throw OpenMMException("DrudeSCFIntegrator: Failed to allocate memory");
     lbfgs_parameter_init(&minimizerParams);
     minimizerParams.linesearch = LBFGS_LINESEARCH_BACKTRACKING_STRONG_WOLFE;
+    minimizerParams.epsilon = 0.0; // Convergence is checked by progress() instead.
     if (sizeof(RealOpenMM) < 8)
         minimizerParams.xtol = 1e-7;
 }
@@ -374,6 +386,20 @@ void ReferenceIntegrateDrudeSCFStepKernel::execute(ContextImpl& context, const D
     vector<RealVec>& vel = extractVelocities(context);
     vector<RealVec>& force = extractForces(context);
     
+    // If the Drude particles are not where the last step left them, the state has been modified
+    // and the previous displacements can no longer be used to predict new ones.
+    
+    if (displacementHistory.size() > 0) {
+        const vector<RealVec>& last = displacementHistory[0];
+        for (int i = 0; i < (int) drudeParticles.size(); i++) {
+            RealVec delta = pos[drudeParticles[i]]-pos[drudeParents[i]]-last[i];
+            if (delta[0] != 0 || delta[1] != 0 || delta[2] != 0) {
+                displacementHistory.clear();
+                break;
+            }
+        }
+    }
+
     // Update the positions and velocities.
     
     int numParticles = particleInvMass.size();
@@ -403,7 +429,9 @@ void ReferenceIntegrateDrudeSCFStepKernel::execute(ContextImpl& context, const D
     // Update the positions of virtual sites and Drude particles.
     
     ReferenceVirtualSites::computePositions(context.getSystem(), pos);
-    minimize(context, integrator.getMinimizationErrorTolerance());
+    predictDrudePositions(pos, integrator.getPredictorOrder());
+    minimize(context, integrator.getMinimizationErrorTolerance(), integrator.getMinimizationForceGroups());
+    recordDrudePositions(pos);
     data.time += integrator.getStepSize();
     data.stepCount++;
 }
@@ -412,10 +440,48 @@ double ReferenceIntegrateDrudeSCFStepKernel::computeKineticEnergy(ContextImpl& c
     return computeShiftedKineticEnergy(context, particleInvMass, 0.5*integrator.getStepSize());
 }
 
+void ReferenceIntegrateDrudeSCFStepKernel::predictDrudePositions(vector<RealVec>& pos, int order) {
+    if (order < 0)
+        return;
+    if (order != (int) predictorCoefficients.size()-2) {
+        // Compute the ASPC coefficients: B_j = (-1)^(j+1) j C(2k+4, k+2-j)/C(2k+2, k+1).
+
+        predictorCoefficients.resize(order+2);
+        for (int j = 1; j <= order+2; j++) {
+            double b = j*binomial(2*order+4, order+2-j)/binomial(2*order+2, order+1);
+            predictorCoefficients[j-1] = (j%2 == 1 ? b : -b);
+        }
+        displacementHistory.clear();
+    }
+    if (displacementHistory.size() < predictorCoefficients.size())
+        return;
+    for (int i = 0; i < (int) drudeParticles.size(); i++) {
+        RealVec displacement;
+        for (int j = 0; j < (int) predictorCoefficients.size(); j++)
+            displacement += displacementHistory[j][i]*predictorCoefficients[j];
+        pos[drudeParticles[i]] = pos[drudeParents[i]]+displacement;
+    }
+}
+
+void ReferenceIntegrateDrudeSCFStepKernel::recordDrudePositions(const vector<RealVec>& pos) {
+    // Store the displacements of the Drude particles from their parents, with the most recent first.
+
+    int historySize = max(1, (int) predictorCoefficients.size());
+    if ((int) displacementHistory.size() < historySize)
+        displacementHistory.push_back(vector<RealVec>(drudeParticles.size()));
+    for (int i = displacementHistory.size()-1; i > 0; i--)
+        displacementHistory[i].swap(displacementHistory[i-1]);
+    for (int i = 0; i < (int) drudeParticles.size(); i++)
+        displacementHistory[0][i] = pos[drudeParticles[i]]-pos[drudeParents[i]];
+}
+
 struct MinimizerData {
     ContextImpl& context;
     vector<int>& drudeParticles;
-    MinimizerData(ContextImpl& context, vector<int>& drudeParticles) : context(context), drudeParticles(drudeParticles) {}
+    int groups;
+    double scale, epsilon, initialEnergy;
+    vector<double> initialGradient;
+    MinimizerData(ContextImpl& context, vector<int>& drudeParticles, int groups) : context(context), drudeParticles(drudeParticles), groups(groups) {}
 };
 
 static lbfgsfloatval_t evaluate(void *instance, const lbfgsfloatval_t *x, lbfgsfloatval_t *g, const int n, const lbfgsfloatval_t step) {
@@ -424,15 +490,25 @@ static lbfgsfloatval_t evaluate(void *instance, const lbfgsfloatval_t *x, lbfgsf
     vector<int>& drudeParticles = data->drudeParticles;
     int numDrudeParticles = drudeParticles.size();
 
+    // The first evaluation is at the starting point, which minimize() has already computed.
+
+    if (data->initialGradient.size() > 0) {
+        for (int i = 0; i < n; i++)
+            g[i] = data->initialGradient[i];
+        data->initialGradient.clear();
+        return data->initialEnergy;
+    }
+
     // Compute the force and energy for this configuration.
 
     vector<RealVec>& pos = extractPositions(context);
     vector<RealVec>& force = extractForces(context);
+    double invScale = 1.0/data->scale;
     for (int i = 0; i < numDrudeParticles; i++)
-        pos[drudeParticles[i]] = RealVec(x[3*i], x[3*i+1], x[3*i+2]);
-    double energy = context.calcForcesAndEnergy(true, true);
+        pos[drudeParticles[i]] = RealVec(x[3*i], x[3*i+1], x[3*i+2])*invScale;
+    double energy = context.calcForcesAndEnergy(true, true, data->groups);
     for (int i = 0; i < numDrudeParticles; i++) {
-        RealVec f = force[drudeParticles[i]];
+        RealVec f = force[drudeParticles[i]]*invScale;
         g[3*i] = -f[0];
         g[3*i+1] = -f[1];
         g[3*i+2] = -f[2];
@@ -440,26 +516,62 @@ static lbfgsfloatval_t evaluate(void *instance, const lbfgsfloatval_t *x, lbfgsf
     return energy;
 }
 
-void ReferenceIntegrateDrudeSCFStepKernel::minimize(ContextImpl& context, double tolerance) {
-    // Record the initial positions and determine a normalization constant for scaling the tolerance.
+static int progress(void *instance, const lbfgsfloatval_t *x, const lbfgsfloatval_t *g, const lbfgsfloatval_t fx, const lbfgsfloatval_t xnorm,
+        const lbfgsfloatval_t gnorm, const lbfgsfloatval_t step, int n, int k, int ls) {
+    // Apply the convergence criterion in unscaled coordinates.
+
+    MinimizerData* data = reinterpret_cast<MinimizerData*>(instance);
+    double realGnorm = gnorm*data->scale;
+    double realXnorm = xnorm/data->scale;
+    return (realGnorm/max(1.0, realXnorm) <= data->epsilon ? 1 : 0);
+}
+
+void ReferenceIntegrateDrudeSCFStepKernel::minimize(ContextImpl& context, double tolerance, int groups) {
+    // Determine a normalization constant for scaling the tolerance.
 
     vector<RealVec>& pos = extractPositions(context);
+    vector<RealVec>& force = extractForces(context);
     int numDrudeParticles = drudeParticles.size();
-    double norm = 0.0;
+    double norm = 0.0, xnorm = 0.0;
     for (int i = 0; i < numDrudeParticles; i++) {
         RealVec p = pos[drudeParticles[i]];
-        minimizerPos[3*i] = p[0];
-        minimizerPos[3*i+1] = p[1];
-        minimizerPos[3*i+2] = p[2];
         norm += p.dot(p);
     }
+    xnorm = sqrt(norm);
     norm /= numDrudeParticles;
     norm = (norm < 1 ? 1 : sqrt(norm));
-    minimizerParams.epsilon = tolerance/norm;
+    MinimizerData data(context, drudeParticles, groups);
+    data.epsilon = tolerance/norm;
+
+    // Compute the forces at the starting point.  If it is already converged, there is nothing to do.
+
+    data.initialEnergy = context.calcForcesAndEnergy(true, true, groups);
+    double gnorm = 0.0;
+    for (int i = 0; i < numDrudeParticles; i++) {
+        RealVec f = force[drudeParticles[i]];
+        gnorm += f.dot(f);
+    }
+    gnorm = sqrt(gnorm);
+    if (gnorm/max(1.0, xnorm) <= data.epsilon)
+        return;
+
+    // L-BFGS always makes its first step a unit distance along the gradient, which is far too long when starting
+    // close to the minimum.  Scale the coordinates so that step instead equals the displacement the stiffest Drude
+    // spring would produce under the current force.
+
+    data.scale = maxSpringConstant/gnorm;
+    data.initialGradient.resize(3*numDrudeParticles);
+    for (int i = 0; i < numDrudeParticles; i++) {
+        RealVec p = pos[drudeParticles[i]];
+        RealVec f = force[drudeParticles[i]];
+        for (int j = 0; j < 3; j++) {
+            minimizerPos[3*i+j] = p[j]*data.scale;
+            data.initialGradient[3*i+j] = -f[j]/data.scale;
+        }
+    }
     
     // Perform the minimization.
 
     lbfgsfloatval_t fx;
-    MinimizerData data(context, drudeParticles);
-    lbfgs(numDrudeParticles*3, minimizerPos, &fx, evaluate, NULL, &data, &minimizerParams);
+    lbfgs(numDrudeParticles*3, minimizerPos, &fx, evaluate, progress, &data, &minimizerParams);
 }
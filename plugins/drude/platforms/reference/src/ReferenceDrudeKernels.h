@@ -152,10 +152,15 @@ public:
      */
     double computeKineticEnergy(ContextImpl& context, const DrudeSCFIntegrator& integrator);
 private:
-    void minimize(ContextImpl& context, double tolerance);
+    void predictDrudePositions(std::vector<RealVec>& pos, int order);
+    void recordDrudePositions(const std::vector<RealVec>& pos);
+    void minimize(ContextImpl& context, double tolerance, int groups);
     ReferencePlatform::PlatformData& data;
-    std::vector<int> drudeParticles;
+    std::vector<int> drudeParticles, drudeParents;
     std::vector<double> particleInvMass;
+    std::vector<std::vector<RealVec> > displacementHistory;
+    std::vector<double> predictorCoefficients;
+    double maxSpringConstant;
     lbfgsfloatval_t *minimizerPos;
     lbfgs_parameter_t minimizerParams;
 };
@@ -35,6 +35,7 @@
 
 #include "openmm/internal/AssertionUtilities.h"
 #include "openmm/Context.h"
+#include "openmm/HarmonicBondForce.h"
 #include "openmm/NonbondedForce.h"
 #include "openmm/Platform.h"
 #include "openmm/System.h"
@@ -50,7 +51,7 @@ using namespace std;
 
 extern "C" OPENMM_EXPORT void registerDrudeReferenceKernelFactories();
 
-void testWater() {
+void createWaterBox(System& system, vector<Vec3>& positions) {
     // Create a box of SWM4-NDP water molecules.  This involves constraints, virtual sites,
     // and Drude particles.
     
@@ -58,7 +59,6 @@ void testWater() {
     const int numMolecules = gridSize*gridSize*gridSize;
     const double spacing = 0.6;
     const double boxSize = spacing*(gridSize+1);
-    System system;
     NonbondedForce* nonbonded = new NonbondedForce();
     DrudeForce* drude = new DrudeForce();
     system.addForce(nonbonded);
@@ -87,7 +87,6 @@ void testWater() {
         system.setVirtualSite(startIndex+4, new ThreeParticleAverageSite(startIndex, startIndex+2, startIndex+3, 0.786646558, 0.106676721, 0.106676721));
         drude->addParticle(startIndex+1, startIndex, -1, -1, -1, -1.71636, ONE_4PI_EPS0*1.71636*1.71636/(100000*4.184), 1, 1);
     }
-    vector<Vec3> positions;
     for (int i = 0; i < gridSize; i++)
         for (int j = 0; j < gridSize; j++)
             for (int k = 0; k < gridSize; k++) {
@@ -98,10 +97,17 @@ void testWater() {
                 positions.push_back(pos+Vec3(-0.023999, 0.092663, 0));
                 positions.push_back(pos);
             }
-    
+}
+
+void testWater() {
+    const int numMolecules = 27;
+    System system;
+    vector<Vec3> positions;
+    createWaterBox(system, positions);
+
     // Simulate it and check energy conservation and the total force on the Drude particles.
     
-    DrudeSCFIntegrator integ(0.0005);
+    DrudeSCFIntegrator integ(0.0005); integ.setPredictorOrder(-1);
     Platform& platform = Platform::getPlatformByName("Reference");
     Context context(system, integ, platform);
     context.setPositions(positions);
@@ -126,10 +132,79 @@ void testWater() {
     }
 }
 
+void testPredictor() {
+    // Starting the minimization from extrapolated positions should not change the trajectory,
+    // beyond the differences allowed by the error tolerance.
+
+    System system;
+    vector<Vec3> positions;
+    createWaterBox(system, positions);
+    DrudeSCFIntegrator integ1(0.0005);
+    DrudeSCFIntegrator integ2(0.0005);
+    integ1.setPredictorOrder(-1);
+    integ1.setMinimizationErrorTolerance(1e-3);
+    integ2.setMinimizationErrorTolerance(1e-3);
+    ASSERT_EQUAL(2, integ2.getPredictorOrder());
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context1(system, integ1, platform);
+    Context context2(system, integ2, platform);
+    context1.setPositions(positions);
+    context1.applyConstraints(1e-5);
+    context1.setVelocitiesToTemperature(300.0);
+    State initial = context1.getState(State::Positions | State::Velocities);
+    context2.setPositions(initial.getPositions());
+    context2.setVelocities(initial.getVelocities());
+    for (int i = 0; i < 20; i++) {
+        integ1.step(1);
+        integ2.step(1);
+        State state1 = context1.getState(State::Energy);
+        State state2 = context2.getState(State::Energy);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-4);
+    }
+}
+
+void testMinimizationForceGroups() {
+    // Add a Force that does not involve the Drude particles, and leave it out of the minimization.
+    // The trajectory should be the same as when all groups are included.
+
+    System system;
+    vector<Vec3> positions;
+    createWaterBox(system, positions);
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    for (int i = 0; i+5 < system.getNumParticles(); i += 10)
+        bonds->addBond(i, i+5, 0.6, 100.0);
+    bonds->setForceGroup(1);
+    system.addForce(bonds);
+    DrudeSCFIntegrator integ1(0.0005);
+    DrudeSCFIntegrator integ2(0.0005);
+    integ2.setMinimizationForceGroups(1);
+    ASSERT_EQUAL(1, integ2.getMinimizationForceGroups());
+    Platform& platform = Platform::getPlatformByName("Reference");
+    Context context1(system, integ1, platform);
+    Context context2(system, integ2, platform);
+    context1.setPositions(positions);
+    context1.applyConstraints(1e-5);
+    context1.setVelocitiesToTemperature(300.0);
+    State initial = context1.getState(State::Positions | State::Velocities);
+    context2.setPositions(initial.getPositions());
+    context2.setVelocities(initial.getVelocities());
+    for (int i = 0; i < 10; i++) {
+        integ1.step(1);
+        integ2.step(1);
+        State state1 = context1.getState(State::Positions | State::Energy);
+        State state2 = context2.getState(State::Positions | State::Energy);
+        ASSERT_EQUAL_TOL(state1.getPotentialEnergy(), state2.getPotentialEnergy(), 1e-4);
+        for (int j = 0; j < system.getNumParticles(); j++)
+            ASSERT_EQUAL_VEC(state1.getPositions()[j], state2.getPositions()[j], 1e-4);
+    }
+}
+
 int main() {
     try {
         registerDrudeReferenceKernelFactories();
         testWater();
+        testPredictor();
+        testMinimizationForceGroups();
     }
     catch(const std::exception& e) {
         std::cout << "exception: " << e.what() << std::endl;
@@ -0,0 +1,537 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuRpmdKernels.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/RPMDIntegrator.h"
+#include "openmm/internal/ContextImpl.h"
+#include "SimTKOpenMMUtilities.h"
+#include <cmath>
+
+using namespace OpenMM;
+using namespace std;
+
+static vector<RealVec>& extractPositions(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->positions);
+}
+
+static vector<RealVec>& extractVelocities(ContextImpl& context) {
+    ReferencePlatform::PlatformData* data = reinterpret_cast<ReferencePlatform::PlatformData*>(context.getPlatformData());
+    return *((vector<RealVec>*) data->velocities);
+}
+
+class CpuIntegrateRPMDStepKernel::FirstHalfStepTask : public ThreadPool::Task {
+public:
+    FirstHalfStepTask(CpuIntegrateRPMDStepKernel& owner, bool applyThermostat) : owner(owner), applyThermostat(applyThermostat) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numParticles = owner.masses.size();
+        int start = threadIndex*numParticles/threads.getNumThreads();
+        int end = (threadIndex+1)*numParticles/threads.getNumThreads();
+        if (applyThermostat)
+            owner.applyThermostat(start, end, threadIndex);
+        owner.updateVelocities(start, end);
+        owner.evolveFreeRingPolymer(start, end, threadIndex);
+    }
+    CpuIntegrateRPMDStepKernel& owner;
+    bool applyThermostat;
+};
+
+class CpuIntegrateRPMDStepKernel::SecondHalfStepTask : public ThreadPool::Task {
+public:
+    SecondHalfStepTask(CpuIntegrateRPMDStepKernel& owner, bool applyThermostat) : owner(owner), applyThermostat(applyThermostat) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numParticles = owner.masses.size();
+        int start = threadIndex*numParticles/threads.getNumThreads();
+        int end = (threadIndex+1)*numParticles/threads.getNumThreads();
+        owner.updateVelocities(start, end);
+        if (applyThermostat)
+            owner.applyThermostat(start, end, threadIndex);
+    }
+    CpuIntegrateRPMDStepKernel& owner;
+    bool applyThermostat;
+};
+
+class CpuIntegrateRPMDStepKernel::ComputeForcesTask : public ThreadPool::Task {
+public:
+    ComputeForcesTask(CpuIntegrateRPMDStepKernel& owner, vector<vector<RealVec> >& copyPositions, vector<vector<RealVec> >& copyForces,
+            int numCopies, int firstWorker, int groups, bool computeVirtualSites) : owner(owner), copyPositions(copyPositions),
+            copyForces(copyForces), numCopies(numCopies), firstWorker(firstWorker), groups(groups), computeVirtualSites(computeVirtualSites),
+            hasError(false) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        try {
+            for (int copy = threadIndex; copy < numCopies; copy += threads.getNumThreads())
+                owner.computeCopyForces(threadIndex, *owner.workerContexts[firstWorker+copy], copyPositions[copy], copyForces[copy],
+                        groups, computeVirtualSites);
+        }
+        catch (exception& ex) {
+            // Exceptions cannot propagate out of a worker thread, so save the message for the main thread.
+
+            hasError = true;
+            errorMessage = ex.what();
+        }
+    }
+    CpuIntegrateRPMDStepKernel& owner;
+    vector<vector<RealVec> >& copyPositions;
+    vector<vector<RealVec> >& copyForces;
+    int numCopies, firstWorker, groups;
+    bool computeVirtualSites, hasError;
+    string errorMessage;
+};
+
+class CpuIntegrateRPMDStepKernel::ContractPositionsTask : public ThreadPool::Task {
+public:
+    ContractPositionsTask(CpuIntegrateRPMDStepKernel& owner, int copies) : owner(owner), copies(copies) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numParticles = owner.masses.size();
+        int start = threadIndex*numParticles/threads.getNumThreads();
+        int end = (threadIndex+1)*numParticles/threads.getNumThreads();
+        owner.contractPositions(start, end, threadIndex, copies);
+    }
+    CpuIntegrateRPMDStepKernel& owner;
+    int copies;
+};
+
+class CpuIntegrateRPMDStepKernel::ContractForcesTask : public ThreadPool::Task {
+public:
+    ContractForcesTask(CpuIntegrateRPMDStepKernel& owner, int copies) : owner(owner), copies(copies) {
+    }
+    void execute(ThreadPool& threads, int threadIndex) {
+        int numParticles = owner.masses.size();
+        int start = threadIndex*numParticles/threads.getNumThreads();
+        int end = (threadIndex+1)*numParticles/threads.getNumThreads();
+        owner.contractForces(start, end, threadIndex, copies);
+    }
+    CpuIntegrateRPMDStepKernel& owner;
+    int copies;
+};
+
+CpuIntegrateRPMDStepKernel::~CpuIntegrateRPMDStepKernel() {
+    for (int i = 0; i < (int) workerContexts.size(); i++)
+        delete workerContexts[i];
+    for (int i = 0; i < (int) workerIntegrators.size(); i++)
+        delete workerIntegrators[i];
+    for (int i = 0; i < (int) threadFFT.size(); i++)
+        fftpack_destroy(threadFFT[i]);
+    for (map<int, vector<fftpack*> >::const_iterator iter = threadContractionFFT.begin(); iter != threadContractionFFT.end(); ++iter)
+        for (int i = 0; i < (int) iter->second.size(); i++)
+            fftpack_destroy(iter->second[i]);
+}
+
+void CpuIntegrateRPMDStepKernel::initialize(const System& system, const RPMDIntegrator& integrator) {
+    int numCopies = integrator.getNumCopies();
+    int numParticles = system.getNumParticles();
+    int numThreads = data.threads.getNumThreads();
+    positions.resize(numCopies);
+    velocities.resize(numCopies);
+    forces.resize(numCopies);
+    for (int i = 0; i < numCopies; i++) {
+        positions[i].resize(numParticles);
+        velocities[i].resize(numParticles);
+        forces[i].resize(numParticles);
+    }
+    masses.resize(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        masses[i] = system.getParticleMass(i);
+    stepSize = integrator.getStepSize();
+    temperature = integrator.getTemperature();
+    friction = integrator.getFriction();
+
+    // Each thread needs its own FFT objects and workspace, since fftpack stores temporary data in them.
+
+    threadFFT.resize(numThreads);
+    threadQ.resize(numThreads);
+    threadV.resize(numThreads);
+    for (int i = 0; i < numThreads; i++) {
+        fftpack_init_1d(&threadFFT[i], numCopies);
+        threadQ[i].resize(numCopies);
+        threadV[i].resize(numCopies);
+    }
+    data.random.initialize(integrator.getRandomNumberSeed(), numThreads);
+    
+    // Build a list of contractions.
+    
+    groupsNotContracted = -1;
+    const map<int, int>& contractions = integrator.getContractions();
+    int maxContractedCopies = 0;
+    for (map<int, int>::const_iterator iter = contractions.begin(); iter != contractions.end(); ++iter) {
+        int group = iter->first;
+        int copies = iter->second;
+        if (group < 0 || group > 31)
+            throw OpenMMException("RPMDIntegrator: Force group must be between 0 and 31");
+        if (copies < 0 || copies > numCopies)
+            throw OpenMMException("RPMDIntegrator: Number of copies for contraction cannot be greater than the total number of copies being simulated");
+        if (copies != numCopies) {
+            if (groupsByCopies.find(copies) == groupsByCopies.end()) {
+                groupsByCopies[copies] = 1<<group;
+                vector<fftpack*>& fft = threadContractionFFT[copies];
+                fft.resize(numThreads);
+                for (int i = 0; i < numThreads; i++)
+                    fftpack_init_1d(&fft[i], copies);
+                if (copies > maxContractedCopies)
+                    maxContractedCopies = copies;
+            }
+            else
+                groupsByCopies[copies] |= 1<<group;
+            groupsNotContracted -= 1<<group;
+        }
+    }
+    
+    // Create workspace for doing contractions.
+    
+    contractedPositions.resize(maxContractedCopies);
+    contractedForces.resize(maxContractedCopies);
+    for (int i = 0; i < maxContractedCopies; i++) {
+        contractedPositions[i].resize(numParticles);
+        contractedForces[i].resize(numParticles);
+    }
+}
+
+void CpuIntegrateRPMDStepKernel::createWorkerContexts(ContextImpl& context, const RPMDIntegrator& integrator) {
+    // Forces are computed by single threaded worker Contexts: one for each copy of the system, followed by
+    // one for each copy of every contraction.  Each worker always sees the same copy, so its neighbor list,
+    // PME grids and other cached data are reused from step to step instead of being invalidated whenever
+    // a different copy's positions are loaded.  The workers get an RPMDIntegrator because some Forces (such
+    // as RPMDMonteCarloBarostat) require one, but they are never used to take time steps.
+
+    Platform& platform = context.getPlatform();
+    map<string, string> properties;
+    const vector<string>& propertyNames = platform.getPropertyNames();
+    for (int i = 0; i < (int) propertyNames.size(); i++)
+        properties[propertyNames[i]] = platform.getPropertyValue(context.getOwner(), propertyNames[i]);
+    properties[CpuPlatform::CpuThreads()] = "1";
+    int numWorkers = positions.size();
+    for (map<int, int>::const_iterator iter = groupsByCopies.begin(); iter != groupsByCopies.end(); ++iter) {
+        firstContractionWorker[iter->first] = numWorkers;
+        numWorkers += iter->first;
+    }
+    for (int i = 0; i < numWorkers; i++) {
+        RPMDIntegrator* workerIntegrator = new RPMDIntegrator(1, integrator.getTemperature(), integrator.getFriction(), integrator.getStepSize());
+        workerIntegrators.push_back(workerIntegrator);
+        workerContexts.push_back(new Context(context.getSystem(), *workerIntegrator, platform, properties));
+    }
+    threadPositions.resize(data.threads.getNumThreads(), vector<Vec3>(masses.size()));
+}
+
+void CpuIntegrateRPMDStepKernel::execute(ContextImpl& context, const RPMDIntegrator& integrator, bool forcesAreValid) {
+    // Loop over copies and compute the force on each one.
+    
+    if (!forcesAreValid)
+        computeForces(context, integrator);
+    stepSize = integrator.getStepSize();
+    temperature = integrator.getTemperature();
+    friction = integrator.getFriction();
+
+    // Apply the thermostat, update velocities, and evolve the free ring polymer.
+
+    FirstHalfStepTask firstTask(*this, integrator.getApplyThermostat());
+    data.threads.execute(firstTask);
+    data.threads.waitForThreads();
+    
+    // Calculate forces based on the updated positions.
+    
+    computeForces(context, integrator);
+
+    // Update velocities and apply the thermostat again.
+
+    SecondHalfStepTask secondTask(*this, integrator.getApplyThermostat());
+    data.threads.execute(secondTask);
+    data.threads.waitForThreads();
+    
+    // Update the time.
+    
+    context.setTime(context.getTime()+stepSize);
+}
+
+void CpuIntegrateRPMDStepKernel::applyThermostat(int start, int end, int threadIndex) {
+    // Apply the PILE-L thermostat.
+
+    const int numCopies = positions.size();
+    const RealOpenMM halfdt = 0.5*stepSize;
+    const RealOpenMM hbar = 1.054571628e-34*AVOGADRO/(1000*1e-12);
+    const RealOpenMM scale = 1.0/sqrt((RealOpenMM) numCopies);
+    const RealOpenMM nkT = numCopies*BOLTZ*temperature;
+    const RealOpenMM twown = 2.0*nkT/hbar;
+    const RealOpenMM c1_0 = exp(-halfdt*friction);
+    const RealOpenMM c2_0 = sqrt(1.0-c1_0*c1_0);
+    fftpack* fft = threadFFT[threadIndex];
+    vector<t_complex>& v = threadV[threadIndex];
+    for (int particle = start; particle < end; particle++) {
+        if (masses[particle] == 0.0)
+            continue;
+        const RealOpenMM c3_0 = c2_0*sqrt(nkT/masses[particle]);
+        for (int component = 0; component < 3; component++) {
+            for (int k = 0; k < numCopies; k++)
+                v[k] = t_complex(scale*velocities[k][particle][component], 0.0);
+            fftpack_exec_1d(fft, FFTPACK_FORWARD, &v[0], &v[0]);
+
+            // Apply a local Langevin thermostat to the centroid mode.
+
+            v[0].re = v[0].re*c1_0 + c3_0*data.random.getGaussianRandom(threadIndex);
+
+            // Use critical damping white noise for the remaining modes.
+
+            for (int k = 1; k <= numCopies/2; k++) {
+                const bool isCenter = (numCopies%2 == 0 && k == numCopies/2);
+                const RealOpenMM wk = twown*sin(k*M_PI/numCopies);
+                const RealOpenMM c1 = exp(-2.0*wk*halfdt);
+                const RealOpenMM c2 = sqrt((1.0-c1*c1)/2) * (isCenter ? sqrt(2.0) : 1.0);
+                const RealOpenMM c3 = c2*sqrt(nkT/masses[particle]);
+                RealOpenMM rand1 = c3*data.random.getGaussianRandom(threadIndex);
+                RealOpenMM rand2 = (isCenter ? 0.0 : c3*data.random.getGaussianRandom(threadIndex));
+                v[k] = v[k]*c1 + t_complex(rand1, rand2);
+                if (k < numCopies-k)
+                    v[numCopies-k] = v[numCopies-k]*c1 + t_complex(rand1, -rand2);
+            }
+            fftpack_exec_1d(fft, FFTPACK_BACKWARD, &v[0], &v[0]);
+            for (int k = 0; k < numCopies; k++)
+                velocities[k][particle][component] = scale*v[k].re;
+        }
+    }
+}
+
+void CpuIntegrateRPMDStepKernel::updateVelocities(int start, int end) {
+    const int numCopies = positions.size();
+    const RealOpenMM halfdt = 0.5*stepSize;
+    for (int j = start; j < end; j++)
+        if (masses[j] != 0.0) {
+            RealOpenMM scale = halfdt/masses[j];
+            for (int i = 0; i < numCopies; i++)
+                velocities[i][j] += forces[i][j]*scale;
+        }
+}
+
+void CpuIntegrateRPMDStepKernel::evolveFreeRingPolymer(int start, int end, int threadIndex) {
+    // Evolve the free ring polymer by transforming to the frequency domain.
+
+    const int numCopies = positions.size();
+    const RealOpenMM dt = stepSize;
+    const RealOpenMM hbar = 1.054571628e-34*AVOGADRO/(1000*1e-12);
+    const RealOpenMM scale = 1.0/sqrt((RealOpenMM) numCopies);
+    const RealOpenMM nkT = numCopies*BOLTZ*temperature;
+    const RealOpenMM twown = 2.0*nkT/hbar;
+    fftpack* fft = threadFFT[threadIndex];
+    vector<t_complex>& q = threadQ[threadIndex];
+    vector<t_complex>& v = threadV[threadIndex];
+    for (int particle = start; particle < end; particle++) {
+        if (masses[particle] == 0.0)
+            continue;
+        for (int component = 0; component < 3; component++) {
+            for (int k = 0; k < numCopies; k++) {
+                q[k] = t_complex(scale*positions[k][particle][component], 0.0);
+                v[k] = t_complex(scale*velocities[k][particle][component], 0.0);
+            }
+            fftpack_exec_1d(fft, FFTPACK_FORWARD, &q[0], &q[0]);
+            fftpack_exec_1d(fft, FFTPACK_FORWARD, &v[0], &v[0]);
+            q[0] += v[0]*dt;
+            for (int k = 1; k < numCopies; k++) {
+                const RealOpenMM wk = twown*sin(k*M_PI/numCopies);
+                const RealOpenMM wt = wk*dt;
+                const RealOpenMM coswt = cos(wt);
+                const RealOpenMM sinwt = sin(wt);
+                const t_complex vprime = v[k]*coswt - q[k]*(wk*sinwt); // Advance velocity from t to t+dt
+                q[k] = v[k]*(sinwt/wk) + q[k]*coswt; // Advance position from t to t+dt
+                v[k] = vprime;
+            }
+            fftpack_exec_1d(fft, FFTPACK_BACKWARD, &q[0], &q[0]);
+            fftpack_exec_1d(fft, FFTPACK_BACKWARD, &v[0], &v[0]);
+            for (int k = 0; k < numCopies; k++) {
+                positions[k][particle][component] = scale*q[k].re;
+                velocities[k][particle][component] = scale*v[k].re;
+            }
+        }
+    }
+}
+
+void CpuIntegrateRPMDStepKernel::computeForces(ContextImpl& context, const RPMDIntegrator& integrator) {
+    const int totalCopies = positions.size();
+    vector<RealVec>& pos = extractPositions(context);
+    vector<RealVec>& vel = extractVelocities(context);
+    if (workerContexts.size() == 0)
+        createWorkerContexts(context, integrator);
+    
+    // Let the main Context update its state for each copy.  This must be done serially, since
+    // barostats and other Forces may modify the positions.
+    
+    for (int i = 0; i < totalCopies; i++) {
+        pos = positions[i];
+        vel = velocities[i];
+        context.computeVirtualSites();
+        Vec3 initialBox[3];
+        context.getPeriodicBoxVectors(initialBox[0], initialBox[1], initialBox[2]);
+        context.updateContextState();
+        Vec3 finalBox[3];
+        context.getPeriodicBoxVectors(finalBox[0], finalBox[1], finalBox[2]);
+        if (initialBox[0] != finalBox[0] || initialBox[1] != finalBox[1] || initialBox[2] != finalBox[2])
+            throw OpenMMException("Standard barostats cannot be used with RPMDIntegrator.  Use RPMDMonteCarloBarostat instead.");
+        positions[i] = pos;
+        velocities[i] = vel;
+    }
+
+    // Copy the periodic box and parameters to the workers.
+
+    Vec3 box[3];
+    context.getPeriodicBoxVectors(box[0], box[1], box[2]);
+    const map<string, double>& parameters = context.getParameters();
+    for (int i = 0; i < (int) workerContexts.size(); i++) {
+        workerContexts[i]->setPeriodicBoxVectors(box[0], box[1], box[2]);
+        for (map<string, double>::const_iterator iter = parameters.begin(); iter != parameters.end(); ++iter)
+            workerContexts[i]->setParameter(iter->first, iter->second);
+    }
+    
+    // Compute forces from all groups that didn't have a specified contraction.
+    
+    ComputeForcesTask task(*this, positions, forces, totalCopies, 0, groupsNotContracted, false);
+    data.threads.execute(task);
+    data.threads.waitForThreads();
+    if (task.hasError)
+        throw OpenMMException(task.errorMessage);
+    
+    // Now loop over contractions and compute forces from them.
+    
+    for (map<int, int>::const_iterator iter = groupsByCopies.begin(); iter != groupsByCopies.end(); ++iter) {
+        int copies = iter->first;
+        int groupFlags = iter->second;
+        ContractPositionsTask contractTask(*this, copies);
+        data.threads.execute(contractTask);
+        data.threads.waitForThreads();
+        ComputeForcesTask forceTask(*this, contractedPositions, contractedForces, copies, firstContractionWorker[copies], groupFlags, true);
+        data.threads.execute(forceTask);
+        data.threads.waitForThreads();
+        if (forceTask.hasError)
+            throw OpenMMException(forceTask.errorMessage);
+        ContractForcesTask forceContractTask(*this, copies);
+        data.threads.execute(forceContractTask);
+        data.threads.waitForThreads();
+    }
+}
+
+void CpuIntegrateRPMDStepKernel::computeCopyForces(int threadIndex, Context& workerContext, vector<RealVec>& copyPositions, vector<RealVec>& copyForces,
+            int groups, bool computeVirtualSites) {
+    vector<Vec3>& pos = threadPositions[threadIndex];
+    int numParticles = masses.size();
+    for (int i = 0; i < numParticles; i++)
+        pos[i] = Vec3(copyPositions[i][0], copyPositions[i][1], copyPositions[i][2]);
+    workerContext.setPositions(pos);
+    if (computeVirtualSites)
+        workerContext.computeVirtualSites();
+    State state = workerContext.getState(State::Forces, false, groups);
+    const vector<Vec3>& f = state.getForces();
+    for (int i = 0; i < numParticles; i++)
+        copyForces[i] = RealVec(f[i][0], f[i][1], f[i][2]);
+}
+
+void CpuIntegrateRPMDStepKernel::contractPositions(int start, int end, int threadIndex, int copies) {
+    // Transform to the frequency domain, set high frequency components to zero, and transform back.
+
+    const int totalCopies = positions.size();
+    const RealOpenMM scale = 1.0/totalCopies;
+    fftpack* fft = threadFFT[threadIndex];
+    fftpack* shortFFT = threadContractionFFT[copies][threadIndex];
+    vector<t_complex>& q = threadQ[threadIndex];
+    for (int particle = start; particle < end; particle++) {
+        for (int component = 0; component < 3; component++) {
+            for (int k = 0; k < totalCopies; k++)
+                q[k] = t_complex(positions[k][particle][component], 0.0);
+            fftpack_exec_1d(fft, FFTPACK_FORWARD, &q[0], &q[0]);
+            if (copies > 1) {
+                int start = (copies+1)/2;
+                int end = totalCopies-copies+start;
+                for (int k = end; k < totalCopies; k++)
+                    q[k-(totalCopies-copies)] = q[k];
+                fftpack_exec_1d(shortFFT, FFTPACK_BACKWARD, &q[0], &q[0]);
+            }
+            for (int k = 0; k < copies; k++)
+                contractedPositions[k][particle][component] = scale*q[k].re;
+        }
+    }
+}
+
+void CpuIntegrateRPMDStepKernel::contractForces(int start, int end, int threadIndex, int copies) {
+    // Transform to the frequency domain, pad with zeros, and transform back.
+
+    const int totalCopies = positions.size();
+    const RealOpenMM scale = 1.0/copies;
+    fftpack* fft = threadFFT[threadIndex];
+    fftpack* shortFFT = threadContractionFFT[copies][threadIndex];
+    vector<t_complex>& q = threadQ[threadIndex];
+    for (int particle = start; particle < end; particle++) {
+        for (int component = 0; component < 3; component++) {
+            for (int k = 0; k < copies; k++)
+                q[k] = t_complex(contractedForces[k][particle][component], 0.0);
+            if (copies > 1)
+                fftpack_exec_1d(shortFFT, FFTPACK_FORWARD, &q[0], &q[0]);
+            int start = (copies+1)/2;
+            int end = totalCopies-copies+start;
+            for (int k = end; k < totalCopies; k++)
+                q[k] = q[k-(totalCopies-copies)];
+            for (int k = start; k < end; k++)
+                q[k] = t_complex(0, 0);
+            fftpack_exec_1d(fft, FFTPACK_BACKWARD, &q[0], &q[0]);
+            for (int k = 0; k < totalCopies; k++)
+                forces[k][particle][component] += scale*q[k].re;
+        }
+    }
+}
+
+double CpuIntegrateRPMDStepKernel::computeKineticEnergy(ContextImpl& context, const RPMDIntegrator& integrator) {
+    int numParticles = masses.size();
+    vector<RealVec>& velData = extractVelocities(context);
+    double energy = 0.0;
+    for (int i = 0; i < numParticles; ++i) {
+        if (masses[i] > 0) {
+            RealVec v = velData[i];
+            energy += masses[i]*(v.dot(v));
+        }
+    }
+    return 0.5*energy;
+}
+
+void CpuIntegrateRPMDStepKernel::setPositions(int copy, const vector<Vec3>& pos) {
+    int numParticles = positions[copy].size();
+    for (int i = 0; i < numParticles; i++)
+        positions[copy][i] = pos[i];
+}
+
+void CpuIntegrateRPMDStepKernel::setVelocities(int copy, const vector<Vec3>& vel) {
+    int numParticles = velocities[copy].size();
+    for (int i = 0; i < numParticles; i++)
+        velocities[copy][i] = vel[i];
+}
+
+void CpuIntegrateRPMDStepKernel::copyToContext(int copy, ContextImpl& context) {
+    extractPositions(context) = positions[copy];
+    extractVelocities(context) = velocities[copy];
+}
@@ -0,0 +1,127 @@
+#ifndef CPU_RPMD_KERNELS_H_
+#define CPU_RPMD_KERNELS_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "CpuPlatform.h"
+#include "openmm/Context.h"
+#include "openmm/RpmdKernels.h"
+#include "RealVec.h"
+#include "fftpack.h"
+
+namespace OpenMM {
+
+/**
+ * This kernel is invoked by RPMDIntegrator to take one time step.  The ring polymer is propagated
+ * in blocks of particles on the CPU platform's ThreadPool, and the forces on different copies of
+ * the system are computed in parallel.  Every copy, and every copy of each contraction, has a Context
+ * of its own for computing forces, so neighbor lists and other cached data remain valid from one step
+ * to the next.
+ */
+class CpuIntegrateRPMDStepKernel : public IntegrateRPMDStepKernel {
+public:
+    class FirstHalfStepTask;
+    class SecondHalfStepTask;
+    class ComputeForcesTask;
+    class ContractPositionsTask;
+    class ContractForcesTask;
+    CpuIntegrateRPMDStepKernel(std::string name, const Platform& platform, CpuPlatform::PlatformData& data) :
+            IntegrateRPMDStepKernel(name, platform), data(data) {
+    }
+    ~CpuIntegrateRPMDStepKernel();
+    /**
+     * Initialize the kernel.
+     *
+     * @param system     the System this kernel will be applied to
+     * @param integrator the RPMDIntegrator this kernel will be used for
+     */
+    void initialize(const System& system, const RPMDIntegrator& integrator);
+    /**
+     * Execute the kernel.
+     *
+     * @param context        the context in which to execute this kernel
+     * @param integrator     the RPMDIntegrator this kernel is being used for
+     * @param forcesAreValid if the context has been modified since the last time step, this will be
+     *                       false to show that cached forces are invalid and must be recalculated
+     */
+    void execute(ContextImpl& context, const RPMDIntegrator& integrator, bool forcesAreValid);
+    /**
+     * Compute the kinetic energy.
+     * 
+     * @param context    the context in which to execute this kernel
+     * @param integrator     the RPMDIntegrator this kernel is being used for
+     */
+    double computeKineticEnergy(ContextImpl& context, const RPMDIntegrator& integrator);
+    /**
+     * Get the positions of all particles in one copy of the system.
+     */
+    void setPositions(int copy, const std::vector<Vec3>& positions);
+    /**
+     * Get the velocities of all particles in one copy of the system.
+     */
+    void setVelocities(int copy, const std::vector<Vec3>& velocities);
+    /**
+     * Copy positions and velocities for one copy into the context.
+     */
+    void copyToContext(int copy, ContextImpl& context);
+private:
+    void createWorkerContexts(ContextImpl& context, const RPMDIntegrator& integrator);
+    void computeForces(ContextImpl& context, const RPMDIntegrator& integrator);
+    void applyThermostat(int start, int end, int threadIndex);
+    void updateVelocities(int start, int end);
+    void evolveFreeRingPolymer(int start, int end, int threadIndex);
+    void contractPositions(int start, int end, int threadIndex, int copies);
+    void contractForces(int start, int end, int threadIndex, int copies);
+    void computeCopyForces(int threadIndex, Context& workerContext, std::vector<RealVec>& copyPositions, std::vector<RealVec>& copyForces,
+            int groups, bool computeVirtualSites);
+    CpuPlatform::PlatformData& data;
+    std::vector<std::vector<RealVec> > positions;
+    std::vector<std::vector<RealVec> > velocities;
+    std::vector<std::vector<RealVec> > forces;
+    std::vector<std::vector<RealVec> > contractedPositions;
+    std::vector<std::vector<RealVec> > contractedForces;
+    std::vector<RealOpenMM> masses;
+    std::map<int, int> groupsByCopies;
+    int groupsNotContracted;
+    RealOpenMM stepSize, temperature, friction;
+    std::vector<fftpack*> threadFFT;
+    std::map<int, std::vector<fftpack*> > threadContractionFFT;
+    std::vector<std::vector<t_complex> > threadQ, threadV;
+    std::vector<Context*> workerContexts;
+    std::vector<Integrator*> workerIntegrators;
+    std::map<int, int> firstContractionWorker;
+    std::vector<std::vector<Vec3> > threadPositions;
+};
+
+} // namespace OpenMM
+
+#endif /*CPU_RPMD_KERNELS_H_*/
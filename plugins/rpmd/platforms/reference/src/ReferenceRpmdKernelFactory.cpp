@@ -38,7 +38,11 @@ extern "C" OPENMM_EXPORT void registerPlatforms() {
 extern "C" OPENMM_EXPORT void registerKernelFactories() {
     for (int i = 0; i < Platform::getNumPlatforms(); i++) {
         Platform& platform = Platform::getPlatform(i);
-        if (dynamic_cast<ReferencePlatform*>(&platform) != NULL) {
+        // Platforms derived from ReferencePlatform may provide their own implementation, which
+        // should not be replaced if its plugin happened to be loaded first.
+
+        if (dynamic_cast<ReferencePlatform*>(&platform) != NULL && (platform.getName() == "Reference" ||
+                !platform.supportsKernels(std::vector<std::string>(1, IntegrateRPMDStepKernel::Name())))) {
             ReferenceRpmdKernelFactory* factory = new ReferenceRpmdKernelFactory();
             platform.registerKernelFactory(IntegrateRPMDStepKernel::Name(), factory);
         }
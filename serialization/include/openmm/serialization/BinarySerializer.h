@@ -0,0 +1,102 @@
+#ifndef OPENMM_BINARY_SERIALIZER_H_
+#define OPENMM_BINARY_SERIALIZER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationProxy.h"
+#include "openmm/OpenMMException.h"
+#include "openmm/internal/windowsExport.h"
+#include <iosfwd>
+
+namespace OpenMM {
+
+/**
+ * BinarySerializer is used for serializing objects in a compact binary format, and for reconstructing
+ * them again.  It uses the same SerializationProxy objects as XmlSerializer, so any object that can be
+ * serialized as XML can also be serialized in binary.  Arrays of vectors (such as the positions,
+ * velocities, and forces in a State) are stored as raw blocks of little endian doubles rather than as
+ * formatted text, which makes them much faster to write and read, and considerably smaller.
+ *
+ * The format begins with a version number, and files written by one version of OpenMM can be read by
+ * later versions.  Binary files are not intended to be human readable or edited by hand.  Use
+ * XmlSerializer if you need that.
+ */
+
+class OPENMM_EXPORT BinarySerializer {
+public:
+    /**
+     * Serialize an object in binary format.
+     *
+     * @param object    the object to serialize
+     * @param rootName  the name to use for the root node
+     * @param stream    an output stream to write the data to.  It should be opened in binary mode.
+     */
+    template <class T>
+    static void serialize(const T* object, const std::string& rootName, std::ostream& stream) {
+        serializeObject(object, SerializationProxy::getProxy(typeid(*object)), rootName, stream);
+    }
+    /**
+     * Reconstruct an object that has been serialized in binary format.
+     *
+     * @param stream    an input stream to read the data from.  It should be opened in binary mode.
+     * @return a pointer to the newly created object.  The caller assumes ownership of the object.
+     */
+    template <class T>
+    static T* deserialize(std::istream& stream) {
+        return reinterpret_cast<T*>(deserializeStream(stream));
+    }
+    /**
+     * Reconstruct an object that has been serialized in binary format and saved to a file.  The file
+     * is memory mapped rather than read through a stream, so large arrays are copied directly from
+     * the file into the object being created.  This is the fastest way to load large States.
+     *
+     * @param filename  the path to the file to read
+     * @return a pointer to the newly created object.  The caller assumes ownership of the object.
+     */
+    template <class T>
+    static T* deserializeFile(const std::string& filename) {
+        return reinterpret_cast<T*>(deserializeMappedFile(filename));
+    }
+private:
+    class BinaryWriter;
+    class BinaryReader;
+    class MappedFile;
+    static void serializeObject(const void* object, const SerializationProxy& proxy, const std::string& rootName, std::ostream& stream);
+    static void* deserializeStream(std::istream& stream);
+    static void* deserializeMappedFile(const std::string& filename);
+    static void* deserializeObject(BinaryReader& reader);
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_BINARY_SERIALIZER_H_*/
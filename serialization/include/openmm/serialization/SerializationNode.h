@@ -62,6 +62,14 @@ namespace OpenMM {
  * property as a string.  Similarly, you can use setStringProperty() to specify a property and then access it
  * using getIntProperty().  This will produce the expected result if the original value was, in fact, the
  * string representation of an int, but if the original string was non-numeric, the result is undefined.
+ *
+ * A node can also store array properties, whose values are arrays of doubles or ints.  These are
+ * intended for per-particle and per-bond data, which can be stored far more compactly as a few arrays
+ * than as one child node per item.  When an array property is written to XML, it appears as an attribute
+ * whose value is a whitespace separated list of numbers.  It is therefore also possible to call
+ * getDoubleArrayProperty() or getIntArrayProperty() on a string property containing such a list, which is
+ * what happens when a node is read back from XML.  Setting a property of any type replaces an existing
+ * property with the same name, even if it had a different type.
  */
 
 class OPENMM_EXPORT SerializationNode {
@@ -103,7 +111,15 @@ public:
      */
     const std::map<std::string, std::string>& getProperties() const;
     /**
-     * Determine whether this node has a property with a particular node.
+     * Get a map containing all of this node's array properties whose values are arrays of doubles.
+     */
+    const std::map<std::string, std::vector<double> >& getDoubleArrayProperties() const;
+    /**
+     * Get a map containing all of this node's array properties whose values are arrays of ints.
+     */
+    const std::map<std::string, std::vector<int> >& getIntArrayProperties() const;
+    /**
+     * Determine whether this node has a property (of any type, including arrays) with a particular name.
      *
      * @param the name of the property to check for
      */
@@ -196,6 +212,34 @@ public:
      * @param value  the value to set for the property
      */
     SerializationNode& setDoubleProperty(const std::string& name, double value);
+    /**
+     * Get the property with a particular name, specified as an array of doubles.  If there is no property
+     * with the specified name, an exception is thrown.
+     *
+     * @param name   the name of the property to get
+     */
+    std::vector<double> getDoubleArrayProperty(const std::string& name) const;
+    /**
+     * Set the value of a property, specified as an array of doubles.
+     *
+     * @param name   the name of the property to set
+     * @param value  the value to set for the property
+     */
+    SerializationNode& setDoubleArrayProperty(const std::string& name, const std::vector<double>& value);
+    /**
+     * Get the property with a particular name, specified as an array of ints.  If there is no property
+     * with the specified name, an exception is thrown.
+     *
+     * @param name   the name of the property to get
+     */
+    std::vector<int> getIntArrayProperty(const std::string& name) const;
+    /**
+     * Set the value of a property, specified as an array of ints.
+     *
+     * @param name   the name of the property to set
+     * @param value  the value to set for the property
+     */
+    SerializationNode& setIntArrayProperty(const std::string& name, const std::vector<int>& value);
     /**
      * Create a new child node
      *
@@ -244,6 +288,8 @@ private:
     std::string name;
     std::vector<SerializationNode> children;
     std::map<std::string, std::string> properties;
+    std::map<std::string, std::vector<double> > doubleArrayProperties;
+    std::map<std::string, std::vector<int> > intArrayProperties;
 };
 
 } // namespace OpenMM
@@ -40,6 +40,8 @@
 namespace OpenMM {
 
 class SerializationNode;
+class SerializationReader;
+class SerializationWriter;
 
 /**
  * A SerializationProxy is an object that knows how to serialize and deserialize objects of a
@@ -84,6 +86,33 @@ public:
      * of the object.
      */
     virtual void* deserialize(const SerializationNode& node) const = 0;
+    /**
+     * Serialize an object incrementally to a SerializationWriter.  Subclasses for types that can be
+     * very large override this to write their data a piece at a time, rather than building a complete
+     * SerializationNode tree in memory.  The default implementation calls serialize() and writes the
+     * resulting tree.
+     *
+     * @param object      a pointer to the object being serialized
+     * @param node        on entry, this holds the name of the node to write (and possibly some properties).
+     *                    The object's properties should be added to it, and it should then be passed to
+     *                    writer.beginNode().  The object's children are then written, followed by a call
+     *                    to writer.endNode().
+     * @param writer      the SerializationWriter to write to
+     */
+    virtual void serializeStream(const void* object, SerializationNode& node, SerializationWriter& writer) const;
+    /**
+     * Reconstruct an object by reading it incrementally from a SerializationReader.  Subclasses for types
+     * that can be very large override this to process their data a piece at a time.  The default
+     * implementation reads the remaining children into memory and calls deserialize().
+     *
+     * @param node    the name and properties of the node describing the object.  Its children have not
+     *                been read yet.
+     * @param reader  the SerializationReader to read the object's children from.  The node describing
+     *                the object is its current node.  The caller will call endNode() after this returns.
+     * @return a pointer to a new object created from the data.  The caller assumes ownership
+     * of the object.
+     */
+    virtual void* deserializeStream(const SerializationNode& node, SerializationReader& reader) const;
     /**
      * Register a SerializationProxy to be used for objects of a particular type.
      *
@@ -0,0 +1,111 @@
+#ifndef OPENMM_SERIALIZATIONREADER_H_
+#define OPENMM_SERIALIZATIONREADER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/Vec3.h"
+#include "openmm/internal/windowsExport.h"
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * A SerializationReader decodes serialized data from an input stream one node at a time, rather than
+ * first building a complete tree of SerializationNodes.  This allows very large objects to be
+ * deserialized with a bounded amount of memory.
+ *
+ * The reader always has a current node (initially the document itself, whose only child is the root
+ * node).  beginNode() reads the next child of the current node and makes it the current node.  Its name
+ * and properties are available immediately, and its children can then be read in turn.  endNode() skips
+ * over any children that have not been read and makes the parent the current node again.  Small subtrees
+ * can be read into memory in a single call with readNode().  This is an abstract class.  Subclasses
+ * implement particular encodings.
+ */
+
+class OPENMM_EXPORT SerializationReader {
+public:
+    virtual ~SerializationReader() {
+    }
+    /**
+     * Begin reading the next child of the current node, and make it the current node.
+     *
+     * @param node    on exit, this contains the name and properties of the child node.  Any previous
+     *                content is discarded.  Its children are not read.
+     * @return true if a child was read, or false if the current node has no more children.  In that case
+     * the current node is unchanged, and endNode() should be called to finish it.
+     */
+    virtual bool beginNode(SerializationNode& node) = 0;
+    /**
+     * Finish reading the current node, skipping any children that have not yet been read, and make its
+     * parent the current node.
+     */
+    virtual void endNode() = 0;
+    /**
+     * Read the next child of the current node, including all of its descendants.
+     *
+     * @param node    on exit, this contains the child node.  Any previous content is discarded.
+     * @return true if a child was read, or false if the current node has no more children
+     */
+    bool readNode(SerializationNode& node);
+    /**
+     * Read all remaining children of the current node (including their descendants), and add them to a
+     * SerializationNode.
+     *
+     * @param node    the children are appended to this node's list of children
+     */
+    void readChildren(SerializationNode& node);
+    /**
+     * Read the remaining elements of an array written by SerializationWriter::writeVectors().  The array
+     * must be the current node.  Subclasses that override writeVectors() must override this to match.
+     *
+     * @param values    the vectors are appended to this
+     */
+    virtual void readVectors(std::vector<Vec3>& values);
+    /**
+     * Read the next child of the current node, which should describe an object written by
+     * SerializationWriter::writeObject(), and reconstruct the object.
+     *
+     * @return a pointer to the newly created object, or NULL if the current node has no more children.
+     * The caller assumes ownership of the object.
+     */
+    template<class T>
+    T* readObject() {
+        return reinterpret_cast<T*>(readUntypedObject());
+    }
+private:
+    void* readUntypedObject();
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_SERIALIZATIONREADER_H_*/
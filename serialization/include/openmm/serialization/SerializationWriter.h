@@ -0,0 +1,108 @@
+#ifndef OPENMM_SERIALIZATIONWRITER_H_
+#define OPENMM_SERIALIZATIONWRITER_H_
+
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationProxy.h"
+#include "openmm/Vec3.h"
+#include "openmm/internal/windowsExport.h"
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace OpenMM {
+
+/**
+ * A SerializationWriter receives serialized data one node at a time and encodes it to an output
+ * stream as it goes, rather than first building a complete tree of SerializationNodes.  This allows
+ * very large objects to be serialized with a bounded amount of memory.
+ *
+ * Nodes are written by calling beginNode() to open a node, writing its children, and then calling
+ * endNode() to close it.  Small subtrees that have already been built in memory can be written in a
+ * single call with writeNode().  This is an abstract class.  Subclasses implement particular encodings.
+ */
+
+class OPENMM_EXPORT SerializationWriter {
+public:
+    virtual ~SerializationWriter() {
+    }
+    /**
+     * Begin writing a new node.  It becomes a child of the node that is currently open, and any nodes
+     * written until the matching call to endNode() become its children.
+     *
+     * @param node    the name and properties of the node to write.  Any children it has are ignored.
+     */
+    virtual void beginNode(const SerializationNode& node) = 0;
+    /**
+     * Finish writing the node most recently opened by beginNode().
+     */
+    virtual void endNode() = 0;
+    /**
+     * Write a complete node, including all of its children.
+     */
+    void writeNode(const SerializationNode& node);
+    /**
+     * Write an array of vectors (such as positions or velocities).  By default this writes a node with
+     * one child per element, each having properties "x", "y", and "z".  Subclasses may override it to
+     * use a more compact encoding.  The array should be read back with SerializationReader::readVectors().
+     *
+     * @param arrayName    the name of the node containing the array
+     * @param elementName  the name of the node for each element
+     * @param values       the vectors to write
+     */
+    virtual void writeVectors(const std::string& arrayName, const std::string& elementName, const std::vector<Vec3>& values);
+    /**
+     * Write a node describing an object.  This is the streaming equivalent of SerializationNode::createChildNode().
+     * The object's SerializationProxy is used to write it, and it is recorded so that it can be recreated by
+     * SerializationReader::readObject().
+     *
+     * @param name    the name of the node to write
+     * @param object  the object to serialize
+     */
+    template <class T>
+    void writeObject(const std::string& name, const T* object) {
+        writeObject(name, object, SerializationProxy::getProxy(typeid(*object)));
+    }
+    /**
+     * Write a node describing an object, using a specified SerializationProxy.
+     *
+     * @param name    the name of the node to write
+     * @param object  the object to serialize
+     * @param proxy   the proxy to use for serializing it
+     */
+    void writeObject(const std::string& name, const void* object, const SerializationProxy& proxy);
+};
+
+} // namespace OpenMM
+
+#endif /*OPENMM_SERIALIZATIONWRITER_H_*/
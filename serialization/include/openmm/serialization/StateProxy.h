@@ -10,6 +10,8 @@ public:
     StateProxy();
     void serialize(const void* object, SerializationNode& node) const;
     void* deserialize(const SerializationNode& node) const;
+    void serializeStream(const void* object, SerializationNode& node, SerializationWriter& writer) const;
+    void* deserializeStream(const SerializationNode& node, SerializationReader& reader) const;
 };
 
 }
@@ -42,6 +42,10 @@ namespace OpenMM {
 
 /**
  * XmlSerializer is used for serializing objects as XML, and for reconstructing them again.
+ *
+ * Objects are written and read incrementally through a SerializationWriter and SerializationReader,
+ * so proxies that support streaming (such as the ones for System, NonbondedForce, and State) never
+ * need to hold a complete SerializationNode tree for the object in memory.
  */
 
 class OPENMM_EXPORT XmlSerializer {
@@ -55,14 +59,7 @@ public:
      */
     template <class T>
     static void serialize(const T* object, const std::string& rootName, std::ostream& stream) {
-        const SerializationProxy& proxy = SerializationProxy::getProxy(typeid(*object));
-        SerializationNode node;
-        node.setName(rootName);
-        proxy.serialize(object, node);
-        if (node.hasProperty("type"))
-            throw OpenMMException(proxy.getTypeName()+" created node with reserved property 'type'");
-        node.setStringProperty("type", proxy.getTypeName());
-        serialize(node, stream);
+        serializeObject(object, SerializationProxy::getProxy(typeid(*object)), rootName, stream);
     }
     /**
      * Reconstruct an object that has been serialized as XML.
@@ -75,10 +72,10 @@ public:
         return reinterpret_cast<T*>(deserializeStream(stream));
     }
 private:
-    class StreamReader;
-    static void serialize(const SerializationNode& node, std::ostream& stream);
+    class XmlWriter;
+    class XmlReader;
+    static void serializeObject(const void* object, const SerializationProxy& proxy, const std::string& rootName, std::ostream& stream);
     static void* deserializeStream(std::istream& stream);
-    static void encodeNode(const SerializationNode& node, std::ostream& stream, int depth);
 };
 
 } // namespace OpenMM
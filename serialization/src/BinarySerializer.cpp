@@ -0,0 +1,451 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/BinarySerializer.h"
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace OpenMM;
+using namespace std;
+
+/**
+ * The file begins with these eight bytes, followed by the format version as a 32 bit integer.
+ * After that comes a sequence of records, each starting with one of the tags below.
+ */
+static const char MagicNumber[] = {'O', 'p', 'e', 'n', 'M', 'M', 'B', 'N'};
+static const int FormatVersion = 2;
+static const char BeginNodeTag = 'N';
+static const char EndNodeTag = 'E';
+static const char VectorArrayTag = 'V';
+
+/**
+ * Vectors are read and written in blocks of this many elements.
+ */
+static const int VectorBlockSize = 65536;
+
+static bool isLittleEndian() {
+    int one = 1;
+    return (*reinterpret_cast<char*>(&one) == 1);
+}
+
+static void swapBytes(char* data, int size) {
+    for (int i = 0; i < size/2; i++)
+        swap(data[i], data[size-1-i]);
+}
+
+/**
+ * This class writes nodes to a binary stream as they are received.  Integers and doubles are always
+ * stored in little endian order, regardless of the native byte order.
+ */
+class BinarySerializer::BinaryWriter : public SerializationWriter {
+public:
+    BinaryWriter(ostream& stream) : stream(stream), littleEndian(isLittleEndian()) {
+    }
+    void writeHeader() {
+        stream.write(MagicNumber, sizeof(MagicNumber));
+        writeInt(FormatVersion);
+    }
+    void beginNode(const SerializationNode& node) {
+        stream.put(BeginNodeTag);
+        writeString(node.getName());
+        const map<string, string>& properties = node.getProperties();
+        writeInt(properties.size());
+        for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter) {
+            writeString(iter->first);
+            writeString(iter->second);
+        }
+        const map<string, vector<double> >& doubleArrays = node.getDoubleArrayProperties();
+        writeInt(doubleArrays.size());
+        for (map<string, vector<double> >::const_iterator iter = doubleArrays.begin(); iter != doubleArrays.end(); ++iter) {
+            writeString(iter->first);
+            writeLong(iter->second.size());
+            if (iter->second.size() > 0)
+                writeDoubles(&iter->second[0], iter->second.size());
+        }
+        const map<string, vector<int> >& intArrays = node.getIntArrayProperties();
+        writeInt(intArrays.size());
+        for (map<string, vector<int> >::const_iterator iter = intArrays.begin(); iter != intArrays.end(); ++iter) {
+            writeString(iter->first);
+            writeLong(iter->second.size());
+            for (int i = 0; i < (int) iter->second.size(); i++)
+                writeInt(iter->second[i]);
+        }
+    }
+    void endNode() {
+        stream.put(EndNodeTag);
+    }
+    void writeVectors(const string& arrayName, const string& elementName, const vector<Vec3>& values) {
+        stream.put(VectorArrayTag);
+        writeString(arrayName);
+        writeString(elementName);
+        writeLong(values.size());
+        if (values.size() > 0)
+            writeDoubles(reinterpret_cast<const double*>(&values[0]), 3*values.size());
+    }
+private:
+    void writeInt(unsigned int value) {
+        char bytes[4];
+        for (int i = 0; i < 4; i++)
+            bytes[i] = (char) ((value>>(8*i))&0xFF);
+        stream.write(bytes, 4);
+    }
+    void writeLong(unsigned long long value) {
+        char bytes[8];
+        for (int i = 0; i < 8; i++)
+            bytes[i] = (char) ((value>>(8*i))&0xFF);
+        stream.write(bytes, 8);
+    }
+    void writeString(const string& value) {
+        writeInt(value.size());
+        stream.write(value.c_str(), value.size());
+    }
+    void writeDoubles(const double* values, size_t count) {
+        if (littleEndian) {
+            stream.write(reinterpret_cast<const char*>(values), count*sizeof(double));
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            double value = values[i];
+            char* bytes = reinterpret_cast<char*>(&value);
+            swapBytes(bytes, sizeof(double));
+            stream.write(bytes, sizeof(double));
+        }
+    }
+    ostream& stream;
+    bool littleEndian;
+};
+
+/**
+ * This class decodes nodes from binary data, either reading them from a stream or taking them from
+ * a block of memory (such as a memory mapped file).  Arrays of vectors appear to be ordinary nodes
+ * with one child per element, but readVectors() copies them directly into place.
+ */
+class BinarySerializer::BinaryReader : public SerializationReader {
+public:
+    BinaryReader(istream& stream) : stream(&stream), data(NULL), size(0), position(0), version(0), currentEnded(false), littleEndian(isLittleEndian()) {
+    }
+    BinaryReader(const char* data, size_t size) : stream(NULL), data(data), size(size), position(0), version(0), currentEnded(false), littleEndian(isLittleEndian()) {
+    }
+    void readHeader() {
+        char magic[sizeof(MagicNumber)];
+        if (!tryRead(magic, sizeof(magic)) || memcmp(magic, MagicNumber, sizeof(magic)) != 0)
+            throw OpenMMException("The data is not in OpenMM's binary serialization format");
+        version = readInt();
+        if (version < 1 || version > FormatVersion)
+            throw OpenMMException("Unsupported binary serialization version");
+    }
+    bool beginNode(SerializationNode& node) {
+        if (currentEnded)
+            return false;
+        if (frames.size() > 0 && frames.back().isArray) {
+            // Return the next element of the array as a node.
+
+            Frame& array = frames.back();
+            if (array.remaining == 0) {
+                currentEnded = true;
+                return false;
+            }
+            double xyz[3];
+            readDoubles(xyz, 3);
+            array.remaining--;
+            node = SerializationNode();
+            node.setName(array.elementName);
+            node.setDoubleProperty("x", xyz[0]).setDoubleProperty("y", xyz[1]).setDoubleProperty("z", xyz[2]);
+            frames.push_back(Frame());
+            currentEnded = true;
+            return true;
+        }
+        char tag;
+        if (!tryRead(&tag, 1)) {
+            if (frames.size() == 0)
+                return false;
+            throw OpenMMException("Unexpected end of binary data");
+        }
+        if (tag == EndNodeTag) {
+            if (frames.size() == 0)
+                throw OpenMMException("Illegal record in binary data");
+            currentEnded = true;
+            return false;
+        }
+        node = SerializationNode();
+        node.setName(readString());
+        Frame frame;
+        if (tag == BeginNodeTag) {
+            int numProperties = readInt();
+            for (int i = 0; i < numProperties; i++) {
+                string name = readString();
+                node.setStringProperty(name, readString());
+            }
+            if (version > 1) {
+                int numDoubleArrays = readInt();
+                for (int i = 0; i < numDoubleArrays; i++) {
+                    string name = readString();
+                    vector<double> values(checkArrayLength(readLong(), sizeof(double)));
+                    if (values.size() > 0)
+                        readDoubles(&values[0], values.size());
+                    node.setDoubleArrayProperty(name, values);
+                }
+                int numIntArrays = readInt();
+                for (int i = 0; i < numIntArrays; i++) {
+                    string name = readString();
+                    vector<int> values(checkArrayLength(readLong(), 4));
+                    for (int j = 0; j < (int) values.size(); j++)
+                        values[j] = (int) readInt();
+                    node.setIntArrayProperty(name, values);
+                }
+            }
+        }
+        else if (tag == VectorArrayTag) {
+            frame.isArray = true;
+            frame.elementName = readString();
+            frame.remaining = readLong();
+        }
+        else
+            throw OpenMMException("Illegal record in binary data");
+        frames.push_back(frame);
+        return true;
+    }
+    void endNode() {
+        if (frames.size() == 0)
+            throw OpenMMException("endNode() called without a matching beginNode()");
+        if (frames.back().isArray) {
+            skip(frames.back().remaining*3*sizeof(double));
+            currentEnded = true;
+        }
+        SerializationNode child;
+        while (!currentEnded)
+            if (beginNode(child))
+                endNode();
+        frames.pop_back();
+        currentEnded = false;
+    }
+    void readVectors(vector<Vec3>& values) {
+        if (frames.size() == 0 || !frames.back().isArray || currentEnded) {
+            SerializationReader::readVectors(values);
+            return;
+        }
+        Frame& array = frames.back();
+        while (array.remaining > 0) {
+            size_t count = (size_t) min(array.remaining, (unsigned long long) VectorBlockSize);
+            size_t start = values.size();
+            values.resize(start+count);
+            readDoubles(&values[start][0], 3*count);
+            array.remaining -= count;
+        }
+        currentEnded = true;
+    }
+private:
+    struct Frame {
+        Frame() : isArray(false), remaining(0) {
+        }
+        bool isArray;
+        unsigned long long remaining;
+        string elementName;
+    };
+    bool tryRead(char* dest, size_t bytes) {
+        if (stream != NULL) {
+            stream->read(dest, bytes);
+            return ((size_t) stream->gcount() == bytes);
+        }
+        if (bytes > size-position)
+            return false;
+        memcpy(dest, data+position, bytes);
+        position += bytes;
+        return true;
+    }
+    void read(char* dest, size_t bytes) {
+        if (!tryRead(dest, bytes))
+            throw OpenMMException("Unexpected end of binary data");
+    }
+    void skip(unsigned long long bytes) {
+        if (stream != NULL) {
+            stream->ignore(bytes);
+            if ((unsigned long long) stream->gcount() != bytes)
+                throw OpenMMException("Unexpected end of binary data");
+        }
+        else {
+            if (bytes > size-position)
+                throw OpenMMException("Unexpected end of binary data");
+            position += bytes;
+        }
+    }
+    unsigned int readInt() {
+        unsigned char bytes[4];
+        read(reinterpret_cast<char*>(bytes), 4);
+        unsigned int value = 0;
+        for (int i = 0; i < 4; i++)
+            value |= ((unsigned int) bytes[i])<<(8*i);
+        return value;
+    }
+    unsigned long long readLong() {
+        unsigned char bytes[8];
+        read(reinterpret_cast<char*>(bytes), 8);
+        unsigned long long value = 0;
+        for (int i = 0; i < 8; i++)
+            value |= ((unsigned long long) bytes[i])<<(8*i);
+        return value;
+    }
+    /**
+     * When reading from memory, verify that an array of the specified length fits in the remaining data
+     * before allocating space for it.
+     */
+    size_t checkArrayLength(unsigned long long length, size_t elementSize) {
+        if (stream == NULL && length > (size-position)/elementSize)
+            throw OpenMMException("Unexpected end of binary data");
+        return (size_t) length;
+    }
+    string readString() {
+        unsigned int length = readInt();
+        if (stream == NULL && length > size-position)
+            throw OpenMMException("Unexpected end of binary data");
+        string value(length, ' ');
+        if (length > 0)
+            read(&value[0], length);
+        return value;
+    }
+    void readDoubles(double* dest, size_t count) {
+        read(reinterpret_cast<char*>(dest), count*sizeof(double));
+        if (!littleEndian)
+            for (size_t i = 0; i < count; i++)
+                swapBytes(reinterpret_cast<char*>(&dest[i]), sizeof(double));
+    }
+    istream* stream;
+    const char* data;
+    size_t size, position;
+    int version;
+    vector<Frame> frames;
+    bool currentEnded, littleEndian;
+};
+
+/**
+ * This class maps a file into memory for reading, and unmaps it when it is deleted.
+ */
+class BinarySerializer::MappedFile {
+public:
+    MappedFile(const string& filename) : data(NULL), size(0) {
+#ifdef WIN32
+        file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            throw OpenMMException("Failed to open file: "+filename);
+        mapping = NULL;
+        LARGE_INTEGER fileSize;
+        if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+            mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (mapping != NULL)
+                data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (data == NULL) {
+                if (mapping != NULL)
+                    CloseHandle(mapping);
+                CloseHandle(file);
+                throw OpenMMException("Failed to map file: "+filename);
+            }
+            size = (size_t) fileSize.QuadPart;
+        }
+#else
+        file = open(filename.c_str(), O_RDONLY);
+        if (file == -1)
+            throw OpenMMException("Failed to open file: "+filename);
+        struct stat status;
+        if (fstat(file, &status) == 0 && status.st_size > 0) {
+            data = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (data == MAP_FAILED) {
+                close(file);
+                throw OpenMMException("Failed to map file: "+filename);
+            }
+            size = status.st_size;
+        }
+#endif
+    }
+    ~MappedFile() {
+#ifdef WIN32
+        if (data != NULL)
+            UnmapViewOfFile(data);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        CloseHandle(file);
+#else
+        if (data != NULL)
+            munmap(data, size);
+        close(file);
+#endif
+    }
+    const char* getData() const {
+        return reinterpret_cast<const char*>(data);
+    }
+    size_t getSize() const {
+        return size;
+    }
+private:
+#ifdef WIN32
+    HANDLE file, mapping;
+#else
+    int file;
+#endif
+    void* data;
+    size_t size;
+};
+
+void BinarySerializer::serializeObject(const void* object, const SerializationProxy& proxy, const std::string& rootName, std::ostream& stream) {
+    BinaryWriter writer(stream);
+    writer.writeHeader();
+    writer.writeObject(rootName, object, proxy);
+}
+
+void* BinarySerializer::deserializeStream(std::istream& stream) {
+    BinaryReader reader(stream);
+    return deserializeObject(reader);
+}
+
+void* BinarySerializer::deserializeMappedFile(const std::string& filename) {
+    MappedFile file(filename);
+    BinaryReader reader(file.getData(), file.getSize());
+    return deserializeObject(reader);
+}
+
+void* BinarySerializer::deserializeObject(BinaryReader& reader) {
+    reader.readHeader();
+    void* object = reader.readObject<void>();
+    if (object == NULL)
+        throw OpenMMException("The binary data does not contain any object");
+    return object;
+}
@@ -42,7 +42,7 @@ GBSAOBCForceProxy::GBSAOBCForceProxy() : SerializationProxy("GBSAOBCForce") {
 }
 
 void GBSAOBCForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 2);
+    node.setIntProperty("version", 3);
     const GBSAOBCForce& force = *reinterpret_cast<const GBSAOBCForce*>(object);
     node.setIntProperty("forceGroup", force.getForceGroup());
     node.setIntProperty("method", (int) force.getNonbondedMethod());
@@ -50,17 +50,16 @@ void GBSAOBCForceProxy::serialize(const void* object, SerializationNode& node) c
     node.setDoubleProperty("soluteDielectric", force.getSoluteDielectric());
     node.setDoubleProperty("solventDielectric", force.getSolventDielectric());
     node.setDoubleProperty("surfaceAreaEnergy", force.getSurfaceAreaEnergy());
-    SerializationNode& particles = node.createChildNode("Particles");
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge, radius, scale;
-        force.getParticleParameters(i, charge, radius, scale);
-        particles.createChildNode("Particle").setDoubleProperty("q", charge).setDoubleProperty("r", radius).setDoubleProperty("scale", scale);
-    }
+    int numParticles = force.getNumParticles();
+    vector<double> charge(numParticles), radius(numParticles), scale(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        force.getParticleParameters(i, charge[i], radius[i], scale[i]);
+    node.createChildNode("Particles").setDoubleArrayProperty("q", charge).setDoubleArrayProperty("r", radius).setDoubleArrayProperty("scale", scale);
 }
 
 void* GBSAOBCForceProxy::deserialize(const SerializationNode& node) const {
     int version = node.getIntProperty("version");
-    if (version < 1 || version > 2)
+    if (version < 1 || version > 3)
         throw OpenMMException("Unsupported version number");
     GBSAOBCForce* force = new GBSAOBCForce();
     try {
@@ -72,9 +71,20 @@ void* GBSAOBCForceProxy::deserialize(const SerializationNode& node) const {
         if (version > 1)
             force->setSurfaceAreaEnergy(node.getDoubleProperty("surfaceAreaEnergy"));
         const SerializationNode& particles = node.getChildNode("Particles");
-        for (int i = 0; i < (int) particles.getChildren().size(); i++) {
-            const SerializationNode& particle = particles.getChildren()[i];
-            force->addParticle(particle.getDoubleProperty("q"), particle.getDoubleProperty("r"), particle.getDoubleProperty("scale"));
+        if (version < 3) {
+            for (int i = 0; i < (int) particles.getChildren().size(); i++) {
+                const SerializationNode& particle = particles.getChildren()[i];
+                force->addParticle(particle.getDoubleProperty("q"), particle.getDoubleProperty("r"), particle.getDoubleProperty("scale"));
+            }
+        }
+        else {
+            vector<double> charge = particles.getDoubleArrayProperty("q");
+            vector<double> radius = particles.getDoubleArrayProperty("r");
+            vector<double> scale = particles.getDoubleArrayProperty("scale");
+            if (radius.size() != charge.size() || scale.size() != charge.size())
+                throw OpenMMException("GBSAOBCForce: particle arrays have different lengths");
+            for (int i = 0; i < (int) charge.size(); i++)
+                force->addParticle(charge[i], radius[i], scale[i]);
         }
     }
     catch (...) {
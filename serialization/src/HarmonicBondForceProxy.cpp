@@ -42,28 +42,40 @@ HarmonicBondForceProxy::HarmonicBondForceProxy() : SerializationProxy("HarmonicB
 }
 
 void HarmonicBondForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 1);
+    node.setIntProperty("version", 2);
     const HarmonicBondForce& force = *reinterpret_cast<const HarmonicBondForce*>(object);
     node.setIntProperty("forceGroup", force.getForceGroup());
-    SerializationNode& bonds = node.createChildNode("Bonds");
-    for (int i = 0; i < force.getNumBonds(); i++) {
-        int particle1, particle2;
-        double distance, k;
-        force.getBondParameters(i, particle1, particle2, distance, k);
-        bonds.createChildNode("Bond").setIntProperty("p1", particle1).setIntProperty("p2", particle2).setDoubleProperty("d", distance).setDoubleProperty("k", k);
-    }
+    int numBonds = force.getNumBonds();
+    vector<int> particle1(numBonds), particle2(numBonds);
+    vector<double> distance(numBonds), k(numBonds);
+    for (int i = 0; i < numBonds; i++)
+        force.getBondParameters(i, particle1[i], particle2[i], distance[i], k[i]);
+    node.createChildNode("Bonds").setIntArrayProperty("p1", particle1).setIntArrayProperty("p2", particle2).setDoubleArrayProperty("d", distance).setDoubleArrayProperty("k", k);
 }
 
 void* HarmonicBondForceProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") != 1)
+    int version = node.getIntProperty("version");
+    if (version < 1 || version > 2)
         throw OpenMMException("Unsupported version number");
     HarmonicBondForce* force = new HarmonicBondForce();
     try {
         force->setForceGroup(node.getIntProperty("forceGroup", 0));
         const SerializationNode& bonds = node.getChildNode("Bonds");
-        for (int i = 0; i < (int) bonds.getChildren().size(); i++) {
-            const SerializationNode& bond = bonds.getChildren()[i];
-            force->addBond(bond.getIntProperty("p1"), bond.getIntProperty("p2"), bond.getDoubleProperty("d"), bond.getDoubleProperty("k"));
+        if (version == 1) {
+            for (int i = 0; i < (int) bonds.getChildren().size(); i++) {
+                const SerializationNode& bond = bonds.getChildren()[i];
+                force->addBond(bond.getIntProperty("p1"), bond.getIntProperty("p2"), bond.getDoubleProperty("d"), bond.getDoubleProperty("k"));
+            }
+        }
+        else {
+            vector<int> particle1 = bonds.getIntArrayProperty("p1");
+            vector<int> particle2 = bonds.getIntArrayProperty("p2");
+            vector<double> distance = bonds.getDoubleArrayProperty("d");
+            vector<double> k = bonds.getDoubleArrayProperty("k");
+            if (particle2.size() != particle1.size() || distance.size() != particle1.size() || k.size() != particle1.size())
+                throw OpenMMException("HarmonicBondForce: bond arrays have different lengths");
+            for (int i = 0; i < (int) particle1.size(); i++)
+                force->addBond(particle1[i], particle2[i], distance[i], k[i]);
         }
     }
     catch (...) {
@@ -31,6 +31,7 @@
 
 #include "openmm/serialization/NonbondedForceProxy.h"
 #include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationReader.h"
 #include "openmm/Force.h"
 #include "openmm/NonbondedForce.h"
 #include <sstream>
@@ -38,12 +39,11 @@
 using namespace OpenMM;
 using namespace std;
 
-NonbondedForceProxy::NonbondedForceProxy() : SerializationProxy("NonbondedForce") {
-}
-
-void NonbondedForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 1);
-    const NonbondedForce& force = *reinterpret_cast<const NonbondedForce*>(object);
+/**
+ * Record the properties of the force, everything except the particles and exceptions.
+ */
+static void serializeProperties(const NonbondedForce& force, SerializationNode& node) {
+    node.setIntProperty("version", 2);
     node.setIntProperty("forceGroup", force.getForceGroup());
     node.setIntProperty("method", (int) force.getNonbondedMethod());
     node.setDoubleProperty("cutoff", force.getCutoffDistance());
@@ -60,49 +60,115 @@ void NonbondedForceProxy::serialize(const void* object, SerializationNode& node)
     node.setIntProperty("ny", ny);
     node.setIntProperty("nz", nz);
     node.setIntProperty("recipForceGroup", force.getReciprocalSpaceForceGroup());
-    SerializationNode& particles = node.createChildNode("Particles");
-    for (int i = 0; i < force.getNumParticles(); i++) {
-        double charge, sigma, epsilon;
-        force.getParticleParameters(i, charge, sigma, epsilon);
-        particles.createChildNode("Particle").setDoubleProperty("q", charge).setDoubleProperty("sig", sigma).setDoubleProperty("eps", epsilon);
-    }
-    SerializationNode& exceptions = node.createChildNode("Exceptions");
-    for (int i = 0; i < force.getNumExceptions(); i++) {
-        int particle1, particle2;
-        double chargeProd, sigma, epsilon;
-        force.getExceptionParameters(i, particle1, particle2, chargeProd, sigma, epsilon);
-        exceptions.createChildNode("Exception").setIntProperty("p1", particle1).setIntProperty("p2", particle2).setDoubleProperty("q", chargeProd).setDoubleProperty("sig", sigma).setDoubleProperty("eps", epsilon);
-    }
 }
 
-void* NonbondedForceProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") != 1)
+/**
+ * Set the properties of the force from a node created by serializeProperties().
+ */
+static void deserializeProperties(NonbondedForce& force, const SerializationNode& node) {
+    int version = node.getIntProperty("version");
+    if (version < 1 || version > 2)
         throw OpenMMException("Unsupported version number");
+    force.setForceGroup(node.getIntProperty("forceGroup", 0));
+    force.setNonbondedMethod((NonbondedForce::NonbondedMethod) node.getIntProperty("method"));
+    force.setCutoffDistance(node.getDoubleProperty("cutoff"));
+    force.setUseSwitchingFunction(node.getBoolProperty("useSwitchingFunction", false));
+    force.setSwitchingDistance(node.getDoubleProperty("switchingDistance", -1.0));
+    force.setEwaldErrorTolerance(node.getDoubleProperty("ewaldTolerance"));
+    force.setReactionFieldDielectric(node.getDoubleProperty("rfDielectric"));
+    force.setUseDispersionCorrection(node.getIntProperty("dispersionCorrection"));
+    double alpha = node.getDoubleProperty("alpha", 0.0);
+    int nx = node.getIntProperty("nx", 0);
+    int ny = node.getIntProperty("ny", 0);
+    int nz = node.getIntProperty("nz", 0);
+    force.setPMEParameters(alpha, nx, ny, nz);
+    force.setReciprocalSpaceForceGroup(node.getIntProperty("recipForceGroup", -1));
+}
+
+NonbondedForceProxy::NonbondedForceProxy() : SerializationProxy("NonbondedForce") {
+}
+
+void NonbondedForceProxy::serialize(const void* object, SerializationNode& node) const {
+    const NonbondedForce& force = *reinterpret_cast<const NonbondedForce*>(object);
+    serializeProperties(force, node);
+    int numParticles = force.getNumParticles();
+    vector<double> charge(numParticles), sigma(numParticles), epsilon(numParticles);
+    for (int i = 0; i < numParticles; i++)
+        force.getParticleParameters(i, charge[i], sigma[i], epsilon[i]);
+    node.createChildNode("Particles").setDoubleArrayProperty("q", charge).setDoubleArrayProperty("sig", sigma).setDoubleArrayProperty("eps", epsilon);
+    int numExceptions = force.getNumExceptions();
+    vector<int> particle1(numExceptions), particle2(numExceptions);
+    vector<double> chargeProd(numExceptions), exceptionSigma(numExceptions), exceptionEpsilon(numExceptions);
+    for (int i = 0; i < numExceptions; i++)
+        force.getExceptionParameters(i, particle1[i], particle2[i], chargeProd[i], exceptionSigma[i], exceptionEpsilon[i]);
+    node.createChildNode("Exceptions").setIntArrayProperty("p1", particle1).setIntArrayProperty("p2", particle2)
+            .setDoubleArrayProperty("q", chargeProd).setDoubleArrayProperty("sig", exceptionSigma).setDoubleArrayProperty("eps", exceptionEpsilon);
+}
+
+void* NonbondedForceProxy::deserialize(const SerializationNode& node) const {
     NonbondedForce* force = new NonbondedForce();
     try {
-        force->setForceGroup(node.getIntProperty("forceGroup", 0));
-        force->setNonbondedMethod((NonbondedForce::NonbondedMethod) node.getIntProperty("method"));
-        force->setCutoffDistance(node.getDoubleProperty("cutoff"));
-        force->setUseSwitchingFunction(node.getBoolProperty("useSwitchingFunction", false));
-        force->setSwitchingDistance(node.getDoubleProperty("switchingDistance", -1.0));
-        force->setEwaldErrorTolerance(node.getDoubleProperty("ewaldTolerance"));
-        force->setReactionFieldDielectric(node.getDoubleProperty("rfDielectric"));
-        force->setUseDispersionCorrection(node.getIntProperty("dispersionCorrection"));
-        double alpha = node.getDoubleProperty("alpha", 0.0);
-        int nx = node.getIntProperty("nx", 0);
-        int ny = node.getIntProperty("ny", 0);
-        int nz = node.getIntProperty("nz", 0);
-        force->setPMEParameters(alpha, nx, ny, nz);
-        force->setReciprocalSpaceForceGroup(node.getIntProperty("recipForceGroup", -1));
+        deserializeProperties(*force, node);
         const SerializationNode& particles = node.getChildNode("Particles");
-        for (int i = 0; i < (int) particles.getChildren().size(); i++) {
-            const SerializationNode& particle = particles.getChildren()[i];
-            force->addParticle(particle.getDoubleProperty("q"), particle.getDoubleProperty("sig"), particle.getDoubleProperty("eps"));
-        }
         const SerializationNode& exceptions = node.getChildNode("Exceptions");
-        for (int i = 0; i < (int) exceptions.getChildren().size(); i++) {
-            const SerializationNode& exception = exceptions.getChildren()[i];
-            force->addException(exception.getIntProperty("p1"), exception.getIntProperty("p2"), exception.getDoubleProperty("q"), exception.getDoubleProperty("sig"), exception.getDoubleProperty("eps"));
+        if (node.getIntProperty("version") == 1) {
+            // Version 1 stored one child node per particle and per exception.
+
+            for (int i = 0; i < (int) particles.getChildren().size(); i++) {
+                const SerializationNode& particle = particles.getChildren()[i];
+                force->addParticle(particle.getDoubleProperty("q"), particle.getDoubleProperty("sig"), particle.getDoubleProperty("eps"));
+            }
+            for (int i = 0; i < (int) exceptions.getChildren().size(); i++) {
+                const SerializationNode& exception = exceptions.getChildren()[i];
+                force->addException(exception.getIntProperty("p1"), exception.getIntProperty("p2"), exception.getDoubleProperty("q"), exception.getDoubleProperty("sig"), exception.getDoubleProperty("eps"));
+            }
+        }
+        else {
+            vector<double> charge = particles.getDoubleArrayProperty("q");
+            vector<double> sigma = particles.getDoubleArrayProperty("sig");
+            vector<double> epsilon = particles.getDoubleArrayProperty("eps");
+            if (sigma.size() != charge.size() || epsilon.size() != charge.size())
+                throw OpenMMException("NonbondedForce: particle arrays have different lengths");
+            for (int i = 0; i < (int) charge.size(); i++)
+                force->addParticle(charge[i], sigma[i], epsilon[i]);
+            vector<int> particle1 = exceptions.getIntArrayProperty("p1");
+            vector<int> particle2 = exceptions.getIntArrayProperty("p2");
+            vector<double> chargeProd = exceptions.getDoubleArrayProperty("q");
+            sigma = exceptions.getDoubleArrayProperty("sig");
+            epsilon = exceptions.getDoubleArrayProperty("eps");
+            if (particle2.size() != particle1.size() || chargeProd.size() != particle1.size() || sigma.size() != particle1.size() || epsilon.size() != particle1.size())
+                throw OpenMMException("NonbondedForce: exception arrays have different lengths");
+            for (int i = 0; i < (int) particle1.size(); i++)
+                force->addException(particle1[i], particle2[i], chargeProd[i], sigma[i], epsilon[i]);
+        }
+    }
+    catch (...) {
+        delete force;
+        throw;
+    }
+    return force;
+}
+
+void* NonbondedForceProxy::deserializeStream(const SerializationNode& node, SerializationReader& reader) const {
+    if (node.getIntProperty("version", 0) > 1)
+        return SerializationProxy::deserializeStream(node, reader);
+
+    // Version 1 files store one node per particle and exception, so read them one at a time.
+
+    NonbondedForce* force = new NonbondedForce();
+    try {
+        deserializeProperties(*force, node);
+        SerializationNode child, item;
+        while (reader.beginNode(child)) {
+            if (child.getName() == "Particles") {
+                while (reader.readNode(item))
+                    force->addParticle(item.getDoubleProperty("q"), item.getDoubleProperty("sig"), item.getDoubleProperty("eps"));
+            }
+            else if (child.getName() == "Exceptions") {
+                while (reader.readNode(item))
+                    force->addException(item.getIntProperty("p1"), item.getIntProperty("p2"), item.getDoubleProperty("q"), item.getDoubleProperty("sig"), item.getDoubleProperty("eps"));
+            }
+            reader.endNode();
         }
     }
     catch (...) {
@@ -42,30 +42,54 @@ RBTorsionForceProxy::RBTorsionForceProxy() : SerializationProxy("RBTorsionForce"
 }
 
 void RBTorsionForceProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 1);
+    node.setIntProperty("version", 2);
     const RBTorsionForce& force = *reinterpret_cast<const RBTorsionForce*>(object);
     node.setIntProperty("forceGroup", force.getForceGroup());
-    SerializationNode& torsions = node.createChildNode("Torsions");
-    for (int i = 0; i < force.getNumTorsions(); i++) {
-        int particle1, particle2, particle3, particle4;
-        double c0, c1, c2, c3, c4, c5;
-        force.getTorsionParameters(i, particle1, particle2, particle3, particle4, c0, c1, c2, c3, c4, c5);
-        torsions.createChildNode("Torsion").setIntProperty("p1", particle1).setIntProperty("p2", particle2).setIntProperty("p3", particle3).setIntProperty("p4", particle4).setDoubleProperty("c0", c0).setDoubleProperty("c1", c1).setDoubleProperty("c2", c2).setDoubleProperty("c3", c3).setDoubleProperty("c4", c4).setDoubleProperty("c5", c5);
-    }
+    int numTorsions = force.getNumTorsions();
+    vector<int> particle1(numTorsions), particle2(numTorsions), particle3(numTorsions), particle4(numTorsions);
+    vector<double> c0(numTorsions), c1(numTorsions), c2(numTorsions), c3(numTorsions), c4(numTorsions), c5(numTorsions);
+    for (int i = 0; i < numTorsions; i++)
+        force.getTorsionParameters(i, particle1[i], particle2[i], particle3[i], particle4[i], c0[i], c1[i], c2[i], c3[i], c4[i], c5[i]);
+    node.createChildNode("Torsions").setIntArrayProperty("p1", particle1).setIntArrayProperty("p2", particle2).setIntArrayProperty("p3", particle3).setIntArrayProperty("p4", particle4)
+            .setDoubleArrayProperty("c0", c0).setDoubleArrayProperty("c1", c1).setDoubleArrayProperty("c2", c2)
+            .setDoubleArrayProperty("c3", c3).setDoubleArrayProperty("c4", c4).setDoubleArrayProperty("c5", c5);
 }
 
 void* RBTorsionForceProxy::deserialize(const SerializationNode& node) const {
-    if (node.getIntProperty("version") != 1)
+    int version = node.getIntProperty("version");
+    if (version < 1 || version > 2)
         throw OpenMMException("Unsupported version number");
     RBTorsionForce* force = new RBTorsionForce();
     try {
         force->setForceGroup(node.getIntProperty("forceGroup", 0));
         const SerializationNode& torsions = node.getChildNode("Torsions");
-        for (int i = 0; i < (int) torsions.getChildren().size(); i++) {
-            const SerializationNode& torsion = torsions.getChildren()[i];
-            force->addTorsion(torsion.getIntProperty("p1"), torsion.getIntProperty("p2"), torsion.getIntProperty("p3"), torsion.getIntProperty("p4"),
-                    torsion.getDoubleProperty("c0"), torsion.getDoubleProperty("c1"), torsion.getDoubleProperty("c2"),
-                    torsion.getDoubleProperty("c3"), torsion.getDoubleProperty("c4"), torsion.getDoubleProperty("c5"));
+        if (version == 1) {
+            for (int i = 0; i < (int) torsions.getChildren().size(); i++) {
+                const SerializationNode& torsion = torsions.getChildren()[i];
+                force->addTorsion(torsion.getIntProperty("p1"), torsion.getIntProperty("p2"), torsion.getIntProperty("p3"), torsion.getIntProperty("p4"),
+                        torsion.getDoubleProperty("c0"), torsion.getDoubleProperty("c1"), torsion.getDoubleProperty("c2"),
+                        torsion.getDoubleProperty("c3"), torsion.getDoubleProperty("c4"), torsion.getDoubleProperty("c5"));
+            }
+        }
+        else {
+            vector<int> particle1 = torsions.getIntArrayProperty("p1");
+            vector<int> particle2 = torsions.getIntArrayProperty("p2");
+            vector<int> particle3 = torsions.getIntArrayProperty("p3");
+            vector<int> particle4 = torsions.getIntArrayProperty("p4");
+            vector<vector<double> > c(6);
+            for (int j = 0; j < 6; j++) {
+                stringstream name;
+                name << "c" << j;
+                c[j] = torsions.getDoubleArrayProperty(name.str());
+            }
+            int numTorsions = particle1.size();
+            bool consistent = (particle2.size() == numTorsions && particle3.size() == numTorsions && particle4.size() == numTorsions);
+            for (int j = 0; j < 6; j++)
+                consistent &= (c[j].size() == numTorsions);
+            if (!consistent)
+                throw OpenMMException("RBTorsionForce: torsion arrays have different lengths");
+            for (int i = 0; i < numTorsions; i++)
+                force->addTorsion(particle1[i], particle2[i], particle3[i], particle4[i], c[0][i], c[1][i], c[2][i], c[3][i], c[4][i], c[5][i]);
         }
     }
     catch (...) {
@@ -74,4 +98,3 @@ void* RBTorsionForceProxy::deserialize(const SerializationNode& node) const {
     }
     return force;
 }
-
@@ -31,6 +31,8 @@
 
 #include "openmm/serialization/SerializationNode.h"
 #include "openmm/OpenMMException.h"
+#include <cctype>
+#include <cstdlib>
 #include <sstream>
 
 using namespace OpenMM;
@@ -73,8 +75,17 @@ const map<string, string>& SerializationNode::getProperties() const {
     return properties;
 }
 
+const map<string, vector<double> >& SerializationNode::getDoubleArrayProperties() const {
+    return doubleArrayProperties;
+}
+
+const map<string, vector<int> >& SerializationNode::getIntArrayProperties() const {
+    return intArrayProperties;
+}
+
 bool SerializationNode::hasProperty(const string& name) const {
-    return (properties.find(name) != properties.end());
+    return (properties.find(name) != properties.end() || doubleArrayProperties.find(name) != doubleArrayProperties.end() ||
+            intArrayProperties.find(name) != intArrayProperties.end());
 }
 
 const string& SerializationNode::getStringProperty(const string& name) const {
@@ -92,6 +103,8 @@ const string& SerializationNode::getStringProperty(const string& name, const str
 }
 
 SerializationNode& SerializationNode::setStringProperty(const string& name, const string& value) {
+    doubleArrayProperties.erase(name);
+    intArrayProperties.erase(name);
     properties[name] = value;
     return *this;
 }
@@ -117,6 +130,8 @@ int SerializationNode::getIntProperty(const string& name, int defaultValue) cons
 SerializationNode& SerializationNode::setIntProperty(const string& name, int value) {
     stringstream s;
     s << value;
+    doubleArrayProperties.erase(name);
+    intArrayProperties.erase(name);
     properties[name] = s.str();
     return *this;
 }
@@ -143,6 +158,8 @@ bool SerializationNode::getBoolProperty(const string& name, bool defaultValue) c
 SerializationNode& SerializationNode::setBoolProperty(const string& name, bool value) {
     stringstream s;
     s << value;
+    doubleArrayProperties.erase(name);
+    intArrayProperties.erase(name);
     properties[name] = s.str();
     return *this;
 }
@@ -164,10 +181,79 @@ double SerializationNode::getDoubleProperty(const string& name, double defaultVa
 SerializationNode& SerializationNode::setDoubleProperty(const string& name, double value) {
     char buffer[32];
     g_fmt(buffer, value);
+    doubleArrayProperties.erase(name);
+    intArrayProperties.erase(name);
     properties[name] = string(buffer);
     return *this;
 }
 
+vector<double> SerializationNode::getDoubleArrayProperty(const string& name) const {
+    map<string, vector<double> >::const_iterator iter = doubleArrayProperties.find(name);
+    if (iter != doubleArrayProperties.end())
+        return iter->second;
+    map<string, vector<int> >::const_iterator intIter = intArrayProperties.find(name);
+    if (intIter != intArrayProperties.end())
+        return vector<double>(intIter->second.begin(), intIter->second.end());
+
+    // Parse a whitespace separated list of values.
+
+    const char* start = getStringProperty(name).c_str();
+    vector<double> value;
+    while (true) {
+        char* end;
+        double element = strtod2(start, &end);
+        if (end == start)
+            break;
+        value.push_back(element);
+        start = end;
+    }
+    while (isspace(*start))
+        start++;
+    if (*start != 0)
+        throw OpenMMException("Property '"+name+"' in node '"+getName()+"' is not an array of numbers");
+    return value;
+}
+
+SerializationNode& SerializationNode::setDoubleArrayProperty(const string& name, const vector<double>& value) {
+    properties.erase(name);
+    intArrayProperties.erase(name);
+    doubleArrayProperties[name] = value;
+    return *this;
+}
+
+vector<int> SerializationNode::getIntArrayProperty(const string& name) const {
+    map<string, vector<int> >::const_iterator iter = intArrayProperties.find(name);
+    if (iter != intArrayProperties.end())
+        return iter->second;
+    if (doubleArrayProperties.find(name) != doubleArrayProperties.end())
+        throw OpenMMException("Property '"+name+"' in node '"+getName()+"' is not an array of ints");
+
+    // Parse a whitespace separated list of values.
+
+    const char* start = getStringProperty(name).c_str();
+    vector<int> value;
+    while (true) {
+        char* end;
+        long element = strtol(start, &end, 10);
+        if (end == start)
+            break;
+        value.push_back((int) element);
+        start = end;
+    }
+    while (isspace(*start))
+        start++;
+    if (*start != 0)
+        throw OpenMMException("Property '"+name+"' in node '"+getName()+"' is not an array of ints");
+    return value;
+}
+
+SerializationNode& SerializationNode::setIntArrayProperty(const string& name, const vector<int>& value) {
+    properties.erase(name);
+    doubleArrayProperties.erase(name);
+    intArrayProperties[name] = value;
+    return *this;
+}
+
 SerializationNode& SerializationNode::createChildNode(const std::string& name) {
     children.push_back(SerializationNode());
     children.back().setName(name);
@@ -30,6 +30,9 @@
  * -------------------------------------------------------------------------- */
 
 #include "openmm/serialization/SerializationProxy.h"
+#include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationWriter.h"
 #include "openmm/OpenMMException.h"
 #include <typeinfo>
 
@@ -53,6 +56,17 @@ const string& SerializationProxy::getTypeName() const {
     return typeName;
 }
 
+void SerializationProxy::serializeStream(const void* object, SerializationNode& node, SerializationWriter& writer) const {
+    serialize(object, node);
+    writer.writeNode(node);
+}
+
+void* SerializationProxy::deserializeStream(const SerializationNode& node, SerializationReader& reader) const {
+    SerializationNode fullNode = node;
+    reader.readChildren(fullNode);
+    return deserialize(fullNode);
+}
+
 void SerializationProxy::registerProxy(const type_info& type, const SerializationProxy* proxy) {
     getProxiesByType()[type.name()] = proxy;
     getProxiesByName()[proxy->getTypeName()] = proxy;
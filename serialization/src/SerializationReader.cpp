@@ -0,0 +1,73 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationProxy.h"
+
+using namespace OpenMM;
+using namespace std;
+
+bool SerializationReader::readNode(SerializationNode& node) {
+    if (!beginNode(node))
+        return false;
+    readChildren(node);
+    endNode();
+    return true;
+}
+
+void SerializationReader::readChildren(SerializationNode& node) {
+    // Read each child directly into place to avoid copying the subtree.
+
+    vector<SerializationNode>& children = node.getChildren();
+    while (true) {
+        children.push_back(SerializationNode());
+        if (!readNode(children.back())) {
+            children.pop_back();
+            return;
+        }
+    }
+}
+
+void SerializationReader::readVectors(vector<Vec3>& values) {
+    SerializationNode element;
+    while (readNode(element))
+        values.push_back(Vec3(element.getDoubleProperty("x"), element.getDoubleProperty("y"), element.getDoubleProperty("z")));
+}
+
+void* SerializationReader::readUntypedObject() {
+    SerializationNode node;
+    if (!beginNode(node))
+        return NULL;
+    const SerializationProxy& proxy = SerializationProxy::getProxy(node.getStringProperty("type"));
+    void* object = proxy.deserializeStream(node, *this);
+    endNode();
+    return object;
+}
@@ -0,0 +1,63 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+#include "openmm/serialization/SerializationWriter.h"
+
+using namespace OpenMM;
+using namespace std;
+
+void SerializationWriter::writeNode(const SerializationNode& node) {
+    beginNode(node);
+    const vector<SerializationNode>& children = node.getChildren();
+    for (int i = 0; i < (int) children.size(); i++)
+        writeNode(children[i]);
+    endNode();
+}
+
+void SerializationWriter::writeVectors(const string& arrayName, const string& elementName, const vector<Vec3>& values) {
+    SerializationNode array;
+    array.setName(arrayName);
+    beginNode(array);
+    SerializationNode element;
+    element.setName(elementName);
+    for (int i = 0; i < (int) values.size(); i++) {
+        element.setDoubleProperty("x", values[i][0]).setDoubleProperty("y", values[i][1]).setDoubleProperty("z", values[i][2]);
+        writeNode(element);
+    }
+    endNode();
+}
+
+void SerializationWriter::writeObject(const string& name, const void* object, const SerializationProxy& proxy) {
+    SerializationNode node;
+    node.setName(name);
+    node.setStringProperty("type", proxy.getTypeName());
+    proxy.serializeStream(object, node, *this);
+}
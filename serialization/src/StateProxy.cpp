@@ -30,6 +30,8 @@
  * -------------------------------------------------------------------------- */
 
 #include "openmm/serialization/StateProxy.h"
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationWriter.h"
 #include <OpenMM.h>
 #include <map>
 
@@ -160,4 +162,101 @@ void* StateProxy::deserialize(const SerializationNode& node) const {
     State *s = new State();
     *s = builder.getState();
     return s;
-}
\ No newline at end of file
+}
+
+void StateProxy::serializeStream(const void* object, SerializationNode& node, SerializationWriter& writer) const {
+    node.setIntProperty("version", 1);
+    const State& s = *reinterpret_cast<const State*>(object);
+    node.setDoubleProperty("time", s.getTime());
+    writer.beginNode(node);
+    Vec3 a,b,c;
+    s.getPeriodicBoxVectors(a,b,c);
+    SerializationNode boxVectorsNode;
+    boxVectorsNode.setName("PeriodicBoxVectors");
+    boxVectorsNode.createChildNode("A").setDoubleProperty("x", a[0]).setDoubleProperty("y", a[1]).setDoubleProperty("z", a[2]);
+    boxVectorsNode.createChildNode("B").setDoubleProperty("x", b[0]).setDoubleProperty("y", b[1]).setDoubleProperty("z", b[2]);
+    boxVectorsNode.createChildNode("C").setDoubleProperty("x", c[0]).setDoubleProperty("y", c[1]).setDoubleProperty("z", c[2]);
+    writer.writeNode(boxVectorsNode);
+    if ((s.getDataTypes()&State::Parameters) != 0) {
+        SerializationNode parametersNode;
+        parametersNode.setName("Parameters");
+        const map<string, double>& stateParams = s.getParameters();
+        for (map<string, double>::const_iterator it = stateParams.begin(); it != stateParams.end(); it++)
+            parametersNode.setDoubleProperty(it->first, it->second);
+        writer.writeNode(parametersNode);
+    }
+    if ((s.getDataTypes()&State::Energy) != 0) {
+        SerializationNode energiesNode;
+        energiesNode.setName("Energies");
+        energiesNode.setDoubleProperty("PotentialEnergy", s.getPotentialEnergy());
+        energiesNode.setDoubleProperty("KineticEnergy", s.getKineticEnergy());
+        writer.writeNode(energiesNode);
+    }
+    if ((s.getDataTypes()&State::Positions) != 0)
+        writer.writeVectors("Positions", "Position", s.getPositions());
+    if ((s.getDataTypes()&State::Velocities) != 0)
+        writer.writeVectors("Velocities", "Velocity", s.getVelocities());
+    if ((s.getDataTypes()&State::Forces) != 0)
+        writer.writeVectors("Forces", "Force", s.getForces());
+    writer.endNode();
+}
+
+void* StateProxy::deserializeStream(const SerializationNode& node, SerializationReader& reader) const {
+    if (node.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    double outTime = node.getDoubleProperty("time");
+    State::StateBuilder builder(outTime);
+    vector<int> arraySizes;
+    bool hasBoxVectors = false;
+    SerializationNode child;
+    while (reader.beginNode(child)) {
+        if (child.getName() == "PeriodicBoxVectors") {
+            reader.readChildren(child);
+            const SerializationNode& AVec = child.getChildNode("A");
+            const SerializationNode& BVec = child.getChildNode("B");
+            const SerializationNode& CVec = child.getChildNode("C");
+            builder.setPeriodicBoxVectors(Vec3(AVec.getDoubleProperty("x"),AVec.getDoubleProperty("y"),AVec.getDoubleProperty("z")),
+                                          Vec3(BVec.getDoubleProperty("x"),BVec.getDoubleProperty("y"),BVec.getDoubleProperty("z")),
+                                          Vec3(CVec.getDoubleProperty("x"),CVec.getDoubleProperty("y"),CVec.getDoubleProperty("z")));
+            hasBoxVectors = true;
+        }
+        else if (child.getName() == "Parameters") {
+            map<string, double> outStateParams;
+            const map<string, string>& inStateParams = child.getProperties();
+            for (map<string, string>::const_iterator pit = inStateParams.begin(); pit != inStateParams.end(); pit++)
+                outStateParams[pit->first] = child.getDoubleProperty(pit->first);
+            builder.setParameters(outStateParams);
+        }
+        else if (child.getName() == "Energies")
+            builder.setEnergy(child.getDoubleProperty("KineticEnergy"), child.getDoubleProperty("PotentialEnergy"));
+        else if (child.getName() == "Positions") {
+            vector<Vec3> outPositions;
+            reader.readVectors(outPositions);
+            builder.setPositions(outPositions);
+            arraySizes.push_back(outPositions.size());
+        }
+        else if (child.getName() == "Velocities") {
+            vector<Vec3> outVelocities;
+            reader.readVectors(outVelocities);
+            builder.setVelocities(outVelocities);
+            arraySizes.push_back(outVelocities.size());
+        }
+        else if (child.getName() == "Forces") {
+            vector<Vec3> outForces;
+            reader.readVectors(outForces);
+            builder.setForces(outForces);
+            arraySizes.push_back(outForces.size());
+        }
+        reader.endNode();
+    }
+    if (!hasBoxVectors)
+        throw OpenMMException("State is missing its periodic box vectors");
+    for (int i = 1; i < arraySizes.size(); i++) {
+        if (arraySizes[i] != arraySizes[i-1]) {
+            throw(OpenMMException("State Deserialization Particle Size Mismatch, check number of particles in Forces, Velocities, Positions!"));
+        }
+    }
+    State *s = new State();
+    *s = builder.getState();
+    return s;
+}
@@ -31,6 +31,8 @@
 
 #include "openmm/serialization/SystemProxy.h"
 #include "openmm/serialization/SerializationNode.h"
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationWriter.h"
 #include "openmm/Force.h"
 #include "openmm/System.h"
 #include "openmm/VirtualSite.h"
@@ -39,48 +41,97 @@
 using namespace OpenMM;
 using namespace std;
 
-SystemProxy::SystemProxy() : SerializationProxy("System") {
-}
-
-void SystemProxy::serialize(const void* object, SerializationNode& node) const {
-    node.setIntProperty("version", 1);
-    const System& system = *reinterpret_cast<const System*>(object);
+/**
+ * Record the default periodic box vectors.
+ */
+static void serializeBoxVectors(const System& system, SerializationNode& box) {
     Vec3 a, b, c;
     system.getDefaultPeriodicBoxVectors(a, b, c);
-    SerializationNode& box = node.createChildNode("PeriodicBoxVectors");
     box.createChildNode("A").setDoubleProperty("x", a[0]).setDoubleProperty("y", a[1]).setDoubleProperty("z", a[2]);
     box.createChildNode("B").setDoubleProperty("x", b[0]).setDoubleProperty("y", b[1]).setDoubleProperty("z", b[2]);
     box.createChildNode("C").setDoubleProperty("x", c[0]).setDoubleProperty("y", c[1]).setDoubleProperty("z", c[2]);
-    SerializationNode& particles = node.createChildNode("Particles");
-    for (int i = 0; i < system.getNumParticles(); i++) {
-        SerializationNode& particle = particles.createChildNode("Particle").setDoubleProperty("mass", system.getParticleMass(i));
-        if (system.isVirtualSite(i)) {
-            if (typeid(system.getVirtualSite(i)) == typeid(TwoParticleAverageSite)) {
-                const TwoParticleAverageSite& site = dynamic_cast<const TwoParticleAverageSite&>(system.getVirtualSite(i));
-                particle.createChildNode("TwoParticleAverageSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setDoubleProperty("w1", site.getWeight(0)).setDoubleProperty("w2", site.getWeight(1));
-            }
-            else if (typeid(system.getVirtualSite(i)) == typeid(ThreeParticleAverageSite)) {
-                const ThreeParticleAverageSite& site = dynamic_cast<const ThreeParticleAverageSite&>(system.getVirtualSite(i));
-                particle.createChildNode("ThreeParticleAverageSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).setDoubleProperty("w1", site.getWeight(0)).setDoubleProperty("w2", site.getWeight(1)).setDoubleProperty("w3", site.getWeight(2));
-            }
-            else if (typeid(system.getVirtualSite(i)) == typeid(OutOfPlaneSite)) {
-                const OutOfPlaneSite& site = dynamic_cast<const OutOfPlaneSite&>(system.getVirtualSite(i));
-                particle.createChildNode("OutOfPlaneSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).setDoubleProperty("w12", site.getWeight12()).setDoubleProperty("w13", site.getWeight13()).setDoubleProperty("wc", site.getWeightCross());
-            }
-            else if (typeid(system.getVirtualSite(i)) == typeid(LocalCoordinatesSite)) {
-                const LocalCoordinatesSite& site = dynamic_cast<const LocalCoordinatesSite&>(system.getVirtualSite(i));
-                Vec3 wo = site.getOriginWeights();
-                Vec3 wx = site.getXWeights();
-                Vec3 wy = site.getYWeights();
-                Vec3 p = site.getLocalPosition();
-                particle.createChildNode("LocalCoordinatesSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).
-                        setDoubleProperty("wo1", wo[0]).setDoubleProperty("wo2", wo[1]).setDoubleProperty("wo3", wo[2]).
-                        setDoubleProperty("wx1", wx[0]).setDoubleProperty("wx2", wx[1]).setDoubleProperty("wx3", wx[2]).
-                        setDoubleProperty("wy1", wy[0]).setDoubleProperty("wy2", wy[1]).setDoubleProperty("wy3", wy[2]).
-                        setDoubleProperty("pos1", p[0]).setDoubleProperty("pos2", p[1]).setDoubleProperty("pos3", p[2]);
-            }
+}
+
+/**
+ * Set the default periodic box vectors from a node created by serializeBoxVectors().
+ */
+static void deserializeBoxVectors(System& system, const SerializationNode& box) {
+    const SerializationNode& boxa = box.getChildNode("A");
+    const SerializationNode& boxb = box.getChildNode("B");
+    const SerializationNode& boxc = box.getChildNode("C");
+    Vec3 a(boxa.getDoubleProperty("x"), boxa.getDoubleProperty("y"), boxa.getDoubleProperty("z"));
+    Vec3 b(boxb.getDoubleProperty("x"), boxb.getDoubleProperty("y"), boxb.getDoubleProperty("z"));
+    Vec3 c(boxc.getDoubleProperty("x"), boxc.getDoubleProperty("y"), boxc.getDoubleProperty("z"));
+    system.setDefaultPeriodicBoxVectors(a, b, c);
+}
+
+/**
+ * Record the mass and virtual site (if any) of one particle.
+ */
+static void serializeParticle(const System& system, int i, SerializationNode& particle) {
+    particle.setName("Particle");
+    particle.setDoubleProperty("mass", system.getParticleMass(i));
+    if (system.isVirtualSite(i)) {
+        if (typeid(system.getVirtualSite(i)) == typeid(TwoParticleAverageSite)) {
+            const TwoParticleAverageSite& site = dynamic_cast<const TwoParticleAverageSite&>(system.getVirtualSite(i));
+            particle.createChildNode("TwoParticleAverageSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setDoubleProperty("w1", site.getWeight(0)).setDoubleProperty("w2", site.getWeight(1));
+        }
+        else if (typeid(system.getVirtualSite(i)) == typeid(ThreeParticleAverageSite)) {
+            const ThreeParticleAverageSite& site = dynamic_cast<const ThreeParticleAverageSite&>(system.getVirtualSite(i));
+            particle.createChildNode("ThreeParticleAverageSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).setDoubleProperty("w1", site.getWeight(0)).setDoubleProperty("w2", site.getWeight(1)).setDoubleProperty("w3", site.getWeight(2));
+        }
+        else if (typeid(system.getVirtualSite(i)) == typeid(OutOfPlaneSite)) {
+            const OutOfPlaneSite& site = dynamic_cast<const OutOfPlaneSite&>(system.getVirtualSite(i));
+            particle.createChildNode("OutOfPlaneSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).setDoubleProperty("w12", site.getWeight12()).setDoubleProperty("w13", site.getWeight13()).setDoubleProperty("wc", site.getWeightCross());
+        }
+        else if (typeid(system.getVirtualSite(i)) == typeid(LocalCoordinatesSite)) {
+            const LocalCoordinatesSite& site = dynamic_cast<const LocalCoordinatesSite&>(system.getVirtualSite(i));
+            Vec3 wo = site.getOriginWeights();
+            Vec3 wx = site.getXWeights();
+            Vec3 wy = site.getYWeights();
+            Vec3 p = site.getLocalPosition();
+            particle.createChildNode("LocalCoordinatesSite").setIntProperty("p1", site.getParticle(0)).setIntProperty("p2", site.getParticle(1)).setIntProperty("p3", site.getParticle(2)).
+                    setDoubleProperty("wo1", wo[0]).setDoubleProperty("wo2", wo[1]).setDoubleProperty("wo3", wo[2]).
+                    setDoubleProperty("wx1", wx[0]).setDoubleProperty("wx2", wx[1]).setDoubleProperty("wx3", wx[2]).
+                    setDoubleProperty("wy1", wy[0]).setDoubleProperty("wy2", wy[1]).setDoubleProperty("wy3", wy[2]).
+                    setDoubleProperty("pos1", p[0]).setDoubleProperty("pos2", p[1]).setDoubleProperty("pos3", p[2]);
+        }
+    }
+}
+
+/**
+ * Add a particle to a System, based on a node created by serializeParticle().
+ */
+static void deserializeParticle(System& system, const SerializationNode& particle) {
+    int i = system.addParticle(particle.getDoubleProperty("mass"));
+    if (particle.getChildren().size() > 0) {
+        const SerializationNode& vsite = particle.getChildren()[0];
+        if (vsite.getName() == "TwoParticleAverageSite")
+            system.setVirtualSite(i, new TwoParticleAverageSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getDoubleProperty("w1"), vsite.getDoubleProperty("w2")));
+        else if (vsite.getName() == "ThreeParticleAverageSite")
+            system.setVirtualSite(i, new ThreeParticleAverageSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), vsite.getDoubleProperty("w1"), vsite.getDoubleProperty("w2"), vsite.getDoubleProperty("w3")));
+        else if (vsite.getName() == "OutOfPlaneSite")
+            system.setVirtualSite(i, new OutOfPlaneSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), vsite.getDoubleProperty("w12"), vsite.getDoubleProperty("w13"), vsite.getDoubleProperty("wc")));
+        else if (vsite.getName() == "LocalCoordinatesSite") {
+            Vec3 wo(vsite.getDoubleProperty("wo1"), vsite.getDoubleProperty("wo2"), vsite.getDoubleProperty("wo3"));
+            Vec3 wx(vsite.getDoubleProperty("wx1"), vsite.getDoubleProperty("wx2"), vsite.getDoubleProperty("wx3"));
+            Vec3 wy(vsite.getDoubleProperty("wy1"), vsite.getDoubleProperty("wy2"), vsite.getDoubleProperty("wy3"));
+            Vec3 p(vsite.getDoubleProperty("pos1"), vsite.getDoubleProperty("pos2"), vsite.getDoubleProperty("pos3"));
+            system.setVirtualSite(i, new LocalCoordinatesSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), wo, wx, wy, p));
         }
     }
+}
+
+SystemProxy::SystemProxy() : SerializationProxy("System") {
+}
+
+void SystemProxy::serialize(const void* object, SerializationNode& node) const {
+    node.setIntProperty("version", 1);
+    const System& system = *reinterpret_cast<const System*>(object);
+    serializeBoxVectors(system, node.createChildNode("PeriodicBoxVectors"));
+    SerializationNode& particles = node.createChildNode("Particles");
+    for (int i = 0; i < system.getNumParticles(); i++)
+        serializeParticle(system, i, particles.createChildNode("Particle"));
     SerializationNode& constraints = node.createChildNode("Constraints");
     for (int i = 0; i < system.getNumConstraints(); i++) {
         int particle1, particle2;
@@ -98,34 +149,10 @@ void* SystemProxy::deserialize(const SerializationNode& node) const {
         throw OpenMMException("Unsupported version number");
     System* system = new System();
     try {
-        const SerializationNode& box = node.getChildNode("PeriodicBoxVectors");
-        const SerializationNode& boxa = box.getChildNode("A");
-        const SerializationNode& boxb = box.getChildNode("B");
-        const SerializationNode& boxc = box.getChildNode("C");
-        Vec3 a(boxa.getDoubleProperty("x"), boxa.getDoubleProperty("y"), boxa.getDoubleProperty("z"));
-        Vec3 b(boxb.getDoubleProperty("x"), boxb.getDoubleProperty("y"), boxb.getDoubleProperty("z"));
-        Vec3 c(boxc.getDoubleProperty("x"), boxc.getDoubleProperty("y"), boxc.getDoubleProperty("z"));
-        system->setDefaultPeriodicBoxVectors(a, b, c);
+        deserializeBoxVectors(*system, node.getChildNode("PeriodicBoxVectors"));
         const SerializationNode& particles = node.getChildNode("Particles");
-        for (int i = 0; i < (int) particles.getChildren().size(); i++) {
-            system->addParticle(particles.getChildren()[i].getDoubleProperty("mass"));
-            if (particles.getChildren()[i].getChildren().size() > 0) {
-                const SerializationNode& vsite = particles.getChildren()[i].getChildren()[0];
-                if (vsite.getName() == "TwoParticleAverageSite")
-                    system->setVirtualSite(i, new TwoParticleAverageSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getDoubleProperty("w1"), vsite.getDoubleProperty("w2")));
-                else if (vsite.getName() == "ThreeParticleAverageSite")
-                    system->setVirtualSite(i, new ThreeParticleAverageSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), vsite.getDoubleProperty("w1"), vsite.getDoubleProperty("w2"), vsite.getDoubleProperty("w3")));
-                else if (vsite.getName() == "OutOfPlaneSite")
-                    system->setVirtualSite(i, new OutOfPlaneSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), vsite.getDoubleProperty("w12"), vsite.getDoubleProperty("w13"), vsite.getDoubleProperty("wc")));
-                else if (vsite.getName() == "LocalCoordinatesSite") {
-                    Vec3 wo(vsite.getDoubleProperty("wo1"), vsite.getDoubleProperty("wo2"), vsite.getDoubleProperty("wo3"));
-                    Vec3 wx(vsite.getDoubleProperty("wx1"), vsite.getDoubleProperty("wx2"), vsite.getDoubleProperty("wx3"));
-                    Vec3 wy(vsite.getDoubleProperty("wy1"), vsite.getDoubleProperty("wy2"), vsite.getDoubleProperty("wy3"));
-                    Vec3 p(vsite.getDoubleProperty("pos1"), vsite.getDoubleProperty("pos2"), vsite.getDoubleProperty("pos3"));
-                    system->setVirtualSite(i, new LocalCoordinatesSite(vsite.getIntProperty("p1"), vsite.getIntProperty("p2"), vsite.getIntProperty("p3"), wo, wx, wy, p));
-                }
-            }
-        }
+        for (int i = 0; i < (int) particles.getChildren().size(); i++)
+            deserializeParticle(*system, particles.getChildren()[i]);
         const SerializationNode& constraints = node.getChildNode("Constraints");
         for (int i = 0; i < (int) constraints.getChildren().size(); i++) {
             const SerializationNode& constraint = constraints.getChildren()[i];
@@ -141,4 +168,78 @@ void* SystemProxy::deserialize(const SerializationNode& node) const {
         throw;
     }
     return system;
-}
\ No newline at end of file
+}
+
+void SystemProxy::serializeStream(const void* object, SerializationNode& node, SerializationWriter& writer) const {
+    node.setIntProperty("version", 1);
+    const System& system = *reinterpret_cast<const System*>(object);
+    writer.beginNode(node);
+    SerializationNode box;
+    box.setName("PeriodicBoxVectors");
+    serializeBoxVectors(system, box);
+    writer.writeNode(box);
+
+    // Write the particles, constraints, and forces one at a time.
+
+    SerializationNode child;
+    child.setName("Particles");
+    writer.beginNode(child);
+    for (int i = 0; i < system.getNumParticles(); i++) {
+        SerializationNode particle;
+        serializeParticle(system, i, particle);
+        writer.writeNode(particle);
+    }
+    writer.endNode();
+    child.setName("Constraints");
+    writer.beginNode(child);
+    for (int i = 0; i < system.getNumConstraints(); i++) {
+        int particle1, particle2;
+        double distance;
+        system.getConstraintParameters(i, particle1, particle2, distance);
+        SerializationNode constraint;
+        constraint.setName("Constraint");
+        constraint.setIntProperty("p1", particle1).setIntProperty("p2", particle2).setDoubleProperty("d", distance);
+        writer.writeNode(constraint);
+    }
+    writer.endNode();
+    child.setName("Forces");
+    writer.beginNode(child);
+    for (int i = 0; i < system.getNumForces(); i++)
+        writer.writeObject("Force", &system.getForce(i));
+    writer.endNode();
+    writer.endNode();
+}
+
+void* SystemProxy::deserializeStream(const SerializationNode& node, SerializationReader& reader) const {
+    if (node.getIntProperty("version") != 1)
+        throw OpenMMException("Unsupported version number");
+    System* system = new System();
+    try {
+        SerializationNode child, item;
+        while (reader.beginNode(child)) {
+            if (child.getName() == "PeriodicBoxVectors") {
+                reader.readChildren(child);
+                deserializeBoxVectors(*system, child);
+            }
+            else if (child.getName() == "Particles") {
+                while (reader.readNode(item))
+                    deserializeParticle(*system, item);
+            }
+            else if (child.getName() == "Constraints") {
+                while (reader.readNode(item))
+                    system->addConstraint(item.getIntProperty("p1"), item.getIntProperty("p2"), item.getDoubleProperty("d"));
+            }
+            else if (child.getName() == "Forces") {
+                Force* force;
+                while ((force = reader.readObject<Force>()) != NULL)
+                    system->addForce(force);
+            }
+            reader.endNode();
+        }
+    }
+    catch (...) {
+        delete system;
+        throw;
+    }
+    return system;
+}
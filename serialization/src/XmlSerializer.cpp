@@ -30,15 +30,20 @@
  * -------------------------------------------------------------------------- */
 
 #include "openmm/serialization/XmlSerializer.h"
-#include "irrXML.h"
+#include "openmm/serialization/SerializationReader.h"
+#include "openmm/serialization/SerializationWriter.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <map>
+#include <vector>
 
 using namespace OpenMM;
 using namespace std;
-using namespace irr;
-using namespace io;
+
+extern "C" char* g_fmt(char*, double);
 
 /**
  * Apply XML encoding to a string.  This is adapted from TinyXML (written by Lee Thomason).
@@ -106,93 +111,271 @@ static void encodeString(const string& str, string* outString) {
     }
 }
 
-void XmlSerializer::serialize(const SerializationNode& node, std::ostream& stream) {
-    stream << "<?xml version=\"1.0\" ?>\n";
-    encodeNode(node, stream, 0);
-}
-
-void XmlSerializer::encodeNode(const SerializationNode& node, std::ostream& stream, int depth) {
-    for (int i = 0; i < depth; i++)
-        stream << '\t';
-    stream << '<' << node.getName();
-    const map<string, string>& properties = node.getProperties();
-    for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter) {
-        string name, value;
-        encodeString(iter->first, &name);
-        encodeString(iter->second, &value);
-        stream << ' ' << name << "=\"" << value << '\"';
-    }
-    const vector<SerializationNode>& children = node.getChildren();
-    if (children.size() == 0)
-        stream << "/>\n";
-    else {
-        stream << ">\n";
-        for (int i = 0; i < (int) children.size(); i++)
-            encodeNode(children[i], stream, depth+1);
-        for (int i = 0; i < depth; i++)
-            stream << '\t';
-        stream << "</" << node.getName() << ">\n";
-    }
-}
-
 /**
- * Adapter class to let irrXML read a C++ stream.
+ * This class writes nodes to an XML stream as they are received.  A start tag is left open until
+ * either a child is written (so it ends with ">") or the node is finished (so it ends with "/>").
  */
-class XmlSerializer::StreamReader : public IFileReadCallBack {
+class XmlSerializer::XmlWriter : public SerializationWriter {
 public:
-    StreamReader(std::istream& stream) : stream(stream) {
-        stream.seekg(0, ios_base::end);
-        size = stream.tellg();
-        stream.seekg(0);
+    XmlWriter(std::ostream& stream) : stream(stream), startTagOpen(false) {
     }
-    int read(void* buffer, int sizeToRead) {
-        stream.read((char*) buffer, sizeToRead);
-        return stream.gcount();
+    void beginNode(const SerializationNode& node) {
+        if (startTagOpen)
+            stream << ">\n";
+        for (int i = 0; i < (int) openNodes.size(); i++)
+            stream << '\t';
+        stream << '<' << node.getName();
+        const map<string, string>& properties = node.getProperties();
+        for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter) {
+            string name, value;
+            encodeString(iter->first, &name);
+            encodeString(iter->second, &value);
+            stream << ' ' << name << "=\"" << value << '\"';
+        }
+
+        // Array properties are written as whitespace separated lists of values.
+
+        const map<string, vector<double> >& doubleArrays = node.getDoubleArrayProperties();
+        for (map<string, vector<double> >::const_iterator iter = doubleArrays.begin(); iter != doubleArrays.end(); ++iter) {
+            string name;
+            encodeString(iter->first, &name);
+            stream << ' ' << name << "=\"";
+            char buffer[32];
+            for (int i = 0; i < (int) iter->second.size(); i++) {
+                g_fmt(buffer, iter->second[i]);
+                if (i > 0)
+                    stream << ' ';
+                stream << buffer;
+            }
+            stream << '\"';
+        }
+        const map<string, vector<int> >& intArrays = node.getIntArrayProperties();
+        for (map<string, vector<int> >::const_iterator iter = intArrays.begin(); iter != intArrays.end(); ++iter) {
+            string name;
+            encodeString(iter->first, &name);
+            stream << ' ' << name << "=\"";
+            for (int i = 0; i < (int) iter->second.size(); i++) {
+                if (i > 0)
+                    stream << ' ';
+                stream << iter->second[i];
+            }
+            stream << '\"';
+        }
+        openNodes.push_back(node.getName());
+        startTagOpen = true;
     }
-    int getSize() {
-        return size;
+    void endNode() {
+        string name = openNodes.back();
+        openNodes.pop_back();
+        if (startTagOpen)
+            stream << "/>\n";
+        else {
+            for (int i = 0; i < (int) openNodes.size(); i++)
+                stream << '\t';
+            stream << "</" << name << ">\n";
+        }
+        startTagOpen = false;
     }
 private:
-    std::istream& stream;
-    int size;
+    std::ostream& stream;
+    vector<string> openNodes;
+    bool startTagOpen;
 };
 
 /**
- * Process an XML node, storing its content into a SerializationNode.
+ * This class parses an XML stream incrementally, reading only as much of it as is needed to return
+ * the next node.  It supports the subset of XML needed for serialized objects: elements, attributes,
+ * and the standard character entities.  Text content, comments, processing instructions, and
+ * declarations are skipped.
  */
-static void decodeNode(SerializationNode& node, IrrXMLReader& xml) {
-    for (int i = 0; i < xml.getAttributeCount(); i++)
-        node.setStringProperty(xml.getAttributeName(i), xml.getAttributeValue(i));
-    if (xml.isEmptyElement())
-        return;
-    while (xml.read()) {
-        switch (xml.getNodeType()) {
-            case EXN_ELEMENT:
-            {
-                SerializationNode& childNode = node.createChildNode(xml.getNodeName());
-                decodeNode(childNode, xml);
-                break;
+class XmlSerializer::XmlReader : public SerializationReader {
+public:
+    XmlReader(std::istream& stream) : buffer(*stream.rdbuf()), currentEnded(false) {
+    }
+    bool beginNode(SerializationNode& node) {
+        if (currentEnded)
+            return false;
+        while (true) {
+            // Skip over any text until the next tag.
+
+            int c = buffer.sbumpc();
+            while (c != '<' && c != EOF)
+                c = buffer.sbumpc();
+            if (c == EOF) {
+                if (openNodes.size() == 0)
+                    return false;
+                throw OpenMMException("Unexpected end of XML document");
             }
-            case EXN_ELEMENT_END:
-                return;
+            c = buffer.sgetc();
+            if (c == '?') {
+                skipPast("?>");
+                continue;
+            }
+            if (c == '!') {
+                buffer.sbumpc();
+                if (buffer.sgetc() == '-') {
+                    skipPast("--");
+                    skipPast("-->");
+                }
+                else if (buffer.sgetc() == '[')
+                    skipPast("]]>");
+                else
+                    skipPast(">");
+                continue;
+            }
+            if (c == '/') {
+                // This is the end of the current node.
+
+                buffer.sbumpc();
+                string name = readName();
+                skipPast(">");
+                if (openNodes.size() == 0 || name != openNodes.back())
+                    throw OpenMMException("Mismatched end tag in XML document: "+name);
+                currentEnded = true;
+                return false;
+            }
+
+            // This is the start of a new node.  Read its name and attributes.
+
+            node = SerializationNode();
+            string name = readName();
+            if (name.size() == 0)
+                throw OpenMMException("Illegal tag in XML document");
+            node.setName(name);
+            while (true) {
+                skipWhitespace();
+                c = buffer.sbumpc();
+                if (c == '/' || c == '>') {
+                    if (c == '/' && buffer.sbumpc() != '>')
+                        throw OpenMMException("Illegal tag in XML document: "+name);
+                    openNodes.push_back(name);
+                    currentEnded = (c == '/');
+                    return true;
+                }
+                if (c == EOF)
+                    throw OpenMMException("Unexpected end of XML document");
+                buffer.sungetc();
+                string attribute = readName();
+                skipWhitespace();
+                if (attribute.size() == 0 || buffer.sbumpc() != '=')
+                    throw OpenMMException("Illegal attribute in XML tag: "+name);
+                skipWhitespace();
+                int quote = buffer.sbumpc();
+                if (quote != '"' && quote != '\'')
+                    throw OpenMMException("Illegal attribute in XML tag: "+name);
+                node.setStringProperty(attribute, readValue(quote));
+            }
+        }
+    }
+    void endNode() {
+        if (openNodes.size() == 0)
+            throw OpenMMException("endNode() called without a matching beginNode()");
+        SerializationNode child;
+        while (!currentEnded)
+            if (beginNode(child))
+                endNode();
+        openNodes.pop_back();
+        currentEnded = false;
+    }
+private:
+    static bool isNameChar(int c) {
+        return (c != EOF && c != '/' && c != '>' && c != '=' && c != '<' && !isspace(c));
+    }
+    void skipWhitespace() {
+        while (buffer.sgetc() != EOF && isspace(buffer.sgetc()))
+            buffer.sbumpc();
+    }
+    void skipPast(const char* terminator) {
+        int length = strlen(terminator);
+        string recent;
+        while ((int) recent.size() < length || recent.compare(recent.size()-length, length, terminator) != 0) {
+            int c = buffer.sbumpc();
+            if (c == EOF)
+                throw OpenMMException("Unexpected end of XML document");
+            recent += (char) c;
+            if ((int) recent.size() > 2*length)
+                recent.erase(0, length);
+        }
+    }
+    string readName() {
+        string name;
+        while (isNameChar(buffer.sgetc()))
+            name += (char) buffer.sbumpc();
+        return name;
+    }
+    /**
+     * Read an attribute value up to the closing quote, decoding character entities.
+     */
+    string readValue(int quote) {
+        string value;
+        while (true) {
+            int c = buffer.sbumpc();
+            if (c == EOF)
+                throw OpenMMException("Unexpected end of XML document");
+            if (c == quote)
+                return value;
+            if (c != '&') {
+                value += (char) c;
+                continue;
+            }
+            string entity;
+            while ((c = buffer.sbumpc()) != ';') {
+                if (c == EOF || entity.size() > 10)
+                    throw OpenMMException("Illegal character entity in XML document");
+                entity += (char) c;
+            }
+            if (entity == "amp")
+                value += '&';
+            else if (entity == "lt")
+                value += '<';
+            else if (entity == "gt")
+                value += '>';
+            else if (entity == "quot")
+                value += '"';
+            else if (entity == "apos")
+                value += '\'';
+            else if (entity.size() > 1 && entity[0] == '#') {
+                unsigned long code = (entity[1] == 'x' ? strtoul(entity.c_str()+2, NULL, 16) : strtoul(entity.c_str()+1, NULL, 10));
+                appendUtf8(code, value);
+            }
+            else
+                value += '&'+entity+';';
+        }
+    }
+    static void appendUtf8(unsigned long code, string& value) {
+        if (code < 0x80)
+            value += (char) code;
+        else if (code < 0x800) {
+            value += (char) (0xC0 | (code>>6));
+            value += (char) (0x80 | (code&0x3F));
+        }
+        else if (code < 0x10000) {
+            value += (char) (0xE0 | (code>>12));
+            value += (char) (0x80 | ((code>>6)&0x3F));
+            value += (char) (0x80 | (code&0x3F));
+        }
+        else {
+            value += (char) (0xF0 | (code>>18));
+            value += (char) (0x80 | ((code>>12)&0x3F));
+            value += (char) (0x80 | ((code>>6)&0x3F));
+            value += (char) (0x80 | (code&0x3F));
         }
     }
+    std::streambuf& buffer;
+    vector<string> openNodes;
+    bool currentEnded;
+};
+
+void XmlSerializer::serializeObject(const void* object, const SerializationProxy& proxy, const std::string& rootName, std::ostream& stream) {
+    stream << "<?xml version=\"1.0\" ?>\n";
+    XmlWriter writer(stream);
+    writer.writeObject(rootName, object, proxy);
 }
 
 void* XmlSerializer::deserializeStream(std::istream& stream) {
-    SerializationNode root;
-    StreamReader reader(stream);
-    IrrXMLReader* xml = createIrrXMLReader(&reader);
-    
-    // Find the root node in the file.
-    
-    while (xml->read() && xml->getNodeType() != EXN_ELEMENT)
-        ;
-    decodeNode(root, *xml);
-    delete xml;
-    
-    // Process the SerializationNodes.
-    
-    const SerializationProxy& proxy = SerializationProxy::getProxy(root.getStringProperty("type"));
-    return proxy.deserialize(root);
+    XmlReader reader(stream);
+    void* object = reader.readObject<void>();
+    if (object == NULL)
+        throw OpenMMException("The XML document does not contain any object");
+    return object;
 }
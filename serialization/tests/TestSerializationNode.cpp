@@ -32,6 +32,7 @@
 #include "openmm/internal/AssertionUtilities.h"
 #include "openmm/serialization/SerializationNode.h"
 #include <iostream>
+#include <vector>
 
 using namespace OpenMM;
 using namespace std;
@@ -75,9 +76,61 @@ void testProperties() {
     ASSERT_EQUAL(false, node.hasProperty("prop2"));
 }
 
+void testArrayProperties() {
+    SerializationNode node;
+    vector<double> doubles;
+    doubles.push_back(1.5);
+    doubles.push_back(-2e-10);
+    doubles.push_back(1.0/3.0);
+    vector<int> ints;
+    ints.push_back(5);
+    ints.push_back(-7);
+    node.setDoubleArrayProperty("doubles", doubles);
+    node.setIntArrayProperty("ints", ints);
+    ASSERT_EQUAL(true, node.hasProperty("doubles"));
+    ASSERT_EQUAL(true, node.hasProperty("ints"));
+    ASSERT(doubles == node.getDoubleArrayProperty("doubles"));
+    ASSERT(ints == node.getIntArrayProperty("ints"));
+
+    // An int array can be read as doubles, but not the other way around.
+
+    vector<double> converted = node.getDoubleArrayProperty("ints");
+    ASSERT_EQUAL(2, converted.size());
+    ASSERT_EQUAL(-7.0, converted[1]);
+    bool threwException = false;
+    try {
+        node.getIntArrayProperty("doubles");
+    }
+    catch (const exception& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+
+    // Arrays can also be parsed from whitespace separated strings, as happens when reading XML.
+
+    node.setStringProperty("doubles", " 1.5 -2e-10\n0.3333333333333333 ");
+    node.setStringProperty("ints", "5 -7");
+    node.setStringProperty("empty", "");
+    node.setStringProperty("text", "1 abc");
+    ASSERT_EQUAL(0, node.getDoubleArrayProperties().size());
+    ASSERT_EQUAL(0, node.getIntArrayProperties().size());
+    ASSERT(doubles == node.getDoubleArrayProperty("doubles"));
+    ASSERT(ints == node.getIntArrayProperty("ints"));
+    ASSERT_EQUAL(0, node.getDoubleArrayProperty("empty").size());
+    threwException = false;
+    try {
+        node.getDoubleArrayProperty("text");
+    }
+    catch (const exception& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
 int main() {
     try {
         testProperties();
+        testArrayProperties();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
@@ -0,0 +1,195 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/Context.h"
+#include "openmm/CustomIntegrator.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/LangevinIntegrator.h"
+#include "openmm/NonbondedForce.h"
+#include "openmm/Platform.h"
+#include "openmm/System.h"
+#include "openmm/VerletIntegrator.h"
+#include "openmm/VirtualSite.h"
+#include "openmm/serialization/BinarySerializer.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace OpenMM;
+using namespace std;
+
+template <class T>
+string toXml(const T* object, const string& rootName) {
+    stringstream buffer;
+    XmlSerializer::serialize<T>(object, rootName, buffer);
+    return buffer.str();
+}
+
+template <class T>
+T* binaryRoundTrip(const T* object, const string& rootName) {
+    stringstream buffer(ios::in | ios::out | ios::binary);
+    BinarySerializer::serialize<T>(object, rootName, buffer);
+    return BinarySerializer::deserialize<T>(buffer);
+}
+
+System* createSystem() {
+    System* system = new System();
+    system->setDefaultPeriodicBoxVectors(Vec3(5, 0, 0), Vec3(0, 6, 0), Vec3(0, 0, 7));
+    for (int i = 0; i < 20; i++)
+        system->addParticle(i == 19 ? 0.0 : 0.1*i+1.0/3.0);
+    system->setVirtualSite(19, new TwoParticleAverageSite(0, 1, 0.4, 0.6));
+    system->addConstraint(2, 3, 0.15);
+    NonbondedForce* nonbonded = new NonbondedForce();
+    nonbonded->setNonbondedMethod(NonbondedForce::PME);
+    for (int i = 0; i < 20; i++)
+        nonbonded->addParticle(i%2 == 0 ? 0.5 : -0.5, 0.3+0.001*i, 0.2);
+    nonbonded->addException(0, 1, 0.1, 0.2, 0.3);
+    system->addForce(nonbonded);
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    bonds->addBond(4, 5, 0.1, 1000.0);
+    bonds->addBond(5, 6, 0.12, 1e-7);
+    system->addForce(bonds);
+    return system;
+}
+
+void testSystem() {
+    System* system = createSystem();
+    System* copy = binaryRoundTrip(system, "System");
+    ASSERT_EQUAL(toXml(system, "System"), toXml(copy, "System"));
+    delete system;
+    delete copy;
+}
+
+void testIntegrators() {
+    LangevinIntegrator langevin(301.1, 0.9, 0.002);
+    langevin.setRandomNumberSeed(5);
+    Integrator* langevinCopy = binaryRoundTrip<Integrator>(&langevin, "Integrator");
+    ASSERT_EQUAL(toXml<Integrator>(&langevin, "Integrator"), toXml(langevinCopy, "Integrator"));
+    delete langevinCopy;
+    CustomIntegrator custom(0.001);
+    custom.addGlobalVariable("a", 1.5);
+    custom.addPerDofVariable("b", 0.0);
+    custom.addComputePerDof("v", "v+dt*f/m");
+    custom.addComputePerDof("x", "x+dt*v");
+    Integrator* customCopy = binaryRoundTrip<Integrator>(&custom, "Integrator");
+    ASSERT_EQUAL(toXml<Integrator>(&custom, "Integrator"), toXml(customCopy, "Integrator"));
+    delete customCopy;
+}
+
+void testState() {
+    System* system = createSystem();
+    VerletIntegrator integrator(0.001);
+    Context context(*system, integrator, Platform::getPlatformByName("Reference"));
+    vector<Vec3> positions, velocities;
+    for (int i = 0; i < system->getNumParticles(); i++) {
+        positions.push_back(Vec3(0.3*i, 0.1*i*i, 1.0/(i+1)));
+        velocities.push_back(Vec3(-0.7*i, 1e-10*i, 3.0/(i+1)));
+    }
+    context.setPositions(positions);
+    context.setVelocities(velocities);
+    State state = context.getState(State::Positions | State::Velocities | State::Forces | State::Energy | State::Parameters);
+    string xml = toXml(&state, "State");
+
+    // Serialize it to a stream and verify that it is reconstructed exactly, and is smaller than the XML.
+
+    stringstream buffer(ios::in | ios::out | ios::binary);
+    BinarySerializer::serialize<State>(&state, "State", buffer);
+    ASSERT(buffer.str().size() < xml.size());
+    State* copy = BinarySerializer::deserialize<State>(buffer);
+    ASSERT_EQUAL(xml, toXml(copy, "State"));
+    for (int i = 0; i < system->getNumParticles(); i++) {
+        ASSERT_EQUAL_VEC(state.getPositions()[i], copy->getPositions()[i], 0);
+        ASSERT_EQUAL_VEC(state.getVelocities()[i], copy->getVelocities()[i], 0);
+    }
+    delete copy;
+
+    // Load it again from a memory mapped file.
+
+    string filename = "TestSerializeBinary.bin";
+    {
+        ofstream file(filename.c_str(), ios::out | ios::binary);
+        file << buffer.str();
+    }
+    copy = BinarySerializer::deserializeFile<State>(filename);
+    remove(filename.c_str());
+    ASSERT_EQUAL(xml, toXml(copy, "State"));
+    delete copy;
+    delete system;
+}
+
+void testInvalidData() {
+    System* system = createSystem();
+    stringstream buffer(ios::in | ios::out | ios::binary);
+    BinarySerializer::serialize(system, "System", buffer);
+    string data = buffer.str();
+    string xml = toXml(system, "System");
+    delete system;
+
+    // Truncated data and data that is not in the binary format should both be rejected.
+
+    bool threwException = false;
+    try {
+        stringstream truncated(data.substr(0, data.size()/2), ios::in | ios::binary);
+        BinarySerializer::deserialize<System>(truncated);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+    threwException = false;
+    try {
+        stringstream xmlBuffer(xml);
+        BinarySerializer::deserialize<System>(xmlBuffer);
+    }
+    catch (const OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+int main() {
+    try {
+        testSystem();
+        testIntegrators();
+        testState();
+        testInvalidData();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
@@ -108,9 +108,45 @@ void testSerialization() {
     }
 }
 
+void testVersion1Format() {
+    // Older versions stored one node per particle and exception.  Make sure they can still be read.
+
+    string xml = "<?xml version=\"1.0\" ?>\n"
+        "<Force alpha=\"0\" cutoff=\"1\" dispersionCorrection=\"1\" ewaldTolerance=\".0005\" forceGroup=\"2\" method=\"0\" "
+        "nx=\"0\" ny=\"0\" nz=\"0\" recipForceGroup=\"-1\" rfDielectric=\"78.3\" switchingDistance=\"-1\" type=\"NonbondedForce\" "
+        "useSwitchingFunction=\"0\" version=\"1\">\n"
+        "\t<Particles>\n"
+        "\t\t<Particle eps=\".01\" q=\"1\" sig=\".1\"/>\n"
+        "\t\t<Particle eps=\".02\" q=\"-.5\" sig=\".2\"/>\n"
+        "\t</Particles>\n"
+        "\t<Exceptions>\n"
+        "\t\t<Exception eps=\".1\" p1=\"0\" p2=\"1\" q=\"2\" sig=\".5\"/>\n"
+        "\t</Exceptions>\n"
+        "</Force>\n";
+    stringstream buffer(xml);
+    NonbondedForce* force = XmlSerializer::deserialize<NonbondedForce>(buffer);
+    ASSERT_EQUAL(2, force->getForceGroup());
+    ASSERT_EQUAL(2, force->getNumParticles());
+    double charge, sigma, epsilon;
+    force->getParticleParameters(1, charge, sigma, epsilon);
+    ASSERT_EQUAL(-0.5, charge);
+    ASSERT_EQUAL(0.2, sigma);
+    ASSERT_EQUAL(0.02, epsilon);
+    ASSERT_EQUAL(1, force->getNumExceptions());
+    int particle1, particle2;
+    force->getExceptionParameters(0, particle1, particle2, charge, sigma, epsilon);
+    ASSERT_EQUAL(0, particle1);
+    ASSERT_EQUAL(1, particle2);
+    ASSERT_EQUAL(2.0, charge);
+    ASSERT_EQUAL(0.5, sigma);
+    ASSERT_EQUAL(0.1, epsilon);
+    delete force;
+}
+
 int main() {
     try {
         testSerialization();
+        testVersion1Format();
     }
     catch(const exception& e) {
         cout << "exception: " << e.what() << endl;
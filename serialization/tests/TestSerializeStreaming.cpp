@@ -0,0 +1,195 @@
+/* -------------------------------------------------------------------------- *
+ *                                   OpenMM                                   *
+ * -------------------------------------------------------------------------- *
+ * This is part of the OpenMM molecular simulation toolkit originating from   *
+ * Simbios, the NIH National Center for Physics-Based Simulation of           *
+ * Biological Structures at Stanford, funded under the NIH Roadmap for        *
+ * Medical Research, grant U54 GM072970. See https://simtk.org.               *
+ *                                                                            *
+ * Portions copyright (c) 2015 Stanford University and the Authors.           *
+ * Authors: Peter Eastman                                                     *
+ * Contributors:                                                              *
+ *                                                                            *
+ * Permission is hereby granted, free of charge, to any person obtaining a    *
+ * copy of this software and associated documentation files (the "Software"), *
+ * to deal in the Software without restriction, including without limitation  *
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,   *
+ * and/or sell copies of the Software, and to permit persons to whom the      *
+ * Software is furnished to do so, subject to the following conditions:       *
+ *                                                                            *
+ * The above copyright notice and this permission notice shall be included in *
+ * all copies or substantial portions of the Software.                        *
+ *                                                                            *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR *
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,   *
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL    *
+ * THE AUTHORS, CONTRIBUTORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,    *
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR      *
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE  *
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.                                     *
+ * -------------------------------------------------------------------------- */
+
+
+#include "openmm/internal/AssertionUtilities.h"
+#include "openmm/HarmonicBondForce.h"
+#include "openmm/NonbondedForce.h"
+#include "openmm/State.h"
+#include "openmm/System.h"
+#include "openmm/VirtualSite.h"
+#include "openmm/serialization/SerializationWriter.h"
+#include "openmm/serialization/XmlSerializer.h"
+#include <iostream>
+#include <sstream>
+
+using namespace OpenMM;
+using namespace std;
+
+/**
+ * This SerializationWriter assembles the nodes it receives into a tree, so the output of the
+ * streaming path can be compared to the tree built by SerializationProxy::serialize().
+ */
+class TreeWriter : public SerializationWriter {
+public:
+    void beginNode(const SerializationNode& node) {
+        SerializationNode& newNode = (openNodes.size() == 0 ? root : openNodes.back()->createChildNode(""));
+        newNode.setName(node.getName());
+        const map<string, string>& properties = node.getProperties();
+        for (map<string, string>::const_iterator iter = properties.begin(); iter != properties.end(); ++iter)
+            newNode.setStringProperty(iter->first, iter->second);
+        const map<string, vector<double> >& doubleArrays = node.getDoubleArrayProperties();
+        for (map<string, vector<double> >::const_iterator iter = doubleArrays.begin(); iter != doubleArrays.end(); ++iter)
+            newNode.setDoubleArrayProperty(iter->first, iter->second);
+        const map<string, vector<int> >& intArrays = node.getIntArrayProperties();
+        for (map<string, vector<int> >::const_iterator iter = intArrays.begin(); iter != intArrays.end(); ++iter)
+            newNode.setIntArrayProperty(iter->first, iter->second);
+        openNodes.push_back(&newNode);
+    }
+    void endNode() {
+        openNodes.pop_back();
+    }
+    SerializationNode root;
+private:
+    vector<SerializationNode*> openNodes;
+};
+
+void assertNodesEqual(const SerializationNode& node1, const SerializationNode& node2) {
+    ASSERT_EQUAL(node1.getName(), node2.getName());
+    ASSERT(node1.getProperties() == node2.getProperties());
+    ASSERT(node1.getDoubleArrayProperties() == node2.getDoubleArrayProperties());
+    ASSERT(node1.getIntArrayProperties() == node2.getIntArrayProperties());
+    ASSERT_EQUAL(node1.getChildren().size(), node2.getChildren().size());
+    for (int i = 0; i < (int) node1.getChildren().size(); i++)
+        assertNodesEqual(node1.getChildren()[i], node2.getChildren()[i]);
+}
+
+System* createSystem() {
+    System* system = new System();
+    for (int i = 0; i < 10; i++)
+        system->addParticle(0.1*i+1);
+    system->addParticle(0.0);
+    system->setVirtualSite(10, new ThreeParticleAverageSite(2, 4, 3, 0.5, 0.2, 0.3));
+    system->addConstraint(0, 1, 3.0);
+    system->addConstraint(4, 1, 1.001);
+    system->setDefaultPeriodicBoxVectors(Vec3(5, 0, 0), Vec3(0, 4, 0), Vec3(0, 0, 1.5));
+    HarmonicBondForce* bonds = new HarmonicBondForce();
+    bonds->addBond(1, 2, 1.5, 100.0);
+    system->addForce(bonds);
+    NonbondedForce* nonbonded = new NonbondedForce();
+    nonbonded->setNonbondedMethod(NonbondedForce::PME);
+    nonbonded->setCutoffDistance(1.2);
+    for (int i = 0; i < 11; i++)
+        nonbonded->addParticle(0.1*(i%3-1), 0.3+0.01*i, 0.5);
+    nonbonded->addException(0, 1, 0.0, 1.0, 0.0);
+    nonbonded->addException(2, 5, 0.1, 0.2, 0.3);
+    system->addForce(nonbonded);
+    return system;
+}
+
+void testStreamMatchesTree() {
+    // The streaming and tree based serialization paths should produce identical nodes.
+
+    System* system = createSystem();
+    const SerializationProxy& proxy = SerializationProxy::getProxy(typeid(*system));
+    SerializationNode tree;
+    tree.setName("System");
+    proxy.serialize(system, tree);
+    tree.setStringProperty("type", proxy.getTypeName());
+    TreeWriter writer;
+    writer.writeObject("System", system);
+    assertNodesEqual(tree, writer.root);
+    delete system;
+}
+
+void testRoundTrip() {
+    // Serialize a System, deserialize it, and serialize it again.  The two documents should be identical.
+
+    System* system = createSystem();
+    stringstream buffer;
+    XmlSerializer::serialize<System>(system, "System", buffer);
+    System* copy = XmlSerializer::deserialize<System>(buffer);
+    stringstream buffer2;
+    XmlSerializer::serialize<System>(copy, "System", buffer2);
+    ASSERT_EQUAL(buffer.str(), buffer2.str());
+    ASSERT_EQUAL(11, copy->getNumParticles());
+    ASSERT_EQUAL(2, copy->getNumConstraints());
+    ASSERT(copy->isVirtualSite(10));
+    const NonbondedForce& nonbonded = dynamic_cast<const NonbondedForce&>(copy->getForce(1));
+    ASSERT_EQUAL(NonbondedForce::PME, nonbonded.getNonbondedMethod());
+    ASSERT_EQUAL(11, nonbonded.getNumParticles());
+    ASSERT_EQUAL(2, nonbonded.getNumExceptions());
+    delete system;
+    delete copy;
+}
+
+void testParseFormatting() {
+    // Parse a hand written document that uses comments, single quotes, character references, irregular
+    // whitespace, and an element the proxy does not recognize.
+
+    string xml = "<?xml version=\"1.0\" ?>\n"
+            "<!-- A State written by hand -->\n"
+            "<State type='State' version=\"1\" time = \"2.5\">\n"
+            "  <Unknown><Nested a=\"1\"/><!-- <Positions/> --></Unknown>\n"
+            "  <PeriodicBoxVectors><A x=\"1\" y=\"0\" z=\"0\"/><B x=\"0\" y=\"&#50;\" z=\"0\"/><C x=\"0\" y=\"0\" z=\"&#x33;\"/></PeriodicBoxVectors>\n"
+            "  <Positions>\n"
+            "    <Position x=\"1\" y=\"2\" z=\"3\"/>\n"
+            "    <Position\n x='4' y='5' z='6' />\n"
+            "  </Positions>\n"
+            "</State>\n";
+    stringstream buffer(xml);
+    State* state = XmlSerializer::deserialize<State>(buffer);
+    ASSERT_EQUAL(2.5, state->getTime());
+    Vec3 a, b, c;
+    state->getPeriodicBoxVectors(a, b, c);
+    ASSERT_EQUAL_VEC(Vec3(1, 0, 0), a, 0);
+    ASSERT_EQUAL_VEC(Vec3(0, 2, 0), b, 0);
+    ASSERT_EQUAL_VEC(Vec3(0, 0, 3), c, 0);
+    ASSERT_EQUAL(2, state->getPositions().size());
+    ASSERT_EQUAL_VEC(Vec3(4, 5, 6), state->getPositions()[1], 0);
+    delete state;
+
+    // A truncated document should throw an exception.
+
+    stringstream truncated(xml.substr(0, xml.find("</Positions>")));
+    bool threwException = false;
+    try {
+        XmlSerializer::deserialize<State>(truncated);
+    }
+    catch (OpenMMException& ex) {
+        threwException = true;
+    }
+    ASSERT(threwException);
+}
+
+int main() {
+    try {
+        testStreamMatchesTree();
+        testRoundTrip();
+        testParseFormatting();
+    }
+    catch(const exception& e) {
+        cout << "exception: " << e.what() << endl;
+        return 1;
+    }
+    cout << "Done" << endl;
+    return 0;
+}
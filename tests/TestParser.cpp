@@ -102,6 +102,23 @@ void verifyEvaluation(const string& expression, double x, double y, double expec
     value = compiled.evaluate();
     ASSERT_EQUAL_TOL(expectedValue, value, 1e-10);
 
+    // Create CompiledVectorExpressions of each width and check that every element gives the same result.
+
+    const vector<int>& widths = CompiledVectorExpression::getAllowedWidths();
+    for (int w = 0; w < (int) widths.size(); w++) {
+        int width = widths[w];
+        CompiledVectorExpression vectorCompiled = parsed.createCompiledVectorExpression(width);
+        for (int i = 0; i < width; i++) {
+            if (vectorCompiled.getVariables().find("x") != vectorCompiled.getVariables().end())
+                vectorCompiled.getVariablePointer("x")[i] = x;
+            if (vectorCompiled.getVariables().find("y") != vectorCompiled.getVariables().end())
+                vectorCompiled.getVariablePointer("y")[i] = y;
+        }
+        const float* values = vectorCompiled.evaluate();
+        for (int i = 0; i < width; i++)
+            ASSERT_EQUAL_TOL(expectedValue, values[i], 1e-5);
+    }
+
     // Make sure that variable renaming works.
 
     variables.clear();
@@ -208,6 +225,114 @@ void testCustomFunction(const string& expression, const string& equivalent) {
     verifySameValue(deriv3, deriv4, 2.0, -3.0);
 }
 
+/**
+ * Verify that a CompiledVectorExpression is accurate over a range of values.  If relative is true, the error
+ * is measured relative to the expected value.  Otherwise it is measured relative to max(1, |expected|).
+ */
+
+void verifyVectorAccuracy(const string& expression, double minX, double maxX, bool relative, double tol) {
+    ParsedExpression parsed = Parser::parse(expression).optimize();
+    CompiledVectorExpression compiled = parsed.createCompiledVectorExpression(4);
+    float* x = compiled.getVariablePointer("x");
+    const int numPoints = 1000;
+    map<string, double> variables;
+    for (int i = 0; i < numPoints; i += 4) {
+        for (int j = 0; j < 4; j++)
+            x[j] = (float) (minX+(maxX-minX)*(i+j)/(numPoints-1));
+        const float* values = compiled.evaluate();
+        for (int j = 0; j < 4; j++) {
+            variables["x"] = x[j];
+            double expected = parsed.evaluate(variables);
+            if (relative) {
+                ASSERT_EQUAL_TOL(1.0, values[j]/expected, tol);
+            }
+            else {
+                ASSERT_EQUAL_TOL(expected, values[j], tol);
+            }
+        }
+    }
+}
+
+/**
+ * Test the inline implementations of functions in CompiledVectorExpression, including special values.
+ */
+
+void testVectorFunctions() {
+    verifyVectorAccuracy("exp(x)", -87, 88, true, 1e-6);
+    verifyVectorAccuracy("exp(x)", -1, 1, true, 1e-6);
+    verifyVectorAccuracy("log(x)", 1e-6, 1, false, 1e-6);
+    verifyVectorAccuracy("log(x)", 1, 1e6, false, 1e-6);
+    verifyVectorAccuracy("sin(x)", -100, 100, false, 1e-6);
+    verifyVectorAccuracy("cos(x)", -100, 100, false, 1e-6);
+    verifyVectorAccuracy("sin(x)", -1, 1, false, 1e-6);
+    verifyVectorAccuracy("cos(x)", -1, 1, false, 1e-6);
+    verifyVectorAccuracy("erfc(x)", -4, 1, false, 1e-6);
+    verifyVectorAccuracy("erfc(x)", 1, 8, true, 1e-5);
+    verifyVectorAccuracy("x^5", -4, 4, true, 1e-6);
+    verifyVectorAccuracy("x^-3", -4, 4, true, 1e-6);
+    verifyVectorAccuracy("x^8", -4, 4, true, 1e-6);
+    verifyVectorAccuracy("step(x-0.5)*x^2", -4, 4, false, 1e-6);
+    CompiledVectorExpression compiled = Parser::parse("exp(x)+log(y)").createCompiledVectorExpression(4);
+    float* x = compiled.getVariablePointer("x");
+    float* y = compiled.getVariablePointer("y");
+    x[0] = -200.0f;
+    y[0] = 1.0f;
+    x[1] = 200.0f;
+    y[1] = 1.0f;
+    x[2] = 0.0f;
+    y[2] = 0.0f;
+    x[3] = 0.0f;
+    y[3] = -1.0f;
+    const float* values = compiled.evaluate();
+    if (values[0] != 0.0f || values[1] != numeric_limits<float>::infinity() ||
+            values[2] != -numeric_limits<float>::infinity() || values[3] == values[3])
+        throw exception();
+}
+
+/**
+ * Test compiling several expressions together.
+ */
+
+void testMultipleOutputs() {
+    vector<ParsedExpression> expressions;
+    expressions.push_back(Parser::parse("x^2*exp(y)"));
+    expressions.push_back(Parser::parse("x^2*exp(y)").differentiate("x"));
+    expressions.push_back(Parser::parse("x"));
+    expressions.push_back(Parser::parse("3"));
+    double x = 1.5, y = -0.5;
+    double expected[] = {x*x*exp(y), 2*x*exp(y), x, 3};
+    CompiledExpression compiled(expressions);
+    ASSERT_EQUAL_TOL(4.0, compiled.getNumOutputs(), 0.0);
+    compiled.getVariableReference("x") = x;
+    compiled.getVariableReference("y") = y;
+    ASSERT_EQUAL_TOL(expected[0], compiled.evaluate(), 1e-10);
+    for (int i = 0; i < 4; i++)
+        ASSERT_EQUAL_TOL(expected[i], compiled.getOutput(i), 1e-10);
+    CompiledExpression copy = compiled;
+    copy.getVariableReference("x") = x;
+    copy.getVariableReference("y") = y;
+    ASSERT_EQUAL_TOL(expected[0], copy.evaluate(), 1e-10);
+    ASSERT_EQUAL_TOL(expected[1], copy.getOutput(1), 1e-10);
+    const vector<int>& widths = CompiledVectorExpression::getAllowedWidths();
+    for (int w = 0; w < (int) widths.size(); w++) {
+        int width = widths[w];
+        CompiledVectorExpression vectorCompiled(expressions, width);
+        ASSERT_EQUAL_TOL(4.0, vectorCompiled.getNumOutputs(), 0.0);
+        for (int j = 0; j < width; j++) {
+            vectorCompiled.getVariablePointer("x")[j] = x+j;
+            vectorCompiled.getVariablePointer("y")[j] = y;
+        }
+        vectorCompiled.evaluate();
+        for (int j = 0; j < width; j++) {
+            double xj = x+j;
+            ASSERT_EQUAL_TOL(xj*xj*exp(y), vectorCompiled.getOutput(0)[j], 1e-5);
+            ASSERT_EQUAL_TOL(2*xj*exp(y), vectorCompiled.getOutput(1)[j], 1e-5);
+            ASSERT_EQUAL_TOL(xj, vectorCompiled.getOutput(2)[j], 1e-5);
+            ASSERT_EQUAL_TOL(3.0, vectorCompiled.getOutput(3)[j], 1e-5);
+        }
+    }
+}
+
 int main() {
     try {
         verifyEvaluation("5", 5.0);
@@ -284,6 +409,8 @@ int main() {
         verifyDerivative("floor(x)+0.5*x*ceil(x)", "0.5*ceil(x)");
         testCustomFunction("custom(x, y)/2", "x*y");
         testCustomFunction("custom(x^2, 1)+custom(2, y-1)", "2*x^2+4*(y-1)");
+        testVectorFunctions();
+        testMultipleOutputs();
         cout << Parser::parse("x*x").optimize() << endl;
         cout << Parser::parse("x*(x*x)").optimize() << endl;
         cout << Parser::parse("(x*x)*x").optimize() << endl;
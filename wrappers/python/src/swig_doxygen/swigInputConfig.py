@@ -242,6 +242,7 @@ UNITS = {
 ("AmoebaMultipoleForce",                 "getMutualInducedTargetEpsilon")                 :  ( None, ()),
 ("AmoebaMultipoleForce",                 "getEwaldErrorTolerance")                        :  ( None, ()),
 ("AmoebaMultipoleForce",                 "getPmeGridDimensions")                          :  ( None,()),
+("AmoebaMultipoleForce",                 "getExtrapolationCoefficients")                  :  ( None,()),
 
 # AmoebaMultipoleForce methods starting w/ getMultipoleParameters need work
 